@@ -3,8 +3,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <stdlib.h>
+#include <stdint.h>
+#include <new>
 
 #include "Maths.h"
+#include "FrameStats.h"
 
 struct Bone
 {
@@ -19,7 +23,7 @@ struct Skeleton
 	Matrix globalInverse;
 	int findBone(std::string name)
 	{
-		for (int i = 0; i < bones.size(); i++)
+		for (int i = 0; i < (int)bones.size(); i++)
 		{
 			if (bones[i].name == name)
 			{
@@ -30,17 +34,128 @@ struct Skeleton
 	}
 };
 
-struct AnimationFrame
+// Heap array whose first element sits on a 16 byte boundary. Only for trivially copyable types.
+// Throws std::bad_alloc like std::vector when the memory is not there
+template<typename T>
+class AlignedArray
 {
-	std::vector<Vec3> positions;
-	std::vector<Quaternion> rotations;
-	std::vector<Vec3> scales;
+public:
+	T* data;
+	int count;
+	AlignedArray()
+	{
+		block = nullptr;
+		data = nullptr;
+		count = 0;
+	}
+	AlignedArray(const AlignedArray& other)
+	{
+		block = nullptr;
+		data = nullptr;
+		count = 0;
+		*this = other;
+	}
+	AlignedArray(AlignedArray&& other)
+	{
+		block = other.block;
+		data = other.data;
+		count = other.count;
+		other.block = nullptr;
+		other.data = nullptr;
+		other.count = 0;
+	}
+	AlignedArray& operator=(const AlignedArray& other)
+	{
+		if (this != &other)
+		{
+			resize(other.count);
+			if (count > 0)
+			{
+				memcpy(data, other.data, count * sizeof(T));
+			}
+		}
+		return *this;
+	}
+	AlignedArray& operator=(AlignedArray&& other)
+	{
+		if (this != &other)
+		{
+			free(block);
+			block = other.block;
+			data = other.data;
+			count = other.count;
+			other.block = nullptr;
+			other.data = nullptr;
+			other.count = 0;
+		}
+		return *this;
+	}
+	~AlignedArray()
+	{
+		free(block);
+	}
+	// Contents are not kept. On failure the array is left empty before the exception
+	void resize(int n)
+	{
+		free(block);
+		block = nullptr;
+		data = nullptr;
+		count = 0;
+		if (n <= 0)
+		{
+			return;
+		}
+		block = (unsigned char*)malloc((size_t)n * sizeof(T) + 15);
+		if (block == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		data = (T*)(((uintptr_t)block + 15) & ~(uintptr_t)15);
+		count = n;
+	}
+	int size() const
+	{
+		return count;
+	}
+	T& operator[](int index)
+	{
+		return data[index];
+	}
+	const T& operator[](int index) const
+	{
+		return data[index];
+	}
+private:
+	unsigned char* block;
 };
 
 struct AnimationSequence // This holds rescaled times
 {
-	std::vector<AnimationFrame> frames;
+	// One contiguous track per channel, indexed [frame * bonesN + bone]
+	AlignedArray<Vec3> positions;
+	AlignedArray<Quaternion> rotations;
+	AlignedArray<Vec3> scales;
+	int framesN;
+	int bonesN;
 	float ticksPerSecond;
+	AnimationSequence()
+	{
+		framesN = 0;
+		bonesN = 0;
+		ticksPerSecond = 1.0f;
+	}
+	void init(int frames, int bones)
+	{
+		framesN = frames;
+		bonesN = bones;
+		positions.resize(frames * bones);
+		rotations.resize(frames * bones);
+		scales.resize(frames * bones);
+	}
+	int key(int frame, int bone) const
+	{
+		return (frame * bonesN) + bone;
+	}
 	Vec3 interpolate(Vec3 p1, Vec3 p2, float t)
 	{
 		return ((p1 * (1.0f - t)) + (p2 * t));
@@ -51,18 +166,18 @@ struct AnimationSequence // This holds rescaled times
 	}
 	float duration()
 	{
-		return ((float)frames.size() / ticksPerSecond);
+		return ((float)framesN / ticksPerSecond);
 	}
 	void calcFrame(float t, int& frame, float& interpolationFact)
 	{
 		interpolationFact = t * ticksPerSecond;
 		frame = (int)floorf(interpolationFact);
 		interpolationFact = interpolationFact - (float)frame;
-		frame = std::min(frame, (int)(frames.size() - 1));
+		frame = std::min(frame, framesN - 1);
 	}
 	bool running(float t)
 	{
-		if ((int)floorf(t * ticksPerSecond) < frames.size())
+		if ((int)floorf(t * ticksPerSecond) < framesN)
 		{
 			return true;
 		}
@@ -70,17 +185,27 @@ struct AnimationSequence // This holds rescaled times
 	}
 	int nextFrame(int frame)
 	{
-		return std::min(frame + 1, (int)(frames.size() - 1));
+		return std::min(frame + 1, framesN - 1);
+	}
+	// Sample the bone's local translation, rotation and scale without building a matrix
+	void sampleLocal(int baseFrame, float interpolationFact, int boneIndex, Vec3& translation, Quaternion& rotation, Vec3& scale)
+	{
+		int k0 = key(baseFrame, boneIndex);
+		int k1 = key(nextFrame(baseFrame), boneIndex);
+		scale = interpolate(scales[k0], scales[k1], interpolationFact);
+		rotation = interpolate(rotations[k0], rotations[k1], interpolationFact);
+		translation = interpolate(positions[k0], positions[k1], interpolationFact);
 	}
 	Matrix interpolateBoneToGlobal(Matrix* matrices, int baseFrame, float interpolationFact, Skeleton* skeleton, int boneIndex)
 	{
-		Matrix scale = Matrix::scaling(interpolate(frames[baseFrame].scales[boneIndex], frames[nextFrame(baseFrame)].scales[boneIndex], interpolationFact));
-		Matrix rotation = interpolate(frames[baseFrame].rotations[boneIndex], frames[nextFrame(baseFrame)].rotations[boneIndex], interpolationFact).toMatrix();
-		Matrix translation = Matrix::translation(interpolate(frames[baseFrame].positions[boneIndex], frames[nextFrame(baseFrame)].positions[boneIndex], interpolationFact));
-		Matrix local = scale * rotation * translation;
+		Vec3 translation;
+		Quaternion rotation;
+		Vec3 scale;
+		sampleLocal(baseFrame, interpolationFact, boneIndex, translation, rotation, scale);
+		Matrix local = Matrix::fromTRS(translation, rotation, scale);
 		if (skeleton->bones[boneIndex].parentIndex > -1)
 		{
-			Matrix global = local * matrices[skeleton->bones[boneIndex].parentIndex];
+			Matrix global = local.mulAffine(matrices[skeleton->bones[boneIndex].parentIndex]);
 			return global;
 		}
 		return local;
@@ -96,28 +221,55 @@ public:
 	{
 		return skeleton.bones.size();
 	}
-	void calcFrame(std::string name, float t, int& frame, float& interpolationFact)
+	// Resolve a clip name once and keep the pointer, the per-frame calls below take the clip directly
+	AnimationSequence* findAnimation(const std::string& name)
 	{
-		animations[name].calcFrame(t, frame, interpolationFact);
+		frameStats().current.clipLookups++;
+		std::map<std::string, AnimationSequence>::iterator it = animations.find(name);
+		if (it == animations.end())
+		{
+			return nullptr;
+		}
+		return &it->second;
 	}
-	Matrix interpolateBoneToGlobal(std::string name, Matrix* matrices, int baseFrame, float interpolationFact, int boneIndex)
+	void calcFrame(AnimationSequence* clip, float t, int& frame, float& interpolationFact)
 	{
-		return animations[name].interpolateBoneToGlobal(matrices, baseFrame, interpolationFact, &skeleton, boneIndex);
+		clip->calcFrame(t, frame, interpolationFact);
 	}
-	void calcTransforms(Matrix* matrices, Matrix coordTransform)
+	Matrix interpolateBoneToGlobal(AnimationSequence* clip, Matrix* matrices, int baseFrame, float interpolationFact, int boneIndex)
+	{
+		return clip->interpolateBoneToGlobal(matrices, baseFrame, interpolationFact, &skeleton, boneIndex);
+	}
+	// Blend two clips in local TRS space and write the global pose of every live bone.
+	// Only bonesSize() entries of matrices are touched, calcTransforms still has to be applied afterwards
+	void blendBonesToGlobal(AnimationSequence* clipA, int frameA, float factA, AnimationSequence* clipB, int frameB, float factB, float weight, Matrix* matrices)
 	{
 		for (int i = 0; i < bonesSize(); i++)
 		{
-			matrices[i] = skeleton.bones[i].offset * matrices[i] * skeleton.globalInverse * coordTransform;
+			Vec3 translationA, scaleA, translationB, scaleB;
+			Quaternion rotationA, rotationB;
+			clipA->sampleLocal(frameA, factA, i, translationA, rotationA, scaleA);
+			clipB->sampleLocal(frameB, factB, i, translationB, rotationB, scaleB);
+			Matrix local = Matrix::fromTRS((translationA * (1.0f - weight)) + (translationB * weight),
+				Quaternion::slerp(rotationA, rotationB, weight),
+				(scaleA * (1.0f - weight)) + (scaleB * weight));
+			int parent = skeleton.bones[i].parentIndex;
+			matrices[i] = (parent > -1) ? local.mulAffine(matrices[parent]) : local;
 		}
 	}
-	bool hasAnimation(std::string name)
+	void calcTransforms(Matrix* matrices, Matrix coordTransform)
 	{
-		if (animations.find(name) == animations.end())
+		// globalInverse * coordTransform is the same for every bone
+		Matrix tail = skeleton.globalInverse * coordTransform;
+		for (int i = 0; i < bonesSize(); i++)
 		{
-			return false;
+			Matrix local = skeleton.bones[i].offset * matrices[i];
+			Matrix::mul(local, tail, matrices[i]);
 		}
-		return true;
+	}
+	bool hasAnimation(const std::string& name)
+	{
+		return (findAnimation(name) != nullptr);
 	}
 };
 
@@ -125,7 +277,7 @@ class AnimationInstance
 {
 public:
 	Animation* animation;
-	std::string usingAnimation;
+	AnimationSequence* usingAnimation;
 	float t;
 	Matrix matrices[256]; // This is defined as 256 to match the maximum number in the shader
 	Matrix matricesPose[256]; // This is to store transforms needed for finding bone positions
@@ -133,6 +285,8 @@ public:
 	void init(Animation* _animation, int fromYZX)
 	{
 		animation = _animation;
+		usingAnimation = nullptr;
+		t = 0;
 		if (fromYZX == 1)
 		{
 			memset(coordTransform.a, 0, 16 * sizeof(float));
@@ -142,36 +296,50 @@ public:
 			coordTransform.a[3][3] = 1.0f;
 		}
 	}
-	void update(std::string name, float dt)
+	// Advance the clock only, switching clip restarts from t = 0
+	void advance(AnimationSequence* clip, float dt)
 	{
-		if (name == usingAnimation)
+		if (clip == usingAnimation)
 		{
 			t += dt;
 		} else
 		{
-			usingAnimation = name;
+			usingAnimation = clip;
 			t = 0;
 		}
-		if (animationFinished() == true)
+	}
+	// Evaluate the pose at the current time into matrices, frames past the end clamp to the last key
+	void evaluate()
+	{
+		if (usingAnimation == nullptr)
 		{
 			return;
 		}
 		int frame = 0;
 		float interpolationFact = 0;
-		animation->calcFrame(name, t, frame, interpolationFact);
+		animation->calcFrame(usingAnimation, t, frame, interpolationFact);
 		for (int i = 0; i < animation->bonesSize(); i++)
 		{
-			matrices[i] = animation->interpolateBoneToGlobal(name, matrices, frame, interpolationFact, i);
+			matrices[i] = animation->interpolateBoneToGlobal(usingAnimation, matrices, frame, interpolationFact, i);
 		}
 		animation->calcTransforms(matrices, coordTransform);
 	}
+	void update(AnimationSequence* clip, float dt)
+	{
+		advance(clip, dt);
+		if (animationFinished() == true)
+		{
+			return;
+		}
+		evaluate();
+	}
 	void resetAnimationTime()
 	{
 		t = 0;
 	}
 	bool animationFinished()
 	{
-		if (t > animation->animations[usingAnimation].duration())
+		if (usingAnimation == nullptr || t > usingAnimation->duration())
 		{
 			return true;
 		}
@@ -180,6 +348,10 @@ public:
 	Matrix findWorldMatrix(std::string boneName)
 	{
 		int boneID = animation->skeleton.findBone(boneName);
+		if (boneID == -1 || usingAnimation == nullptr)
+		{
+			return coordTransform;
+		}
 		std::vector<int> boneChain;
 		int ID = boneID;
 		while (ID != -1)
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include "stb_image.h"
+#include "JobSystem.h"
+#include "ModelCache.h"
+
+// CPU half of asset loading. File reads, GEM parsing/cooking, animation conversion and image decoding
+// run as jobs on a JobSystem; the main thread then picks the results up one by one and does the GPU upload.
+// Nothing here touches D3D so it can run (and be timed) without a device.
+
+// Resolve a texture name found in a GEM material against the model's texture folder
+inline std::string resolveModelTexturePath(const std::string& value, const std::string& modelFolder)
+{
+	if (modelFolder.empty() || value.find('/') == 0 || value.find('\\') == 0)
+	{
+		return value;
+	}
+	if (value.find("Models/") == 0 || value.find("Models\\") == 0)
+	{
+		return value;
+	}
+	return modelFolder + "/" + value;
+}
+
+// RGBA8 pixels from stb_image, free with stbi_image_free once uploaded
+struct DecodedImage
+{
+	unsigned char* pixels;
+	int width;
+	int height;
+	int channels;
+};
+
+struct PreloadedModel
+{
+	CookedModel cooked;
+	Animation animation; // Filled only for animated models
+	bool loaded;
+};
+
+class AssetPreloader
+{
+public:
+	AssetPreloader()
+	{
+		jobs = nullptr;
+		decodeMs = 0;
+		lastFinishMs = 0;
+		requested = 0;
+	}
+	AssetPreloader(const AssetPreloader&) = delete;
+	AssetPreloader& operator=(const AssetPreloader&) = delete;
+	~AssetPreloader()
+	{
+		if (jobs != nullptr)
+		{
+			jobs->wait();
+		}
+		for (std::map<std::string, ImageEntry>::iterator it = images.begin(); it != images.end(); ++it)
+		{
+			if (it->second.image.pixels != nullptr)
+			{
+				stbi_image_free(it->second.image.pixels);
+			}
+		}
+		for (std::map<std::string, ModelEntry>::iterator it = models.begin(); it != models.end(); ++it)
+		{
+			delete it->second.model;
+		}
+	}
+
+	void init(JobSystem* _jobs)
+	{
+		jobs = _jobs;
+		start = std::chrono::high_resolution_clock::now();
+	}
+
+	// Queue an image decode, repeated requests for the same file are ignored
+	void requestImage(const std::string& filename)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (images.find(filename) != images.end())
+			{
+				return;
+			}
+			ImageEntry& entry = images[filename];
+			entry.image.pixels = nullptr;
+			entry.image.width = 0;
+			entry.image.height = 0;
+			entry.image.channels = 0;
+			entry.done = false;
+			requested++;
+		}
+		jobs->submit([this, filename]()
+		{
+			std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+			DecodedImage image;
+			image.pixels = stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, 4);
+			double ms = elapsedMs(t0);
+			std::lock_guard<std::mutex> lock(mutex);
+			ImageEntry& entry = images[filename];
+			entry.image = image;
+			entry.done = true;
+			finish(ms);
+		});
+	}
+
+	// Queue a model load (cooked cache, rebuilt when stale). Once its materials are known the
+	// textures they reference are queued as well, resolved against textureFolder
+	void requestModel(const std::string& filename, const std::string& textureFolder)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (models.find(filename) != models.end())
+			{
+				return;
+			}
+			ModelEntry& entry = models[filename];
+			entry.model = new PreloadedModel();
+			entry.model->loaded = false;
+			entry.done = false;
+			requested++;
+		}
+		jobs->submit([this, filename, textureFolder]()
+		{
+			std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+			PreloadedModel* model;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				model = models[filename].model;
+			}
+			model->loaded = model->cooked.load(filename);
+			if (model->loaded)
+			{
+				for (int i = 0; i < model->cooked.meshes.size(); i++)
+				{
+					GEMLoader::GEMMaterial& material = model->cooked.meshes[i].material;
+					requestMaterialTexture(material, "albedo", "diffuse", textureFolder);
+					requestMaterialTexture(material, "nh", "normal", textureFolder);
+					requestMaterialTexture(material, "rmax", "specular", textureFolder);
+				}
+				if (model->cooked.animated)
+				{
+					model->cooked.fillAnimation(model->animation);
+				}
+			}
+			double ms = elapsedMs(t0);
+			std::lock_guard<std::mutex> lock(mutex);
+			models[filename].done = true;
+			finish(ms);
+		});
+	}
+
+	// Wait for a requested image and hand its pixels to the caller. Returns false if it was never requested
+	bool takeImage(const std::string& filename, DecodedImage& image)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		std::map<std::string, ImageEntry>::iterator it = images.find(filename);
+		if (it == images.end())
+		{
+			return false;
+		}
+		finished.wait(lock, [&it]() { return it->second.done; });
+		image = it->second.image;
+		it->second.image.pixels = nullptr;
+		return true;
+	}
+
+	// Wait for a requested model, the preloader keeps ownership until releaseModel
+	PreloadedModel* acquireModel(const std::string& filename)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		std::map<std::string, ModelEntry>::iterator it = models.find(filename);
+		if (it == models.end())
+		{
+			return nullptr;
+		}
+		finished.wait(lock, [&it]() { return it->second.done; });
+		return it->second.model;
+	}
+
+	// Drop the mapping and CPU copies once the GPU upload is done
+	void releaseModel(const std::string& filename)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::string, ModelEntry>::iterator it = models.find(filename);
+		if (it != models.end() && it->second.done)
+		{
+			delete it->second.model;
+			it->second.model = nullptr;
+		}
+	}
+
+	void waitAll()
+	{
+		jobs->wait();
+	}
+
+	// Sum of decode time across jobs against wall time since init, the gap is what the thread pool saved
+	void printStats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		printf("Asset preload: %d assets, decode %.1f ms total, %.1f ms wall on %d threads\n",
+			requested, decodeMs, lastFinishMs, jobs->workerCount());
+	}
+
+private:
+	struct ImageEntry
+	{
+		DecodedImage image;
+		bool done;
+	};
+	struct ModelEntry
+	{
+		PreloadedModel* model;
+		bool done;
+	};
+
+	JobSystem* jobs;
+	std::mutex mutex;
+	std::condition_variable finished;
+	std::map<std::string, ImageEntry> images;
+	std::map<std::string, ModelEntry> models;
+	std::chrono::high_resolution_clock::time_point start;
+	double decodeMs;
+	double lastFinishMs;
+	int requested;
+
+	static double elapsedMs(std::chrono::high_resolution_clock::time_point from)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - from).count();
+	}
+
+	// Called with the mutex held
+	void finish(double ms)
+	{
+		decodeMs += ms;
+		lastFinishMs = elapsedMs(start);
+		finished.notify_all();
+	}
+
+	void requestMaterialTexture(GEMLoader::GEMMaterial& material, const std::string& name, const std::string& fallback, const std::string& textureFolder)
+	{
+		GEMLoader::GEMMaterialProperty prop = material.find(name);
+		if (prop.value.empty())
+		{
+			prop = material.find(fallback);
+		}
+		if (!prop.value.empty())
+		{
+			requestImage(resolveModelTexturePath(prop.value, textureFolder));
+		}
+	}
+};
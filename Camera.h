@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "Maths.h"
 #include "GameObject.h"
+#include "Lod.h"
 enum class CameraMode
 {
 	THIRD_PERSON,  // 第三人称跟随相机
@@ -36,6 +37,9 @@ private:
 	float orbitHeight;
 	Vec3 orbitCenter;
 
+	// 最近一次 getViewProjection 算出的相机位置
+	Vec3 eyePosition;
+
 public:
 	CameraManager()
 	{
@@ -117,8 +121,8 @@ public:
 			{
 				// 第三人称相机跟随玩家
 				// 相机位置 = 玩家位置 + 偏移
-				from = player->position + thirdPersonOffset;
-				target = player->position + Vec3(3, 10, 5);
+				from = player->renderPosition + thirdPersonOffset;
+				target = player->renderPosition + Vec3(3, 10, 5);
 			}
 			else
 			{
@@ -138,7 +142,7 @@ public:
 				Vec3 forward(-sinf(theta), 0.0f, -cosf(theta));
 
 				// 相机位置 = 玩家位置 + 高度偏移 + 前向偏移(避免穿模)
-				from = player->position + Vec3(0, firstPersonOffset.y, 0) + forward * firstPersonOffset.z;
+				from = player->renderPosition + Vec3(0, firstPersonOffset.y, 0) + forward * firstPersonOffset.z;
 				
 				// 目标点 = 相机位置 + 前方向量
 				target = from + forward;
@@ -170,9 +174,25 @@ public:
 			break;
 		}
 
+		eyePosition = from;
 		return v * p;
 	}
 
+	// 获取相机位置（以最近一次 getViewProjection 为准）
+	Vec3 getPosition() const
+	{
+		return eyePosition;
+	}
+
+	// LOD 选择用的相机参数（以最近一次 getViewProjection 为准）
+	LodView lodView() const
+	{
+		LodView view;
+		view.eye = eyePosition;
+		view.projectionScale = 1.0f / tanf(fov * 0.5f * 3.141592654f / 180.0f);
+		return view;
+	}
+
 	// 获取当前模式
 	CameraMode getMode() const
 	{
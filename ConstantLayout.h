@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+
+// Byte layout of constant buffers as reported by shader reflection. Nothing here touches D3D:
+// Shader fills these from ID3D12ShaderReflection, and the same layouts can be written out as text
+// and read back so lookups and handle resolution can be checked without a device.
+
+struct ConstantBufferVariable
+{
+	unsigned int offset;
+	unsigned int size;
+};
+
+class ConstantBufferLayout
+{
+public:
+	std::string name;
+	std::map<std::string, ConstantBufferVariable> variables;
+	unsigned int sizeInBytes; // End of the last variable, before the 256 byte rounding of the GPU buffer
+
+	ConstantBufferLayout()
+	{
+		sizeInBytes = 0;
+	}
+
+	void addVariable(const std::string& variableName, unsigned int offset, unsigned int size)
+	{
+		ConstantBufferVariable variable;
+		variable.offset = offset;
+		variable.size = size;
+		variables[variableName] = variable;
+		if (offset + size > sizeInBytes)
+		{
+			sizeInBytes = offset + size;
+		}
+	}
+
+	bool find(const std::string& variableName, ConstantBufferVariable& variable) const
+	{
+		std::map<std::string, ConstantBufferVariable>::const_iterator it = variables.find(variableName);
+		if (it == variables.end())
+		{
+			return false;
+		}
+		variable = it->second;
+		return true;
+	}
+};
+
+// Where one variable lives in a shader stage: index of the cbuffer plus the byte range inside it
+struct ConstantLocation
+{
+	int bufferIndex;
+	unsigned int offset;
+	unsigned int size;
+};
+
+// Look a variable up by cbuffer and variable name. Returns false (bufferIndex -1, size 0) when either is missing
+inline bool resolveConstantLocation(const std::vector<ConstantBufferLayout>& layouts, const std::string& bufferName, const std::string& variableName, ConstantLocation& location)
+{
+	location.bufferIndex = -1;
+	location.offset = 0;
+	location.size = 0;
+	for (int i = 0; i < (int)layouts.size(); i++)
+	{
+		if (layouts[i].name != bufferName)
+		{
+			continue;
+		}
+		ConstantBufferVariable variable;
+		if (!layouts[i].find(variableName, variable))
+		{
+			return false;
+		}
+		location.bufferIndex = i;
+		location.offset = variable.offset;
+		location.size = variable.size;
+		return true;
+	}
+	return false;
+}
+
+// Text record of a stage's layouts, one cbuffer per block:
+//   cbuffer <name> <count>
+//   <variable> <offset> <size>     (count lines)
+inline std::string writeConstantLayouts(const std::vector<ConstantBufferLayout>& layouts)
+{
+	std::ostringstream out;
+	for (int i = 0; i < (int)layouts.size(); i++)
+	{
+		out << "cbuffer " << layouts[i].name << " " << layouts[i].variables.size() << "\n";
+		for (std::map<std::string, ConstantBufferVariable>::const_iterator it = layouts[i].variables.begin(); it != layouts[i].variables.end(); ++it)
+		{
+			out << it->first << " " << it->second.offset << " " << it->second.size << "\n";
+		}
+	}
+	return out.str();
+}
+
+inline bool readConstantLayouts(const std::string& text, std::vector<ConstantBufferLayout>& layouts)
+{
+	layouts.clear();
+	std::istringstream in(text);
+	std::string keyword;
+	while (in >> keyword)
+	{
+		ConstantBufferLayout layout;
+		int count = 0;
+		if (keyword != "cbuffer" || !(in >> layout.name >> count) || count < 0)
+		{
+			return false;
+		}
+		for (int i = 0; i < count; i++)
+		{
+			std::string variableName;
+			unsigned int offset;
+			unsigned int size;
+			if (!(in >> variableName >> offset >> size))
+			{
+				return false;
+			}
+			layout.addVariable(variableName, offset, size);
+		}
+		layouts.push_back(layout);
+	}
+	return true;
+}
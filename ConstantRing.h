@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+
+// Slot bookkeeping for a per-frame upload buffer made of fixed-size slots: one slot per draw for a
+// constant buffer, one per instance for an instance stream.
+// The buffer is split into one segment per frame in flight; a frame only allocates from its own
+// segment, so slots the GPU may still be reading for the other frames are never overwritten.
+// A segment becomes reusable once the fence value recorded when it was closed has completed.
+// When a segment runs out the ring doubles; the old storage must stay alive until every frame that
+// could still reference it has retired, which takes one more pass over all segments.
+// No graphics API types here, ConstantBuffer owns the D3D resource and fences.
+class ConstantSlotRing
+{
+public:
+	ConstantSlotRing()
+	{
+		init(0, 1);
+	}
+
+	void init(unsigned int _slotsPerSegment, int _segments)
+	{
+		slotsPerSegment = _slotsPerSegment;
+		segments = _segments;
+		used.assign(segments, 0);
+		fences.assign(segments, 0);
+		current = -1;
+		frame = 0;
+		peak = 0;
+		grows = 0;
+		retired.clear();
+	}
+
+	// Start allocating for a new frame from segment. Its fence (segmentFence) must have completed
+	void beginFrame(int segment, unsigned long long frameNumber)
+	{
+		current = segment;
+		frame = frameNumber;
+		used[current] = 0;
+	}
+
+	// Fence value that will signal once the GPU has finished the frame that used the current segment
+	void closeFrame(long long fenceValue)
+	{
+		if (current < 0)
+		{
+			return;
+		}
+		fences[current] = fenceValue;
+		current = -1;
+	}
+
+	long long segmentFence(int segment) const
+	{
+		return fences[segment];
+	}
+
+	// Absolute slot index in the current storage, false when the segment is full (call grow)
+	bool allocate(unsigned int& slot)
+	{
+		return allocate(1, slot);
+	}
+
+	// count consecutive slots starting at first, false when they do not fit in the segment (call grow)
+	bool allocate(unsigned int count, unsigned int& first)
+	{
+		if (current < 0 || count > slotsPerSegment - used[current])
+		{
+			return false;
+		}
+		first = (current * slotsPerSegment) + used[current];
+		used[current] += count;
+		if (used[current] > peak)
+		{
+			peak = used[current];
+		}
+		return true;
+	}
+
+	// Double the segments. The caller switches to new storage of totalSlots() and keeps the old one
+	// until releaseRetired says it is free. Earlier slots of this frame stay valid in the old storage,
+	// so nothing has to be copied
+	void grow()
+	{
+		retired.push_back(frame + segments);
+		slotsPerSegment = slotsPerSegment > 0 ? slotsPerSegment * 2 : 1;
+		for (int i = 0; i < segments; i++)
+		{
+			used[i] = 0;
+		}
+		grows++;
+	}
+
+	// Number of retired storages (oldest first) that no in-flight frame can reference any more
+	int releaseRetired(unsigned long long frameNumber)
+	{
+		int count = 0;
+		while (!retired.empty() && retired.front() <= frameNumber)
+		{
+			retired.pop_front();
+			count++;
+		}
+		return count;
+	}
+
+	int currentSegment() const
+	{
+		return current;
+	}
+
+	unsigned int usedSlots() const
+	{
+		return current < 0 ? 0 : used[current];
+	}
+
+	// Most slots any single frame has needed so far
+	unsigned int peakSlots() const
+	{
+		return peak;
+	}
+
+	unsigned int segmentSlots() const
+	{
+		return slotsPerSegment;
+	}
+
+	unsigned int totalSlots() const
+	{
+		return slotsPerSegment * segments;
+	}
+
+	int growCount() const
+	{
+		return grows;
+	}
+
+	int retiredCount() const
+	{
+		return (int)retired.size();
+	}
+
+private:
+	unsigned int slotsPerSegment;
+	int segments;
+	std::vector<unsigned int> used;
+	std::vector<long long> fences;
+	int current;
+	unsigned long long frame;
+	unsigned int peak;
+	int grows;
+	std::deque<unsigned long long> retired; // Frame number from which each retired storage can be freed
+};
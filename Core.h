@@ -3,6 +3,7 @@
 #include <d3d12.h>
 #include <dxgi1_4.h>
 #include <vector>
+#include "UploadRing.h"
 
 #pragma comment(lib, "d3d12")
 #pragma comment(lib, "dxgi")
@@ -27,12 +28,20 @@ public:
 	}
 	void wait()
 	{
-		if (fence->GetCompletedValue() < value)
+		waitFor(value);
+	}
+	void waitFor(long long target)
+	{
+		if ((long long)fence->GetCompletedValue() < target)
 		{
-			fence->SetEventOnCompletion(value, eventHandle);
+			fence->SetEventOnCompletion(target, eventHandle);
 			WaitForSingleObject(eventHandle, INFINITE);
 		}
 	}
+	long long completed()
+	{
+		return (long long)fence->GetCompletedValue();
+	}
 	~GPUFence()
 	{
 		CloseHandle(eventHandle);
@@ -56,6 +65,196 @@ public:
 	}
 };
 
+// Coalesces resource uploads into one COPY command list executed on the copy queue.
+// Source data is staged in a persistent, persistently mapped UPLOAD buffer managed by UploadRing;
+// a submit only happens when the ring runs out of space or the caller flushes.
+// Destination resources must be created in D3D12_RESOURCE_STATE_COMMON: the copy queue promotes them to
+// COPY_DEST implicitly and they decay back to COMMON afterwards, from where the graphics queue promotes
+// buffers and textures to the read states it needs.
+class UploadBatcher
+{
+public:
+	ID3D12Resource* staging;
+	unsigned char* mapped;
+	UploadRing ring;
+	ID3D12Device5* device;
+	ID3D12CommandQueue* queue;
+	ID3D12CommandAllocator* allocators[2];
+	long long allocatorFence[2];
+	ID3D12GraphicsCommandList* commandList;
+	GPUFence fence;
+	int current;
+	bool recording;
+	int submits;
+	long long queueWaitValue;
+	// Uploads larger than the whole ring get their own buffer, released once the copy has completed
+	struct TemporaryUpload
+	{
+		ID3D12Resource* resource;
+		long long fenceValue;
+	};
+	std::vector<TemporaryUpload> temporaries;
+
+	void init(ID3D12Device5* _device, ID3D12CommandQueue* _queue, unsigned long long capacity)
+	{
+		device = _device;
+		queue = _queue;
+		staging = createUploadBuffer(capacity);
+		staging->Map(0, nullptr, reinterpret_cast<void**>(&mapped));
+		ring.init(capacity);
+		for (int i = 0; i < 2; i++)
+		{
+			device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocators[i]));
+			allocatorFence[i] = 0;
+		}
+		device->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_COPY, D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&commandList));
+		fence.create(device);
+		current = 0;
+		recording = false;
+		submits = 0;
+		queueWaitValue = 0;
+	}
+	void upload(ID3D12Resource* dstResource, const void* data, unsigned int size, D3D12_PLACED_SUBRESOURCE_FOOTPRINT* texFootprint)
+	{
+		ID3D12Resource* src = staging;
+		unsigned long long offset = 0;
+		if (size > ring.size())
+		{
+			src = createUploadBuffer(size);
+			void* temp = nullptr;
+			src->Map(0, nullptr, &temp);
+			memcpy(temp, data, size);
+			src->Unmap(0, nullptr);
+		} else
+		{
+			unsigned long long alignment = (texFootprint != NULL) ? D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT : 16;
+			while (!ring.allocate(size, alignment, offset))
+			{
+				makeRoom();
+			}
+			memcpy(mapped + offset, data, size);
+		}
+		begin();
+		if (texFootprint != NULL)
+		{
+			D3D12_TEXTURE_COPY_LOCATION srcLocation = {};
+			srcLocation.pResource = src;
+			srcLocation.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+			srcLocation.PlacedFootprint = *texFootprint;
+			srcLocation.PlacedFootprint.Offset = offset;
+			D3D12_TEXTURE_COPY_LOCATION dstLocation = {};
+			dstLocation.pResource = dstResource;
+			dstLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+			dstLocation.SubresourceIndex = 0;
+			commandList->CopyTextureRegion(&dstLocation, 0, 0, 0, &srcLocation, nullptr);
+		} else
+		{
+			commandList->CopyBufferRegion(dstResource, 0, src, offset, size);
+		}
+		if (src != staging)
+		{
+			TemporaryUpload temporary;
+			temporary.resource = src;
+			temporary.fenceValue = fence.value + 1; // Value signalled by the next submit
+			temporaries.push_back(temporary);
+		}
+	}
+	// Execute everything recorded so far on the copy queue, does not wait
+	void submit()
+	{
+		if (!recording)
+		{
+			return;
+		}
+		commandList->Close();
+		ID3D12CommandList* lists[] = { commandList };
+		queue->ExecuteCommandLists(1, lists);
+		fence.signal(queue);
+		allocatorFence[current] = fence.value;
+		ring.closeBatch(fence.value);
+		current = 1 - current;
+		recording = false;
+		submits++;
+	}
+	// End of a loading phase: submit and wait once for all uploads
+	void flush()
+	{
+		submit();
+		fence.wait();
+		retire();
+	}
+	// Make another queue wait on the GPU for every upload submitted so far, without blocking the CPU
+	void queueWait(ID3D12CommandQueue* otherQueue)
+	{
+		submit();
+		if (fence.value > queueWaitValue && fence.completed() < fence.value)
+		{
+			otherQueue->Wait(fence.fence, fence.value);
+		}
+		queueWaitValue = fence.value;
+	}
+	void release()
+	{
+		flush();
+		staging->Unmap(0, nullptr);
+		staging->Release();
+		commandList->Release();
+		allocators[0]->Release();
+		allocators[1]->Release();
+	}
+
+private:
+	ID3D12Resource* createUploadBuffer(unsigned long long size)
+	{
+		ID3D12Resource* buffer;
+		D3D12_HEAP_PROPERTIES heapProps = {};
+		heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+		D3D12_RESOURCE_DESC bufferDesc = {};
+		bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		bufferDesc.Width = size;
+		bufferDesc.Height = 1;
+		bufferDesc.DepthOrArraySize = 1;
+		bufferDesc.MipLevels = 1;
+		bufferDesc.SampleDesc.Count = 1;
+		bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, NULL, IID_PPV_ARGS(&buffer));
+		return buffer;
+	}
+	void begin()
+	{
+		if (recording)
+		{
+			return;
+		}
+		fence.waitFor(allocatorFence[current]);
+		allocators[current]->Reset();
+		commandList->Reset(allocators[current], NULL);
+		recording = true;
+	}
+	// The ring is full: submit what is pending, then wait for the oldest batch in flight to free its space
+	void makeRoom()
+	{
+		submit();
+		fence.waitFor((long long)ring.oldestFence());
+		retire();
+	}
+	void retire()
+	{
+		long long done = fence.completed();
+		ring.retire((unsigned long long)done);
+		for (int i = 0; i < (int)temporaries.size(); i++)
+		{
+			if (temporaries[i].fenceValue <= done)
+			{
+				temporaries[i].resource->Release();
+				temporaries[i] = temporaries.back();
+				temporaries.pop_back();
+				i--;
+			}
+		}
+	}
+};
+
 class Core
 {
 public:
@@ -79,7 +278,13 @@ public:
 	ID3D12GraphicsCommandList4* graphicsCommandList[2];
 	ID3D12RootSignature* rootSignature;
 	unsigned int srvTableIndex;
+	unsigned int frameConstantsRootIndex;
+	unsigned int frameConstantsRegister;
+	unsigned int textureSetRootIndex;
+	static const unsigned int textureSetSize = 8; // Textures in a set, registers t1..t8
 	GPUFence graphicsQueueFence[2];
+	UploadBatcher uploader;
+	unsigned long long frameNumber; // Incremented by beginFrame
 	int width;
 	int height;
 	HWND windowHandle;
@@ -188,6 +393,10 @@ public:
 
 		graphicsQueueFence[0].create(device);
 		graphicsQueueFence[1].create(device);
+		frameNumber = 0;
+
+		// 64MB staging ring on the copy queue, larger uploads fall back to a one-off buffer
+		uploader.init(device, copyQueue, 64 * 1024 * 1024);
 
 		createRootSignature();
 
@@ -300,6 +509,29 @@ public:
 		rootParameterSRV.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 		parameters.push_back(rootParameterSRV);
 
+		// Root Parameter 3: Per-frame constants (b1), shared by every shader stage
+		D3D12_ROOT_PARAMETER rootParameterCBFrame;
+		rootParameterCBFrame.ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+		rootParameterCBFrame.Descriptor.ShaderRegister = 1; // Register(b1)
+		rootParameterCBFrame.Descriptor.RegisterSpace = 0;
+		rootParameterCBFrame.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+		parameters.push_back(rootParameterCBFrame);
+
+		// Root Parameter 4: SRV Descriptor Table for a set of textures (t1..t8) one draw picks from per instance
+		D3D12_DESCRIPTOR_RANGE textureSetRange;
+		textureSetRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+		textureSetRange.NumDescriptors = textureSetSize;
+		textureSetRange.BaseShaderRegister = 1; // Register(t1)
+		textureSetRange.RegisterSpace = 0;
+		textureSetRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+		D3D12_ROOT_PARAMETER rootParameterTextureSet;
+		rootParameterTextureSet.ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+		rootParameterTextureSet.DescriptorTable.NumDescriptorRanges = 1;
+		rootParameterTextureSet.DescriptorTable.pDescriptorRanges = &textureSetRange;
+		rootParameterTextureSet.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+		parameters.push_back(rootParameterTextureSet);
+
 		// Static Sampler for texture sampling (s0)
 		D3D12_STATIC_SAMPLER_DESC samplerDesc = {};
 		samplerDesc.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
@@ -336,6 +568,9 @@ public:
 		}
 		device->CreateRootSignature(0, serialized->GetBufferPointer(), serialized->GetBufferSize(), IID_PPV_ARGS(&rootSignature));
 		srvTableIndex = 2; // SRV table is at index 2
+		frameConstantsRootIndex = 3;
+		frameConstantsRegister = 1;
+		textureSetRootIndex = 4;
 		serialized->Release();
 	}
 	void resetCommandList()
@@ -350,55 +585,17 @@ public:
 		ID3D12CommandList* lists[] = { getCommandList() };
 		graphicsQueue->ExecuteCommandLists(1, lists);
 	}
+	// Queue a copy into dstResource on the copy queue. dstResource must be in D3D12_RESOURCE_STATE_COMMON,
+	// targetState is then reached by implicit promotion on first use so no barrier is recorded here.
+	// The data is copied into the staging ring before returning, so the caller can free it straight away
 	void uploadResource(ID3D12Resource* dstResource, const void* data, unsigned int size, D3D12_RESOURCE_STATES targetState, D3D12_PLACED_SUBRESOURCE_FOOTPRINT *texFootprint = NULL)
 	{
-		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
-		ID3D12Resource* uploadBuffer;
-		D3D12_HEAP_PROPERTIES heapProps = {};
-		heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-		D3D12_RESOURCE_DESC bufferDesc = {};
-		bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-		bufferDesc.Width = size;
-		bufferDesc.Height = 1;
-		bufferDesc.DepthOrArraySize = 1;
-		bufferDesc.MipLevels = 1;
-		bufferDesc.SampleDesc.Count = 1;
-		bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-		device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, NULL, IID_PPV_ARGS(&uploadBuffer));
-
-		void* mappeddata = nullptr;
-		uploadBuffer->Map(0, nullptr, &mappeddata);
-		memcpy(mappeddata, data, size);
-		uploadBuffer->Unmap(0, nullptr);
-
-		resetCommandList();
-
-		if (texFootprint != NULL)
-		{
-			D3D12_TEXTURE_COPY_LOCATION src = {};
-			src.pResource = uploadBuffer;
-			src.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-			src.PlacedFootprint = *texFootprint;
-			D3D12_TEXTURE_COPY_LOCATION dst = {};
-			dst.pResource = dstResource;
-			dst.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
-			dst.SubresourceIndex = 0;
-			getCommandList()->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
-		} else
-		{
-			getCommandList()->CopyBufferRegion(dstResource, 0, uploadBuffer, 0, size);
-		}
-
-
-		Barrier::add(dstResource, D3D12_RESOURCE_STATE_COPY_DEST, targetState, getCommandList());
-
-		getCommandList()->Close();
-		ID3D12CommandList* lists[] = { getCommandList() };
-		graphicsQueue->ExecuteCommandLists(1, lists);
-
-		flushGraphicsQueue();
-
-		uploadBuffer->Release();
+		uploader.upload(dstResource, data, size, texFootprint);
+	}
+	// Submit pending uploads and wait for them, call once at the end of a loading phase
+	void flushUploads()
+	{
+		uploader.flush();
 	}
 	ID3D12GraphicsCommandList4* getCommandList()
 	{
@@ -409,6 +606,9 @@ public:
 	{
 		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
 		graphicsQueueFence[frameIndex].wait();
+		frameNumber++;
+		// Uploads queued after the last flush must land before this frame's draws read them (GPU side wait only)
+		uploader.queueWait(graphicsQueue);
 		D3D12_CPU_DESCRIPTOR_HANDLE renderTargetViewHandle = backbufferHeap->GetCPUDescriptorHandleForHeapStart();
 		unsigned int renderTargetViewDescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 		renderTargetViewHandle.ptr += frameIndex * renderTargetViewDescriptorSize;
@@ -454,6 +654,7 @@ public:
 			graphicsQueueFence[i].signal(graphicsQueue);
 			graphicsQueueFence[i].wait();
 		}
+		uploader.release();
 		rootSignature->Release();
 		graphicsCommandList[0]->Release();
 		graphicsCommandAllocator[0]->Release();
@@ -4,8 +4,9 @@
 #include "Material.h"
 #include "PSO.h"
 #include "Shaders.h"
+#include "GrassInstance.h"
 
-//用于TerrainTile的草地实例数据结构
+//实例化绘制的每实例数据（完整世界矩阵），用于路、路边草和装饰物；草地用更紧凑的 GrassInstance
 struct InstanceData
 {
 	Matrix worldMatrix;
@@ -120,11 +121,15 @@ public:
 	Mesh mesh;
 	Material* material;
 	std::string shaderName;
+	Shader* shader;
+	ConstantHandle worldHandle;
+	ConstantHandle emissiveHandle;
 	bool initialized;
 
 	Skybox()
 	{
 		material = nullptr;
+		shader = nullptr;
 		initialized = false;
 	}
 
@@ -228,12 +233,15 @@ public:
 			VertexLayoutCache::getStaticLayout());
 
 		shaderName = "SkyboxEmissive";
+		shader = shaders->find(shaderName);
+		worldHandle = shaders->findConstantVS(shaderName, "staticMeshBuffer", "W");
+		emissiveHandle = shaders->findConstantPS(shaderName, "SkyboxBuffer", "emissiveIntensity");
 		initialized = true;
 
 		printf("Skybox initialization complete\n");
 		fflush(stdout);
 	}
-	void draw(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp, Vec3 cameraPosition, TextureManager* textureManager, float emissiveIntensity = 1.0f)
+	void draw(Core* core, PSOManager* psos, Shaders* shaders, Vec3 cameraPosition, TextureManager* textureManager, float emissiveIntensity = 1.0f)
 	{
 		if (!initialized)
 		{
@@ -250,18 +258,17 @@ public:
 		// 天空球跟随相机位置
 		Matrix W = Matrix::translation(cameraPosition);
 
-		// 更新 VS 常量
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "VP", &vp);
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "W", &W);
+		// 更新 VS 常量（VP 在每帧常量块里）
+		shaders->update(worldHandle, &W);
 
 		// 更新天空球自发光常量（PS b1)
-		shaders->updateConstantPS(shaderName, "SkyboxBuffer", "emissiveIntensity", &emissiveIntensity);
+		shaders->update(emissiveHandle, &emissiveIntensity);
 
 		// 绑定纹理堆
 		textureManager->bindHeap(core);
 
 		// 应用着色器和 PSO
-		shaders->apply(core, shaderName);
+		shader->apply(core);
 		psos->bind(core, "SkyboxEmissivePSO");
 
 		// 绑定材质纹理
@@ -282,11 +289,13 @@ public:
 	Mesh mesh;
 	std::vector<Material*> materials;
 	std::string shaderName;
-	float time;
+	Shader* shader;
+	D3D12_GPU_DESCRIPTOR_HANDLE textureSet; // 所有草地贴图连续排列，GrassInstance::type 是下标
 
 	GrassPatch()
 	{
-		time = 0.0f;
+		shader = nullptr;
+		textureSet.ptr = 0;
 	}
 
 	STATIC_VERTEX addVertex(Vec3 p, Vec3 n, float tu, float tv)
@@ -353,11 +362,12 @@ public:
 		// 加载草地着色器
 		shaders->load(core, "Grass", "VSGrass.txt", "PSGrass.txt");
 		shaderName = "Grass";
+		shader = shaders->find(shaderName);
 
 		psos->createPSO(core, "GrassPSO",
 			shaders->find("Grass")->vs,
 			shaders->find("Grass")->ps,
-			VertexLayoutCache::getInstancedLayout()); 
+			VertexLayoutCache::getGrassInstancedLayout());
 		printf("GrassPatch initialized (waiting for textures)\n");
 		fflush(stdout);
 	}
@@ -371,55 +381,34 @@ public:
 		printf("GrassPatch added texture: %s\n", texturePath.c_str());
 	}
 
-	void drawInstanced(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp,
-		TextureManager* textureManager, DirectionalLight* light, float dt,
-		int type, ID3D12Resource* instanceBuffer, int instanceCount)
+	// 所有种类的草一次绘制，每个实例自带贴图编号
+	void drawInstanced(Core* core, PSOManager* psos, Shaders* shaders,
+		TextureManager* textureManager, const D3D12_VERTEX_BUFFER_VIEW& instanceView, int instanceCount)
 	{
-		if (instanceCount == 0) return;
+		if (instanceCount == 0 || materials.empty()) return;
 
-		time += dt;
+		// VP、时间、风和光照都在每帧常量块里，位置、缩放、朝向和贴图编号通过 instanceView 传递，这里没有常量要写
 
-		// 更新全局常量 (VP, Time, Light)
-		// 注意：W 矩阵不再通过这里传递，而是通过 instanceBuffer
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "VP", &vp);
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "time", &time);
-
-		float windStrength = 0.1f;
-		float windSpeed = 0.1f;
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "windStrength", &windStrength);
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "windSpeed", &windSpeed);
-
-		// 光照常量
-		Vec3 lightDir = light->getLightDirectionForShader();
-		shaders->updateConstantPS(shaderName, "LightBuffer", "lightDirection", &lightDir);
-		shaders->updateConstantPS(shaderName, "LightBuffer", "lightIntensity", &light->intensity);
-		shaders->updateConstantPS(shaderName, "LightBuffer", "lightColor", &light->color);
-		shaders->updateConstantPS(shaderName, "LightBuffer", "ambientStrength", &light->ambientStrength);
+		// 贴图全部加入后第一次绘制时建立贴图组
+		if (textureSet.ptr == 0)
+		{
+			std::vector<Texture*> textures;
+			for (int i = 0; i < materials.size(); i++)
+			{
+				textures.push_back(materials[i]->diffuseTexture);
+			}
+			textureSet = textureManager->createTextureSet(textures);
+		}
 
 		// 绑定纹理
 		textureManager->bindHeap(core);
-		if (type >= 0 && type < materials.size())
-		{
-			materials[type]->bind(core);
-		}
+		core->getCommandList()->SetGraphicsRootDescriptorTable(core->textureSetRootIndex, textureSet);
+		frameStats().current.rootBinds++;
 
-		shaders->apply(core, shaderName);
+		shader->apply(core);
 		psos->bind(core, "GrassPSO");
 
-		
-		core->getCommandList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		core->getCommandList()->IASetVertexBuffers(0, 1, &mesh.vbView);
-		core->getCommandList()->IASetIndexBuffer(&mesh.ibView);
-
-		
-		D3D12_VERTEX_BUFFER_VIEW instanceView;
-		instanceView.BufferLocation = instanceBuffer->GetGPUVirtualAddress();
-		instanceView.StrideInBytes = sizeof(InstanceData);
-		instanceView.SizeInBytes = sizeof(InstanceData) * instanceCount;
-		core->getCommandList()->IASetVertexBuffers(1, 1, &instanceView);
-
-		
-		core->getCommandList()->DrawIndexedInstanced(mesh.numMeshIndices, instanceCount, 0, 0, 0);
+		mesh.drawInstanced(core, instanceView, instanceCount);
 	}
 };
 
@@ -430,11 +419,15 @@ public:
 	Mesh mesh;
 	Material* material;
 	std::string shaderName;
+	Shader* shader;
+	ConstantHandle worldHandle;
+	ConstantHandle emissiveHandle;
 	bool initialized;
 
 	DistantLayer()
 	{
 		material = nullptr;
+		shader = nullptr;
 		initialized = false;
 	}
 
@@ -544,20 +537,22 @@ public:
 			VertexLayoutCache::getStaticLayout());
 
 		shaderName = "DistantLayerEmissive";
+		shader = shaders->find(shaderName);
+		worldHandle = shaders->findConstantVS(shaderName, "staticMeshBuffer", "W");
+		emissiveHandle = shaders->findConstantPS(shaderName, "SkyboxBuffer", "emissiveIntensity");
 		initialized = true;
 	}
 
 	// 绘制函数保持不变
-	void draw(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp, Matrix& w, TextureManager* textureManager, float emissiveIntensity = 1.0f)
+	void draw(Core* core, PSOManager* psos, Shaders* shaders, Matrix& w, TextureManager* textureManager, float emissiveIntensity = 1.0f)
 	{
 		if (!initialized) return;
 
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "VP", &vp);
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "W", &w);
-		shaders->updateConstantPS(shaderName, "SkyboxBuffer", "emissiveIntensity", &emissiveIntensity);
+		shaders->update(worldHandle, &w);
+		shaders->update(emissiveHandle, &emissiveIntensity);
 
 		textureManager->bindHeap(core);
-		shaders->apply(core, shaderName);
+		shader->apply(core);
 		psos->bind(core, "DistantLayerEmissivePSO");
 
 		if (material && material->hasTexture)
@@ -0,0 +1,77 @@
+#pragma once
+
+// Fixed rate simulation clock. Frame times go into an accumulator and come out as whole steps of 1 / hz
+// seconds, so gameplay advances the same way at any frame rate. After a hitch at most maxStepsPerFrame
+// steps run and the rest is dropped: the game slows down for a moment instead of spiralling into ever
+// longer frames. alpha() says how far the frame is between the last two steps, for drawing interpolated
+// transforms. No platform types, a headless run just calls advance() with whatever frame time it likes
+class FixedStepClock
+{
+public:
+	FixedStepClock()
+	{
+		init(60.0f, 8);
+	}
+
+	void init(float hz, int _maxStepsPerFrame)
+	{
+		stepLength = 1.0f / hz;
+		maxStepsPerFrame = _maxStepsPerFrame;
+		accumulator = 0.0f;
+		steps = 0;
+		dropped = 0.0;
+	}
+
+	// Add a frame's time, returns how many steps of step() seconds to run now
+	int advance(float frameDt)
+	{
+		accumulator += frameDt > 0.0f ? frameDt : 0.0f;
+		int count = (int)(accumulator / stepLength);
+		if (count > maxStepsPerFrame)
+		{
+			dropped += accumulator - maxStepsPerFrame * stepLength;
+			count = maxStepsPerFrame;
+			accumulator = count * stepLength;
+		}
+		accumulator -= count * stepLength;
+		accumulator = accumulator > 0.0f ? accumulator : 0.0f;
+		steps += count;
+		return count;
+	}
+
+	float step() const
+	{
+		return stepLength;
+	}
+
+	// 0 draws the previous step's state, 1 the latest
+	float alpha() const
+	{
+		float a = accumulator / stepLength;
+		return a < 1.0f ? a : 1.0f;
+	}
+
+	// Simulated time so far
+	double time() const
+	{
+		return steps * (double)stepLength;
+	}
+
+	long long stepCount() const
+	{
+		return steps;
+	}
+
+	// Time thrown away by the catch-up limit
+	double droppedTime() const
+	{
+		return dropped;
+	}
+
+private:
+	float stepLength;
+	int maxStepsPerFrame;
+	float accumulator;
+	long long steps;
+	double dropped;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include "Maths.h"
+#include "Shaders.h"
+
+// CPU copy of the per-frame block every shader sees as
+//   cbuffer FrameConstants : register(b1)
+// Laid out to HLSL packing rules: float3 + float share a 16 byte row, nothing straddles a row.
+struct FrameConstantData
+{
+	Matrix VP;
+	Vec3 cameraPosition;
+	float time;
+	Vec3 lightDirection; // Surface to light
+	float lightIntensity;
+	Vec3 lightColor;
+	float ambientStrength;
+	float windStrength;
+	float windSpeed;
+	float padding[2];
+};
+
+static_assert(sizeof(FrameConstantData) == 128, "FrameConstantData must match cbuffer FrameConstants");
+static_assert(offsetof(FrameConstantData, cameraPosition) == 64, "FrameConstantData must match cbuffer FrameConstants");
+static_assert(offsetof(FrameConstantData, lightDirection) == 80, "FrameConstantData must match cbuffer FrameConstants");
+static_assert(offsetof(FrameConstantData, lightColor) == 96, "FrameConstantData must match cbuffer FrameConstants");
+static_assert(offsetof(FrameConstantData, windStrength) == 112, "FrameConstantData must match cbuffer FrameConstants");
+
+// Written once and bound once per frame on its own root parameter (visible to all stages),
+// so per-object buffers only carry what changes per draw (W, bones)
+class FrameConstants
+{
+public:
+	FrameConstantData data;
+
+	// One draw's worth per frame, plus the spare slot next() takes after binding
+	void init(Core* core)
+	{
+		buffer.init(core, sizeof(FrameConstantData), 4);
+		buffer.layout.name = "FrameConstants";
+	}
+
+	// Copy data into this frame's slot and bind it, call after beginRenderPass has set the root signature
+	void apply(Core* core)
+	{
+		buffer.write(0, &data, sizeof(FrameConstantData));
+		core->getCommandList()->SetGraphicsRootConstantBufferView(core->frameConstantsRootIndex, buffer.getGPUAddress());
+		frameStats().current.rootBinds++;
+		buffer.next();
+	}
+
+	void free()
+	{
+		buffer.free();
+	}
+
+private:
+	ConstantBuffer buffer;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdio>
+
+// Per-frame renderer counters. Code that does the counted work bumps the current frame,
+// the main loop calls endFrame() once per frame and report() prints the last finished frame.
+struct FrameStats
+{
+	unsigned long long constantBytes; // Bytes copied into constant buffers
+	int constantWrites;
+	int drawCalls;
+	int instances;                    // Instances submitted by those draws
+	int triangles;                    // ... and their triangles, at the level of detail drawn
+	int psoBinds;
+	int rootBinds;                    // Root CBVs, descriptor tables and descriptor heaps
+	int inputBinds;                   // Topology, vertex and index buffers
+	int objectsTested;                // Models and model instances that went through frustum culling
+	int objectsDrawn;                 // ... and survived it
+	int grassTested;                  // Grass instances, culled per clump
+	int grassDrawn;
+	int skeletonsEvaluated;           // Animation poses computed, one per StateMachine update
+	int bonesEvaluated;
+	int clipLookups;                  // Animation clips found by name, Animation::findAnimation
+
+	FrameStats()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		constantBytes = 0;
+		constantWrites = 0;
+		drawCalls = 0;
+		instances = 0;
+		triangles = 0;
+		psoBinds = 0;
+		rootBinds = 0;
+		inputBinds = 0;
+		objectsTested = 0;
+		objectsDrawn = 0;
+		grassTested = 0;
+		grassDrawn = 0;
+		skeletonsEvaluated = 0;
+		bonesEvaluated = 0;
+		clipLookups = 0;
+	}
+
+	// Everything recorded on the command list that is not a draw
+	int stateChanges() const
+	{
+		return psoBinds + rootBinds + inputBinds;
+	}
+};
+
+class FrameStatsCounter
+{
+public:
+	FrameStats current;
+	FrameStats last;
+
+	FrameStatsCounter()
+	{
+		frames = 0;
+		elapsed = 0;
+	}
+
+	void endFrame()
+	{
+		last = current;
+		current.reset();
+		frames++;
+	}
+
+	// Print the last frame's counters every interval seconds
+	void report(float dt, float interval = 1.0f)
+	{
+		elapsed += dt;
+		if (elapsed < interval)
+		{
+			return;
+		}
+		printf("Frame stats (%d frames): constant buffers %llu bytes in %d writes per frame\n",
+			frames, last.constantBytes, last.constantWrites);
+		printf("  %d draw calls (%d instances, %d triangles), %d state changes (%d PSO, %d root, %d input)\n",
+			last.drawCalls, last.instances, last.triangles, last.stateChanges(), last.psoBinds, last.rootBinds, last.inputBinds);
+		printf("  culling: %d of %d objects, %d of %d grass instances drawn\n",
+			last.objectsDrawn, last.objectsTested, last.grassDrawn, last.grassTested);
+		printf("  animation: %d skeletons, %d bones evaluated, %d clip lookups\n", last.skeletonsEvaluated, last.bonesEvaluated, last.clipLookups);
+		elapsed = 0;
+		frames = 0;
+	}
+
+private:
+	int frames;
+	float elapsed;
+};
+
+inline FrameStatsCounter& frameStats()
+{
+	static FrameStatsCounter stats;
+	return stats;
+}
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include <float.h>
+#include "Maths.h"
+
+// Axis aligned box in a mesh's or model's own space, or in world space after transformed()
+struct BoundingBox
+{
+	Vec3 min;
+	Vec3 max;
+
+	BoundingBox()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	}
+
+	bool valid() const
+	{
+		return min.x <= max.x;
+	}
+
+	void extend(const Vec3& p)
+	{
+		min = Vec3(p.x < min.x ? p.x : min.x, p.y < min.y ? p.y : min.y, p.z < min.z ? p.z : min.z);
+		max = Vec3(p.x > max.x ? p.x : max.x, p.y > max.y ? p.y : max.y, p.z > max.z ? p.z : max.z);
+	}
+
+	void extend(const BoundingBox& box)
+	{
+		if (box.valid())
+		{
+			extend(box.min);
+			extend(box.max);
+		}
+	}
+
+	Vec3 center() const
+	{
+		return (min + max) * 0.5f;
+	}
+
+	Vec3 extents() const
+	{
+		return (max - min) * 0.5f;
+	}
+
+	// Box around this box after an affine transform (Arvo): the centre moves, extents take |rotation * scale|
+	BoundingBox transformed(const Matrix& w) const
+	{
+		if (!valid())
+		{
+			return *this;
+		}
+		Vec3 c = center();
+		Vec3 e = extents();
+		Vec3 worldCenter(
+			w.a[0][0] * c.x + w.a[0][1] * c.y + w.a[0][2] * c.z + w.a[0][3],
+			w.a[1][0] * c.x + w.a[1][1] * c.y + w.a[1][2] * c.z + w.a[1][3],
+			w.a[2][0] * c.x + w.a[2][1] * c.y + w.a[2][2] * c.z + w.a[2][3]);
+		Vec3 worldExtents(
+			fabsf(w.a[0][0]) * e.x + fabsf(w.a[0][1]) * e.y + fabsf(w.a[0][2]) * e.z,
+			fabsf(w.a[1][0]) * e.x + fabsf(w.a[1][1]) * e.y + fabsf(w.a[1][2]) * e.z,
+			fabsf(w.a[2][0]) * e.x + fabsf(w.a[2][1]) * e.y + fabsf(w.a[2][2]) * e.z);
+		BoundingBox box;
+		box.min = worldCenter - worldExtents;
+		box.max = worldCenter + worldExtents;
+		return box;
+	}
+};
+
+struct BoundingSphere
+{
+	Vec3 center;
+	float radius;
+
+	BoundingSphere()
+	{
+		center = Vec3(0, 0, 0);
+		radius = 0;
+	}
+
+	// Centred on the box, radius to the farthest of the points
+	void fromPoints(const BoundingBox& box, const Vec3* points, int count, int strideInBytes)
+	{
+		center = box.center();
+		float maxDistanceSq = 0;
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(points);
+		for (int i = 0; i < count; i++)
+		{
+			const Vec3& v = *reinterpret_cast<const Vec3*>(p + ((size_t)i * strideInBytes));
+			float distanceSq = SQ(v.x - center.x) + SQ(v.y - center.y) + SQ(v.z - center.z);
+			if (distanceSq > maxDistanceSq)
+			{
+				maxDistanceSq = distanceSq;
+			}
+		}
+		radius = sqrtf(maxDistanceSq);
+	}
+
+	// Grow the radius (centre fixed) until sphere is inside
+	void enclose(const BoundingSphere& sphere)
+	{
+		float reach = sqrtf(SQ(sphere.center.x - center.x) + SQ(sphere.center.y - center.y) + SQ(sphere.center.z - center.z)) + sphere.radius;
+		if (reach > radius)
+		{
+			radius = reach;
+		}
+	}
+
+	// World space sphere under w, the radius takes the largest axis scale
+	BoundingSphere transformed(const Matrix& w) const
+	{
+		BoundingSphere sphere;
+		sphere.center = Vec3(
+			w.a[0][0] * center.x + w.a[0][1] * center.y + w.a[0][2] * center.z + w.a[0][3],
+			w.a[1][0] * center.x + w.a[1][1] * center.y + w.a[1][2] * center.z + w.a[1][3],
+			w.a[2][0] * center.x + w.a[2][1] * center.y + w.a[2][2] * center.z + w.a[2][3]);
+		float sx = SQ(w.a[0][0]) + SQ(w.a[1][0]) + SQ(w.a[2][0]);
+		float sy = SQ(w.a[0][1]) + SQ(w.a[1][1]) + SQ(w.a[2][1]);
+		float sz = SQ(w.a[0][2]) + SQ(w.a[1][2]) + SQ(w.a[2][2]);
+		float maxScaleSq = sx > sy ? sx : sy;
+		maxScaleSq = maxScaleSq > sz ? maxScaleSq : sz;
+		sphere.radius = radius * sqrtf(maxScaleSq);
+		return sphere;
+	}
+};
+
+// The six planes of a view-projection matrix (Gribb/Hartmann), normals pointing inwards.
+// VP rows are x, y, z, w of clip space (clip = VP * p), depth is the D3D [0, w] range
+class Frustum
+{
+public:
+	// a, b, c, d per plane: a point is inside when a * x + b * y + c * z + d >= 0 for all six
+	float planes[6][4];
+
+	void fromViewProjection(const Matrix& vp)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			planes[0][i] = vp.a[3][i] + vp.a[0][i]; // Left
+			planes[1][i] = vp.a[3][i] - vp.a[0][i]; // Right
+			planes[2][i] = vp.a[3][i] + vp.a[1][i]; // Bottom
+			planes[3][i] = vp.a[3][i] - vp.a[1][i]; // Top
+			planes[4][i] = vp.a[2][i];              // Near
+			planes[5][i] = vp.a[3][i] - vp.a[2][i]; // Far
+		}
+		for (int p = 0; p < 6; p++)
+		{
+			float length = sqrtf(SQ(planes[p][0]) + SQ(planes[p][1]) + SQ(planes[p][2]));
+			if (length > 0)
+			{
+				for (int i = 0; i < 4; i++)
+				{
+					planes[p][i] /= length;
+				}
+			}
+		}
+	}
+
+	bool sphereVisible(const Vec3& center, float radius) const
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			if (distance(p, center) < -radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Conservative: a box that straddles two planes outside a corner can still pass
+	bool boxVisible(const BoundingBox& box) const
+	{
+		Vec3 center = box.center();
+		Vec3 extents = box.extents();
+		for (int p = 0; p < 6; p++)
+		{
+			float reach = fabsf(planes[p][0]) * extents.x + fabsf(planes[p][1]) * extents.y + fabsf(planes[p][2]) * extents.z;
+			if (distance(p, center) < -reach)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Box test over structure-of-arrays centres and extents, four boxes per SSE step.
+	// Writes 1 (visible) or 0 per box and returns how many are visible
+	int cullBoxes(const float* cx, const float* cy, const float* cz, const float* ex, const float* ey, const float* ez, int count, unsigned char* visible) const
+	{
+		int visibleCount = 0;
+		int i = 0;
+#if defined(MATHS_USE_SSE)
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(cx + i);
+			__m128 y = _mm_loadu_ps(cy + i);
+			__m128 z = _mm_loadu_ps(cz + i);
+			__m128 extentX = _mm_loadu_ps(ex + i);
+			__m128 extentY = _mm_loadu_ps(ey + i);
+			__m128 extentZ = _mm_loadu_ps(ez + i);
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 a = _mm_set1_ps(planes[p][0]);
+				__m128 b = _mm_set1_ps(planes[p][1]);
+				__m128 c = _mm_set1_ps(planes[p][2]);
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(b, y)), _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(planes[p][3])));
+				__m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, a), extentX), _mm_mul_ps(_mm_andnot_ps(signMask, b), extentY)), _mm_mul_ps(_mm_andnot_ps(signMask, c), extentZ));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, reach), _mm_setzero_ps()));
+			}
+			int mask = _mm_movemask_ps(outside);
+			for (int k = 0; k < 4; k++)
+			{
+				visible[i + k] = (mask & (1 << k)) ? 0 : 1;
+				visibleCount += visible[i + k];
+			}
+		}
+#endif
+		for (; i < count; i++)
+		{
+			BoundingBox box;
+			box.min = Vec3(cx[i] - ex[i], cy[i] - ey[i], cz[i] - ez[i]);
+			box.max = Vec3(cx[i] + ex[i], cy[i] + ey[i], cz[i] + ez[i]);
+			visible[i] = boxVisible(box) ? 1 : 0;
+			visibleCount += visible[i];
+		}
+		return visibleCount;
+	}
+
+	// Sphere test over structure-of-arrays centres and radii, four spheres per SSE step
+	int cullSpheres(const float* cx, const float* cy, const float* cz, const float* radius, int count, unsigned char* visible) const
+	{
+		int visibleCount = 0;
+		int i = 0;
+#if defined(MATHS_USE_SSE)
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(cx + i);
+			__m128 y = _mm_loadu_ps(cy + i);
+			__m128 z = _mm_loadu_ps(cz + i);
+			__m128 r = _mm_loadu_ps(radius + i);
+			__m128 outside = _mm_setzero_ps();
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][0]), x), _mm_mul_ps(_mm_set1_ps(planes[p][1]), y)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p][2]), z), _mm_set1_ps(planes[p][3])));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+			}
+			int mask = _mm_movemask_ps(outside);
+			for (int k = 0; k < 4; k++)
+			{
+				visible[i + k] = (mask & (1 << k)) ? 0 : 1;
+				visibleCount += visible[i + k];
+			}
+		}
+#endif
+		for (; i < count; i++)
+		{
+			visible[i] = sphereVisible(Vec3(cx[i], cy[i], cz[i]), radius[i]) ? 1 : 0;
+			visibleCount += visible[i];
+		}
+		return visibleCount;
+	}
+
+private:
+	float distance(int p, const Vec3& point) const
+	{
+		return planes[p][0] * point.x + planes[p][1] * point.y + planes[p][2] * point.z + planes[p][3];
+	}
+};
+
+// World boxes gathered into structure-of-arrays form and culled in one cullBoxes call
+class BoxCullBatch
+{
+public:
+	void clear()
+	{
+		cx.clear();
+		cy.clear();
+		cz.clear();
+		ex.clear();
+		ey.clear();
+		ez.clear();
+		visible.clear();
+	}
+
+	// Index of the box, pass it to isVisible after cull
+	int add(const BoundingBox& box)
+	{
+		Vec3 c = box.center();
+		Vec3 e = box.extents();
+		cx.push_back(c.x);
+		cy.push_back(c.y);
+		cz.push_back(c.z);
+		ex.push_back(e.x);
+		ey.push_back(e.y);
+		ez.push_back(e.z);
+		return (int)cx.size() - 1;
+	}
+
+	int cull(const Frustum& frustum)
+	{
+		visible.resize(cx.size());
+		if (cx.empty())
+		{
+			return 0;
+		}
+		return frustum.cullBoxes(cx.data(), cy.data(), cz.data(), ex.data(), ey.data(), ez.data(), (int)cx.size(), visible.data());
+	}
+
+	bool isVisible(int index) const
+	{
+		return visible[index] != 0;
+	}
+
+	int size() const
+	{
+		return (int)cx.size();
+	}
+
+private:
+	std::vector<float> cx;
+	std::vector<float> cy;
+	std::vector<float> cz;
+	std::vector<float> ex;
+	std::vector<float> ey;
+	std::vector<float> ez;
+	std::vector<unsigned char> visible;
+};
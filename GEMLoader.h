@@ -29,6 +29,19 @@ SOFTWARE.
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace GEMLoader
 {
@@ -104,7 +117,7 @@ namespace GEMLoader
 		std::vector<GEMMaterialProperty> properties;
 		GEMMaterialProperty find(std::string name)
 		{
-			for (int i = 0; i < properties.size(); i++)
+			for (int i = 0; i < (int)properties.size(); i++)
 			{
 				if (properties[i].name == name)
 				{
@@ -199,198 +212,422 @@ namespace GEMLoader
 		GEMMatrix globalInverse;
 	};
 
-	class GEMModelLoader
+	// Read-only view over a run of elements inside a mapped file. The data is not guaranteed to be aligned,
+	// copy it out (memcpy or assign) rather than dereferencing members in place on strict-alignment targets
+	template<typename T>
+	class GEMSpan
 	{
-	private:
-		GEMMaterialProperty loadProperty(std::ifstream& file)
+	public:
+		const T* data;
+		unsigned int count;
+		GEMSpan()
 		{
-			GEMMaterialProperty prop;
-			prop.name = loadString(file);
-			prop.value = loadString(file);
-			return prop;
+			data = nullptr;
+			count = 0;
 		}
-		void loadMesh(std::ifstream& file, GEMMesh& mesh, int isAnimated)
+		unsigned int size() const
 		{
-			unsigned int n = 0;
-			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-			for (unsigned int i = 0; i < n; i++)
+			return count;
+		}
+		const T* begin() const
+		{
+			return data;
+		}
+		const T* end() const
+		{
+			return data + count;
+		}
+	};
+
+	class GEMMeshView
+	{
+	public:
+		GEMMaterial material;
+		GEMSpan<GEMStaticVertex> verticesStatic;
+		GEMSpan<GEMAnimatedVertex> verticesAnimated;
+		GEMSpan<unsigned int> indices;
+		bool isAnimated()
+		{
+			return verticesAnimated.size() > 0;
+		}
+	};
+
+	// Frames are stored back to back as bonesN positions, bonesN rotations, bonesN scales
+	class GEMAnimationSequenceView
+	{
+	public:
+		std::string name;
+		int frames;
+		float ticksPerSecond;
+		unsigned int bonesN;
+		const unsigned char* data;
+		size_t frameSize() const
+		{
+			return bonesN * (sizeof(GEMVec3) + sizeof(GEMQuaternion) + sizeof(GEMVec3));
+		}
+		const GEMVec3* positions(int frame) const
+		{
+			return reinterpret_cast<const GEMVec3*>(data + (frame * frameSize()));
+		}
+		const GEMQuaternion* rotations(int frame) const
+		{
+			return reinterpret_cast<const GEMQuaternion*>(data + (frame * frameSize()) + (bonesN * sizeof(GEMVec3)));
+		}
+		const GEMVec3* scales(int frame) const
+		{
+			return reinterpret_cast<const GEMVec3*>(data + (frame * frameSize()) + (bonesN * (sizeof(GEMVec3) + sizeof(GEMQuaternion))));
+		}
+	};
+
+	// Whole file mapped read-only, unmapped when this goes out of scope
+	class GEMMappedFile
+	{
+	public:
+		const unsigned char* data;
+		size_t size;
+#ifdef _WIN32
+		HANDLE file;
+		HANDLE mapping;
+#endif
+		GEMMappedFile()
+		{
+			data = nullptr;
+			size = 0;
+#ifdef _WIN32
+			file = INVALID_HANDLE_VALUE;
+			mapping = NULL;
+#endif
+		}
+		GEMMappedFile(const GEMMappedFile&) = delete;
+		GEMMappedFile& operator=(const GEMMappedFile&) = delete;
+		~GEMMappedFile()
+		{
+			close();
+		}
+		bool open(const std::string& filename)
+		{
+			close();
+#ifdef _WIN32
+			file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			if (file == INVALID_HANDLE_VALUE)
 			{
-				mesh.material.properties.push_back(loadProperty(file));
+				return false;
 			}
-			if (isAnimated == 0)
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
 			{
-				file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-				for (unsigned int i = 0; i < n; i++)
-				{
-					GEMStaticVertex v;
-					file.read(reinterpret_cast<char*>(&v), sizeof(GEMStaticVertex));
-					mesh.verticesStatic.push_back(v);
-				}
-				file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-				for (unsigned int i = 0; i < n; i++)
-				{
-					unsigned int index = 0;
-					file.read(reinterpret_cast<char*>(&index), sizeof(unsigned int));
-					mesh.indices.push_back(index);
-				}
-			} else
+				close();
+				return false;
+			}
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping == NULL)
 			{
-				file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-				for (unsigned int i = 0; i < n; i++)
-				{
-					GEMAnimatedVertex v;
-					file.read(reinterpret_cast<char*>(&v), sizeof(GEMAnimatedVertex));
-					mesh.verticesAnimated.push_back(v);
-				}
-				file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-				for (unsigned int i = 0; i < n; i++)
-				{
-					unsigned int index = 0;
-					file.read(reinterpret_cast<char*>(&index), sizeof(unsigned int));
-					mesh.indices.push_back(index);
-				}
+				close();
+				return false;
+			}
+			data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			if (data == nullptr)
+			{
+				close();
+				return false;
+			}
+			size = (size_t)fileSize.QuadPart;
+#else
+			int fd = ::open(filename.c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				return false;
 			}
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size == 0)
+			{
+				::close(fd);
+				return false;
+			}
+			void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (p == MAP_FAILED)
+			{
+				return false;
+			}
+			data = static_cast<const unsigned char*>(p);
+			size = (size_t)st.st_size;
+#endif
+			return true;
+		}
+		void close()
+		{
+#ifdef _WIN32
+			if (data != nullptr)
+			{
+				UnmapViewOfFile(data);
+			}
+			if (mapping != NULL)
+			{
+				CloseHandle(mapping);
+				mapping = NULL;
+			}
+			if (file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(file);
+				file = INVALID_HANDLE_VALUE;
+			}
+#else
+			if (data != nullptr)
+			{
+				munmap(const_cast<unsigned char*>(data), size);
+			}
+#endif
+			data = nullptr;
+			size = 0;
+		}
+	};
+
+	// Bounds checked cursor over a mapped file. Any read past the end clears valid and returns zeroes
+	class GEMReader
+	{
+	public:
+		const unsigned char* data;
+		size_t size;
+		size_t offset;
+		bool valid;
+		GEMReader(const unsigned char* _data, size_t _size)
+		{
+			data = _data;
+			size = _size;
+			offset = 0;
+			valid = true;
 		}
-		std::string loadString(std::ifstream& file)
+		const unsigned char* take(size_t bytes)
 		{
-			int l = 0;
-			file.read(reinterpret_cast<char*>(&l), sizeof(int));
-			char* buffer = new char[l + 1];
-			memset(buffer, 0, l * sizeof(char));
-			file.read(buffer, l * sizeof(char));
-			buffer[l] = 0;
-			std::string str(buffer);
-			delete[] buffer;
-			return str;
+			if (!valid || bytes > size - offset)
+			{
+				valid = false;
+				return nullptr;
+			}
+			const unsigned char* p = data + offset;
+			offset += bytes;
+			return p;
 		}
-		GEMVec3 loadVec3(std::ifstream& file)
+		template<typename T>
+		T read()
 		{
-			GEMVec3 v;
-			file.read(reinterpret_cast<char*>(&v), sizeof(GEMVec3));
+			T v;
+			memset(&v, 0, sizeof(T));
+			const unsigned char* p = take(sizeof(T));
+			if (p != nullptr)
+			{
+				memcpy(&v, p, sizeof(T));
+			}
 			return v;
 		}
-		GEMMatrix loadMatrix(std::ifstream& file)
+		std::string readString()
 		{
-			GEMMatrix mat;
-			file.read(reinterpret_cast<char*>(&mat.m), sizeof(float) * 16);
-			return mat;
+			int l = read<int>();
+			if (l < 0)
+			{
+				valid = false;
+				return std::string();
+			}
+			const char* p = reinterpret_cast<const char*>(take(l));
+			if (p == nullptr)
+			{
+				return std::string();
+			}
+			const char* terminator = static_cast<const char*>(memchr(p, 0, l));
+			return std::string(p, terminator ? (terminator - p) : l);
 		}
-		GEMQuaternion loadQuaternion(std::ifstream& file)
+		template<typename T>
+		GEMSpan<T> readArray()
 		{
-			GEMQuaternion q;
-			file.read(reinterpret_cast<char*>(&q.q), sizeof(float) * 4);
-			return q;
+			GEMSpan<T> span;
+			unsigned int n = read<unsigned int>();
+			if (!valid || n > (size - offset) / sizeof(T))
+			{
+				valid = false;
+				return span;
+			}
+			span.data = reinterpret_cast<const T*>(take(n * sizeof(T)));
+			span.count = n;
+			return span;
 		}
-		void loadFrame(GEMAnimationSequence& aseq, std::ifstream& file, int bonesN)
+	};
+
+	// Everything parsed out of one .gem file. Spans point into the mapping, so they are only valid while this object lives
+	class GEMModelView
+	{
+	public:
+		GEMMappedFile file;
+		bool animated;
+		std::vector<GEMMeshView> meshes;
+		std::vector<GEMBone> bones;
+		GEMMatrix globalInverse;
+		std::vector<GEMAnimationSequenceView> animations;
+		GEMModelView()
 		{
-			GEMAnimationFrame frame;
-			for (int i = 0; i < bonesN; i++)
+			animated = false;
+			memset(&globalInverse, 0, sizeof(GEMMatrix));
+		}
+		GEMModelView(const GEMModelView&) = delete;
+		GEMModelView& operator=(const GEMModelView&) = delete;
+	};
+
+	class GEMModelLoader
+	{
+	private:
+		bool parse(GEMReader& reader, GEMModelView& view)
+		{
+			unsigned int n = reader.read<unsigned int>();
+			if (n != 4058972161)
+			{
+				return false;
+			}
+			view.animated = (reader.read<unsigned int>() != 0);
+			n = reader.read<unsigned int>();
+			// Every mesh needs at least its three counts, reject counts the file cannot hold before allocating
+			if (!reader.valid || n > (reader.size - reader.offset) / (3 * sizeof(unsigned int)))
 			{
-				GEMVec3 p = loadVec3(file);
-				frame.positions.push_back(p);
+				return false;
 			}
-			for (int i = 0; i < bonesN; i++)
+			view.meshes.resize(n);
+			for (unsigned int i = 0; i < n && reader.valid; i++)
 			{
-				GEMQuaternion q = loadQuaternion(file);
-				frame.rotations.push_back(q);
+				GEMMeshView& mesh = view.meshes[i];
+				unsigned int propertiesN = reader.read<unsigned int>();
+				for (unsigned int j = 0; j < propertiesN && reader.valid; j++)
+				{
+					GEMMaterialProperty prop;
+					prop.name = reader.readString();
+					prop.value = reader.readString();
+					mesh.material.properties.push_back(prop);
+				}
+				if (view.animated)
+				{
+					mesh.verticesAnimated = reader.readArray<GEMAnimatedVertex>();
+				} else
+				{
+					mesh.verticesStatic = reader.readArray<GEMStaticVertex>();
+				}
+				mesh.indices = reader.readArray<unsigned int>();
 			}
-			for (int i = 0; i < bonesN; i++)
+			if (!view.animated)
 			{
-				GEMVec3 s = loadVec3(file);
-				frame.scales.push_back(s);
+				return reader.valid;
+			}
+			// Read skeleton
+			unsigned int bonesN = reader.read<unsigned int>();
+			for (unsigned int i = 0; i < bonesN && reader.valid; i++)
+			{
+				GEMBone bone;
+				bone.name = reader.readString();
+				bone.offset = reader.read<GEMMatrix>();
+				bone.parentIndex = reader.read<int>();
+				view.bones.push_back(bone);
 			}
-			aseq.frames.push_back(frame);
+			view.globalInverse = reader.read<GEMMatrix>();
+			// Read animation sequences, the frame data itself stays in the mapping
+			n = reader.read<unsigned int>();
+			for (unsigned int i = 0; i < n && reader.valid; i++)
+			{
+				GEMAnimationSequenceView aseq;
+				aseq.name = reader.readString();
+				aseq.frames = reader.read<int>();
+				aseq.ticksPerSecond = reader.read<float>();
+				aseq.bonesN = bonesN;
+				if (aseq.frames < 0 || (aseq.frameSize() > 0 && (size_t)aseq.frames > (reader.size - reader.offset) / aseq.frameSize()))
+				{
+					reader.valid = false;
+					break;
+				}
+				aseq.data = reader.take(aseq.frames * aseq.frameSize());
+				view.animations.push_back(aseq);
+			}
+			return reader.valid;
 		}
-		void loadFrames(GEMAnimationSequence& aseq, std::ifstream& file, int bonesN, int frames)
+		void copyMeshes(GEMModelView& view, std::vector<GEMMesh>& meshes)
 		{
-			for (int i = 0; i < frames; i++)
+			meshes.reserve(meshes.size() + view.meshes.size());
+			for (int i = 0; i < (int)view.meshes.size(); i++)
 			{
-				loadFrame(aseq, file, bonesN);
+				meshes.push_back(GEMMesh());
+				GEMMesh& mesh = meshes.back();
+				mesh.material = view.meshes[i].material;
+				mesh.verticesStatic.assign(view.meshes[i].verticesStatic.begin(), view.meshes[i].verticesStatic.end());
+				mesh.verticesAnimated.assign(view.meshes[i].verticesAnimated.begin(), view.meshes[i].verticesAnimated.end());
+				mesh.indices.assign(view.meshes[i].indices.begin(), view.meshes[i].indices.end());
 			}
 		}
-	public:
-		bool isAnimatedModel(std::string filename)
+		void mapOrExit(std::string& filename, GEMModelView& view)
 		{
-			std::ifstream file(filename, ::std::ios::binary);
-			unsigned int n = 0;
-			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-			if (n != 4058972161)
+			if (!map(filename, view))
 			{
-				std::cout << filename << " is not a GE Model File" << std::endl;
-				file.close();
 				exit(0);
 			}
-			unsigned int isAnimated = 0;
-			file.read(reinterpret_cast<char*>(&isAnimated), sizeof(unsigned int));
-			file.close();
-			return isAnimated;
 		}
-		void load(std::string filename, std::vector<GEMMesh>& meshes)
+	public:
+		// Map the file and parse its layout once. Vertex, index and key frame data are not copied
+		bool map(std::string filename, GEMModelView& view)
 		{
-			std::ifstream file(filename, ::std::ios::binary);
-			unsigned int n = 0;
-			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-			if (n != 4058972161)
+			if (!view.file.open(filename))
 			{
-				std::cout << filename << " is not a GE Model File" << std::endl;
-				file.close();
-				exit(0);
+				std::cout << filename << " could not be opened" << std::endl;
+				return false;
 			}
-			unsigned int isAnimated = 0;
-			file.read(reinterpret_cast<char*>(&isAnimated), sizeof(unsigned int));
-			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-			for (unsigned int i = 0; i < n; i++)
+			GEMReader reader(view.file.data, view.file.size);
+			if (!parse(reader, view))
 			{
-				GEMMesh mesh;
-				loadMesh(file, mesh, isAnimated);
-				meshes.push_back(mesh);
+				std::cout << filename << " is not a GE Model File or is truncated" << std::endl;
+				view.file.close();
+				return false;
 			}
-			file.close();
+			return true;
 		}
-		void load(std::string filename, std::vector<GEMMesh>& meshes, GEMAnimation& animation)
+		bool isAnimatedModel(std::string filename)
 		{
-			std::ifstream file(filename, ::std::ios::binary);
+			GEMMappedFile file;
 			unsigned int n = 0;
-			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+			unsigned int isAnimated = 0;
+			if (file.open(filename))
+			{
+				GEMReader reader(file.data, file.size);
+				n = reader.read<unsigned int>();
+				isAnimated = reader.read<unsigned int>();
+			}
 			if (n != 4058972161)
 			{
 				std::cout << filename << " is not a GE Model File" << std::endl;
 				exit(0);
 			}
-			unsigned int isAnimated = 0;
-			file.read(reinterpret_cast<char*>(&isAnimated), sizeof(unsigned int));
-			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-			for (unsigned int i = 0; i < n; i++)
+			return isAnimated;
+		}
+		void load(std::string filename, std::vector<GEMMesh>& meshes)
+		{
+			GEMModelView view;
+			mapOrExit(filename, view);
+			copyMeshes(view, meshes);
+		}
+		void load(std::string filename, std::vector<GEMMesh>& meshes, GEMAnimation& animation)
+		{
+			GEMModelView view;
+			mapOrExit(filename, view);
+			copyMeshes(view, meshes);
+			animation.bones.insert(animation.bones.end(), view.bones.begin(), view.bones.end());
+			animation.globalInverse = view.globalInverse;
+			for (int i = 0; i < (int)view.animations.size(); i++)
 			{
-				GEMMesh mesh;
-				loadMesh(file, mesh, isAnimated);
-				meshes.push_back(mesh);
+				GEMAnimationSequenceView& src = view.animations[i];
+				animation.animations.push_back(GEMAnimationSequence());
+				GEMAnimationSequence& aseq = animation.animations.back();
+				aseq.name = src.name;
+				aseq.ticksPerSecond = src.ticksPerSecond;
+				aseq.frames.resize(src.frames);
+				for (int j = 0; j < src.frames; j++)
+				{
+					aseq.frames[j].positions.assign(src.positions(j), src.positions(j) + src.bonesN);
+					aseq.frames[j].rotations.assign(src.rotations(j), src.rotations(j) + src.bonesN);
+					aseq.frames[j].scales.assign(src.scales(j), src.scales(j) + src.bonesN);
+				}
 			}
-			// Read skeleton
-			unsigned int bonesN = 0;
-			file.read(reinterpret_cast<char*>(&bonesN), sizeof(unsigned int));
-			for (unsigned int i = 0; i < bonesN; i++)
-			{
-				GEMBone bone;
-				bone.name = loadString(file);
-				bone.offset = loadMatrix(file);
-				file.read(reinterpret_cast<char*>(&bone.parentIndex), sizeof(int));
-				animation.bones.push_back(bone);
-			}
-			animation.globalInverse = loadMatrix(file);
-			// Read animation sequence
-			file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
-			for (unsigned int i = 0; i < n; i++)
-			{
-				GEMAnimationSequence aseq;
-				aseq.name = loadString(file);
-				int frames = 0;
-				file.read(reinterpret_cast<char*>(&frames), sizeof(int));
-				file.read(reinterpret_cast<char*>(&aseq.ticksPerSecond), sizeof(float));
-				loadFrames(aseq, file, bonesN, frames);
-				animation.animations.push_back(aseq);
-			}
-			file.close();
 		}
 	};
 
@@ -15,7 +15,13 @@
 #include "GameObject.h"
 #include "Camera.h"
 #include "PlayerController.h"
+#include "Simulation.h"
 #include "Audio.h" 
+#include "JobSystem.h"
+#include "AssetLoader.h"
+#include "FrameConstants.h"
+#include "FrameStats.h"
+#include <chrono>
 #pragma comment(lib, "d3dcompiler.lib")
 
 
@@ -24,10 +30,6 @@
 
 int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nCmdShow)
 {
-	// 初始化随机数种子
-	//Initialize random number seed
-	srand((unsigned int)time(NULL));
-
 	// 分配并显示控制台窗口
 	//Allocate and display console window
 	AllocConsole();
@@ -47,10 +49,42 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nC
 	Shaders shaders;
 	PSOManager psos;
 
+	// 每帧共享的常量块（VP、相机、时间、光照、风），每帧写一次、绑定一次
+	// Per-frame constant block (VP, camera, time, light, wind), written and bound once per frame
+	FrameConstants frameConstants;
+	frameConstants.init(&core);
+
 	TextureManager textureManager;
 	textureManager.init(&core, 100);
 	MaterialManager materialManager(&textureManager);
 
+	// 资源预加载：模型读取/烘焙、动画转换、图片解码都放到线程池里并行，主线程只负责 GPU 上传
+	// Asset preload: model reading/cooking, animation conversion and image decoding run on the thread pool, the main thread only does GPU uploads
+	std::chrono::high_resolution_clock::time_point loadStart = std::chrono::high_resolution_clock::now();
+	JobSystem jobSystem;
+	jobSystem.init();
+	AssetPreloader preloader;
+	preloader.init(&jobSystem);
+	// 最大的模型先提交，缩短关键路径；模型材质引用的纹理会在解析后自动排队
+	// Largest models first to shorten the critical path; textures referenced by materials are queued once parsed
+	preloader.requestModel("Models/Farmer-male.gem", "Models/Textures");
+	preloader.requestModel("Models/Sheep-01.gem", "Models/Textures");
+	preloader.requestModel("Models/Duck-white.gem", "Models/Textures");
+	preloader.requestModel("Models/acacia_003.gem", "Models/Textures");
+	preloader.requestModel("Models/road_009.gem", "Models/Textures");
+	preloader.requestModel("Models/ground_005.gem", "Models/Textures");
+	preloader.requestImage("Models/Textures/skybox2.png");
+	preloader.requestImage("Models/Textures/m.png");
+	preloader.requestImage("Models/Textures/m2.png");
+	preloader.requestImage("Models/Textures/m3.png");
+	preloader.requestImage("Models/Textures/m4.png");
+	preloader.requestImage("Models/Textures/grass.png");
+	preloader.requestImage("Models/Textures/grass2.png");
+	preloader.requestImage("Models/Textures/grass3.png");
+	preloader.requestImage("Models/Textures/grass4.png");
+	preloader.requestImage("Models/Textures/grass5.png");
+	textureManager.preloader = &preloader;
+
 	// 初始化音频系统
 	// Initialize audio system
 	AudioSystem audioSystem;
@@ -96,16 +130,16 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nC
 	//小蘑菇
 	// Small mushroom
 	StaticModel staticModel;
-	staticModel.load(&core, "Models/acacia_003.gem", &shaders, &psos, &materialManager);
+	staticModel.load(&core, "Models/acacia_003.gem", &shaders, &psos, &materialManager, &preloader);
 
 	//路
 	// Road
 	StaticModel road;
-	road.load(&core, "Models/road_009.gem", &shaders, &psos, &materialManager);
+	road.load(&core, "Models/road_009.gem", &shaders, &psos, &materialManager, &preloader);
 	//路边草
 	// Grass beside the road
 	StaticModel grass;
-	grass.load(&core, "Models/ground_005.gem", &shaders, &psos, &materialManager);
+	grass.load(&core, "Models/ground_005.gem", &shaders, &psos, &materialManager, &preloader);
 	//小草
 	// Small grass
 	GrassPatch grassPatch;
@@ -123,20 +157,20 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nC
 	// 创建玩家模型和实例
 	// Create player model and instance
 	AnimatedModel animatedModel;
-	animatedModel.load(&core, "Models/Duck-white.gem", &psos, &shaders, &materialManager);
+	animatedModel.load(&core, "Models/Duck-white.gem", &psos, &shaders, &materialManager, &preloader);
 	MoveAnimatedModel player;
 	player.init(&animatedModel, Vec3(0, 0, -2), Vec3(0.1f, 0.1f, 0.1f));
 	player.setSpeed(10.0f); // 设置移动速度// Set movement speed
 
-	// 初始化玩家控制器
-	// Initialize player controller
+	// 初始化玩家控制器，只负责读键盘
+	// Initialize player controller, it only reads the keyboard
 	PlayerController playerController;
-	playerController.init(&player, &window);
+	playerController.init(&window);
 
 	// 创建农民模型和实例
 	// Create farmer model and instance
 	AnimatedModel FamerAnimatedModel;
-	FamerAnimatedModel.load(&core, "Models/Farmer-male.gem", &psos, &shaders, &materialManager);
+	FamerAnimatedModel.load(&core, "Models/Farmer-male.gem", &psos, &shaders, &materialManager, &preloader);
 
 	MoveAnimatedModel farmer;
 	farmer.init(&FamerAnimatedModel, Vec3(0, 0, 15), Vec3(0.1f, 0.1f, 0.1f));
@@ -147,13 +181,32 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nC
 	//山羊障碍物
 	// Goat obstacle
 	AnimatedModel goatModel;
-	goatModel.load(&core, "Models/Sheep-01.gem", &psos, &shaders, &materialManager);
+	goatModel.load(&core, "Models/Sheep-01.gem", &psos, &shaders, &materialManager, &preloader);
+
+	// 所有资源都已上传，之后的纹理请求直接走同步加载
+	// All assets are uploaded, later texture requests fall back to synchronous loading
+	preloader.waitAll();
+	textureManager.preloader = nullptr;
+	preloader.printStats();
+	// 所有拷贝都在复制队列上批量提交，这里只等待一次
+	// All copies are batched on the copy queue, wait for them once here
+	core.flushUploads();
+	printf("GPU uploads: %d copy queue submits\n", core.uploader.submits);
+	printf("Startup asset loading: %.1f ms\n", std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count());
 	
 
-	// 创建地形管理器
-	// Create terrain manager
+	// 游戏逻辑：地块、碰撞、状态流转，和窗口、图形 API 无关，按固定 60 Hz 步长推进
+	// Game logic: tiles, collision, state flow, independent of window and graphics API, advanced at a fixed 60 Hz step
+	GameSimulation simulation;
+	simulation.init(&player, &farmer, &goatModel.animation, "level.txt");
+
+	// 创建地形管理器，地块内容变了由 simulation.track 通知它
+	// Create terrain manager, simulation.track tells it when tile content changes
 	TerrainManager terrainManager;
-	terrainManager.init(&core, &road, &grass, &grassPatch, &goatModel, &staticModel, player.position);
+	terrainManager.setJobSystem(&jobSystem);
+	terrainManager.init(&core, &road, &grass, &grassPatch, &goatModel, &staticModel, &simulation.track);
+	// 障碍物骨骼按到相机的距离降频计算// Obstacle skeletons are evaluated less often the further they are from the camera
+	AnimationLod obstacleAnimationLod;
 
 
 	// 创建相机管理器实例
@@ -170,32 +223,11 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nC
 	sunLight.ambientStrength = 0.28f;// 环境光强度// Ambient light strength
 
 
-	// 加载带光照的着色器// Load lit shaders
-	shaders.load(&core, "StaticModelLit", "VS.txt", "PSLit.txt");
-	shaders.load(&core, "StaticModelLitUntextured", "VS.txt", "PSLitUnTextured.txt");
-	psos.createPSO(&core, "StaticModelLitPSO",shaders.find("StaticModelLit")->vs,shaders.find("StaticModelLit")->ps,VertexLayoutCache::getStaticLayout());
-	psos.createPSO(&core, "StaticModelLitUntexturedPSO",shaders.find("StaticModelLitUntextured")->vs,shaders.find("StaticModelLitUntextured")->ps,VertexLayoutCache::getStaticLayout());
-	// 加载带光照的着色器（动画模型）// Load lit shaders (animated models)
-	shaders.load(&core, "AnimatedLit", "VSAnim.txt", "PSLit.txt");
-	shaders.load(&core, "AnimatedLitUntextured", "VSAnim.txt", "PSLitUnTextured.txt");
-	psos.createPSO(&core, "AnimatedModelLitPSO",shaders.find("AnimatedLit")->vs,shaders.find("AnimatedLit")->ps,VertexLayoutCache::getAnimatedLayout());
-	psos.createPSO(&core, "AnimatedModelLitUntexturedPSO",shaders.find("AnimatedLitUntextured")->vs,shaders.find("AnimatedLitUntextured")->ps,VertexLayoutCache::getAnimatedLayout());
-
 	Timer timer;
 	float t = 0;
 	static float sunPitch = 45.0f;
 	static float sunYaw = 45.0f;
 
-	// 碰撞计数器和游戏状态// Collision counter and game state
-	int collisionCount = 0;
-	// 定义游戏状态枚举// Define game state enum
-	enum GameState {
-		PLAYING,
-		GAMEOVER_WALK, // 农民走向玩家 // Farmer walks towards the player
-		GAMEOVER_GRAB  // 农民抓起玩家 // Farmer grabs the player
-	};
-	GameState gameState = PLAYING;
-
 
 	while (1)
 	{
@@ -227,88 +259,36 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nC
 
 		t += dt;
 
-		// ！！！！！游戏逻辑！！！！！// !!!!!Game Logic!!!!!!!
-		if (gameState == PLAYING)
-		{
-			// 检测碰撞（假设玩家半径 5.5）// Check collisions (assuming player radius 5.5)
-			int newHits = terrainManager.checkCollisions(player.position, 5.5f);
-			if (newHits > 0)
-			{
-				collisionCount += newHits;
-				printf("Total Collisions: %d\n", collisionCount);
-
-				// 如果碰撞达到2次，进入游戏结束流程// If collisions reach 2, enter game over process
-				if (collisionCount >= 2)
-				{
-					gameState = GAMEOVER_WALK;
-
-					// 1. 玩家死亡// Player dies
-					player.setSpeed(0.0f); 
-					player.playAnimation("death", 0.2f, false); // 播放死亡动画，不循环// Play death animation, non-looping
-
-					// 2. 农民切换到走路状态// Farmer switches to walking state
-					farmer.setSpeed(0.0f); // 停止自动奔跑// Stop auto-running
-					farmer.playAnimation("walk", 0.2f); // 切换到走路动画// Switch to walking animation
-				}
-				else
-				{
-					// Not the last life: Play hit animation (non-looping)// 不是最后一条命：播放受击动画（不循环）
-					player.playAnimation("hit reaction", 0.1f, false);
-				}
-			}
-			// Check if hit animation finished, then resume running// 检查受击动画是否完成，然后恢复奔跑
-			if (player.stateMachine.getState() == "hit reaction" && player.stateMachine.isAnimationFinished())
-			{
-				player.playAnimation("run forward", 0.2f, true);
-			}
-
-
-			// 只有游戏未结束时，才允许玩家左右移动// Only allow player to move left/right when game is not over
-			playerController.update(dt);
-		}
-		else if (gameState == GAMEOVER_WALK)
-		{
-			// 农民走向玩家// Farmer walks towards the player
-			// 目标位置：玩家位置前方一点点（Z轴正方向是后方，所以加一点Z）// Target position: a bit in front of the player
-			Vec3 targetPos = player.position;
-			targetPos.z += 5.0f; // 停在玩家身后3米处// Stop 3 meters behind the player
-
-			Vec3 dir = targetPos - farmer.position;
-			float dist = dir.length();
-
-			if (dist < 0.1f)
-			{
-				// 到达位置，开始抓取// Arrived at position, start grabbing
-				gameState = GAMEOVER_GRAB;
-				farmer.playAnimation("grab low", 0.2f, false); // 播放抓取动画// Play grab animation
-			}
-			else
-			{
-				// 移动农民// Move farmer
-				dir = dir.normalize();
-				float walkSpeed = 5.0f;
-				farmer.position += dir * walkSpeed * dt;
-			}
-		}
+		// 游戏逻辑按固定步长推进，和帧率无关，卡顿后最多补 8 步，之后角色画在最后两步之间的插值位置
+		// Game logic runs in fixed steps, independent of frame rate, at most 8 catch-up steps after a hitch, then characters are drawn between the last two steps
+		simulation.update(dt, playerController.readInput());
 
 		//相机// Camera
 		Matrix vp = cameraManager.getViewProjection(t, &player);
+		// 视锥平面，地形绘制前用来剔除看不见的地块和实例// Frustum planes, used to cull tiles and instances before terrain draws are recorded
+		Frustum frustum;
+		frustum.fromViewProjection(vp);
+		// 按屏幕大小选细节层级// Level of detail picked from screen size
+		LodView lodView = cameraManager.lodView();
+		// 看得见的障碍物在绘制前算好骨骼，Headless 用同一个函数// Visible obstacles evaluate their skeletons before drawing, Headless runs the same function
+		animateVisibleObstacles(simulation.track, goatModel.sphere, frustum, lodView.eye, obstacleAnimationLod);
 
 		core.beginRenderPass();
 
 
-		// 更新光照常量到着色器// Update lighting constants to shaders
-		Vec3 lightDir = sunLight.getLightDirectionForShader();
-		shaders.updateConstantPS("StaticModelLit", "LightBuffer", "lightDirection", &lightDir);
-		shaders.updateConstantPS("StaticModelLit", "LightBuffer", "lightIntensity", &sunLight.intensity);
-		shaders.updateConstantPS("StaticModelLit", "LightBuffer", "lightColor", &sunLight.color);
-		shaders.updateConstantPS("StaticModelLit", "LightBuffer", "ambientStrength", &sunLight.ambientStrength);
-
-		// 更新动画模型的光照常量// Update animated model lighting constants
-		shaders.updateConstantPS("AnimatedLit", "LightBuffer", "lightDirection", &lightDir);
-		shaders.updateConstantPS("AnimatedLit", "LightBuffer", "lightIntensity", &sunLight.intensity);
-		shaders.updateConstantPS("AnimatedLit", "LightBuffer", "lightColor", &sunLight.color);
-		shaders.updateConstantPS("AnimatedLit", "LightBuffer", "ambientStrength", &sunLight.ambientStrength);
+		// 填写并绑定每帧常量，之后的绘制只写 W 和骨骼// Fill and bind the per-frame constants, draws below only write W and bones
+		frameConstants.data.VP = vp;
+		frameConstants.data.cameraPosition = cameraManager.getPosition();
+		frameConstants.data.time = t;
+		frameConstants.data.lightDirection = sunLight.getLightDirectionForShader();
+		frameConstants.data.lightIntensity = sunLight.intensity;
+		frameConstants.data.lightColor = sunLight.color;
+		frameConstants.data.ambientStrength = sunLight.ambientStrength;
+		frameConstants.data.windStrength = 0.1f;
+		// 以前草的时间每次实例绘制都累加一次（每帧约 10 个地块 x 5 种草），风速乘回去保持原来的摆动速度
+		// Grass time used to advance once per instanced draw (about 10 tiles x 5 grass types per frame), scale wind speed to keep the old sway
+		frameConstants.data.windSpeed = 5.0f;
+		frameConstants.apply(&core);
 
 
 		// 首先绘制天空球（获取相机位置）// First draw skybox (get camera position)
@@ -316,10 +296,10 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nC
 		// 第一人称和第三人称时，天空球和远景层都跟随玩家移动// In first-person and third-person, skybox and distant layers follow player movement
 		if (cameraManager.getMode() == CameraMode::THIRD_PERSON || cameraManager.getMode() == CameraMode::FIRST_PERSON)
 		{
-			skyboxCenter = player.position;
+			skyboxCenter = player.renderPosition;
 		}
 		float skyEmissive = 1.2f; // 增强天空球亮度// Enhance skybox brightness
-		skybox.draw(&core, &psos, &shaders, vp, skyboxCenter, &textureManager, skyEmissive);
+		skybox.draw(&core, &psos, &shaders, skyboxCenter, &textureManager, skyEmissive);
 
 		// 绘制远景层// Draw distant layers
 		float layerEmissive = 1.0f;
@@ -330,44 +310,51 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nC
 		Matrix distantLayerWorld2 = Matrix::translation(skyboxCenter + Vec3(100, -38.0f, 0));// 第三层远景稍微高一点
 		//绘制需要倒序进行，从最远的开始画起
 		// 第四层远景（山脉）
-		distantLayer4.draw(&core, &psos, &shaders, vp,distantLayerWorld, &textureManager, layerEmissive);
+		distantLayer4.draw(&core, &psos, &shaders, distantLayerWorld, &textureManager, layerEmissive);
 		// 第三层远景（云）
-		//distantLayer3.draw(&core, &psos, &shaders, vp, distantLayerWorld2, &textureManager, layerEmissive+0.33f);
+		//distantLayer3.draw(&core, &psos, &shaders, distantLayerWorld2, &textureManager, layerEmissive+0.33f);
 		// 第三层远景2（云）
-		//distantLayer35.draw(&core, &psos, &shaders, vp, distantLayerWorld, &textureManager, layerEmissive + 0.35f);
+		//distantLayer35.draw(&core, &psos, &shaders, distantLayerWorld, &textureManager, layerEmissive + 0.35f);
 		// 第二层远景
-		distantLayer2.draw(&core, &psos, &shaders, vp, distantLayerWorld, &textureManager, layerEmissive);
+		distantLayer2.draw(&core, &psos, &shaders, distantLayerWorld, &textureManager, layerEmissive);
 		// 第一层远景
-		distantLayer.draw(&core, &psos, &shaders, vp, distantLayerWorld, &textureManager, layerEmissive);
+		distantLayer.draw(&core, &psos, &shaders, distantLayerWorld, &textureManager, layerEmissive);
 		
 
 
-		// 更新并绘制地形// Update and draw  terrain
-		terrainManager.update(player.position, dt);
-		terrainManager.drawLit(&core, &psos, &shaders, vp, &textureManager, &sunLight, dt);
+		// 绘制地形// Draw terrain
+		terrainManager.drawLit(&core, &psos, &shaders, &textureManager, frustum, lodView);
 
 
-		// 画静态模型 - 传入 sunLight 指针// Draw static model - pass in sunLight
+		// 画静态模型// Draw static model
 		Matrix W;
-		W = Matrix::scaling(Vec3(0.01f, 0.01f, 0.01f)) * Matrix::translation(Vec3(5, 0, 0));
-		staticModel.drawLit(&core, &psos, &shaders, vp, W, &textureManager, &sunLight);
+		W = Matrix::fromTS(Vec3(5, 0, 0), Vec3(0.01f, 0.01f, 0.01f));
+		staticModel.drawLit(&core, &psos, &shaders, W, &textureManager);
 
 		// 画另一个静态模型// Draw another static model
-		W = Matrix::scaling(Vec3(0.01f, 0.01f, 0.01f)) * Matrix::translation(Vec3(10, 0, 0));
-		staticModel.drawLit(&core, &psos, &shaders, vp, W, &textureManager, &sunLight);
+		W = Matrix::fromTS(Vec3(10, 0, 0), Vec3(0.01f, 0.01f, 0.01f));
+		staticModel.drawLit(&core, &psos, &shaders, W, &textureManager);
 
-		// 更新并绘制玩家// Update and draw player
-		player.update(dt);
-		player.drawLit(&core, &psos, &shaders, vp, &textureManager, &sunLight);
+		// 绘制玩家// Draw player
+		player.updateLod(lodView, terrainManager.lodSelector);
+		player.drawLit(&core, &psos, &shaders, &textureManager);
 
-		// 更新并绘制农民// Update and draw farmer
-		farmer.update(dt);
-		farmer.drawLit(&core, &psos, &shaders, vp, &textureManager, &sunLight);
+		// 绘制农民// Draw farmer
+		farmer.updateLod(lodView, terrainManager.lodSelector);
+		farmer.drawLit(&core, &psos, &shaders, &textureManager);
 
 		core.finishFrame();
+
+		// 每秒打印一次上一帧的常量缓冲字节数、绘制调用和状态切换次数// Print the last frame's constant buffer bytes, draw calls and state changes once a second
+		frameStats().endFrame();
+		frameStats().report(dt);
 	}
 
 	core.flushGraphicsQueue();
+	frameConstants.free();
+
+	// 每个着色器常量缓冲每帧用到的最大槽数，用来调整初始大小// Peak slots per frame for each shader constant buffer, to tune the initial size
+	shaders.printConstantBufferStats();
 
 	// 清理控制台// Clean up console
 	if (pFile) fclose(pFile);
@@ -1,7 +1,7 @@
 ﻿#pragma once
 #include <vector>
-#include <fstream> 
-#include <sstream> 
+#include <algorithm>
+#include <cstddef>
 #include "Mesh.h"
 #include "Material.h"
 #include "Shaders.h"
@@ -9,8 +9,47 @@
 #include "Animation.h"
 #include "Environment.h"
 #include "StateMechine.h" 
+#include "ModelCache.h"
+#include "InstanceBuffer.h"
+#include "GrassCuller.h"
+#include "Simulation.h"
+#include "TerrainLayout.h"
 
 
+// 一个着色器变体要用到的常量句柄，load 时解析一次，绘制时直接按偏移写入
+// VP 和光照在每帧常量块里，每个物体只写 W 和骨骼
+struct ModelShaderHandles
+{
+	Shader* shader;
+	ConstantHandle W;
+	ConstantHandle bones;              // 只有动画着色器有
+
+	ModelShaderHandles()
+	{
+		shader = nullptr;
+	}
+
+	void resolve(Shaders* shaders, const std::string& shaderName, bool animated)
+	{
+		shader = shaders->find(shaderName);
+		W = shaders->findConstantVS(shaderName, "staticMeshBuffer", "W");
+		if (animated)
+		{
+			bones = shaders->findConstantVS(shaderName, "staticMeshBuffer", "bones");
+		}
+	}
+};
+
+// 打印一个网格每级 LOD 的三角形数
+inline void printLods(const Mesh* mesh)
+{
+	printf("  LOD triangles: %u", mesh->numMeshIndices / 3);
+	for (int i = 0; i < mesh->lods.size(); i++)
+	{
+		printf(" -> %u", mesh->lods[i].numIndices / 3);
+	}
+	printf("\n");
+}
 
 //静态模型类
 class StaticModel
@@ -19,20 +58,43 @@ public:
 	std::vector<Mesh*> meshes;
 	std::vector<Material*> materials;
 	bool hasTextures;
+	ModelShaderHandles unlitHandles;
+	ModelShaderHandles litHandles;
+	Shader* litInstancedShader;        // W 来自每实例数据，没有每物体常量
+	BoundingBox bounds;                // 模型空间包围盒和包围球，加载时由所有网格算出，用于视锥剔除
+	BoundingSphere sphere;
+	int lodLevels;                     // 加载时简化出的细节层级数（含原始网格）
 
 	StaticModel()
 	{
 		hasTextures = false;
+		litInstancedShader = nullptr;
+		lodLevels = 1;
 	}
 
-	void load(Core* core, std::string filename, Shaders* shaders, PSOManager* psos, MaterialManager* materialManager)
+	void load(Core* core, std::string filename, Shaders* shaders, PSOManager* psos, MaterialManager* materialManager, AssetPreloader* preloader = nullptr)
 	{
 		printf("\n=== Loading Static Model: %s ===\n", filename.c_str());
 		fflush(stdout);
 
-		GEMLoader::GEMModelLoader loader;
-		std::vector<GEMLoader::GEMMesh> gemmeshes;
-		loader.load(filename, gemmeshes);
+		// 读取 .gem.cooked 缓存（缺失或源文件改动时自动重新生成），顶点/索引直接从缓存上传
+		// 如果预加载器已经在工作线程里读好了，就直接拿结果，这里只做 GPU 上传
+		CookedModel localCooked;
+		CookedModel* cooked = &localCooked;
+		PreloadedModel* preloaded = preloader ? preloader->acquireModel(filename) : nullptr;
+		if (preloaded != nullptr)
+		{
+			if (!preloaded->loaded)
+			{
+				return;
+			}
+			cooked = &preloaded->cooked;
+		}
+		else if (!localCooked.load(filename))
+		{
+			return;
+		}
+		std::vector<CookedMeshView>& gemmeshes = cooked->meshes;
 
 		printf("Found %d meshes\n", (int)gemmeshes.size());
 		fflush(stdout);
@@ -56,14 +118,13 @@ public:
 			fflush(stdout);
 
 			Mesh* mesh = new Mesh();
-			std::vector<STATIC_VERTEX> vertices;
-			for (int j = 0; j < gemmeshes[i].verticesStatic.size(); j++)
-			{
-				STATIC_VERTEX v;
-				memcpy(&v, &gemmeshes[i].verticesStatic[j], sizeof(STATIC_VERTEX));
-				vertices.push_back(v);
-			}
-			mesh->init(core, vertices, gemmeshes[i].indices);
+			mesh->init(core, reinterpret_cast<const STATIC_VERTEX*>(gemmeshes[i].vertices), gemmeshes[i].vertexCount,
+				gemmeshes[i].indices, gemmeshes[i].indexCount);
+			// 远处用的简化版本，和原网格共用顶点缓冲
+			mesh->buildLods(core, gemmeshes[i].vertices, sizeof(STATIC_VERTEX), gemmeshes[i].vertexCount, offsetof(STATIC_VERTEX, normal),
+				gemmeshes[i].indices, gemmeshes[i].indexCount);
+			printLods(mesh);
+			lodLevels = mesh->lodLevels() > lodLevels ? mesh->lodLevels() : lodLevels;
 			meshes.push_back(mesh);
 
 			
@@ -81,6 +142,13 @@ public:
 			fflush(stdout);
 		}
 
+		if (preloaded != nullptr)
+		{
+			preloader->releaseModel(filename);
+		}
+
+		computeModelBounds(meshes, bounds, sphere);
+
 		printf("\nModel loaded. hasTextures = %s\n", hasTextures ? "true" : "false");
 		fflush(stdout);
 
@@ -89,27 +157,41 @@ public:
 		shaders->load(core, "StaticModelTextured", "VS.txt", "PSTextured.txt");
 		psos->createPSO(core, "StaticModelPSO", shaders->find("StaticModelUntextured")->vs, shaders->find("StaticModelUntextured")->ps, VertexLayoutCache::getStaticLayout());
 		psos->createPSO(core, "StaticModelTexturedPSO", shaders->find("StaticModelTextured")->vs, shaders->find("StaticModelTextured")->ps, VertexLayoutCache::getStaticLayout());
+		shaders->load(core, "StaticModelLit", "VS.txt", "PSLit.txt");
+		shaders->load(core, "StaticModelLitUntextured", "VS.txt", "PSLitUnTextured.txt");
+		psos->createPSO(core, "StaticModelLitPSO", shaders->find("StaticModelLit")->vs, shaders->find("StaticModelLit")->ps, VertexLayoutCache::getStaticLayout());
+		psos->createPSO(core, "StaticModelLitUntexturedPSO", shaders->find("StaticModelLitUntextured")->vs, shaders->find("StaticModelLitUntextured")->ps, VertexLayoutCache::getStaticLayout());
+		shaders->load(core, "StaticModelLitInstanced", "VSInstanced.txt", "PSLit.txt");
+		shaders->load(core, "StaticModelLitInstancedUntextured", "VSInstanced.txt", "PSLitUnTextured.txt");
+		psos->createPSO(core, "StaticModelLitInstancedPSO", shaders->find("StaticModelLitInstanced")->vs, shaders->find("StaticModelLitInstanced")->ps, VertexLayoutCache::getInstancedLayout());
+		psos->createPSO(core, "StaticModelLitInstancedUntexturedPSO", shaders->find("StaticModelLitInstancedUntextured")->vs, shaders->find("StaticModelLitInstancedUntextured")->ps, VertexLayoutCache::getInstancedLayout());
+
+		// 常量句柄在这里解析好，绘制时不再按名字查找
+		unlitHandles.resolve(shaders, hasTextures ? "StaticModelTextured" : "StaticModelUntextured", false);
+		litHandles.resolve(shaders, hasTextures ? "StaticModelLit" : "StaticModelLitUntextured", false);
+		litInstancedShader = shaders->find(hasTextures ? "StaticModelLitInstanced" : "StaticModelLitInstancedUntextured");
 	}
 	//
 	void updateWorld(Shaders* shaders, Matrix& w)
 	{
-		std::string shaderName = hasTextures ? "StaticModelTextured" : "StaticModelUntextured";
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "W", &w);
+		shaders->update(unlitHandles.W, &w);
 	}
 
-	void draw(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp, TextureManager* textureManager)
+	void draw(Core* core, PSOManager* psos, Shaders* shaders, TextureManager* textureManager)
 	{
-		std::string shaderName = hasTextures ? "StaticModelTextured" : "StaticModelUntextured";
 		std::string psoName = hasTextures ? "StaticModelTexturedPSO" : "StaticModelPSO";
 
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "VP", &vp);
+		if (unlitHandles.shader == nullptr)
+		{
+			return;
+		}
 
 		if (hasTextures)
 		{
 			textureManager->bindHeap(core);
 		}
 
-		shaders->apply(core, shaderName);
+		unlitHandles.shader->apply(core);
 		psos->bind(core, psoName);
 
 		for (int i = 0; i < meshes.size(); i++)
@@ -123,27 +205,23 @@ public:
 	}
 
 	
-	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp, Matrix& w, TextureManager* textureManager, DirectionalLight* light)
+	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, Matrix& w, TextureManager* textureManager, int lod = 0)
 	{
-		std::string shaderName = hasTextures ? "StaticModelLit" : "StaticModelLitUntextured";
 		std::string psoName = hasTextures ? "StaticModelLitPSO" : "StaticModelLitUntexturedPSO";
 
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "VP", &vp);
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "W", &w);
+		if (litHandles.shader == nullptr)
+		{
+			return;
+		}
 
-		
-		Vec3 lightDir = light->getLightDirectionForShader();
-		shaders->updateConstantPS(shaderName, "LightBuffer", "lightDirection", &lightDir);
-		shaders->updateConstantPS(shaderName, "LightBuffer", "lightIntensity", &light->intensity);
-		shaders->updateConstantPS(shaderName, "LightBuffer", "lightColor", &light->color);
-		shaders->updateConstantPS(shaderName, "LightBuffer", "ambientStrength", &light->ambientStrength);
+		shaders->update(litHandles.W, &w);
 
 		if (hasTextures)
 		{
 			textureManager->bindHeap(core);
 		}
 
-		shaders->apply(core, shaderName);
+		litHandles.shader->apply(core);
 		psos->bind(core, psoName);
 
 		for (int i = 0; i < meshes.size(); i++)
@@ -152,7 +230,36 @@ public:
 			{
 				materials[i]->bind(core);
 			}
-			meshes[i]->draw(core);
+			meshes[i]->draw(core, lod);
+		}
+	}
+
+	// 同一个模型的多个副本一次画完：每个网格一次 DrawIndexedInstanced，W 矩阵在 instanceView 里，所有副本用同一级 LOD
+	void drawLitInstanced(Core* core, PSOManager* psos, Shaders* shaders, TextureManager* textureManager,
+		const D3D12_VERTEX_BUFFER_VIEW& instanceView, int instanceCount, int lod = 0)
+	{
+		std::string psoName = hasTextures ? "StaticModelLitInstancedPSO" : "StaticModelLitInstancedUntexturedPSO";
+
+		if (litInstancedShader == nullptr || instanceCount == 0)
+		{
+			return;
+		}
+
+		if (hasTextures)
+		{
+			textureManager->bindHeap(core);
+		}
+
+		litInstancedShader->apply(core);
+		psos->bind(core, psoName);
+
+		for (int i = 0; i < meshes.size(); i++)
+		{
+			if (hasTextures && materials[i]->hasTexture)
+			{
+				materials[i]->bind(core);
+			}
+			meshes[i]->drawInstanced(core, instanceView, instanceCount, lod);
 		}
 	}
 
@@ -165,21 +272,39 @@ public:
 	Animation animation;
 	std::vector<Material*> materials;
 	bool hasTextures;
+	ModelShaderHandles unlitHandles;
+	ModelShaderHandles litHandles;
+	BoundingBox bounds;                // 绑定姿势下的模型空间包围体
+	BoundingSphere sphere;             // 已放大，动画可能把顶点带出绑定姿势的范围
+	int lodLevels;
 
 	AnimatedModel()
 	{
 		hasTextures = false;
+		lodLevels = 1;
 	}
 
-	void load(Core* core, std::string filename, PSOManager* psos, Shaders* shaders, MaterialManager* materialManager)
+	void load(Core* core, std::string filename, PSOManager* psos, Shaders* shaders, MaterialManager* materialManager, AssetPreloader* preloader = nullptr)
 	{
 		printf("\n=== Loading Animated Model: %s ===\n", filename.c_str());
 		fflush(stdout);
 
-		GEMLoader::GEMModelLoader loader;
-		std::vector<GEMLoader::GEMMesh> gemmeshes;
-		GEMLoader::GEMAnimation gemanimation;
-		loader.load(filename, gemmeshes, gemanimation);
+		CookedModel localCooked;
+		CookedModel* cooked = &localCooked;
+		PreloadedModel* preloaded = preloader ? preloader->acquireModel(filename) : nullptr;
+		if (preloaded != nullptr)
+		{
+			if (!preloaded->loaded)
+			{
+				return;
+			}
+			cooked = &preloaded->cooked;
+		}
+		else if (!localCooked.load(filename))
+		{
+			return;
+		}
+		std::vector<CookedMeshView>& gemmeshes = cooked->meshes;
 
 		printf("Found %d meshes\n", (int)gemmeshes.size());
 		fflush(stdout);
@@ -202,14 +327,13 @@ public:
 			fflush(stdout);
 
 			Mesh* mesh = new Mesh();
-			std::vector<ANIMATED_VERTEX> vertices;
-			for (int j = 0; j < gemmeshes[i].verticesAnimated.size(); j++)
-			{
-				ANIMATED_VERTEX v;
-				memcpy(&v, &gemmeshes[i].verticesAnimated[j], sizeof(ANIMATED_VERTEX));
-				vertices.push_back(v);
-			}
-			mesh->init(core, vertices, gemmeshes[i].indices);
+			mesh->init(core, reinterpret_cast<const ANIMATED_VERTEX*>(gemmeshes[i].vertices), gemmeshes[i].vertexCount,
+				gemmeshes[i].indices, gemmeshes[i].indexCount);
+			// 简化版本直接引用原顶点，骨骼权重不变
+			mesh->buildLods(core, gemmeshes[i].vertices, sizeof(ANIMATED_VERTEX), gemmeshes[i].vertexCount, offsetof(ANIMATED_VERTEX, normal),
+				gemmeshes[i].indices, gemmeshes[i].indexCount);
+			printLods(mesh);
+			lodLevels = mesh->lodLevels() > lodLevels ? mesh->lodLevels() : lodLevels;
 			meshes.push_back(mesh);
 
 			
@@ -227,6 +351,9 @@ public:
 			fflush(stdout);
 		}
 
+		computeModelBounds(meshes, bounds, sphere);
+		sphere.radius *= 1.5f;
+
 		printf("\nModel loaded. hasTextures = %s\n", hasTextures ? "true" : "false");
 		fflush(stdout);
 
@@ -234,51 +361,34 @@ public:
 		shaders->load(core, "AnimatedTextured", "VSAnim.txt", "PSTextured.txt");
 		psos->createPSO(core, "AnimatedModelPSO", shaders->find("AnimatedUntextured")->vs, shaders->find("AnimatedUntextured")->ps, VertexLayoutCache::getAnimatedLayout());
 		psos->createPSO(core, "AnimatedModelTexturedPSO", shaders->find("AnimatedTextured")->vs, shaders->find("AnimatedTextured")->ps, VertexLayoutCache::getAnimatedLayout());
+		shaders->load(core, "AnimatedLit", "VSAnim.txt", "PSLit.txt");
+		shaders->load(core, "AnimatedLitUntextured", "VSAnim.txt", "PSLitUnTextured.txt");
+		psos->createPSO(core, "AnimatedModelLitPSO", shaders->find("AnimatedLit")->vs, shaders->find("AnimatedLit")->ps, VertexLayoutCache::getAnimatedLayout());
+		psos->createPSO(core, "AnimatedModelLitUntexturedPSO", shaders->find("AnimatedLitUntextured")->vs, shaders->find("AnimatedLitUntextured")->ps, VertexLayoutCache::getAnimatedLayout());
+
+		unlitHandles.resolve(shaders, hasTextures ? "AnimatedTextured" : "AnimatedUntextured", true);
+		litHandles.resolve(shaders, hasTextures ? "AnimatedLit" : "AnimatedLitUntextured", true);
 
-		memcpy(&animation.skeleton.globalInverse, &gemanimation.globalInverse, 16 * sizeof(float));
-		for (int i = 0; i < gemanimation.bones.size(); i++)
+		// 骨骼和动画轨道在缓存里已经按 [frame * bones + bone] 排好，每个通道一次拷贝
+		// 预加载时工作线程已经转换好了，直接移交
+		if (preloaded != nullptr)
 		{
-			Bone bone;
-			bone.name = gemanimation.bones[i].name;
-			memcpy(&bone.offset, &gemanimation.bones[i].offset, 16 * sizeof(float));
-			bone.parentIndex = gemanimation.bones[i].parentIndex;
-			animation.skeleton.bones.push_back(bone);
+			animation = std::move(preloaded->animation);
+			preloader->releaseModel(filename);
 		}
-		for (int i = 0; i < gemanimation.animations.size(); i++)
+		else
 		{
-			std::string name = gemanimation.animations[i].name;
-			AnimationSequence aseq;
-			aseq.ticksPerSecond = gemanimation.animations[i].ticksPerSecond;
-			for (int j = 0; j < gemanimation.animations[i].frames.size(); j++)
-			{
-				AnimationFrame frame;
-				for (int index = 0; index < gemanimation.animations[i].frames[j].positions.size(); index++)
-				{
-					Vec3 p;
-					Quaternion q;
-					Vec3 s;
-					memcpy(&p, &gemanimation.animations[i].frames[j].positions[index], sizeof(Vec3));
-					frame.positions.push_back(p);
-					memcpy(&q, &gemanimation.animations[i].frames[j].rotations[index], sizeof(Quaternion));
-					frame.rotations.push_back(q);
-					memcpy(&s, &gemanimation.animations[i].frames[j].scales[index], sizeof(Vec3));
-					frame.scales.push_back(s);
-				}
-				aseq.frames.push_back(frame);
-			}
-			animation.animations.insert({ name, aseq });
+			cooked->fillAnimation(animation);
 		}
 	}
 
 	void updateWorld(Shaders* shaders, Matrix& w)
 	{
-		std::string shaderName = hasTextures ? "AnimatedTextured" : "AnimatedUntextured";
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "W", &w);
+		shaders->update(unlitHandles.W, &w);
 	}
 
-	void draw(Core* core, PSOManager* psos, Shaders* shaders, AnimationInstance* instance, Matrix& vp, Matrix& w, TextureManager* textureManager)
+	void draw(Core* core, PSOManager* psos, Shaders* shaders, Matrix* bones, Matrix& w, TextureManager* textureManager)
 	{
-		std::string shaderName = hasTextures ? "AnimatedTextured" : "AnimatedUntextured";
 		std::string psoName = hasTextures ? "AnimatedModelTexturedPSO" : "AnimatedModelPSO";
 
 		
@@ -288,9 +398,9 @@ public:
 			return;
 		}
 
-		if (instance == nullptr)
+		if (bones == nullptr)
 		{
-			printf("ERROR: AnimationInstance is null!\n");
+			printf("ERROR: Bone matrices are null!\n");
 			return;
 		}
 
@@ -300,12 +410,11 @@ public:
 		}
 
 		// 先更新常量
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "W", &w);
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "VP", &vp);
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "bones", instance->matrices);
+		shaders->update(unlitHandles.W, &w);
+		shaders->update(unlitHandles.bones, bones);
 
 		// 然后应用着色器（在 PSO 之前）
-		shaders->apply(core, shaderName);
+		unlitHandles.shader->apply(core);
 
 		// 最后绑定 PSO
 		psos->bind(core, psoName);
@@ -320,12 +429,11 @@ public:
 		}
 	}
 	
-	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, AnimationInstance* instance, Matrix& vp, Matrix& w, TextureManager* textureManager, DirectionalLight* light)
+	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, Matrix* bones, Matrix& w, TextureManager* textureManager, int lod = 0)
 	{
-		std::string shaderName = hasTextures ? "AnimatedLit" : "AnimatedLitUntextured";
 		std::string psoName = hasTextures ? "AnimatedModelLitPSO" : "AnimatedModelLitUntexturedPSO";
 
-		if (meshes.empty() || instance == nullptr)
+		if (meshes.empty() || bones == nullptr)
 		{
 			return;
 		}
@@ -335,18 +443,10 @@ public:
 			textureManager->bindHeap(core);
 		}
 
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "W", &w);
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "VP", &vp);
-		shaders->updateConstantVS(shaderName, "staticMeshBuffer", "bones", instance->matrices);
+		shaders->update(litHandles.W, &w);
+		shaders->update(litHandles.bones, bones);
 
-		// 每次绘制前都更新光照常量
-		Vec3 lightDir = light->getLightDirectionForShader();
-		shaders->updateConstantPS(shaderName, "LightBuffer", "lightDirection", &lightDir);
-		shaders->updateConstantPS(shaderName, "LightBuffer", "lightIntensity", &light->intensity);
-		shaders->updateConstantPS(shaderName, "LightBuffer", "lightColor", &light->color);
-		shaders->updateConstantPS(shaderName, "LightBuffer", "ambientStrength", &light->ambientStrength);
-
-		shaders->apply(core, shaderName);
+		litHandles.shader->apply(core);
 		psos->bind(core, psoName);
 
 		for (int i = 0; i < meshes.size(); i++)
@@ -355,491 +455,185 @@ public:
 			{
 				materials[i]->bind(core);
 			}
-			meshes[i]->draw(core);
+			meshes[i]->draw(core, lod);
 		}
 	}
 };
 //可位移的动画模型类（用到动画模型类）
-class MoveAnimatedModel
+class MoveAnimatedModel : public Runner
 {
 public:
 	AnimatedModel* model;
-	// 替换为状态机
-	StateMachine stateMachine;
-	Vec3 position;
-	Vec3 scale;
-	float speed;
-	float rotationX;
-	float rotationY;
-	float rotationZ;
-	
+	int lod;           // 当前细节层级，由 updateLod 按屏幕大小选择
+	// 位置、速度、状态机和插值都在 Runner 里，这里只管绘制
 
 	MoveAnimatedModel()
 	{
-		position = Vec3(0, 0, 0);
-		scale = Vec3(0.1f, 0.1f, 0.1f);
-		speed = 1.0f;
-		rotationX = 0.0f;
-		rotationY = 0.0f;
-		rotationZ = 0.0f;
+		lod = 0;
 		model = nullptr;
 	}
 
 	void init(AnimatedModel* _model, Vec3 startPosition, Vec3 _scale)
 	{
 		model = _model;
-		position = startPosition;
-		scale = _scale;
-		//初始化状态机//Initialize state machine
-		stateMachine.init(&model->animation);
-		if (model->animation.hasAnimation("run forward"))
-		{
-			stateMachine.changeState("run forward", 0.0f);
-		}
-	}
-
-	void update(float dt)
-	{
-		// 更新状态机// Update state machine
-		stateMachine.update(dt * 0.5f);
-
-		// 向前移动（Z轴正方向）// Move forward (positive Z direction)
-		position.z -= speed * dt;
+		Runner::init(&model->animation, startPosition, _scale);
 	}
 
-	// 增加 loop 参数，默认为 true// Add loop parameter, default to true
-	void playAnimation(std::string name, float blendTime = 0.2f, bool loop = true)
-	{
-		stateMachine.changeState(name, blendTime, loop);
-	}
-
-	void draw(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp, TextureManager* textureManager)
+	void draw(Core* core, PSOManager* psos, Shaders* shaders, TextureManager* textureManager)
 	{
 		// 构建世界矩阵：缩放 -> 旋转 -> 平移
-		Matrix W = Matrix::scaling(scale) *
-			Matrix::rotateX(rotationX) *
-			Matrix::rotateY(rotationY) *
-			Matrix::rotateZ(rotationZ) *
-			Matrix::translation(position);
+		Matrix W = Matrix::fromEulerTRS(renderPosition, Vec3(rotationX, rotationY, rotationZ), scale);
 
 		// 传入状态机的渲染实例
-		model->draw(core, psos, shaders, stateMachine.getRenderInstance(), vp, W, textureManager);
+		model->draw(core, psos, shaders, stateMachine.getRenderMatrices(), W, textureManager);
 	}
 	
-	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp, TextureManager* textureManager, DirectionalLight* light)
+	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, TextureManager* textureManager)
 	{
-		Matrix W = Matrix::scaling(scale) *
-			Matrix::rotateX(rotationX) *
-			Matrix::rotateY(rotationY) *
-			Matrix::rotateZ(rotationZ) *
-			Matrix::translation(position);
+		Matrix W = Matrix::fromEulerTRS(renderPosition, Vec3(rotationX, rotationY, rotationZ), scale);
 
 		// 传入状态机的渲染实例
-		model->drawLit(core, psos, shaders, stateMachine.getRenderInstance(), vp, W, textureManager, light);
-	}
-
-	// 设置起点和缩放的接口
-	void setTransform(Vec3 startPosition, Vec3 _scale)
-	{
-		position = startPosition;
-		scale = _scale;
-	}
-
-	// 设置速度
-	void setSpeed(float _speed)
-	{
-		speed = _speed;
+		model->drawLit(core, psos, shaders, stateMachine.getRenderMatrices(), W, textureManager, lod);
 	}
 
-	// 设置旋转角度（弧度）
-	void setRotation(int xyz, float _rotation)
+	// 按包围球在屏幕上的大小选 LOD，每帧绘制前调用
+	void updateLod(const LodView& view, const LodSelector& selector)
 	{
-		if (xyz == 0) rotationX = _rotation;
-		else if (xyz == 1) rotationY = _rotation;
-		else if (xyz == 2) rotationZ = _rotation;
+		BoundingSphere sphere = model->sphere.transformed(Matrix::fromEulerTRS(renderPosition, Vec3(rotationX, rotationY, rotationZ), scale));
+		selector.select(view.screenSize(sphere), model->lodLevels, lod);
 	}
 };
-//专门的障碍物类-用来处理障碍物逻辑-本质是动画模型（比如前方是正在吃草的山羊）
-class Obstacle {
-public:
-	AnimatedModel* model;
-	StateMachine stateMachine;
-	Vec3 position;
-	Vec3 scale;
-	float rotationY;
-	bool hit;              
-	float collisionRadius; 
-
-	Obstacle()
-	{
-		model = nullptr;
-		position = Vec3(0, 0, 0);
-		scale = Vec3(0.1f, 0.1f, 0.1f);
-		rotationY = 0.0f;
-		hit = false;
-		collisionRadius = 0.5f;
-	}
-
-	void init(AnimatedModel* _model, Vec3 _pos, float _rotY, float _scale)
-	{
-		model = _model;
-		position = _pos;
-		rotationY = _rotY;
-		scale = Vec3(_scale, _scale, _scale);
-		hit = false;            
-		collisionRadius = 0.8f; 
-
-		if (model)
-		{
-			
-			stateMachine.init(&model->animation);
-			stateMachine.changeState("eating", 0.0f);
-
-			
-			float randomOffset = ((float)rand() / RAND_MAX) * 5.0f;
-			stateMachine.update(randomOffset);
-		}
-	}
-
-	void update(float dt)
-	{
-		if (!model) return;
-		
-		stateMachine.update(dt);
-	}
-
-	
-	void playAnimation(std::string name, float blendTime = 0.2f, bool loop = true)
-	{
-		stateMachine.changeState(name, blendTime, loop);
-	}
-
-	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp, TextureManager* textureManager, DirectionalLight* light)
-	{
-		if (!model) return;
-
-		Matrix W = Matrix::scaling(scale) *
-			Matrix::rotateY(rotationY) *
-			Matrix::translation(position);
-
-		
-		model->drawLit(core, psos, shaders, stateMachine.getRenderInstance(), vp, W, textureManager, light);
-	}
-};
-//地块类-包含障碍物和草地实例化逻辑
+//地块的绘制数据-草地实例、包围盒和细节层级，障碍物和装饰物本身在 Track 的 TrackTile 里
 class TerrainTile
 {
 public:
-	Vec3 position;
-	float length;  // 地块沿Z轴的长度
+	TrackTile* tile;  // 对应的轨道地块，回收后还是同一个
 
-	// 障碍物
-	std::vector<Obstacle> obstacles;
+	// 每个装饰物和障碍物上一帧用的细节层级，LOD 切换的滞后靠它，顺序同 TrackTile 里的列表
+	std::vector<int> decorationLods;
+	std::vector<int> obstacleLods;
 
-	// 装饰物（蘑菇）
-	struct Decoration {
-		Vec3 position;
-		float scale;
-		float rotationY;
-	};
-	std::vector<Decoration> decorations;
+	// 草地实例（CPU 端），GPU 数据在 TerrainManager 的草地实例缓冲里，所有种类和地块合成一次绘制
+	std::vector<GrassInstance> grassInstances;
+	GrassSpheres grassSpheres;  // 每棵草的世界空间包围球，顺序同 grassInstances，用于逐棵剔除
 
-	// 硬件实例化资源管理
-	static const int MAX_GRASS_TYPES = 5;
-	ID3D12Resource* instanceBuffers[MAX_GRASS_TYPES];
-	int instanceCounts[MAX_GRASS_TYPES];
-
-	// 记录当前 Buffer 的容量（能装多少个实例）
-	int bufferCapacities[MAX_GRASS_TYPES];
-	bool buffersCreated;
+	// 世界空间包围盒，包含路、路边草、草、装饰物和障碍物，每次生成后由 TerrainManager 更新
+	BoundingBox bounds;
 
 	TerrainTile()
 	{
-		position = Vec3(0, 0, 0);
-		length = 20.0f;
-		buffersCreated = false;
-		for (int i = 0; i < MAX_GRASS_TYPES; i++) {
-			instanceBuffers[i] = nullptr;
-			instanceCounts[i] = 0;
-			bufferCapacities[i] = 0; // 初始化容量为0
-		}
+		tile = nullptr;
 	}
 
-	// 析构函数
-	~TerrainTile()
+	// 生成草（只算 CPU 数据，上传由 TerrainManager 的草地实例缓冲负责）
+	// 随机数来自地块自己的草地随机流，同一种子和地块序号总是生成同样的草
+	void generateGrass()
 	{
-		cleanupBuffers();
-	}
-	void cleanupBuffers()
-	{
-		for (int i = 0; i < MAX_GRASS_TYPES; i++) {
-			if (instanceBuffers[i]) {
-				// 但如果在运行时手动调用 cleanup，必须先 flush
-				instanceBuffers[i]->Release();
-				instanceBuffers[i] = nullptr;
-			}
-			instanceCounts[i] = 0;
-			bufferCapacities[i] = 0;
-		}
-		buffersCreated = false;
+		generateTerrainGrass(*tile, grassInstances);
 	}
 
-	// 碰撞检测逻辑
-	int checkCollisions(Vec3 playerPos, float playerRadius)
+	// 地块内容重新生成后调用，细节层级从最精细开始
+	void resetLods()
 	{
-		int hits = 0;
-		for (auto& obs : obstacles)
-		{
-			if (obs.hit) continue;
-			float dx = playerPos.x - obs.position.x;
-			float dz = playerPos.z - obs.position.z;
-			float distSq = dx * dx + dz * dz;
-			float minDist = playerRadius + obs.collisionRadius;
-			if (distSq < minDist * minDist)
-			{
-				obs.hit = true;
-				hits++;
-				printf("Collision Detected! Obstacle at Z: %.2f\n", obs.position.z);
-			}
-		}
-		return hits;
+		decorationLods.assign(tile->decorations.size(), 0);
+		obstacleLods.assign(tile->obstacles.size(), 0);
 	}
 
-	// 智能生成草（复用 Buffer + 安全扩容）
-	void generateGrass(Core* core)
+	// 绘制 (不带光照)
+	void draw(Core* core, PSOManager* psos, Shaders* shaders,
+		StaticModel* road, StaticModel* grass, TextureManager* textureManager)
 	{
-		// 1. CPU 端计算数据 (保持不变)
-		std::vector<InstanceData> cpuInstances[MAX_GRASS_TYPES];
-
-		
-		float minVal = -4.0f;
-		float maxVal = 4.0f;
-
-		auto randomOffset = [minVal, maxVal]() {
-			float r = (float)rand() / RAND_MAX;
-			return r * (maxVal - minVal) + minVal;
-			};
-		auto randomType = []() { return rand() % MAX_GRASS_TYPES; };
-
-		auto addGrass = [&](float xBase, float zBase) {
-			float offsetX = randomOffset();
-			float offsetZ = randomOffset();
-			int type = randomType();
-			Vec3 finalPos = position + Vec3(xBase + offsetX, 0.0f, zBase + offsetZ);
-			float scale = 5.0f;
-			Matrix W = Matrix::scaling(Vec3(scale, scale, scale)) * Matrix::translation(finalPos);
-			InstanceData data;
-			data.worldMatrix = W;
-			cpuInstances[type].push_back(data);
-			};
-
-		//右侧
-		for (int x = -30; x <= -0; x++) {
-			for (int z = -6; z <= 6; z++) {
-				addGrass(x * 5.0f - 17.0f, z * 10.0f);
-			}
-		}
-		//左侧
-		for (int x = 0; x <= 5; x++) {
-			for (int z = -6; z <= 6; z++) {
-				addGrass(x * 5.0f + 17.0f, z * 10.0f);
-			}
-		}
-
-		// 2. 智能更新 GPU Buffer
-		for (int i = 0; i < MAX_GRASS_TYPES; i++)
-		{
-			int newCount = (int)cpuInstances[i].size();
-			instanceCounts[i] = newCount;
+		Matrix W;
+		W = Matrix::fromTS(tile->position + Vec3(0, -0.8f, 0), Vec3(0.07f, 0.01f, 0.04f));
+		road->updateWorld(shaders, W);
+		road->draw(core, psos, shaders, textureManager);
 
-			if (newCount > 0)
-			{
-				// 情况 A: 现有的 Buffer 太小，或者还没有 Buffer
-				if (instanceBuffers[i] == nullptr || newCount > bufferCapacities[i])
-				{
-					// 安全措施：如果旧 Buffer 存在，必须等待 GPU 用完它才能删除
-					if (instanceBuffers[i] != nullptr)
-					{
-						core->flushGraphicsQueue(); // 强制同步 GPU，防止崩溃
-						instanceBuffers[i]->Release();
-						instanceBuffers[i] = nullptr;
-					}
-
-					// 计算新容量：预留 1.5 倍空间，防止下次稍微多一点草又要重新分配
-					int newCapacity = (int)(newCount * 1.5f);
-					if (newCapacity < 64) newCapacity = 64; // 最小分配大小
-					bufferCapacities[i] = newCapacity;
-
-					int bufferSize = newCapacity * sizeof(InstanceData);
-
-					// 创建新 Buffer
-					D3D12_HEAP_PROPERTIES heapProps = {};
-					heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-					heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-					heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-					heapProps.CreationNodeMask = 1;
-					heapProps.VisibleNodeMask = 1;
-
-					D3D12_RESOURCE_DESC bufferDesc = {};
-					bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-					bufferDesc.Width = bufferSize;
-					bufferDesc.Height = 1;
-					bufferDesc.DepthOrArraySize = 1;
-					bufferDesc.MipLevels = 1;
-					bufferDesc.SampleDesc.Count = 1;
-					bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-					bufferDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-					core->device->CreateCommittedResource(
-						&heapProps, D3D12_HEAP_FLAG_NONE,
-						&bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ,
-						nullptr, IID_PPV_ARGS(&instanceBuffers[i]));
-				}
+		W = Matrix::fromTS(tile->position + Vec3(-20.0f, -0.7f, 0), Vec3(0.01f, 0.01f, 0.06f));
+		grass->updateWorld(shaders, W);
+		grass->draw(core, psos, shaders, textureManager);
 
-				// 情况 B: Buffer 够大，直接更新数据（这是最快且最安全的路径）
-				// Map -> Copy -> Unmap
-				void* pData;
-				// 注意：这里只拷贝实际需要的数量 (newCount)，而不是整个容量
-				instanceBuffers[i]->Map(0, nullptr, &pData);
-				memcpy(pData, cpuInstances[i].data(), newCount * sizeof(InstanceData));
-				instanceBuffers[i]->Unmap(0, nullptr);
-			}
-		}
-		buffersCreated = true;
+		W = Matrix::fromTS(tile->position + Vec3(15.0f, -0.7f, 0), Vec3(0.01f, 0.01f, 0.06f));
+		grass->updateWorld(shaders, W);
+		grass->draw(core, psos, shaders, textureManager);
 	}
 
-	// 生成障碍物
-	void generateObstacles(AnimatedModel* model, int obstacleType)
+	// 收集路、路边草和装饰物的世界矩阵，由 TerrainManager 把所有地块合并成每个模型一次实例化绘制
+	void collectStaticInstances(std::vector<InstanceData>& roads, std::vector<InstanceData>& verges, std::vector<InstanceData>& decorationInstances)
 	{
-		obstacles.clear();
-		if (!model) return;
-
-		// obstacleType: 0=None, 1=Left, 2=Right
-		if (obstacleType == 0) return;
-
-		Obstacle obs;
-		bool isLeft = (obstacleType == 1);
-		float xPos = isLeft ? 5.0f : -5.3f;
-		float rotY = isLeft ? 1.57f : -1.57f;
-		
-		// Z轴偏移仍然保留一点随机性，增加视觉变化
-		float zOffset = ((float)rand() / RAND_MAX - 0.5f) * (length * 0.6f);
-		Vec3 obsPos = position + Vec3(xPos, -0.8f, zOffset);
-		obs.init(model, obsPos, rotY, 0.11f);
-		obstacles.push_back(obs);
+		collectRoadInstances(roads, verges);
+		InstanceData data;
+		for (auto& dec : tile->decorations)
+		{
+			data.worldMatrix = terrainDecorationMatrix(dec);
+			decorationInstances.push_back(data);
+		}
 	}
 
-	// 生成装饰物
-	void generateDecorations(int count)
+	// 同上，但装饰物按 LOD 分组放进 decorationsByLod[级别]，每个级别一次实例化绘制
+	void collectStaticInstances(std::vector<InstanceData>& roads, std::vector<InstanceData>& verges, std::vector<InstanceData>* decorationsByLod,
+		StaticModel* decorationModel, const LodView& view, const LodSelector& selector)
 	{
-		decorations.clear();
-		
-		for (int i = 0; i < count; i++)
+		collectRoadInstances(roads, verges);
+		if (decorationModel == nullptr)
 		{
-			Decoration dec;
-			// 随机位置，避开道路 (道路宽约 10，左右各 5)
-			// 在 +/- 8 到 +/- 25 之间
-			bool isLeft = (rand() % 2 == 0);
-			float xOffset = 18.0f + ((float)rand() / RAND_MAX) * 17.0f;
-			float x = isLeft ? xOffset : -xOffset;
-
-			// Z轴随机
-			float zOffset = ((float)rand() / RAND_MAX - 0.5f) * length;
-
-			dec.position = position + Vec3(x, -0.8f, zOffset);
-
-			// 随机缩放 (参考 Game.cpp 中的 0.01f)
-			float randomScale = 0.007f + ((float)rand() / RAND_MAX) * 0.01f; 
-			dec.scale = randomScale;
-
-			dec.rotationY = ((float)rand() / RAND_MAX) * 6.28f;
-
-			decorations.push_back(dec);
+			return;
+		}
+		InstanceData data;
+		for (int i = 0; i < tile->decorations.size(); i++)
+		{
+			data.worldMatrix = terrainDecorationMatrix(tile->decorations[i]);
+			int level = selector.select(view.screenSize(decorationModel->sphere.transformed(data.worldMatrix)), decorationModel->lodLevels, decorationLods[i]);
+			decorationsByLod[level].push_back(data);
 		}
 	}
 
-	// 更新 
-	void update(float dt)
+	// 路和路边草，每个地块固定三个实例
+	void collectRoadInstances(std::vector<InstanceData>& roads, std::vector<InstanceData>& verges)
 	{
-		for (auto& obs : obstacles) obs.update(dt);
-	}
+		InstanceData data;
+		// 1. 路
+		data.worldMatrix = terrainRoadMatrix(*tile);
+		roads.push_back(data);
 
-	void setPosition(Vec3 pos) { position = pos; }
+		// 2. 路边草
+		data.worldMatrix = terrainVergeMatrix(*tile, 0);
+		verges.push_back(data);
+		data.worldMatrix = terrainVergeMatrix(*tile, 1);
+		verges.push_back(data);
+	}
 
-	// 绘制 (不带光照)
-	void draw(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp,
-		StaticModel* road, StaticModel* grass, TextureManager* textureManager)
+	// 障碍物的世界空间包围球
+	static BoundingSphere obstacleSphere(AnimatedModel* model, const TrackObstacle& obs)
 	{
-		Matrix W;
-		shaders->updateConstantVS("StaticModelUntextured", "staticMeshBuffer", "VP", &vp);
-		W = Matrix::scaling(Vec3(0.07f, 0.01f, 0.04f)) * Matrix::translation(position + Vec3(0, -0.8f, 0));
-		road->updateWorld(shaders, W);
-		road->draw(core, psos, shaders, vp, textureManager);
-
-		W = Matrix::scaling(Vec3(0.01f, 0.01f, 0.06f)) * Matrix::translation(position + Vec3(-20.0f, -0.7f, 0));
-		grass->updateWorld(shaders, W);
-		grass->draw(core, psos, shaders, vp, textureManager);
-
-		W = Matrix::scaling(Vec3(0.01f, 0.01f, 0.06f)) * Matrix::translation(position + Vec3(15.0f, -0.7f, 0));
-		grass->updateWorld(shaders, W);
-		grass->draw(core, psos, shaders, vp, textureManager);
+		return obs.worldSphere(model->sphere);
 	}
 
-	// 绘制 (带光照)
-	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp,
-		StaticModel* road, StaticModel* grass, GrassPatch* grassPatch, StaticModel* decorationModel,
-		TextureManager* textureManager, DirectionalLight* light, float dt)
+	// 绘制 (带光照)，路、路边草、装饰物和草阵都由 TerrainManager 合并绘制，这里只剩障碍物
+	// 骨骼在绘制前由 animateVisibleObstacles 算好，这里只画
+	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, TextureManager* textureManager, const Frustum& frustum,
+		const LodView& view, const LodSelector& selector, AnimatedModel* obstacleModel)
 	{
-		Matrix W;
-		// 1. 路
-		W = Matrix::scaling(Vec3(0.07f, 0.01f, 0.04f)) * Matrix::translation(position + Vec3(0, -0.8f, 0));
-		road->drawLit(core, psos, shaders, vp, W, textureManager, light);
-
-		// 2. 路边草
-		W = Matrix::scaling(Vec3(0.03f, 0.01f, 0.06f)) * Matrix::translation(position + Vec3(-29.9f, -0.7f, 0));
-		grass->drawLit(core, psos, shaders, vp, W, textureManager, light);
-
-		W = Matrix::scaling(Vec3(0.02f, 0.01f, 0.06f)) * Matrix::translation(position + Vec3(20.0f, -0.7f, 0));
-		grass->drawLit(core, psos, shaders, vp, W, textureManager, light);
-
-		// 3. 实例化草阵
-		if (buffersCreated)
-		{
-			for (int i = 0; i < MAX_GRASS_TYPES; i++)
-			{
-				if (instanceCounts[i] > 0 && instanceBuffers[i])
-				{
-					grassPatch->drawInstanced(core, psos, shaders, vp, textureManager, light, dt, i, instanceBuffers[i], instanceCounts[i]);
-				}
-			}
-		}
-
-		// 4. 障碍物
-		for (auto& obs : obstacles)
+		for (int i = 0; i < tile->obstacles.size(); i++)
 		{
-			obs.drawLit(core, psos, shaders, vp, textureManager, light);
-		}
-
-		// 5. 装饰物
-		if (decorationModel)
-		{
-			for (auto& dec : decorations)
+			TrackObstacle& obs = tile->obstacles[i];
+			frameStats().current.objectsTested++;
+			BoundingSphere sphere = obstacleSphere(obstacleModel, obs);
+			if (frustum.sphereVisible(sphere.center, sphere.radius))
 			{
-				Matrix W = Matrix::scaling(Vec3(dec.scale, dec.scale, dec.scale)) *
-					Matrix::rotateY(dec.rotationY) *
-					Matrix::translation(dec.position);
-				decorationModel->drawLit(core, psos, shaders, vp, W, textureManager, light);
+				frameStats().current.objectsDrawn++;
+				selector.select(view.screenSize(sphere), obstacleModel->lodLevels, obstacleLods[i]);
+				Matrix W = Matrix::fromYawTRS(obs.position, obs.rotationY, obs.scale);
+				obstacleModel->drawLit(core, psos, shaders, obs.stateMachine.getRenderMatrices(), W, textureManager, obstacleLods[i]);
 			}
 		}
 	}
 };
-//地形管理类-负责地块的生成和回收
-class TerrainManager
+//地形管理类-负责地形的绘制，地块的生成和回收在 Track 里，内容变了通过 TrackListener 通知这里
+class TerrainManager : public TrackListener
 {
 private:
-	std::vector<TerrainTile*> tiles;
-	int numTiles;
-	float tileLength;
+	Track* track;
+	std::vector<TerrainTile> terrainTiles; // 按 TrackTile::id 存放
 	StaticModel* roadModel;
 	StaticModel* grassModel;
 	GrassPatch* grassPatchModel;
@@ -847,89 +641,48 @@ private:
 	StaticModel* decorationModel; // 新增装饰物模型指针
 	Core* corePtr; // 需要保存 Core 指针用于地块生成
 
-	// 配置结构体
-	struct TileConfig {
-		int obstacleType; // 0: None, 1: Left, 2: Right
-		int decorationCount;
-	};
-	std::vector<TileConfig> levelConfigs;
-	int currentConfigIndex;
+	// 路、路边草和装饰物的每帧实例数据，所有地块合在一起，每个模型一次绘制
+	InstanceBuffer staticInstances;
+	std::vector<InstanceData> roadInstances;
+	std::vector<InstanceData> vergeInstances;
+	std::vector<InstanceData> decorationInstances;
+	std::vector<InstanceData> decorationLods[LOD_MAX_LEVELS]; // 装饰物按细节层级分组
+
+	// 每帧剔除后留下的草，紧凑写进这里一次绘制。可见的草每帧都在变，没有常驻的草地缓冲，
+	// 地块回收时只重新生成那块地的 CPU 草和包围球，不上传任何东西
+	InstanceBuffer grassBuffer;
+	GrassCuller grassCuller;
+	float grassDrawDistance;       // 超过这个距离的草不画
+
+	// 视锥剔除：先按地块包围盒，再按可见地块里的每个实例
+	BoxCullBatch tileCull;
+	BoxCullBatch instanceCull;
 
 public:
+	LodSelector lodSelector;      // 地块和角色共用的细节层级切换阈值
+
 	TerrainManager()
 	{
-		numTiles = 10;
-		tileLength = 35.0f;
+		track = nullptr;
+		grassDrawDistance = 300.0f;
 		roadModel = nullptr;
 		grassModel = nullptr;
 		grassPatchModel = nullptr;
 		obstacleModel = nullptr;
 		decorationModel = nullptr;
 		corePtr = nullptr;
-		currentConfigIndex = 0;
 	}
 
 	// 析构函数：清理内存
 	~TerrainManager()
 	{
-		for (auto tile : tiles)
-		{
-			delete tile;
-		}
-		tiles.clear();
+		if (track) track->setListener(nullptr);
+		staticInstances.free();
+		grassBuffer.free();
 	}
 
-	// 加载关卡配置
-	void loadLevelConfig(std::string filename)
-	{
-		std::ifstream file(filename);
-		if (!file.is_open())
-		{
-			printf("Warning: Could not open %s. Using random generation.\n", filename.c_str());
-			return;
-		}
-
-		levelConfigs.clear();
-		std::string line;
-		while (std::getline(file, line))
-		{
-			if (line.empty() || line[0] == '#') continue;
-			std::stringstream ss(line);
-			std::string obsStr;
-			int decCount;
-			ss >> obsStr >> decCount;
-
-			TileConfig config;
-			if (obsStr == "LEFT") config.obstacleType = 1;
-			else if (obsStr == "RIGHT") config.obstacleType = 2;
-			else config.obstacleType = 0; // NONE or others
-
-			config.decorationCount = decCount;
-			levelConfigs.push_back(config);
-		}
-		printf("Loaded %d tile configs from %s\n", (int)levelConfigs.size(), filename.c_str());
-		currentConfigIndex = 0;
-	}
-
-	// 获取下一个配置
-	TileConfig getNextConfig()
-	{
-		if (levelConfigs.empty())
-		{
-			// 如果没有配置文件，回退到随机逻辑
-			TileConfig config;
-			config.obstacleType = (rand() % 2 == 0) ? (rand() % 2 + 1) : 0; // 50% chance for obstacle
-			config.decorationCount = (rand() % 100 > 30) ? (rand() % 2 + 1) : 0; // 70% chance for decorations
-			return config;
-		}
-
-		TileConfig config = levelConfigs[currentConfigIndex];
-		currentConfigIndex = (currentConfigIndex + 1) % levelConfigs.size();
-		return config;
-	}
-
-	// init 增加 Core* 参数
-	void init(Core* core, StaticModel* road, StaticModel* grass, GrassPatch* grassPatch, AnimatedModel* _obstacleModel, StaticModel* _decorationModel, Vec3 playerStartPosition)
+	// track 要先 init 好，之后它的地块每次重新生成都会回调 tileGenerated
+	void init(Core* core, StaticModel* road, StaticModel* grass, GrassPatch* grassPatch, AnimatedModel* _obstacleModel, StaticModel* _decorationModel, Track* _track)
 	{
 		corePtr = core; // 保存指针
 		roadModel = road;
@@ -937,111 +690,214 @@ public:
 		grassPatchModel = grassPatch;
 		obstacleModel = _obstacleModel;
 		decorationModel = _decorationModel;
+		track = _track;
 
-		// 加载配置
-		loadLevelConfig("level.txt");
+		// 每块地 1 条路 + 2 条路边草 + 几个装饰物，不够时会自动扩容
+		staticInstances.init(core, "TerrainStatic", sizeof(InstanceData), 128);
+		// 最多所有草都可见，不够时会自动扩容
+		grassBuffer.init(core, "Grass", sizeof(GrassInstance), track->tileCount() * TERRAIN_GRASS_PER_TILE);
 
-		// 清理旧数据（如果有）
-		for (auto tile : tiles) delete tile;
-		tiles.clear();
+		// 现有地块马上回调一次，生成草和包围盒
+		terrainTiles.clear();
+		track->setListener(this);
 
-		int tilesBehand = 2;
-		int tilesAhead = numTiles - tilesBehand;
+		printf("TerrainManager initialized with %d tiles (Hardware Instancing Enabled)\n", (int)track->tiles.size());
+	}
 
-		for (int i = 0; i < numTiles; i++)
+	// 地块在最前面重新生成了：草、细节层级和包围盒跟着重建
+	void tileGenerated(TrackTile& tile) override
+	{
+		if (terrainTiles.size() <= tile.id)
 		{
-			// 使用 new 创建对象
-			TerrainTile* tile = new TerrainTile();
-			tile->length = tileLength;
-
-			float zPos = playerStartPosition.z + (tilesBehand - i) * tileLength;
-			tile->setPosition(Vec3(playerStartPosition.x, playerStartPosition.y, zPos));
-
-			// 传入 core 生成草地实例缓冲区
-			tile->generateGrass(corePtr);
-
-			// 获取配置
-			TileConfig config = getNextConfig();
-
-			// 生成障碍物
-			tile->generateObstacles(obstacleModel, config.obstacleType);
-
-			// 生成装饰物
-			tile->generateDecorations(config.decorationCount);
-
-			tiles.push_back(tile);
+			terrainTiles.resize(tile.id + 1);
 		}
-
-		printf("TerrainManager initialized with %d tiles (Hardware Instancing Enabled)\n", numTiles);
+		TerrainTile& terrain = terrainTiles[tile.id];
+		terrain.tile = &tile;
+		terrain.generateGrass();
+		terrain.resetLods();
+		updateTileBounds(&terrain);
 	}
 
-	int checkCollisions(Vec3 playerPos, float playerRadius)
+	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, TextureManager* textureManager, const Frustum& frustum, const LodView& view)
 	{
-		int totalHits = 0;
-		for (auto tile : tiles) // tile 是指针
+		if (track == nullptr || roadModel == nullptr || grassModel == nullptr || grassPatchModel == nullptr)
 		{
-			totalHits += tile->checkCollisions(playerPos, playerRadius);
+			return;
 		}
-		return totalHits;
-	}
+		const std::vector<TrackTile*>& tiles = track->tiles;
 
-	void update(Vec3 playerPosition, float dt)
-	{
-		// 更新所有地块上的障碍物动画
+		// 先剔除整块地，看不见的地块里的东西都不用再测
+		tileCull.clear();
 		for (auto tile : tiles)
 		{
-			tile->update(dt);
+			tileCull.add(terrainTiles[tile->id].bounds);
 		}
+		tileCull.cull(frustum);
 
-		// 地块回收逻辑
-		if (tiles.empty()) return;
+		roadInstances.clear();
+		vergeInstances.clear();
+		for (int l = 0; l < LOD_MAX_LEVELS; l++)
+		{
+			decorationLods[l].clear();
+		}
+		FrameStats& stats = frameStats().current;
+		for (int i = 0; i < tiles.size(); i++)
+		{
+			if (tileCull.isVisible(i))
+			{
+				terrainTiles[tiles[i]->id].collectStaticInstances(roadInstances, vergeInstances, decorationLods, decorationModel, view, lodSelector);
+			}
+			else
+			{
+				stats.objectsTested += 3 + (decorationModel ? (int)tiles[i]->decorations.size() : 0) + (obstacleModel ? (int)tiles[i]->obstacles.size() : 0);
+			}
+		}
+		cullInstances(frustum, roadModel, roadInstances);
+		cullInstances(frustum, grassModel, vergeInstances);
+		if (decorationModel)
+		{
+			for (int l = 0; l < LOD_MAX_LEVELS; l++)
+			{
+				cullInstances(frustum, decorationModel, decorationLods[l]);
+			}
+		}
 
-		// 找到玩家身后最远的地块（列表第一个）
-		float backTileZ = tiles[0]->position.z;
+		// 路和路边草先画，大面积遮挡物先写深度
+		drawInstances(core, psos, shaders, textureManager, roadModel, roadInstances);
+		drawInstances(core, psos, shaders, textureManager, grassModel, vergeInstances);
 
-		// 如果玩家已经远离身后的地块
-		if (playerPosition.z < backTileZ - tileLength * 1.5f)
+		// 可见地块里的每棵草再按视锥和距离剔除，留下的紧凑写进本帧的实例缓冲，一次绘制
+		grassCuller.clear();
+		for (int i = 0; i < tiles.size(); i++)
+		{
+			TerrainTile& terrain = terrainTiles[tiles[i]->id];
+			stats.grassTested += (int)terrain.grassInstances.size();
+			if (tileCull.isVisible(i))
+			{
+				grassCuller.addTile(terrain.grassInstances, terrain.grassSpheres);
+			}
+		}
+		unsigned int grassCount = grassCuller.cull(frustum, view.eye, grassDrawDistance);
+		if (grassCount > 0)
 		{
-			// 取出第一个地块（指针）
-			TerrainTile* recycledTile = tiles[0];
-			tiles.erase(tiles.begin());
+			D3D12_VERTEX_BUFFER_VIEW grassView;
+			grassCuller.copyVisible(grassBuffer.allocate(grassCount, grassView));
+			grassPatchModel->drawInstanced(core, psos, shaders, textureManager, grassView, grassCount);
+			stats.grassDrawn += grassCount;
+		}
 
-			// 计算新位置（在最前方）
-			float newZ = tiles.back()->position.z - tileLength;
-			recycledTile->setPosition(Vec3(tiles.back()->position.x, tiles.back()->position.y, newZ));
+		// 障碍物
+		if (obstacleModel)
+		{
+			for (int i = 0; i < tiles.size(); i++)
+			{
+				if (tileCull.isVisible(i))
+				{
+					terrainTiles[tiles[i]->id].drawLit(core, psos, shaders, textureManager, frustum, view, lodSelector, obstacleModel);
+				}
+			}
+		}
 
-			// 重新生成内容（这里不需要 delete 再 new，只需重置数据）
-			
-			// 获取下一个配置
-			TileConfig config = getNextConfig();
+		if (decorationModel)
+		{
+			for (int l = 0; l < LOD_MAX_LEVELS; l++)
+			{
+				drawInstances(core, psos, shaders, textureManager, decorationModel, decorationLods[l], l);
+			}
+		}
+	}
 
-			// 重新生成草（会重建 GPU 缓冲区）
-			recycledTile->generateGrass(corePtr);
-			// 重新生成障碍物
-			recycledTile->generateObstacles(obstacleModel, config.obstacleType);
-			// 重新生成装饰物
-			recycledTile->generateDecorations(config.decorationCount);
+	// 地块内容变了以后重新算包围盒：路、路边草和装饰物用模型包围盒变换到世界空间，草用每棵草的包围球，障碍物用包围球
+	void updateTileBounds(TerrainTile* tile)
+	{
+		BoundingBox box;
+		roadInstances.clear();
+		vergeInstances.clear();
+		decorationInstances.clear();
+		tile->collectStaticInstances(roadInstances, vergeInstances, decorationInstances);
+		for (auto& instance : roadInstances)
+		{
+			if (roadModel) box.extend(roadModel->bounds.transformed(instance.worldMatrix));
+		}
+		for (auto& instance : vergeInstances)
+		{
+			if (grassModel) box.extend(grassModel->bounds.transformed(instance.worldMatrix));
+		}
+		if (decorationModel)
+		{
+			for (auto& instance : decorationInstances)
+			{
+				box.extend(decorationModel->bounds.transformed(instance.worldMatrix));
+			}
+		}
+		roadInstances.clear();
+		vergeInstances.clear();
+		decorationInstances.clear();
 
-			tiles.push_back(recycledTile);
+		if (grassPatchModel)
+		{
+			// 风只让草尖在 XZ 方向偏移不到 windStrength * 1.2，留一点余量
+			tile->grassSpheres.build(tile->grassInstances, grassPatchModel->mesh.sphere, 0.5f);
+			const GrassSpheres& spheres = tile->grassSpheres;
+			for (int i = 0; i < spheres.x.size(); i++)
+			{
+				Vec3 center(spheres.x[i], spheres.y[i], spheres.z[i]);
+				Vec3 r(spheres.radius[i], spheres.radius[i], spheres.radius[i]);
+				box.extend(center - r);
+				box.extend(center + r);
+			}
+		}
 
-			// printf("Tile recycled: z=%.2f -> z=%.2f\n", backTileZ, newZ);
+		if (obstacleModel)
+		{
+			for (auto& obs : tile->tile->obstacles)
+			{
+				BoundingSphere sphere = TerrainTile::obstacleSphere(obstacleModel, obs);
+				Vec3 r(sphere.radius, sphere.radius, sphere.radius);
+				box.extend(sphere.center - r);
+				box.extend(sphere.center + r);
+			}
 		}
+		tile->bounds = box;
 	}
 
-	void drawLit(Core* core, PSOManager* psos, Shaders* shaders, Matrix& vp, TextureManager* textureManager, DirectionalLight* light, float dt)
+	// 按模型包围盒批量剔除实例，只留下可见的，保持原来的顺序
+	void cullInstances(const Frustum& frustum, StaticModel* model, std::vector<InstanceData>& instances)
 	{
-		if (roadModel == nullptr || grassModel == nullptr || grassPatchModel == nullptr)
+		instanceCull.clear();
+		for (auto& instance : instances)
 		{
-			return;
+			instanceCull.add(model->bounds.transformed(instance.worldMatrix));
 		}
+		int visibleCount = instanceCull.cull(frustum);
+		int kept = 0;
+		for (int i = 0; i < instances.size(); i++)
+		{
+			if (instanceCull.isVisible(i))
+			{
+				if (kept != i)
+				{
+					instances[kept] = instances[i];
+				}
+				kept++;
+			}
+		}
+		instances.resize(kept);
+		frameStats().current.objectsTested += instanceCull.size();
+		frameStats().current.objectsDrawn += visibleCount;
+	}
 
-		// 绘制所有地块
-		for (auto tile : tiles)
+	void drawInstances(Core* core, PSOManager* psos, Shaders* shaders, TextureManager* textureManager,
+		StaticModel* model, std::vector<InstanceData>& instances, int lod = 0)
+	{
+		if (instances.empty())
 		{
-			tile->drawLit(core, psos, shaders, vp, roadModel, grassModel, grassPatchModel, decorationModel, textureManager, light, dt);
+			return;
 		}
+		D3D12_VERTEX_BUFFER_VIEW view = staticInstances.upload(instances.data(), (unsigned int)instances.size());
+		model->drawLitInstanced(core, psos, shaders, textureManager, view, (int)instances.size(), lod);
 	}
 
-	void setNumTiles(int num) { numTiles = num; }
-	void setTileLength(float length) { tileLength = length; }
+	// 草的逐棵剔除在草多的时候分给线程池
+	void setJobSystem(JobSystem* jobs) { grassCuller.init(jobs); }
 };
\ No newline at end of file
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+#include "Maths.h"
+#include "Frustum.h"
+#include "GrassInstance.h"
+#include "JobSystem.h"
+
+// World space bounding spheres of one tile's grass, structure-of-arrays so four clumps are tested per SSE step.
+// Built once when the tile's grass is generated, in the same order as its GrassInstance list
+struct GrassSpheres
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+
+	// clump is the grass mesh's object space sphere, margin covers what the vertex shader adds (wind)
+	void build(const std::vector<GrassInstance>& instances, const BoundingSphere& clump, float margin)
+	{
+		int count = (int)instances.size();
+		x.resize(count);
+		y.resize(count);
+		z.resize(count);
+		radius.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			BoundingSphere sphere = clump.transformed(grassInstanceMatrix(instances[i]));
+			x[i] = sphere.center.x;
+			y[i] = sphere.center.y;
+			z[i] = sphere.center.z;
+			radius[i] = sphere.radius + margin;
+		}
+	}
+};
+
+// Per-frame grass culling on the CPU: every clump of the added tiles is tested against the frustum and a
+// draw distance, and the survivors are packed into one contiguous list for a single instanced draw.
+// Large sets are split into chunks of whole tiles that run on the JobSystem, each chunk compacts into
+// its own list and copyVisible() joins them in tile order straight into the upload buffer
+class GrassCuller
+{
+public:
+	// Below this many clumps the job hand-off costs more than it saves
+	static const int INSTANCES_PER_JOB = 8192;
+
+	GrassCuller()
+	{
+		jobs = nullptr;
+		visibleCount = 0;
+		usedChunks = 0;
+	}
+
+	// jobs may be nullptr, everything then runs on the calling thread
+	void init(JobSystem* _jobs)
+	{
+		jobs = _jobs;
+	}
+
+	void clear()
+	{
+		tiles.clear();
+		visibleCount = 0;
+		usedChunks = 0;
+	}
+
+	void addTile(const std::vector<GrassInstance>& instances, const GrassSpheres& spheres)
+	{
+		if (instances.empty())
+		{
+			return;
+		}
+		Tile tile;
+		tile.instances = instances.data();
+		tile.spheres = &spheres;
+		tile.count = (int)instances.size();
+		tiles.push_back(tile);
+	}
+
+	// Returns how many clumps survive, copyVisible() then writes them out
+	unsigned int cull(const Frustum& frustum, const Vec3& eye, float maxDistance)
+	{
+		int total = 0;
+		for (int i = 0; i < (int)tiles.size(); i++)
+		{
+			total += tiles[i].count;
+		}
+		int chunkCount = 1;
+		if (jobs != nullptr && total > INSTANCES_PER_JOB)
+		{
+			chunkCount = (total + INSTANCES_PER_JOB - 1) / INSTANCES_PER_JOB;
+			int threads = jobs->workerCount() + 1;
+			chunkCount = chunkCount < threads ? chunkCount : threads;
+			chunkCount = chunkCount < (int)tiles.size() ? chunkCount : (int)tiles.size();
+		}
+		if ((int)chunks.size() < chunkCount)
+		{
+			chunks.resize(chunkCount);
+		}
+
+		// Whole tiles per chunk, cut where the running total passes an even share
+		int tile = 0;
+		int done = 0;
+		for (int c = 0; c < chunkCount; c++)
+		{
+			chunks[c].firstTile = tile;
+			int target = (int)(((long long)total * (c + 1)) / chunkCount);
+			while (tile < (int)tiles.size() && (done < target || c == chunkCount - 1))
+			{
+				done += tiles[tile].count;
+				tile++;
+			}
+			chunks[c].endTile = tile;
+		}
+
+		float maxDistanceSq = maxDistance * maxDistance;
+		// The calling thread takes the first chunk instead of sitting in wait()
+		for (int c = 1; c < chunkCount; c++)
+		{
+			Chunk* chunk = &chunks[c];
+			jobs->submit([this, chunk, &frustum, eye, maxDistanceSq]() { cullChunk(*chunk, frustum, eye, maxDistanceSq); });
+		}
+		cullChunk(chunks[0], frustum, eye, maxDistanceSq);
+		if (chunkCount > 1)
+		{
+			jobs->wait();
+		}
+
+		usedChunks = chunkCount;
+		visibleCount = 0;
+		for (int c = 0; c < chunkCount; c++)
+		{
+			visibleCount += (unsigned int)chunks[c].visible.size();
+		}
+		return visibleCount;
+	}
+
+	// Sequential writes only, destination is usually write-combined upload memory
+	void copyVisible(void* destination) const
+	{
+		unsigned char* out = reinterpret_cast<unsigned char*>(destination);
+		for (int c = 0; c < usedChunks; c++)
+		{
+			size_t bytes = chunks[c].visible.size() * sizeof(GrassInstance);
+			if (bytes > 0)
+			{
+				memcpy(out, chunks[c].visible.data(), bytes);
+				out += bytes;
+			}
+		}
+	}
+
+	unsigned int visibleInstances() const
+	{
+		return visibleCount;
+	}
+
+	int chunksUsed() const
+	{
+		return usedChunks;
+	}
+
+	// One range of instances against the frustum planes and the distance, survivors appended to out
+	static void cullRange(const Frustum& frustum, const Vec3& eye, float maxDistanceSq, const GrassInstance* instances,
+		const float* cx, const float* cy, const float* cz, const float* radius, int count, std::vector<GrassInstance>& out)
+	{
+		int i = 0;
+#if defined(MATHS_USE_SSE)
+		__m128 eyeX = _mm_set1_ps(eye.x);
+		__m128 eyeY = _mm_set1_ps(eye.y);
+		__m128 eyeZ = _mm_set1_ps(eye.z);
+		__m128 maxSq = _mm_set1_ps(maxDistanceSq);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(cx + i);
+			__m128 y = _mm_loadu_ps(cy + i);
+			__m128 z = _mm_loadu_ps(cz + i);
+			__m128 r = _mm_loadu_ps(radius + i);
+			__m128 dx = _mm_sub_ps(x, eyeX);
+			__m128 dy = _mm_sub_ps(y, eyeY);
+			__m128 dz = _mm_sub_ps(z, eyeZ);
+			__m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			__m128 outside = _mm_cmpgt_ps(distanceSq, maxSq);
+			// Most clumps of a long track are beyond the draw distance or behind a side plane, stop once all four are out
+			for (int p = 0; p < 6 && _mm_movemask_ps(outside) != 0xf; p++)
+			{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.planes[p][0]), x), _mm_mul_ps(_mm_set1_ps(frustum.planes[p][1]), y)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.planes[p][2]), z), _mm_set1_ps(frustum.planes[p][3])));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+			}
+			int mask = ~_mm_movemask_ps(outside) & 0xf;
+			for (int k = 0; mask != 0; k++, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					out.push_back(instances[i + k]);
+				}
+			}
+		}
+#endif
+		for (; i < count; i++)
+		{
+			float distanceSq = SQ(cx[i] - eye.x) + SQ(cy[i] - eye.y) + SQ(cz[i] - eye.z);
+			if (distanceSq <= maxDistanceSq && frustum.sphereVisible(Vec3(cx[i], cy[i], cz[i]), radius[i]))
+			{
+				out.push_back(instances[i]);
+			}
+		}
+	}
+
+private:
+	struct Tile
+	{
+		const GrassInstance* instances;
+		const GrassSpheres* spheres;
+		int count;
+	};
+	struct Chunk
+	{
+		int firstTile;
+		int endTile;
+		std::vector<GrassInstance> visible; // Kept between frames so it stops allocating once warm
+	};
+	JobSystem* jobs;
+	std::vector<Tile> tiles;
+	std::vector<Chunk> chunks;
+	int usedChunks;
+	unsigned int visibleCount;
+
+	void cullChunk(Chunk& chunk, const Frustum& frustum, const Vec3& eye, float maxDistanceSq)
+	{
+		chunk.visible.clear();
+		for (int t = chunk.firstTile; t < chunk.endTile; t++)
+		{
+			const GrassSpheres& s = *tiles[t].spheres;
+			cullRange(frustum, eye, maxDistanceSq, tiles[t].instances, s.x.data(), s.y.data(), s.z.data(), s.radius.data(), tiles[t].count, chunk.visible);
+		}
+	}
+};
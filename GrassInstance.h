@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include "Maths.h"
+
+// Per-instance data of one grass clump, 16 bytes instead of a 64 byte world matrix.
+// VSGrass rebuilds the world transform as Matrix::fromYawTRS(position, yaw, scale) and
+// PSGrass picks the texture from the grass texture set by type, so every type shares one draw.
+// Matches VertexLayoutCache::getGrassInstancedLayout (slot 1)
+struct GrassInstance
+{
+	Vec3 position;        // INSTANCEPOS   R32G32B32_FLOAT, world space needs full floats
+	unsigned short scale; // INSTANCESCALE R16_FLOAT, uniform
+	unsigned char yaw;    // INSTANCEYAW   R8_UNORM, fraction of a full turn
+	unsigned char type;   // INSTANCETYPE  R8_UINT, index into the texture set
+};
+
+static_assert(sizeof(GrassInstance) == 16, "GrassInstance must match getGrassInstancedLayout");
+
+// IEEE 754 half, round to nearest even. Too large becomes infinity, too small flushes through denormals to zero
+inline unsigned short floatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int exponentBits = (bits >> 23) & 0xff;
+	unsigned int mantissa = bits & 0x7fffff;
+	if (exponentBits == 0xff)
+	{
+		return (unsigned short)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+	}
+	int exponent = (int)exponentBits - 127 + 15;
+	if (exponent >= 31)
+	{
+		return (unsigned short)(sign | 0x7c00);
+	}
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+		{
+			return (unsigned short)sign;
+		}
+		mantissa |= 0x800000;
+		unsigned int shift = (unsigned int)(14 - exponent);
+		unsigned int half = mantissa >> shift;
+		unsigned int remainder = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+		{
+			half++;
+		}
+		return (unsigned short)(sign | half);
+	}
+	unsigned int half = sign | ((unsigned int)exponent << 10) | (mantissa >> 13);
+	unsigned int remainder = mantissa & 0x1fff;
+	// A carry out of the mantissa correctly bumps the exponent
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+	{
+		half++;
+	}
+	return (unsigned short)half;
+}
+
+inline float halfToFloat(unsigned short half)
+{
+	unsigned int sign = (unsigned int)(half & 0x8000) << 16;
+	unsigned int exponent = (half >> 10) & 0x1f;
+	unsigned int mantissa = half & 0x3ff;
+	unsigned int bits;
+	if (exponent == 0x1f)
+	{
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else if (exponent != 0)
+	{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+	else if (mantissa == 0)
+	{
+		bits = sign;
+	}
+	else
+	{
+		// Denormal: shift until the implicit bit appears
+		int e = -1;
+		do
+		{
+			e++;
+			mantissa <<= 1;
+		} while ((mantissa & 0x400) == 0);
+		bits = sign | ((unsigned int)(127 - 15 - e) << 23) | ((mantissa & 0x3ff) << 13);
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+inline GrassInstance packGrassInstance(const Vec3& position, float scale, float yaw, int type)
+{
+	const float turn = 6.28318530718f;
+	float fraction = yaw / turn;
+	fraction -= floorf(fraction);
+	GrassInstance instance;
+	instance.position = position;
+	instance.scale = floatToHalf(scale);
+	instance.yaw = (unsigned char)(int)(fraction * 255.0f + 0.5f);
+	instance.type = (unsigned char)type;
+	return instance;
+}
+
+inline float grassInstanceYaw(const GrassInstance& instance)
+{
+	return (instance.yaw / 255.0f) * 6.28318530718f;
+}
+
+// The world matrix VSGrass builds from an instance, for checking against the full matrix path
+inline Matrix grassInstanceMatrix(const GrassInstance& instance)
+{
+	float scale = halfToFloat(instance.scale);
+	return Matrix::fromYawTRS(instance.position, grassInstanceYaw(instance), Vec3(scale, scale, scale));
+}
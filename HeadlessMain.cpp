@@ -0,0 +1,319 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include "Simulation.h"
+#include "ModelCache.h"
+#include "Lod.h"
+#include "FrameStats.h"
+
+// Headless driver for the gameplay core: no window, no device. Runs a number of frames of GameSimulation
+// with scripted lane input and prints where the time went, per subsystem, as per-frame statistics.
+//
+//   Headless [--frames n] [--dt seconds] [--jitter fraction] [--seed n] [--lives n]
+//            [--models folder] [--level file] [--script file]
+//
+// A script file has one "seconds LEFT|RIGHT|NONE" line per change, the last one holds to the end.
+// Without one the runner weaves left, centre, right, centre every four seconds.
+// --lives 0 (the default) never ends the run, so every frame measures a running game; 2 is the game's rule.
+// --seed replaces the level's track seed: the same seed, script and frame times always give the same run.
+//
+// Only platform-neutral headers are included: the Headless project in Test.sln builds it on Windows, CMakeLists.txt
+// everywhere else. Run it from the repository root
+
+// Lane input over time
+class InputScript
+{
+public:
+	InputScript()
+	{
+		loopLength = 0.0;
+	}
+
+	void useDefault()
+	{
+		events.clear();
+		add(0.0, true, false);
+		add(1.5, false, false);
+		add(2.0, false, true);
+		add(3.5, false, false);
+		loopLength = 4.0;
+	}
+
+	bool load(const std::string& filename)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		events.clear();
+		loopLength = 0.0;
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#') continue;
+			std::stringstream ss(line);
+			double time;
+			std::string lane;
+			ss >> time >> lane;
+			add(time, lane == "LEFT", lane == "RIGHT");
+		}
+		return true;
+	}
+
+	RunnerInput at(double time) const
+	{
+		if (loopLength > 0.0)
+		{
+			time -= loopLength * (double)(long long)(time / loopLength);
+		}
+		RunnerInput input;
+		for (int i = 0; i < (int)events.size() && events[i].time <= time; i++)
+		{
+			input = events[i].input;
+		}
+		return input;
+	}
+
+private:
+	struct Event
+	{
+		double time;
+		RunnerInput input;
+	};
+	std::vector<Event> events;
+	double loopLength; // 0 holds the last event instead of repeating
+
+	void add(double time, bool left, bool right)
+	{
+		Event event;
+		event.time = time;
+		event.input.left = left;
+		event.input.right = right;
+		events.push_back(event);
+	}
+};
+
+// Per-frame samples of one subsystem, in milliseconds
+class FrameSamples
+{
+public:
+	std::string name;
+	std::vector<double> samples;
+
+	FrameSamples(const std::string& _name, int reserve)
+	{
+		name = _name;
+		samples.reserve(reserve);
+	}
+
+	void print()
+	{
+		std::vector<double> sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (int i = 0; i < (int)sorted.size(); i++)
+		{
+			total += sorted[i];
+		}
+		double mean = sorted.empty() ? 0.0 : total / sorted.size();
+		printf("  %-20s %9.2f %9.2f %9.2f %9.2f %9.2f %10.1f\n", name.c_str(), mean * 1000.0, percentile(sorted, 0.5) * 1000.0,
+			percentile(sorted, 0.95) * 1000.0, percentile(sorted, 0.99) * 1000.0, (sorted.empty() ? 0.0 : sorted.back()) * 1000.0, total);
+	}
+
+private:
+	static double percentile(const std::vector<double>& sorted, double p)
+	{
+		if (sorted.empty()) return 0.0;
+		int index = (int)(p * (sorted.size() - 1) + 0.5);
+		return sorted[index];
+	}
+};
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point from)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - from).count();
+}
+
+// The obstacle model's bounding sphere as AnimatedModel::load makes it: the mesh spheres enclosed in one
+// around the centre of all the vertices, then enlarged for the poses
+static bool loadObstacleSphere(const std::string& filename, BoundingSphere& sphere)
+{
+	CookedModel model;
+	if (!model.load(filename))
+	{
+		return false;
+	}
+	BoundingBox box;
+	std::vector<BoundingSphere> spheres(model.meshes.size());
+	for (int i = 0; i < (int)model.meshes.size(); i++)
+	{
+		const CookedMeshView& mesh = model.meshes[i];
+		const unsigned char* vertex = reinterpret_cast<const unsigned char*>(mesh.vertices);
+		BoundingBox meshBox;
+		for (unsigned int v = 0; v < mesh.vertexCount; v++)
+		{
+			meshBox.extend(*reinterpret_cast<const Vec3*>(vertex + (size_t)v * mesh.vertexStride));
+		}
+		spheres[i].fromPoints(meshBox, reinterpret_cast<const Vec3*>(mesh.vertices), (int)mesh.vertexCount, (int)mesh.vertexStride);
+		box.extend(meshBox);
+	}
+	sphere.center = box.valid() ? box.center() : Vec3(0, 0, 0);
+	sphere.radius = 0;
+	for (int i = 0; i < (int)spheres.size(); i++)
+	{
+		sphere.enclose(spheres[i]);
+	}
+	sphere.radius *= 1.5f;
+	return true;
+}
+
+// CameraManager's default third person view of the player, the one Game.cpp starts with
+static Frustum cameraFrustum(const Runner& player, Vec3& eye)
+{
+	eye = player.renderPosition + Vec3(13.0f, 6.0f, 20.0f);
+	Matrix vp = Matrix::lookAt(eye, player.renderPosition + Vec3(3, 10, 5), Vec3(0, 1, 0)) *
+		Matrix::perspective(0.1f, 1000.0f, 1920.0f / 1080.0f, 60.0f);
+	Frustum frustum;
+	frustum.fromViewProjection(vp);
+	return frustum;
+}
+
+static bool loadAnimation(const std::string& filename, Animation& animation)
+{
+	CookedModel model;
+	if (!model.load(filename) || !model.animated)
+	{
+		printf("ERROR: %s has no animation\n", filename.c_str());
+		return false;
+	}
+	model.fillAnimation(animation);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 36000;
+	float frameDt = 1.0f / 60.0f;
+	float jitter = 0.0f;
+	long long seed = -1; // The level's own
+	int lives = 0;
+	std::string models = "Models";
+	std::string level = "level.txt";
+	std::string scriptFile;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--frames") == 0) frames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--dt") == 0) frameDt = (float)atof(argv[i + 1]);
+		else if (strcmp(argv[i], "--jitter") == 0) jitter = (float)atof(argv[i + 1]);
+		else if (strcmp(argv[i], "--seed") == 0) seed = atoll(argv[i + 1]);
+		else if (strcmp(argv[i], "--lives") == 0) lives = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--models") == 0) models = argv[i + 1];
+		else if (strcmp(argv[i], "--level") == 0) level = argv[i + 1];
+		else if (strcmp(argv[i], "--script") == 0) scriptFile = argv[i + 1];
+		else
+		{
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	InputScript script;
+	script.useDefault();
+	if (!scriptFile.empty() && !script.load(scriptFile))
+	{
+		printf("ERROR: Could not open script %s\n", scriptFile.c_str());
+		return 1;
+	}
+
+	// Same assets and start as Game.cpp, only the skeletons and clips are needed
+	Animation duck;
+	Animation farmerAnimation;
+	Animation sheep;
+	BoundingSphere sheepSphere;
+	if (!loadAnimation(models + "/Duck-white.gem", duck) || !loadAnimation(models + "/Farmer-male.gem", farmerAnimation) ||
+		!loadAnimation(models + "/Sheep-01.gem", sheep) || !loadObstacleSphere(models + "/Sheep-01.gem", sheepSphere))
+	{
+		return 1;
+	}
+
+	Runner player;
+	player.init(&duck, Vec3(0, 0, -2), Vec3(0.1f, 0.1f, 0.1f));
+	player.setSpeed(10.0f);
+	Runner farmer;
+	farmer.init(&farmerAnimation, Vec3(0, 0, 15), Vec3(0.1f, 0.1f, 0.1f));
+	farmer.playAnimation("run", 0.0f);
+	farmer.setRotation(0, -3.14f / 2.0f);
+	farmer.setSpeed(10.0f);
+
+	SimulationProfile profile;
+	GameSimulation simulation;
+	simulation.verbose = false;
+	simulation.collisionsToLose = lives;
+	simulation.init(&player, &farmer, &sheep, level, seed);
+	simulation.profile = &profile;
+	AnimationLod animationLod;
+
+	FrameSamples frameTotal("frame", frames);
+	FrameSamples collision("collision", frames);
+	FrameSamples flow("game flow + input", frames);
+	FrameSamples track("track + recycling", frames);
+	FrameSamples runners("runners", frames);
+	FrameSamples obstacles("obstacle animation", frames);
+	long long skeletons = 0;
+	long long bones = 0;
+
+	printf("Headless run: %d frames of %.2f ms (jitter %.0f%%), seed %u, %s\n", frames, frameDt * 1000.0f, jitter * 100.0f,
+		simulation.track.seed, lives > 0 ? "game over rules on" : "no game over");
+	RandomStream jitterRandom(simulation.track.seed, 0, 0); // Stream 0 is not used by the track
+	std::chrono::high_resolution_clock::time_point runStart = std::chrono::high_resolution_clock::now();
+	double simulatedTime = 0.0;
+	for (int f = 0; f < frames; f++)
+	{
+		float dt = frameDt;
+		if (jitter > 0.0f)
+		{
+			dt *= 1.0f + jitter * jitterRandom.range(-1.0f, 1.0f);
+		}
+		simulatedTime += dt;
+		std::chrono::high_resolution_clock::time_point frameStart = std::chrono::high_resolution_clock::now();
+		profile.reset();
+		simulation.update(dt, script.at(simulatedTime));
+
+		std::chrono::high_resolution_clock::time_point animationStart = std::chrono::high_resolution_clock::now();
+		Vec3 eye;
+		Frustum frustum = cameraFrustum(player, eye);
+		animateVisibleObstacles(simulation.track, sheepSphere, frustum, eye, animationLod);
+		obstacles.samples.push_back(elapsedMs(animationStart));
+		frameTotal.samples.push_back(elapsedMs(frameStart));
+		collision.samples.push_back(profile.collisionMs);
+		flow.samples.push_back(profile.flowMs);
+		track.samples.push_back(profile.trackMs);
+		runners.samples.push_back(profile.runnersMs);
+
+		skeletons += frameStats().current.skeletonsEvaluated;
+		bones += frameStats().current.bonesEvaluated;
+		frameStats().endFrame();
+	}
+	double wallMs = elapsedMs(runStart);
+
+	printf("Simulated %.1f s in %lld steps (%.1f s dropped by the catch-up limit), wall %.1f ms, %.0fx real time\n",
+		simulation.clock.time(), simulation.clock.stepCount(), simulation.clock.droppedTime(), wallMs, simulatedTime * 1000.0 / wallMs);
+	printf("Distance %.1f, %d tiles recycled, %d collisions, state %s\n", -(player.position.z + 2.0f), simulation.track.recycledTiles(),
+		simulation.collisionCount, simulation.state == PLAYING ? "PLAYING" : (simulation.state == GAMEOVER_WALK ? "GAMEOVER_WALK" : "GAMEOVER_GRAB"));
+	printf("Animation: %.1f skeletons, %.0f bones evaluated per frame\n", (double)skeletons / frames, (double)bones / frames);
+	printf("Per frame (us)            mean       p50       p95       p99       max   total ms\n");
+	frameTotal.print();
+	collision.print();
+	flow.print();
+	track.print();
+	runners.print();
+	obstacles.print();
+	return 0;
+}
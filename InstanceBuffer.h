@@ -0,0 +1,139 @@
+#pragma once
+
+#include <d3d12.h>
+#include <deque>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include "Core.h"
+#include "ConstantRing.h"
+
+// Persistently mapped upload buffer for per-instance vertex data that is rebuilt every frame.
+// Same scheme as ConstantBuffer: one segment per frame in flight, guarded by that back buffer's fence,
+// doubling when a frame needs more. Each upload is one contiguous run of instances bound at slot 1
+class InstanceBuffer
+{
+public:
+	InstanceBuffer()
+	{
+		instanceBuffer = nullptr;
+		buffer = nullptr;
+		core = nullptr;
+	}
+
+	void init(Core* _core, std::string _name, unsigned int _stride, unsigned int maxInstancesPerFrame)
+	{
+		core = _core;
+		name = _name;
+		stride = _stride;
+		ring.init(maxInstancesPerFrame > 0 ? maxInstancesPerFrame : 1, 2);
+		frameTag = ~0ull;
+		createBuffer();
+	}
+
+	// Copy count instances into this frame's segment and describe them for IASetVertexBuffers(1, ...)
+	D3D12_VERTEX_BUFFER_VIEW upload(const void* data, unsigned int count)
+	{
+		D3D12_VERTEX_BUFFER_VIEW view;
+		void* destination = allocate(count, view);
+		memcpy(destination, data, (size_t)count * stride);
+		return view;
+	}
+
+	// Room for count instances in this frame's segment, for callers that write them in place.
+	// The memory is write-combined: fill it front to back and never read it
+	void* allocate(unsigned int count, D3D12_VERTEX_BUFFER_VIEW& view)
+	{
+		beginFrameIfNeeded();
+		unsigned int first;
+		while (!ring.allocate(count, first))
+		{
+			grow();
+		}
+		view.BufferLocation = instanceBuffer->GetGPUVirtualAddress() + ((unsigned long long)first * stride);
+		view.StrideInBytes = stride;
+		view.SizeInBytes = count * stride;
+		return &buffer[(unsigned long long)first * stride];
+	}
+
+	void free()
+	{
+		if (instanceBuffer == nullptr)
+		{
+			return;
+		}
+		instanceBuffer->Unmap(0, NULL);
+		instanceBuffer->Release();
+		instanceBuffer = nullptr;
+		for (int i = 0; i < retiredBuffers.size(); i++)
+		{
+			retiredBuffers[i]->Unmap(0, NULL);
+			retiredBuffers[i]->Release();
+		}
+		retiredBuffers.clear();
+	}
+
+private:
+	std::string name;
+	ID3D12Resource* instanceBuffer;
+	unsigned char* buffer;
+	unsigned int stride;
+	ConstantSlotRing ring;
+	unsigned long long frameTag;
+	std::deque<ID3D12Resource*> retiredBuffers;
+	Core* core;
+
+	void createBuffer()
+	{
+		D3D12_HEAP_PROPERTIES heapprops;
+		memset(&heapprops, 0, sizeof(D3D12_HEAP_PROPERTIES));
+		heapprops.Type = D3D12_HEAP_TYPE_UPLOAD;
+		heapprops.CreationNodeMask = 1;
+		heapprops.VisibleNodeMask = 1;
+		D3D12_RESOURCE_DESC bufferDesc;
+		memset(&bufferDesc, 0, sizeof(D3D12_RESOURCE_DESC));
+		bufferDesc.Width = (unsigned long long)stride * ring.totalSlots();
+		bufferDesc.Height = 1;
+		bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		bufferDesc.DepthOrArraySize = 1;
+		bufferDesc.MipLevels = 1;
+		bufferDesc.SampleDesc.Count = 1;
+		bufferDesc.SampleDesc.Quality = 0;
+		bufferDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, NULL, IID_PPV_ARGS(&instanceBuffer));
+		D3D12_RANGE readRange = { 0, 0 };
+		instanceBuffer->Map(0, &readRange, (void**)&buffer);
+	}
+
+	void beginFrameIfNeeded()
+	{
+		if (frameTag == core->frameNumber)
+		{
+			return;
+		}
+		int previous = ring.currentSegment();
+		if (previous >= 0)
+		{
+			ring.closeFrame(core->graphicsQueueFence[previous].value);
+		}
+		int segment = core->frameIndex();
+		core->graphicsQueueFence[segment].waitFor(ring.segmentFence(segment));
+		frameTag = core->frameNumber;
+		ring.beginFrame(segment, frameTag);
+		for (int i = ring.releaseRetired(frameTag); i > 0; i--)
+		{
+			retiredBuffers.front()->Unmap(0, NULL);
+			retiredBuffers.front()->Release();
+			retiredBuffers.pop_front();
+		}
+	}
+
+	// Earlier uploads of this frame keep pointing at the old buffer, which is retired rather than released
+	void grow()
+	{
+		ring.grow();
+		retiredBuffers.push_back(instanceBuffer);
+		createBuffer();
+		printf("InstanceBuffer %s grown to %u instances per frame\n", name.c_str(), ring.segmentSlots());
+	}
+};
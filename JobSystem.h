@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Small fixed-size thread pool. Jobs are plain std::function<void()> run in FIFO order,
+// a job may submit further jobs. wait() blocks until the queue is empty and no job is running.
+class JobSystem
+{
+public:
+	JobSystem()
+	{
+		running = 0;
+		stopping = false;
+	}
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem()
+	{
+		shutdown();
+	}
+
+	// threadCount <= 0 uses one worker per hardware thread minus the calling thread
+	void init(int threadCount = 0)
+	{
+		shutdown();
+		if (threadCount <= 0)
+		{
+			threadCount = (int)std::thread::hardware_concurrency() - 1;
+		}
+		if (threadCount < 1)
+		{
+			threadCount = 1;
+		}
+		stopping = false;
+		for (int i = 0; i < threadCount; i++)
+		{
+			workers.push_back(std::thread(&JobSystem::workerLoop, this));
+		}
+	}
+
+	int workerCount()
+	{
+		return (int)workers.size();
+	}
+
+	void submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+		jobAvailable.notify_one();
+	}
+
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		allDone.wait(lock, [this]() { return jobs.empty() && running == 0; });
+	}
+
+	void shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (int i = 0; i < (int)workers.size(); i++)
+		{
+			workers[i].join();
+		}
+		workers.clear();
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable allDone;
+	int running;
+	bool stopping;
+
+	void workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (jobs.empty())
+				{
+					return;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+				running++;
+			}
+			job();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				running--;
+				if (jobs.empty() && running == 0)
+				{
+					allDone.notify_all();
+				}
+			}
+		}
+	}
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <math.h>
+#include "Maths.h"
+#include "Frustum.h"
+
+// Level of detail: index lists for coarser versions of a mesh, and picking one per draw from screen size.
+// Coarse levels index into the mesh's own vertex buffer, so every attribute (UVs, bone weights) stays valid
+// and only an extra index buffer per level is needed. No graphics API types here.
+
+#define LOD_MAX_LEVELS 3
+
+// Vertex clustering (Rossignac and Borrel): snap vertices to a grid, one representative per cell,
+// drop the triangles that collapse. Cells are also split by dominant normal direction, so the two
+// sides of a thin part (ears, leaves) do not merge into one sheet.
+class MeshSimplifier
+{
+public:
+	// resolution cells along the longest side of the bounds. Writes the coarse index list to out
+	static void cluster(const void* vertices, int strideInBytes, int numVertices, int normalOffset,
+		const unsigned int* indices, int numIndices, int resolution, std::vector<unsigned int>& out)
+	{
+		out.clear();
+		if (numVertices == 0 || numIndices < 3)
+		{
+			return;
+		}
+		const unsigned char* base = reinterpret_cast<const unsigned char*>(vertices);
+		BoundingBox box;
+		for (int i = 0; i < numVertices; i++)
+		{
+			box.extend(position(base, strideInBytes, i));
+		}
+		Vec3 size = box.max - box.min;
+		float longest = size.x > size.y ? size.x : size.y;
+		longest = longest > size.z ? longest : size.z;
+		float cellSize = longest > 0 ? longest / (float)resolution : 1.0f;
+
+		// Cell of every vertex, then the vertex nearest its cell's average stands in for all of them
+		std::unordered_map<unsigned long long, int> cells;
+		std::vector<int> cellOf(numVertices);
+		std::vector<Vec3> sums;
+		std::vector<int> counts;
+		for (int i = 0; i < numVertices; i++)
+		{
+			const Vec3& p = position(base, strideInBytes, i);
+			const Vec3& n = *reinterpret_cast<const Vec3*>(base + ((size_t)i * strideInBytes) + normalOffset);
+			unsigned long long key = cellKey(p, box.min, cellSize, normalBucket(n));
+			std::unordered_map<unsigned long long, int>::iterator it = cells.find(key);
+			int cell;
+			if (it == cells.end())
+			{
+				cell = (int)sums.size();
+				cells[key] = cell;
+				sums.push_back(Vec3(0, 0, 0));
+				counts.push_back(0);
+			}
+			else
+			{
+				cell = it->second;
+			}
+			cellOf[i] = cell;
+			sums[cell] = sums[cell] + p;
+			counts[cell]++;
+		}
+		std::vector<int> representative(sums.size(), -1);
+		std::vector<float> bestDistance(sums.size(), 0);
+		for (int i = 0; i < numVertices; i++)
+		{
+			int cell = cellOf[i];
+			Vec3 mean = sums[cell] / (float)counts[cell];
+			const Vec3& p = position(base, strideInBytes, i);
+			float distance = SQ(p.x - mean.x) + SQ(p.y - mean.y) + SQ(p.z - mean.z);
+			if (representative[cell] < 0 || distance < bestDistance[cell])
+			{
+				representative[cell] = i;
+				bestDistance[cell] = distance;
+			}
+		}
+
+		// Remap, dropping collapsed and repeated triangles
+		std::unordered_set<unsigned long long> seen;
+		bool canDeduplicate = sums.size() < (1u << 21); // Three cell indices packed into one key
+		for (int t = 0; t + 2 < numIndices; t += 3)
+		{
+			int a = cellOf[indices[t]];
+			int b = cellOf[indices[t + 1]];
+			int c = cellOf[indices[t + 2]];
+			if (a == b || b == c || a == c)
+			{
+				continue;
+			}
+			// Cells split by normal can have representatives at the same position, or three in a line
+			const Vec3& pa = position(base, strideInBytes, representative[a]);
+			Vec3 area = Cross(position(base, strideInBytes, representative[b]) - pa, position(base, strideInBytes, representative[c]) - pa);
+			if (area.x == 0 && area.y == 0 && area.z == 0)
+			{
+				continue;
+			}
+			// Rotate so the smallest cell comes first, the winding is kept
+			while (a > b || a > c)
+			{
+				int first = a;
+				a = b;
+				b = c;
+				c = first;
+			}
+			if (canDeduplicate)
+			{
+				unsigned long long key = ((unsigned long long)a << 42) | ((unsigned long long)b << 21) | (unsigned long long)c;
+				if (!seen.insert(key).second)
+				{
+					continue;
+				}
+			}
+			out.push_back((unsigned int)representative[a]);
+			out.push_back((unsigned int)representative[b]);
+			out.push_back((unsigned int)representative[c]);
+		}
+	}
+
+	// Coarse levels at about half and a fifth of the triangles, finest first (level 0 is the original
+	// and not included). A level that does not save at least a quarter over the previous one is skipped
+	static void buildLevels(const void* vertices, int strideInBytes, int numVertices, int normalOffset,
+		const unsigned int* indices, int numIndices, std::vector<std::vector<unsigned int>>& levels)
+	{
+		levels.clear();
+		const float ratios[LOD_MAX_LEVELS - 1] = { 0.5f, 0.2f };
+		int previousTriangles = numIndices / 3;
+		for (int l = 0; l < LOD_MAX_LEVELS - 1; l++)
+		{
+			int target = (int)((numIndices / 3) * ratios[l]);
+			std::vector<unsigned int> best;
+			findResolution(vertices, strideInBytes, numVertices, normalOffset, indices, numIndices, target, best);
+			int triangles = (int)best.size() / 3;
+			if (triangles == 0 || triangles > previousTriangles * 3 / 4)
+			{
+				break;
+			}
+			levels.push_back(best);
+			previousTriangles = triangles;
+		}
+	}
+
+private:
+	static const Vec3& position(const unsigned char* base, int strideInBytes, int i)
+	{
+		return *reinterpret_cast<const Vec3*>(base + ((size_t)i * strideInBytes));
+	}
+
+	// Which of +x, -x, +y, -y, +z, -z the normal points along most
+	static int normalBucket(const Vec3& n)
+	{
+		float ax = fabsf(n.x);
+		float ay = fabsf(n.y);
+		float az = fabsf(n.z);
+		if (ax >= ay && ax >= az)
+		{
+			return n.x >= 0 ? 0 : 1;
+		}
+		if (ay >= az)
+		{
+			return n.y >= 0 ? 2 : 3;
+		}
+		return n.z >= 0 ? 4 : 5;
+	}
+
+	static unsigned long long cellKey(const Vec3& p, const Vec3& origin, float cellSize, int bucket)
+	{
+		unsigned long long x = (unsigned long long)(int)((p.x - origin.x) / cellSize) & 0xfffff;
+		unsigned long long y = (unsigned long long)(int)((p.y - origin.y) / cellSize) & 0xfffff;
+		unsigned long long z = (unsigned long long)(int)((p.z - origin.z) / cellSize) & 0xfffff;
+		return (x << 43) | (y << 23) | (z << 3) | (unsigned long long)bucket;
+	}
+
+	// Finest grid whose result is at or under target triangles, by bisection on the resolution
+	static void findResolution(const void* vertices, int strideInBytes, int numVertices, int normalOffset,
+		const unsigned int* indices, int numIndices, int target, std::vector<unsigned int>& best)
+	{
+		int low = 1;
+		int high = 512;
+		std::vector<unsigned int> attempt;
+		best.clear();
+		while (low <= high)
+		{
+			int resolution = (low + high) / 2;
+			cluster(vertices, strideInBytes, numVertices, normalOffset, indices, numIndices, resolution, attempt);
+			if ((int)attempt.size() / 3 <= target)
+			{
+				best.swap(attempt);
+				low = resolution + 1;
+			}
+			else
+			{
+				high = resolution - 1;
+			}
+		}
+	}
+};
+
+// What the selector needs from the camera, filled in by CameraManager::lodView
+struct LodView
+{
+	Vec3 eye;
+	float projectionScale; // 1 / tan(fov / 2)
+
+	LodView()
+	{
+		eye = Vec3(0, 0, 0);
+		projectionScale = 1.0f;
+	}
+
+	// Projected radius of a world space sphere as a fraction of half the screen height
+	float screenSize(const BoundingSphere& sphere) const
+	{
+		float distance = sqrtf(SQ(sphere.center.x - eye.x) + SQ(sphere.center.y - eye.y) + SQ(sphere.center.z - eye.z));
+		if (distance <= sphere.radius)
+		{
+			return 1.0f;
+		}
+		return (sphere.radius * projectionScale) / distance;
+	}
+};
+
+// Picks a level from screen size. Level i + 1 takes over below switchSize[i]; a draw only moves once it is
+// hysteresis (a fraction) past the switch size, so something hovering at the boundary keeps its level
+class LodSelector
+{
+public:
+	float switchSize[LOD_MAX_LEVELS - 1];
+	float hysteresis;
+
+	LodSelector()
+	{
+		// At 1080p a radius of about 43 and 16 pixels
+		switchSize[0] = 0.08f;
+		switchSize[1] = 0.03f;
+		hysteresis = 0.2f;
+	}
+
+	// current is the level this draw used last frame, it is updated and returned
+	int select(float screenSize, int levelCount, int& current) const
+	{
+		int level = current;
+		level = level < levelCount - 1 ? level : levelCount - 1;
+		level = level > 0 ? level : 0;
+		while (level < levelCount - 1 && screenSize < switchSize[level] * (1.0f - hysteresis))
+		{
+			level++;
+		}
+		while (level > 0 && screenSize > switchSize[level - 1] * (1.0f + hysteresis))
+		{
+			level--;
+		}
+		current = level;
+		return level;
+	}
+};
+
+// How often a skinned model re-evaluates its bones, from its distance to the camera. Near it every frame,
+// further away at a fixed lower rate. The skipped time goes into the next evaluation, so a throttled
+// animation keeps its speed and only its pose updates less often
+class AnimationLod
+{
+public:
+	float fullRateDistance;
+	float reducedRateDistance;
+	float reducedInterval;   // Seconds between evaluations out to reducedRateDistance
+	float distantInterval;   // ... and beyond it
+
+	AnimationLod()
+	{
+		fullRateDistance = 50.0f;
+		reducedRateDistance = 120.0f;
+		reducedInterval = 1.0f / 20.0f;
+		distantInterval = 1.0f / 8.0f;
+	}
+
+	// 0 means every frame
+	float interval(float distance) const
+	{
+		if (distance <= fullRateDistance)
+		{
+			return 0.0f;
+		}
+		return distance <= reducedRateDistance ? reducedInterval : distantInterval;
+	}
+};
@@ -34,23 +34,8 @@ public:
 
 		if (!albedoProp.value.empty())
 		{
-			// 智能路径拼接
-			std::string texturePath;
-			if (modelFolder.empty() || albedoProp.value.find('/') == 0 || albedoProp.value.find('\\') == 0)
-			{
-				// 如果 modelFolder 为空，或者纹理路径以斜杠开头，直接使用纹理路径
-				texturePath = albedoProp.value;
-			}
-			else if (albedoProp.value.find("Models/") == 0 || albedoProp.value.find("Models\\") == 0)
-			{
-				// 如果纹理路径已经包含完整路径（以 Models/ 开头），直接使用
-				texturePath = albedoProp.value;
-			}
-			else
-			{
-				// 否则，拼接 modelFolder 和纹理文件名
-				texturePath = modelFolder + "/" + albedoProp.value;
-			}
+			// 智能路径拼接（和预加载器共用同一规则，保证纹理路径一致）
+			std::string texturePath = resolveModelTexturePath(albedoProp.value, modelFolder);
 
 			printf("  Loading albedo/diffuse texture: %s\n", texturePath.c_str());
 			fflush(stdout);
@@ -83,19 +68,7 @@ public:
 
 		if (!normalProp.value.empty())
 		{
-			std::string texturePath;
-			if (modelFolder.empty() || normalProp.value.find('/') == 0 || normalProp.value.find('\\') == 0)
-			{
-				texturePath = normalProp.value;
-			}
-			else if (normalProp.value.find("Models/") == 0 || normalProp.value.find("Models\\") == 0)
-			{
-				texturePath = normalProp.value;
-			}
-			else
-			{
-				texturePath = modelFolder + "/" + normalProp.value;
-			}
+			std::string texturePath = resolveModelTexturePath(normalProp.value, modelFolder);
 
 			printf("  Loading normal texture: %s\n", texturePath.c_str());
 			fflush(stdout);
@@ -120,19 +93,7 @@ public:
 
 		if (!specularProp.value.empty())
 		{
-			std::string texturePath;
-			if (modelFolder.empty() || specularProp.value.find('/') == 0 || specularProp.value.find('\\') == 0)
-			{
-				texturePath = specularProp.value;
-			}
-			else if (specularProp.value.find("Models/") == 0 || specularProp.value.find("Models\\") == 0)
-			{
-				texturePath = specularProp.value;
-			}
-			else
-			{
-				texturePath = modelFolder + "/" + specularProp.value;
-			}
+			std::string texturePath = resolveModelTexturePath(specularProp.value, modelFolder);
 
 			printf("  Loading specular/rmax texture: %s\n", texturePath.c_str());
 			fflush(stdout);
@@ -153,6 +114,7 @@ public:
 		if (diffuseTexture && diffuseTexture->textureResource)
 		{
 			core->getCommandList()->SetGraphicsRootDescriptorTable(2, diffuseTexture->srvHandle);
+			frameStats().current.rootBinds++;
 		}
 	}
 };
@@ -5,6 +5,21 @@
 #undef min
 #undef max
 #include <algorithm>
+#include <string.h>
+
+// SIMD path is picked at compile time: AVX2 (/arch:AVX2), then SSE (always on for x64), else scalar.
+// Define MATHS_NO_SIMD to force the scalar code.
+#if !defined(MATHS_NO_SIMD) && defined(__AVX2__)
+#define MATHS_USE_AVX2
+#endif
+#if !defined(MATHS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MATHS_USE_SSE
+#endif
+#if defined(MATHS_USE_AVX2)
+#include <immintrin.h>
+#elif defined(MATHS_USE_SSE)
+#include <xmmintrin.h>
+#endif
 
 #define SQ(x) ((x) * (x))
 
@@ -48,8 +63,10 @@ public:
 
 static float Dot(const Vec3& v1, const Vec3& v2) { return ((v1.x * v2.x) + (v1.y * v2.y) + (v1.z * v2.z)); }
 static Vec3 Cross(const Vec3 &v1, const Vec3 &v2) { return Vec3((v1.y * v2.z) - (v1.z * v2.y), (v1.z * v2.x) - (v1.x * v2.z), (v1.x * v2.y) - (v1.y * v2.x)); }
-static Vec3 Max(const Vec3& v1, const Vec3& v2) { return Vec3(std::max(v1.x, v2.x), std::max(v1.y, v2.y), std::max(v1.z, v2.z)); }
-static Vec3 Min(const Vec3& v1, const Vec3& v2) { return Vec3(std::min(v1.x, v2.x), std::min(v1.y, v2.y), std::min(v1.z, v2.z)); }
+inline Vec3 Max(const Vec3& v1, const Vec3& v2) { return Vec3(std::max(v1.x, v2.x), std::max(v1.y, v2.y), std::max(v1.z, v2.z)); }
+inline Vec3 Min(const Vec3& v1, const Vec3& v2) { return Vec3(std::min(v1.x, v2.x), std::min(v1.y, v2.y), std::min(v1.z, v2.z)); }
+
+class Quaternion;
 
 class alignas(64) Matrix
 {
@@ -150,41 +167,147 @@ public:
 	Matrix mul(const Matrix& matrix) const
 	{
 		Matrix ret;
+		mul(*this, matrix, ret);
+		return ret;
+	}
+	// out = lhs * rhs. out must not alias lhs or rhs
+	static void mul(const Matrix& lhs, const Matrix& rhs, Matrix& out)
+	{
+		const float* m = lhs.m;
+		const float* r = rhs.m;
+#if defined(MATHS_USE_AVX2)
+		// Each 128 bit lane computes one output row, two rows per iteration
+		__m256 a0 = _mm256_broadcast_ps((const __m128*)&m[0]);
+		__m256 a1 = _mm256_broadcast_ps((const __m128*)&m[4]);
+		__m256 a2 = _mm256_broadcast_ps((const __m128*)&m[8]);
+		__m256 a3 = _mm256_broadcast_ps((const __m128*)&m[12]);
+		for (int i = 0; i < 16; i += 8)
+		{
+			__m256 b = _mm256_loadu_ps(&r[i]);
+			__m256 res = _mm256_mul_ps(_mm256_shuffle_ps(b, b, 0x00), a0);
+			res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_shuffle_ps(b, b, 0x55), a1));
+			res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_shuffle_ps(b, b, 0xAA), a2));
+			res = _mm256_add_ps(res, _mm256_mul_ps(_mm256_shuffle_ps(b, b, 0xFF), a3));
+			_mm256_storeu_ps(&out.m[i], res);
+		}
+#elif defined(MATHS_USE_SSE)
+		__m128 a0 = _mm_loadu_ps(&m[0]);
+		__m128 a1 = _mm_loadu_ps(&m[4]);
+		__m128 a2 = _mm_loadu_ps(&m[8]);
+		__m128 a3 = _mm_loadu_ps(&m[12]);
+		for (int i = 0; i < 16; i += 4)
+		{
+			__m128 res = _mm_mul_ps(_mm_set1_ps(r[i]), a0);
+			res = _mm_add_ps(res, _mm_mul_ps(_mm_set1_ps(r[i + 1]), a1));
+			res = _mm_add_ps(res, _mm_mul_ps(_mm_set1_ps(r[i + 2]), a2));
+			res = _mm_add_ps(res, _mm_mul_ps(_mm_set1_ps(r[i + 3]), a3));
+			_mm_storeu_ps(&out.m[i], res);
+		}
+#else
+		out.m[0] = m[0] * r[0] + m[4] * r[1] + m[8] * r[2] + m[12] * r[3];
+		out.m[1] = m[1] * r[0] + m[5] * r[1] + m[9] * r[2] + m[13] * r[3];
+		out.m[2] = m[2] * r[0] + m[6] * r[1] + m[10] * r[2] + m[14] * r[3];
+		out.m[3] = m[3] * r[0] + m[7] * r[1] + m[11] * r[2] + m[15] * r[3];
 
-		ret.m[0] = m[0] * matrix.m[0] + m[4] * matrix.m[1] + m[8] * matrix.m[2] + m[12] * matrix.m[3];
-		ret.m[1] = m[1] * matrix.m[0] + m[5] * matrix.m[1] + m[9] * matrix.m[2] + m[13] * matrix.m[3];
-		ret.m[2] = m[2] * matrix.m[0] + m[6] * matrix.m[1] + m[10] * matrix.m[2] + m[14] * matrix.m[3];
-		ret.m[3] = m[3] * matrix.m[0] + m[7] * matrix.m[1] + m[11] * matrix.m[2] + m[15] * matrix.m[3];
-
-		ret.m[4] = m[0] * matrix.m[4] + m[4] * matrix.m[5] + m[8] * matrix.m[6] + m[12] * matrix.m[7];
-		ret.m[5] = m[1] * matrix.m[4] + m[5] * matrix.m[5] + m[9] * matrix.m[6] + m[13] * matrix.m[7];
-		ret.m[6] = m[2] * matrix.m[4] + m[6] * matrix.m[5] + m[10] * matrix.m[6] + m[14] * matrix.m[7];
-		ret.m[7] = m[3] * matrix.m[4] + m[7] * matrix.m[5] + m[11] * matrix.m[6] + m[15] * matrix.m[7];
-
-		ret.m[8] = m[0] * matrix.m[8] + m[4] * matrix.m[9] + m[8] * matrix.m[10] + m[12] * matrix.m[11];
-		ret.m[9] = m[1] * matrix.m[8] + m[5] * matrix.m[9] + m[9] * matrix.m[10] + m[13] * matrix.m[11];
-		ret.m[10] = m[2] * matrix.m[8] + m[6] * matrix.m[9] + m[10] * matrix.m[10] + m[14] * matrix.m[11];
-		ret.m[11] = m[3] * matrix.m[8] + m[7] * matrix.m[9] + m[11] * matrix.m[10] + m[15] * matrix.m[11];
+		out.m[4] = m[0] * r[4] + m[4] * r[5] + m[8] * r[6] + m[12] * r[7];
+		out.m[5] = m[1] * r[4] + m[5] * r[5] + m[9] * r[6] + m[13] * r[7];
+		out.m[6] = m[2] * r[4] + m[6] * r[5] + m[10] * r[6] + m[14] * r[7];
+		out.m[7] = m[3] * r[4] + m[7] * r[5] + m[11] * r[6] + m[15] * r[7];
 
-		ret.m[12] = m[0] * matrix.m[12] + m[4] * matrix.m[13] + m[8] * matrix.m[14] + m[12] * matrix.m[15];
-		ret.m[13] = m[1] * matrix.m[12] + m[5] * matrix.m[13] + m[9] * matrix.m[14] + m[13] * matrix.m[15];
-		ret.m[14] = m[2] * matrix.m[12] + m[6] * matrix.m[13] + m[10] * matrix.m[14] + m[14] * matrix.m[15];
-		ret.m[15] = m[3] * matrix.m[12] + m[7] * matrix.m[13] + m[11] * matrix.m[14] + m[15] * matrix.m[15];
+		out.m[8] = m[0] * r[8] + m[4] * r[9] + m[8] * r[10] + m[12] * r[11];
+		out.m[9] = m[1] * r[8] + m[5] * r[9] + m[9] * r[10] + m[13] * r[11];
+		out.m[10] = m[2] * r[8] + m[6] * r[9] + m[10] * r[10] + m[14] * r[11];
+		out.m[11] = m[3] * r[8] + m[7] * r[9] + m[11] * r[10] + m[15] * r[11];
 
-		return ret;
+		out.m[12] = m[0] * r[12] + m[4] * r[13] + m[8] * r[14] + m[12] * r[15];
+		out.m[13] = m[1] * r[12] + m[5] * r[13] + m[9] * r[14] + m[13] * r[15];
+		out.m[14] = m[2] * r[12] + m[6] * r[13] + m[10] * r[14] + m[14] * r[15];
+		out.m[15] = m[3] * r[12] + m[7] * r[13] + m[11] * r[14] + m[15] * r[15];
+#endif
+	}
+	// out[i] = lhs[i] * rhs[i]
+	static void mulArray(const Matrix* lhs, const Matrix* rhs, Matrix* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			mul(lhs[i], rhs[i], out[i]);
+		}
+	}
+	// out[i] = lhs[i] * rhs, used for applying one shared transform to many matrices
+	static void mulArray(const Matrix* lhs, const Matrix& rhs, Matrix* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			mul(lhs[i], rhs, out[i]);
+		}
 	}
 	Matrix operator*(const Matrix& matrix)
 	{
 		return mul(matrix);
 	}
-	Vec3 mulVec(const Vec3& v)
+	// Same as mul, but both matrices must be affine (bottom row 0, 0, 0, 1) so the projective row is skipped
+	Matrix mulAffine(const Matrix& matrix) const
+	{
+		Matrix ret;
+		const float* r = matrix.m;
+		for (int i = 0; i < 12; i += 4)
+		{
+			ret.m[i] = m[0] * r[i] + m[4] * r[i + 1] + m[8] * r[i + 2];
+			ret.m[i + 1] = m[1] * r[i] + m[5] * r[i + 1] + m[9] * r[i + 2];
+			ret.m[i + 2] = m[2] * r[i] + m[6] * r[i + 1] + m[10] * r[i + 2];
+			ret.m[i + 3] = m[3] * r[i] + m[7] * r[i + 1] + m[11] * r[i + 2] + r[i + 3];
+		}
+		return ret;
+	}
+	// Writes scaling(s) * rotation * translation(t) directly instead of multiplying full matrices
+	static Matrix fromTRS(const Vec3& t, const Quaternion& r, const Vec3& s);
+	// Same as scaling(s) * rotateX(euler.x) * rotateY(euler.y) * rotateZ(euler.z) * translation(t)
+	static Matrix fromEulerTRS(const Vec3& t, const Vec3& euler, const Vec3& s)
+	{
+		float cx = cosf(euler.x);
+		float sx = sinf(euler.x);
+		float cy = cosf(euler.y);
+		float sy = sinf(euler.y);
+		float cz = cosf(euler.z);
+		float sz = sinf(euler.z);
+		float sysx = sy * sx;
+		float sycx = sy * cx;
+		return Matrix(
+			cz * cy * s.x, (sz * cx + cz * sysx) * s.y, (sz * sx - cz * sycx) * s.z, t.x,
+			-sz * cy * s.x, (cz * cx - sz * sysx) * s.y, (cz * sx + sz * sycx) * s.z, t.y,
+			sy * s.x, -cy * sx * s.y, cy * cx * s.z, t.z,
+			0, 0, 0, 1);
+	}
+	// Only a rotation about Y, which is what most objects in the scene use
+	static Matrix fromYawTRS(const Vec3& t, float yaw, const Vec3& s)
+	{
+		float c = cosf(yaw);
+		float sn = sinf(yaw);
+		return Matrix(
+			c * s.x, 0, -sn * s.z, t.x,
+			0, s.y, 0, t.y,
+			sn * s.x, 0, c * s.z, t.z,
+			0, 0, 0, 1);
+	}
+	// scaling(s) * translation(t)
+	static Matrix fromTS(const Vec3& t, const Vec3& s)
+	{
+		return Matrix(
+			s.x, 0, 0, t.x,
+			0, s.y, 0, t.y,
+			0, 0, s.z, t.z,
+			0, 0, 0, 1);
+	}
+	// One vector or point at a time stays scalar: moving a single Vec3 in and out of a register costs more
+	// than the multiply-adds
+	Vec3 mulVec(const Vec3& v) const
 	{
 		return Vec3(
 			(v.x * m[0] + v.y * m[1] + v.z * m[2]),
 			(v.x * m[4] + v.y * m[5] + v.z * m[6]),
 			(v.x * m[8] + v.y * m[9] + v.z * m[10]));
 	}
-	Vec3 mulPoint(const Vec3& v)
+	Vec3 mulPoint(const Vec3& v) const
 	{
 		Vec3 v1 = Vec3(
 			(v.x * m[0] + v.y * m[1] + v.z * m[2]) + m[3],
@@ -195,14 +318,63 @@ public:
 		w = 1.0f / w;
 		return (v1 * w);
 	}
+	// Batch versions. mulVecs stays a plain loop, which compilers already vectorise and which measured faster
+	// than shuffling packed Vec3s in and out of registers for nine multiply-adds. mulPoints does four points
+	// per SSE step with the same operations in the same order as mulPoint. in and out may be the same array
+	void mulVecs(const Vec3* in, Vec3* out, int count) const
+	{
+		for (int i = 0; i < count; i++)
+		{
+			out[i] = mulVec(in[i]);
+		}
+	}
+	void mulPoints(const Vec3* in, Vec3* out, int count) const
+	{
+		int i = 0;
+#if defined(MATHS_USE_SSE)
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]), m3 = _mm_set1_ps(m[3]);
+		const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]), m7 = _mm_set1_ps(m[7]);
+		const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]), m11 = _mm_set1_ps(m[11]);
+		const __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]), m15 = _mm_set1_ps(m[15]);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x, y, z;
+			loadVec3x4(&in[i].x, x, y, z);
+			__m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m0), _mm_mul_ps(y, m1)), _mm_mul_ps(z, m2)), m3);
+			__m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m4), _mm_mul_ps(y, m5)), _mm_mul_ps(z, m6)), m7);
+			__m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m8), _mm_mul_ps(y, m9)), _mm_mul_ps(z, m10)), m11);
+			__m128 w = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m12, x), _mm_mul_ps(m13, y)), _mm_mul_ps(m14, z)), m15);
+			w = _mm_div_ps(one, w);
+			storeVec3x4(_mm_mul_ps(rx, w), _mm_mul_ps(ry, w), _mm_mul_ps(rz, w), &out[i].x);
+		}
+#endif
+		for (; i < count; i++)
+		{
+			out[i] = mulPoint(in[i]);
+		}
+	}
 	Matrix operator=(const Matrix& matrix)
 	{
+#if defined(MATHS_USE_AVX2)
+		// In the same two 256 bit halves mul reads and writes: a product copied with narrower moves is not
+		// forwarded to the next mul's loads, which stalls a chain of products (a skeleton walk) on every link
+		_mm256_storeu_ps(&m[0], _mm256_loadu_ps(&matrix.m[0]));
+		_mm256_storeu_ps(&m[8], _mm256_loadu_ps(&matrix.m[8]));
+#else
 		memcpy(m, matrix.m, sizeof(float) * 16);
+#endif
 		return (*this);
 	}
-	Matrix invert() // Unrolled inverse from MESA library
+	// Returns the identity if the matrix is singular, use invert(Matrix&) to find out
+	Matrix invert() const
 	{
 		Matrix inv;
+		invert(inv);
+		return inv;
+	}
+	bool invert(Matrix& inv) const // Unrolled inverse from MESA library
+	{
 		inv[0] = m[5] * m[10] * m[15] -
 			m[5] * m[11] * m[14] -
 			m[9] * m[6] * m[15] +
@@ -302,13 +474,71 @@ public:
 		float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
 		if (det == 0)
 		{
-			exit(0); // Perhaps add logging here. This should not happen in a games context
+			inv.identity();
+			return false;
 		}
 		det = 1.0 / det;
 		for (int i = 0; i < 16; i++)
 		{
 			inv[i] = inv[i] * det;
 		}
+		return true;
+	}
+	// For rotation/scale + translation matrices (bottom row 0, 0, 0, 1). Only the 3x3 part is inverted
+	Matrix invertAffine() const
+	{
+		Matrix inv;
+		invertAffine(inv);
+		return inv;
+	}
+	// inv may be this matrix: everything is read into locals before the first write
+	bool invertAffine(Matrix& inv) const
+	{
+		float c00 = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+		float c01 = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+		float c02 = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+		float det = a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02;
+		if (det == 0)
+		{
+			inv.identity();
+			return false;
+		}
+		det = 1.0f / det;
+		float r01 = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * det;
+		float r02 = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * det;
+		float r11 = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * det;
+		float r12 = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * det;
+		float r21 = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * det;
+		float r22 = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * det;
+		float tx = a[0][3];
+		float ty = a[1][3];
+		float tz = a[2][3];
+		inv.a[0][0] = c00 * det;
+		inv.a[0][1] = r01;
+		inv.a[0][2] = r02;
+		inv.a[1][0] = c01 * det;
+		inv.a[1][1] = r11;
+		inv.a[1][2] = r12;
+		inv.a[2][0] = c02 * det;
+		inv.a[2][1] = r21;
+		inv.a[2][2] = r22;
+		inv.invertTranslation(tx, ty, tz);
+		return true;
+	}
+	// For rotation + translation only (camera views, unscaled bones). The inverse rotation is the transpose
+	Matrix invertRigid() const
+	{
+		Matrix inv;
+		inv.a[0][0] = a[0][0];
+		inv.a[0][1] = a[1][0];
+		inv.a[0][2] = a[2][0];
+		inv.a[1][0] = a[0][1];
+		inv.a[1][1] = a[1][1];
+		inv.a[1][2] = a[2][1];
+		inv.a[2][0] = a[0][2];
+		inv.a[2][1] = a[1][2];
+		inv.a[2][2] = a[2][2];
+		inv.invertTranslation(a[0][3], a[1][3], a[2][3]);
 		return inv;
 	}
 	static Matrix lookAt(const Vec3& from, const Vec3& to, const Vec3& up)
@@ -358,6 +588,48 @@ public:
 			0, 0, 0, 1
 		);
 	}
+private:
+	// Translation of the inverse is -R^-1 * t, with R^-1 already in the upper 3x3
+	void invertTranslation(float tx, float ty, float tz)
+	{
+		a[0][3] = -(a[0][0] * tx + a[0][1] * ty + a[0][2] * tz);
+		a[1][3] = -(a[1][0] * tx + a[1][1] * ty + a[1][2] * tz);
+		a[2][3] = -(a[2][0] * tx + a[2][1] * ty + a[2][2] * tz);
+		a[3][0] = 0;
+		a[3][1] = 0;
+		a[3][2] = 0;
+		a[3][3] = 1;
+	}
+#if defined(MATHS_USE_SSE)
+	static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 arrays must be packed floats");
+	// Four packed Vec3s (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3) to one register per coordinate and back
+	static void loadVec3x4(const float* p, __m128& x, __m128& y, __m128& z)
+	{
+		__m128 a = _mm_loadu_ps(p);
+		__m128 b = _mm_loadu_ps(p + 4);
+		__m128 c = _mm_loadu_ps(p + 8);
+		__m128 x23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+		__m128 y01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+		__m128 y23 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+		__m128 z01 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+		__m128 z23 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+		x = _mm_shuffle_ps(a, x23, _MM_SHUFFLE(2, 0, 3, 0));
+		y = _mm_shuffle_ps(y01, y23, _MM_SHUFFLE(2, 0, 2, 0));
+		z = _mm_shuffle_ps(z01, z23, _MM_SHUFFLE(2, 0, 2, 0));
+	}
+	static void storeVec3x4(const __m128& x, const __m128& y, const __m128& z, float* p)
+	{
+		__m128 x01y01 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 0, 1, 0));
+		__m128 z0x1 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0));
+		__m128 y1z1 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1));
+		__m128 x2y2 = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2));
+		__m128 z2x3 = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2));
+		__m128 y3z3 = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3));
+		_mm_storeu_ps(p, _mm_shuffle_ps(x01y01, z0x1, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(p + 4, _mm_shuffle_ps(y1z1, x2y2, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(p + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+#endif
 };
 
 class Quaternion
@@ -497,6 +769,24 @@ public:
 	}
 };
 
+inline Matrix Matrix::fromTRS(const Vec3& t, const Quaternion& r, const Vec3& s)
+{
+	float aa = r.a * r.a;
+	float ab = r.a * r.b;
+	float ac = r.a * r.c;
+	float bb = r.b * r.b;
+	float cc = r.c * r.c;
+	float bc = r.b * r.c;
+	float da = r.d * r.a;
+	float db = r.d * r.b;
+	float dc = r.d * r.c;
+	return Matrix(
+		(1.0f - 2.0f * (bb + cc)) * s.x, 2.0f * (ab - dc) * s.y, 2.0f * (ac + db) * s.z, t.x,
+		2.0f * (ab + dc) * s.x, (1.0f - 2.0f * (aa + cc)) * s.y, 2.0f * (bc - da) * s.z, t.y,
+		2.0f * (ac - db) * s.x, 2.0f * (bc + da) * s.y, (1.0f - 2.0f * (aa + bb)) * s.z, t.z,
+		0, 0, 0, 1);
+}
+
 class Frame
 {
 public:
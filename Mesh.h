@@ -4,6 +4,9 @@
 #include <vector>
 #include "Maths.h"
 #include "Core.h"
+#include "FrameStats.h"
+#include "Frustum.h"
+#include "Lod.h"
 
 struct STATIC_VERTEX
 {
@@ -73,6 +76,24 @@ public:
 		static const D3D12_INPUT_LAYOUT_DESC desc = { inputLayoutInstanced, 8 };
 		return desc;
 	}
+	// Static mesh in slot 0, compact GrassInstance in slot 1
+	static const D3D12_INPUT_LAYOUT_DESC& getGrassInstancedLayout()
+	{
+		static const D3D12_INPUT_ELEMENT_DESC inputLayoutGrassInstanced[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 36, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+
+			{ "INSTANCEPOS", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+			{ "INSTANCESCALE", 0, DXGI_FORMAT_R16_FLOAT, 1, 12, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+			{ "INSTANCEYAW", 0, DXGI_FORMAT_R8_UNORM, 1, 14, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+			{ "INSTANCETYPE", 0, DXGI_FORMAT_R8_UINT, 1, 15, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+		};
+		static const D3D12_INPUT_LAYOUT_DESC desc = { inputLayoutGrassInstanced, 8 };
+		return desc;
+	}
 };
 
 class Mesh
@@ -84,8 +105,27 @@ public:
 	D3D12_INDEX_BUFFER_VIEW ibView;
 	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc;
 	unsigned int numMeshIndices;
-	void init(Core* core, void* vertices, int vertexSizeInBytes, int numVertices, unsigned int* indices, int numIndices)
+	BoundingBox bounds;     // Object space, from the vertex positions
+	BoundingSphere sphere;
+	// Coarser index lists into the same vertex buffer, lods[0] is level 1. Level 0 is indexBuffer above
+	struct Lod
 	{
+		ID3D12Resource* indexBuffer;
+		D3D12_INDEX_BUFFER_VIEW ibView;
+		unsigned int numIndices;
+	};
+	std::vector<Lod> lods;
+	void init(Core* core, const void* vertices, int vertexSizeInBytes, int numVertices, const unsigned int* indices, int numIndices)
+	{
+		// Every vertex format starts with the position
+		const unsigned char* vertex = reinterpret_cast<const unsigned char*>(vertices);
+		bounds.clear();
+		for (int i = 0; i < numVertices; i++)
+		{
+			bounds.extend(*reinterpret_cast<const Vec3*>(vertex + ((size_t)i * vertexSizeInBytes)));
+		}
+		sphere.fromPoints(bounds, reinterpret_cast<const Vec3*>(vertices), numVertices, vertexSizeInBytes);
+
 		D3D12_HEAP_PROPERTIES heapprops;
 		memset(&heapprops, 0, sizeof(D3D12_HEAP_PROPERTIES));
 		heapprops.Type = D3D12_HEAP_TYPE_DEFAULT;
@@ -107,54 +147,152 @@ public:
 
 		core->uploadResource(vertexBuffer, vertices, numVertices * vertexSizeInBytes, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
 
-		D3D12_RESOURCE_DESC ibDesc;
-		memset(&ibDesc, 0, sizeof(D3D12_RESOURCE_DESC));
-		ibDesc.Width = numIndices * sizeof(unsigned int);
-		ibDesc.Height = 1;
-		ibDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-		ibDesc.DepthOrArraySize = 1;
-		ibDesc.MipLevels = 1;
-		ibDesc.SampleDesc.Count = 1;
-		ibDesc.SampleDesc.Quality = 0;
-		ibDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-		hr = core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &ibDesc, D3D12_RESOURCE_STATE_COMMON, NULL, IID_PPV_ARGS(&indexBuffer));
-
-		core->uploadResource(indexBuffer, indices, numIndices * sizeof(unsigned int), D3D12_RESOURCE_STATE_INDEX_BUFFER);
+		createIndexBuffer(core, indices, numIndices, indexBuffer, ibView);
 
 		vbView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
 		vbView.StrideInBytes = vertexSizeInBytes;
 		vbView.SizeInBytes = numVertices * vertexSizeInBytes;
 
-		ibView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
-		ibView.Format = DXGI_FORMAT_R32_UINT;
-		ibView.SizeInBytes = numIndices * sizeof(unsigned int);
-
 		numMeshIndices = numIndices;
 	}
-	void init(Core* core, std::vector<STATIC_VERTEX> vertices, std::vector<unsigned int> indices)
+	// Simplify at load (MeshSimplifier) and upload the coarse levels, vertices and indices are what init was given
+	void buildLods(Core* core, const void* vertices, int vertexSizeInBytes, int numVertices, int normalOffset, const unsigned int* indices, int numIndices)
+	{
+		std::vector<std::vector<unsigned int>> levels;
+		MeshSimplifier::buildLevels(vertices, vertexSizeInBytes, numVertices, normalOffset, indices, numIndices, levels);
+		for (int i = 0; i < levels.size(); i++)
+		{
+			Lod lod;
+			createIndexBuffer(core, levels[i].data(), (int)levels[i].size(), lod.indexBuffer, lod.ibView);
+			lod.numIndices = (unsigned int)levels[i].size();
+			lods.push_back(lod);
+		}
+	}
+	int lodLevels() const
+	{
+		return 1 + (int)lods.size();
+	}
+	void init(Core* core, const std::vector<STATIC_VERTEX>& vertices, const std::vector<unsigned int>& indices)
 	{
 		init(core, &vertices[0], sizeof(STATIC_VERTEX), vertices.size(), &indices[0], indices.size());
 		inputLayoutDesc = VertexLayoutCache::getStaticLayout();
 	}
-	void init(Core* core, std::vector<ANIMATED_VERTEX> vertices, std::vector<unsigned int> indices)
+	void init(Core* core, const std::vector<ANIMATED_VERTEX>& vertices, const std::vector<unsigned int>& indices)
 	{
 		init(core, &vertices[0], sizeof(ANIMATED_VERTEX), vertices.size(), &indices[0], indices.size());
 		inputLayoutDesc = VertexLayoutCache::getAnimatedLayout();
 	}
-	void draw(Core* core)
+	// Upload straight from caller owned memory (e.g. a mapped model file), nothing is copied on the CPU side
+	void init(Core* core, const STATIC_VERTEX* vertices, int numVertices, const unsigned int* indices, int numIndices)
+	{
+		init(core, (const void*)vertices, sizeof(STATIC_VERTEX), numVertices, indices, numIndices);
+		inputLayoutDesc = VertexLayoutCache::getStaticLayout();
+	}
+	void init(Core* core, const ANIMATED_VERTEX* vertices, int numVertices, const unsigned int* indices, int numIndices)
 	{
+		init(core, (const void*)vertices, sizeof(ANIMATED_VERTEX), numVertices, indices, numIndices);
+		inputLayoutDesc = VertexLayoutCache::getAnimatedLayout();
+	}
+	// lod past the last level draws the coarsest one
+	void draw(Core* core, int lod = 0)
+	{
+		const D3D12_INDEX_BUFFER_VIEW* view;
+		unsigned int count;
+		lodIndices(lod, view, count);
 		core->getCommandList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 		core->getCommandList()->IASetVertexBuffers(0, 1, &vbView);
-		core->getCommandList()->IASetIndexBuffer(&ibView);
-		core->getCommandList()->DrawIndexedInstanced(numMeshIndices, 1, 0, 0, 0);
+		core->getCommandList()->IASetIndexBuffer(view);
+		core->getCommandList()->DrawIndexedInstanced(count, 1, 0, 0, 0);
+		frameStats().current.inputBinds += 3;
+		frameStats().current.drawCalls++;
+		frameStats().current.instances++;
+		frameStats().current.triangles += count / 3;
+	}
+	// One draw for instanceCount copies, per-instance data (e.g. InstanceData) comes from slot 1
+	void drawInstanced(Core* core, const D3D12_VERTEX_BUFFER_VIEW& instanceView, int instanceCount, int lod = 0)
+	{
+		const D3D12_INDEX_BUFFER_VIEW* view;
+		unsigned int count;
+		lodIndices(lod, view, count);
+		core->getCommandList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		core->getCommandList()->IASetVertexBuffers(0, 1, &vbView);
+		core->getCommandList()->IASetVertexBuffers(1, 1, &instanceView);
+		core->getCommandList()->IASetIndexBuffer(view);
+		core->getCommandList()->DrawIndexedInstanced(count, instanceCount, 0, 0, 0);
+		frameStats().current.inputBinds += 4;
+		frameStats().current.drawCalls++;
+		frameStats().current.instances += instanceCount;
+		frameStats().current.triangles += (count / 3) * instanceCount;
 	}
 	void cleanUp()
 	{
 		indexBuffer->Release();
 		vertexBuffer->Release();
+		for (int i = 0; i < lods.size(); i++)
+		{
+			lods[i].indexBuffer->Release();
+		}
+		lods.clear();
 	}
 	~Mesh()
 	{
 		cleanUp();
 	}
-};
\ No newline at end of file
+
+private:
+	void createIndexBuffer(Core* core, const unsigned int* indices, int numIndices, ID3D12Resource*& buffer, D3D12_INDEX_BUFFER_VIEW& view)
+	{
+		D3D12_HEAP_PROPERTIES heapprops;
+		memset(&heapprops, 0, sizeof(D3D12_HEAP_PROPERTIES));
+		heapprops.Type = D3D12_HEAP_TYPE_DEFAULT;
+		heapprops.CreationNodeMask = 1;
+		heapprops.VisibleNodeMask = 1;
+
+		D3D12_RESOURCE_DESC ibDesc;
+		memset(&ibDesc, 0, sizeof(D3D12_RESOURCE_DESC));
+		ibDesc.Width = numIndices * sizeof(unsigned int);
+		ibDesc.Height = 1;
+		ibDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		ibDesc.DepthOrArraySize = 1;
+		ibDesc.MipLevels = 1;
+		ibDesc.SampleDesc.Count = 1;
+		ibDesc.SampleDesc.Quality = 0;
+		ibDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &ibDesc, D3D12_RESOURCE_STATE_COMMON, NULL, IID_PPV_ARGS(&buffer));
+
+		core->uploadResource(buffer, indices, numIndices * sizeof(unsigned int), D3D12_RESOURCE_STATE_INDEX_BUFFER);
+
+		view.BufferLocation = buffer->GetGPUVirtualAddress();
+		view.Format = DXGI_FORMAT_R32_UINT;
+		view.SizeInBytes = numIndices * sizeof(unsigned int);
+	}
+
+	void lodIndices(int lod, const D3D12_INDEX_BUFFER_VIEW*& view, unsigned int& count) const
+	{
+		if (lod <= 0 || lods.empty())
+		{
+			view = &ibView;
+			count = numMeshIndices;
+			return;
+		}
+		const Lod& level = lods[(lod <= (int)lods.size() ? lod : (int)lods.size()) - 1];
+		view = &level.ibView;
+		count = level.numIndices;
+	}
+};
+
+// Bounds of a whole model: the union of its mesh boxes, and a sphere on that box's centre around every mesh sphere
+inline void computeModelBounds(const std::vector<Mesh*>& meshes, BoundingBox& box, BoundingSphere& sphere)
+{
+	box.clear();
+	for (int i = 0; i < meshes.size(); i++)
+	{
+		box.extend(meshes[i]->bounds);
+	}
+	sphere.center = box.valid() ? box.center() : Vec3(0, 0, 0);
+	sphere.radius = 0;
+	for (int i = 0; i < meshes.size(); i++)
+	{
+		sphere.enclose(meshes[i]->sphere);
+	}
+}
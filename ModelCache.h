@@ -0,0 +1,455 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "GEMLoader.h"
+#include "Animation.h"
+
+// Cooked model cache
+// A .gem file is cooked once into <file>.gem.cooked next to it. The blob holds the vertex and index
+// data exactly as uploaded to the GPU and the animation tracks already laid out as [frame * bones + bone],
+// so a warm start is one mapping plus a few memcpys. The blob records a hash of the source file
+// and is rebuilt whenever the source content changes or the format version is bumped.
+//
+// Layout (every block starts on a 16 byte boundary):
+//   CookedHeader | mesh records | bone records | clip records | property records | string table
+//   | per mesh: vertices, indices | per clip: positions, rotations, scales
+
+#define COOKED_MODEL_MAGIC 0x434D4547 // "GEMC" read as a little endian word
+#define COOKED_MODEL_VERSION 1
+
+struct CookedHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long sourceHash;
+	unsigned long long sourceSize;
+	unsigned long long fileSize;
+	unsigned int animated;
+	unsigned int vertexStride;
+	unsigned int meshCount;
+	unsigned int bonesN;
+	unsigned int clipCount;
+	unsigned int propertyCount;
+	unsigned long long meshTableOffset;
+	unsigned long long boneTableOffset;
+	unsigned long long clipTableOffset;
+	unsigned long long propertyTableOffset;
+	float globalInverse[16];
+};
+
+struct CookedMeshRecord
+{
+	unsigned long long vertexOffset;
+	unsigned long long indexOffset;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int firstProperty;
+	unsigned int propertyCount;
+};
+
+struct CookedBoneRecord
+{
+	float offset[16];
+	int parentIndex;
+	unsigned int nameOffset;
+	unsigned int nameLength;
+	unsigned int pad;
+};
+
+struct CookedClipRecord
+{
+	unsigned long long positionsOffset;
+	unsigned long long rotationsOffset;
+	unsigned long long scalesOffset;
+	unsigned int nameOffset;
+	unsigned int nameLength;
+	int frames;
+	float ticksPerSecond;
+};
+
+struct CookedPropertyRecord
+{
+	unsigned int nameOffset;
+	unsigned int nameLength;
+	unsigned int valueOffset;
+	unsigned int valueLength;
+};
+
+// Mesh data as stored in the blob, the pointers stay valid while the owning CookedModel lives
+class CookedMeshView
+{
+public:
+	GEMLoader::GEMMaterial material;
+	const void* vertices;
+	unsigned int vertexCount;
+	unsigned int vertexStride;
+	const unsigned int* indices;
+	unsigned int indexCount;
+};
+
+// Appends blocks to a growing byte buffer, used only while cooking
+class CookedWriter
+{
+public:
+	std::vector<unsigned char> bytes;
+	void align()
+	{
+		bytes.resize((bytes.size() + 15) & ~(size_t)15, 0);
+	}
+	unsigned long long reserve(size_t size)
+	{
+		align();
+		unsigned long long offset = bytes.size();
+		bytes.resize(bytes.size() + size, 0);
+		return offset;
+	}
+	unsigned long long append(const void* data, size_t size)
+	{
+		unsigned long long offset = reserve(size);
+		if (size > 0)
+		{
+			memcpy(&bytes[(size_t)offset], data, size);
+		}
+		return offset;
+	}
+	void write(unsigned long long offset, const void* data, size_t size)
+	{
+		if (size > 0)
+		{
+			memcpy(&bytes[(size_t)offset], data, size);
+		}
+	}
+};
+
+class CookedModel
+{
+public:
+	std::vector<CookedMeshView> meshes;
+	bool animated;
+
+	CookedModel()
+	{
+		animated = false;
+		data = nullptr;
+		size = 0;
+		memset(&header, 0, sizeof(CookedHeader));
+	}
+	CookedModel(const CookedModel&) = delete;
+	CookedModel& operator=(const CookedModel&) = delete;
+
+	// 64-bit FNV-1a taken over 8 byte words (byte-wise for the tail), cheap enough to run on every start
+	static unsigned long long hashBytes(const unsigned char* bytes, size_t count)
+	{
+		unsigned long long h = 14695981039346656037ULL;
+		size_t words = count / 8;
+		for (size_t i = 0; i < words; i++)
+		{
+			unsigned long long w;
+			memcpy(&w, bytes + (i * 8), 8);
+			h = (h ^ w) * 1099511628211ULL;
+		}
+		for (size_t i = words * 8; i < count; i++)
+		{
+			h = (h ^ bytes[i]) * 1099511628211ULL;
+		}
+		return (h ^ (unsigned long long)count) * 1099511628211ULL;
+	}
+
+	static std::string cookedFilename(const std::string& gemFilename)
+	{
+		return gemFilename + ".cooked";
+	}
+
+	// Load the cooked blob for a .gem file, cooking it first when it is missing or stale
+	bool load(const std::string& gemFilename)
+	{
+		release();
+		GEMLoader::GEMMappedFile source;
+		if (!source.open(gemFilename))
+		{
+			printf("ERROR: Could not open model %s\n", gemFilename.c_str());
+			return false;
+		}
+		unsigned long long sourceHash = hashBytes(source.data, source.size);
+		unsigned long long sourceSize = source.size;
+		if (file.open(cookedFilename(gemFilename)))
+		{
+			if (parse(file.data, file.size, sourceHash, sourceSize))
+			{
+				return true;
+			}
+			release();
+		}
+		source.close();
+		printf("Cooking %s\n", gemFilename.c_str());
+		if (!cook(gemFilename, sourceHash))
+		{
+			return false;
+		}
+		return parse(memory.data(), memory.size(), sourceHash, sourceSize);
+	}
+
+	// Copy the skeleton and the pre-laid-out clips into an Animation, one memcpy per track
+	void fillAnimation(Animation& animation)
+	{
+		memcpy(animation.skeleton.globalInverse.m, header.globalInverse, 16 * sizeof(float));
+		const CookedBoneRecord* bones = reinterpret_cast<const CookedBoneRecord*>(data + header.boneTableOffset);
+		for (unsigned int i = 0; i < header.bonesN; i++)
+		{
+			Bone bone;
+			bone.name = readString(bones[i].nameOffset, bones[i].nameLength);
+			memcpy(bone.offset.m, bones[i].offset, 16 * sizeof(float));
+			bone.parentIndex = bones[i].parentIndex;
+			animation.skeleton.bones.push_back(bone);
+		}
+		const CookedClipRecord* clips = reinterpret_cast<const CookedClipRecord*>(data + header.clipTableOffset);
+		for (unsigned int i = 0; i < header.clipCount; i++)
+		{
+			AnimationSequence aseq;
+			aseq.ticksPerSecond = clips[i].ticksPerSecond;
+			aseq.init(clips[i].frames, header.bonesN);
+			size_t keys = (size_t)clips[i].frames * header.bonesN;
+			memcpy(aseq.positions.data, data + clips[i].positionsOffset, keys * sizeof(Vec3));
+			memcpy(aseq.rotations.data, data + clips[i].rotationsOffset, keys * sizeof(Quaternion));
+			memcpy(aseq.scales.data, data + clips[i].scalesOffset, keys * sizeof(Vec3));
+			animation.animations.insert({ readString(clips[i].nameOffset, clips[i].nameLength), std::move(aseq) });
+		}
+	}
+
+private:
+	GEMLoader::GEMMappedFile file;
+	std::vector<unsigned char> memory; // Used when the blob was just cooked (or could not be written)
+	const unsigned char* data;
+	size_t size;
+	CookedHeader header;
+
+	void release()
+	{
+		meshes.clear();
+		file.close();
+		memory.clear();
+		data = nullptr;
+		size = 0;
+	}
+
+	std::string readString(unsigned int offset, unsigned int length)
+	{
+		return std::string(reinterpret_cast<const char*>(data + offset), length);
+	}
+
+	bool inRange(unsigned long long offset, unsigned long long bytes)
+	{
+		return (offset <= size) && (bytes <= size - offset);
+	}
+
+	bool parse(const unsigned char* blob, size_t blobSize, unsigned long long sourceHash, unsigned long long sourceSize)
+	{
+		data = blob;
+		size = blobSize;
+		if (size < sizeof(CookedHeader))
+		{
+			return false;
+		}
+		memcpy(&header, data, sizeof(CookedHeader));
+		if (header.magic != COOKED_MODEL_MAGIC || header.version != COOKED_MODEL_VERSION || header.fileSize != size ||
+			header.sourceHash != sourceHash || header.sourceSize != sourceSize)
+		{
+			return false;
+		}
+		unsigned int expectedStride = header.animated ? sizeof(GEMLoader::GEMAnimatedVertex) : sizeof(GEMLoader::GEMStaticVertex);
+		if (header.vertexStride != expectedStride ||
+			!inRange(header.meshTableOffset, (unsigned long long)header.meshCount * sizeof(CookedMeshRecord)) ||
+			!inRange(header.boneTableOffset, (unsigned long long)header.bonesN * sizeof(CookedBoneRecord)) ||
+			!inRange(header.clipTableOffset, (unsigned long long)header.clipCount * sizeof(CookedClipRecord)) ||
+			!inRange(header.propertyTableOffset, (unsigned long long)header.propertyCount * sizeof(CookedPropertyRecord)))
+		{
+			return false;
+		}
+		animated = (header.animated != 0);
+		const CookedPropertyRecord* properties = reinterpret_cast<const CookedPropertyRecord*>(data + header.propertyTableOffset);
+		for (unsigned int i = 0; i < header.propertyCount; i++)
+		{
+			if (!inRange(properties[i].nameOffset, properties[i].nameLength) || !inRange(properties[i].valueOffset, properties[i].valueLength))
+			{
+				return false;
+			}
+		}
+		// Parents come before their children: blendBonesToGlobal builds the palette in bone order and the
+		// parent walks stop at -1, so anything else would read a palette entry not yet written or out of range
+		const CookedBoneRecord* bones = reinterpret_cast<const CookedBoneRecord*>(data + header.boneTableOffset);
+		for (unsigned int i = 0; i < header.bonesN; i++)
+		{
+			if (!inRange(bones[i].nameOffset, bones[i].nameLength) || bones[i].parentIndex < -1 || bones[i].parentIndex >= (int)i)
+			{
+				return false;
+			}
+		}
+		const CookedClipRecord* clips = reinterpret_cast<const CookedClipRecord*>(data + header.clipTableOffset);
+		for (unsigned int i = 0; i < header.clipCount; i++)
+		{
+			unsigned long long keys = (unsigned long long)(clips[i].frames < 0 ? 0 : clips[i].frames) * header.bonesN;
+			if (clips[i].frames < 0 || !inRange(clips[i].nameOffset, clips[i].nameLength) ||
+				!inRange(clips[i].positionsOffset, keys * sizeof(Vec3)) ||
+				!inRange(clips[i].rotationsOffset, keys * sizeof(Quaternion)) ||
+				!inRange(clips[i].scalesOffset, keys * sizeof(Vec3)))
+			{
+				return false;
+			}
+		}
+		const CookedMeshRecord* records = reinterpret_cast<const CookedMeshRecord*>(data + header.meshTableOffset);
+		meshes.resize(header.meshCount);
+		for (unsigned int i = 0; i < header.meshCount; i++)
+		{
+			const CookedMeshRecord& record = records[i];
+			if (!inRange(record.vertexOffset, (unsigned long long)record.vertexCount * header.vertexStride) ||
+				!inRange(record.indexOffset, (unsigned long long)record.indexCount * sizeof(unsigned int)) ||
+				(unsigned long long)record.firstProperty + record.propertyCount > header.propertyCount)
+			{
+				meshes.clear();
+				return false;
+			}
+			CookedMeshView& mesh = meshes[i];
+			mesh.vertices = data + record.vertexOffset;
+			mesh.vertexCount = record.vertexCount;
+			mesh.vertexStride = header.vertexStride;
+			mesh.indices = reinterpret_cast<const unsigned int*>(data + record.indexOffset);
+			mesh.indexCount = record.indexCount;
+			mesh.material.properties.clear();
+			for (unsigned int j = 0; j < record.propertyCount; j++)
+			{
+				const CookedPropertyRecord& property = properties[record.firstProperty + j];
+				GEMLoader::GEMMaterialProperty prop;
+				prop.name = readString(property.nameOffset, property.nameLength);
+				prop.value = readString(property.valueOffset, property.valueLength);
+				mesh.material.properties.push_back(prop);
+			}
+		}
+		return true;
+	}
+
+	// Parse the source with the mapped GEM reader and lay it out in memory, then try to write it next to the source.
+	// Failing to write the cache is not fatal, the in-memory blob is used for this run
+	bool cook(const std::string& gemFilename, unsigned long long sourceHash)
+	{
+		GEMLoader::GEMModelLoader loader;
+		GEMLoader::GEMModelView view;
+		if (!loader.map(gemFilename, view))
+		{
+			return false;
+		}
+		CookedWriter writer;
+		CookedHeader h;
+		memset(&h, 0, sizeof(CookedHeader));
+		h.magic = COOKED_MODEL_MAGIC;
+		h.version = COOKED_MODEL_VERSION;
+		h.sourceHash = sourceHash;
+		h.sourceSize = view.file.size;
+		h.animated = view.animated ? 1 : 0;
+		h.vertexStride = view.animated ? sizeof(GEMLoader::GEMAnimatedVertex) : sizeof(GEMLoader::GEMStaticVertex);
+		h.meshCount = (unsigned int)view.meshes.size();
+		h.bonesN = (unsigned int)view.bones.size();
+		h.clipCount = (unsigned int)view.animations.size();
+		memcpy(h.globalInverse, view.globalInverse.m, 16 * sizeof(float));
+		for (int i = 0; i < (int)view.meshes.size(); i++)
+		{
+			h.propertyCount += (unsigned int)view.meshes[i].material.properties.size();
+		}
+		writer.reserve(sizeof(CookedHeader));
+		h.meshTableOffset = writer.reserve(h.meshCount * sizeof(CookedMeshRecord));
+		h.boneTableOffset = writer.reserve(h.bonesN * sizeof(CookedBoneRecord));
+		h.clipTableOffset = writer.reserve(h.clipCount * sizeof(CookedClipRecord));
+		h.propertyTableOffset = writer.reserve(h.propertyCount * sizeof(CookedPropertyRecord));
+
+		std::vector<CookedMeshRecord> meshRecords(h.meshCount);
+		std::vector<CookedBoneRecord> boneRecords(h.bonesN);
+		std::vector<CookedClipRecord> clipRecords(h.clipCount);
+		std::vector<CookedPropertyRecord> propertyRecords;
+		// String table
+		for (int i = 0; i < (int)view.meshes.size(); i++)
+		{
+			meshRecords[i].firstProperty = (unsigned int)propertyRecords.size();
+			meshRecords[i].propertyCount = (unsigned int)view.meshes[i].material.properties.size();
+			for (int j = 0; j < (int)view.meshes[i].material.properties.size(); j++)
+			{
+				GEMLoader::GEMMaterialProperty& prop = view.meshes[i].material.properties[j];
+				CookedPropertyRecord record;
+				record.nameLength = (unsigned int)prop.name.size();
+				record.nameOffset = (unsigned int)writer.append(prop.name.data(), prop.name.size());
+				record.valueLength = (unsigned int)prop.value.size();
+				record.valueOffset = (unsigned int)writer.append(prop.value.data(), prop.value.size());
+				propertyRecords.push_back(record);
+			}
+		}
+		for (unsigned int i = 0; i < h.bonesN; i++)
+		{
+			memcpy(boneRecords[i].offset, view.bones[i].offset.m, 16 * sizeof(float));
+			boneRecords[i].parentIndex = view.bones[i].parentIndex;
+			boneRecords[i].nameLength = (unsigned int)view.bones[i].name.size();
+			boneRecords[i].nameOffset = (unsigned int)writer.append(view.bones[i].name.data(), view.bones[i].name.size());
+		}
+		for (unsigned int i = 0; i < h.clipCount; i++)
+		{
+			clipRecords[i].nameLength = (unsigned int)view.animations[i].name.size();
+			clipRecords[i].nameOffset = (unsigned int)writer.append(view.animations[i].name.data(), view.animations[i].name.size());
+		}
+		// GPU ready vertex and index blocks
+		for (unsigned int i = 0; i < h.meshCount; i++)
+		{
+			GEMLoader::GEMMeshView& mesh = view.meshes[i];
+			if (view.animated)
+			{
+				meshRecords[i].vertexCount = mesh.verticesAnimated.size();
+				meshRecords[i].vertexOffset = writer.append(mesh.verticesAnimated.data, mesh.verticesAnimated.size() * sizeof(GEMLoader::GEMAnimatedVertex));
+			} else
+			{
+				meshRecords[i].vertexCount = mesh.verticesStatic.size();
+				meshRecords[i].vertexOffset = writer.append(mesh.verticesStatic.data, mesh.verticesStatic.size() * sizeof(GEMLoader::GEMStaticVertex));
+			}
+			meshRecords[i].indexCount = mesh.indices.size();
+			meshRecords[i].indexOffset = writer.append(mesh.indices.data, mesh.indices.size() * sizeof(unsigned int));
+		}
+		// Animation tracks as [frame * bones + bone]
+		for (unsigned int i = 0; i < h.clipCount; i++)
+		{
+			GEMLoader::GEMAnimationSequenceView& clip = view.animations[i];
+			clipRecords[i].frames = clip.frames;
+			clipRecords[i].ticksPerSecond = clip.ticksPerSecond;
+			clipRecords[i].positionsOffset = writer.reserve((size_t)clip.frames * h.bonesN * sizeof(GEMLoader::GEMVec3));
+			clipRecords[i].rotationsOffset = writer.reserve((size_t)clip.frames * h.bonesN * sizeof(GEMLoader::GEMQuaternion));
+			clipRecords[i].scalesOffset = writer.reserve((size_t)clip.frames * h.bonesN * sizeof(GEMLoader::GEMVec3));
+			for (int j = 0; j < clip.frames; j++)
+			{
+				writer.write(clipRecords[i].positionsOffset + ((size_t)j * h.bonesN * sizeof(GEMLoader::GEMVec3)), clip.positions(j), h.bonesN * sizeof(GEMLoader::GEMVec3));
+				writer.write(clipRecords[i].rotationsOffset + ((size_t)j * h.bonesN * sizeof(GEMLoader::GEMQuaternion)), clip.rotations(j), h.bonesN * sizeof(GEMLoader::GEMQuaternion));
+				writer.write(clipRecords[i].scalesOffset + ((size_t)j * h.bonesN * sizeof(GEMLoader::GEMVec3)), clip.scales(j), h.bonesN * sizeof(GEMLoader::GEMVec3));
+			}
+		}
+		writer.align();
+		h.fileSize = writer.bytes.size();
+		writer.write(0, &h, sizeof(CookedHeader));
+		writer.write(h.meshTableOffset, meshRecords.data(), meshRecords.size() * sizeof(CookedMeshRecord));
+		writer.write(h.boneTableOffset, boneRecords.data(), boneRecords.size() * sizeof(CookedBoneRecord));
+		writer.write(h.clipTableOffset, clipRecords.data(), clipRecords.size() * sizeof(CookedClipRecord));
+		writer.write(h.propertyTableOffset, propertyRecords.data(), propertyRecords.size() * sizeof(CookedPropertyRecord));
+		memory.swap(writer.bytes);
+
+		// Write to a temporary file first so a crash never leaves a half written cache behind
+		std::string filename = cookedFilename(gemFilename);
+		std::string temp = filename + ".tmp";
+		std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(memory.data()), memory.size());
+		out.close();
+		bool written = !out.fail();
+		remove(filename.c_str());
+		if (!written || rename(temp.c_str(), filename.c_str()) != 0)
+		{
+			remove(temp.c_str());
+			printf("WARNING: Could not write %s\n", filename.c_str());
+		}
+		return true;
+	}
+};
@@ -3,6 +3,7 @@
 #include <d3d12.h>
 #include <unordered_map>
 #include <string>
+#include "FrameStats.h"
 
 class PSOManager
 {
@@ -72,6 +73,7 @@ public:
     void bind(Core* core, std::string name)
     {
         core->getCommandList()->SetPipelineState(psos[name]);
+        frameStats().current.psoBinds++;
     }
 
 	// 创建支持透明混合和关闭深度写入的PSO-用于远景类效果
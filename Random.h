@@ -0,0 +1,93 @@
+#pragma once
+
+// Counter-based random numbers: Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+// Every block of four values is a pure function of a key and a counter, there is no shared state to seed or
+// advance. Content generated from (seed, index, stream) comes out the same on every run, in any order and on
+// any thread, and adding draws to one stream never shifts another
+
+class Philox
+{
+public:
+	// One block: ten rounds over a 128 bit counter with a 64 bit key
+	static void generate(const unsigned int counter[4], const unsigned int key[2], unsigned int out[4])
+	{
+		unsigned int c0 = counter[0];
+		unsigned int c1 = counter[1];
+		unsigned int c2 = counter[2];
+		unsigned int c3 = counter[3];
+		unsigned int k0 = key[0];
+		unsigned int k1 = key[1];
+		for (int round = 0; round < 10; round++)
+		{
+			unsigned long long p0 = (unsigned long long)0xD2511F53u * c0;
+			unsigned long long p1 = (unsigned long long)0xCD9E8D57u * c2;
+			unsigned int hi0 = (unsigned int)(p0 >> 32);
+			unsigned int hi1 = (unsigned int)(p1 >> 32);
+			c0 = hi1 ^ c1 ^ k0;
+			c1 = (unsigned int)p1;
+			c2 = hi0 ^ c3 ^ k1;
+			c3 = (unsigned int)p0;
+			k0 += 0x9E3779B9u;
+			k1 += 0xBB67AE85u;
+		}
+		out[0] = c0;
+		out[1] = c1;
+		out[2] = c2;
+		out[3] = c3;
+	}
+};
+
+// Sequential draws from one (seed, index, stream): the key is the seed and the stream, the counter the index
+// and the draw number. Cheap to make, so make one where it is needed instead of passing one around
+class RandomStream
+{
+public:
+	RandomStream(unsigned int seed, unsigned long long index, unsigned int stream)
+	{
+		key[0] = seed;
+		key[1] = stream;
+		counter[0] = 0;
+		counter[1] = 0;
+		counter[2] = (unsigned int)index;
+		counter[3] = (unsigned int)(index >> 32);
+		used = 4;
+	}
+
+	unsigned int next()
+	{
+		if (used == 4)
+		{
+			Philox::generate(counter, key, block);
+			if (++counter[0] == 0)
+			{
+				counter[1]++;
+			}
+			used = 0;
+		}
+		return block[used++];
+	}
+
+	// [0, 1), 24 bits so every value is exact in a float
+	float uniform()
+	{
+		return (float)(next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// [low, high)
+	float range(float low, float high)
+	{
+		return low + (high - low) * uniform();
+	}
+
+	// [0, n) for n > 0, by multiply and shift rather than modulo
+	int below(int n)
+	{
+		return (int)(((unsigned long long)next() * (unsigned int)n) >> 32);
+	}
+
+private:
+	unsigned int key[2];
+	unsigned int counter[4];
+	unsigned int block[4];
+	int used;
+};
@@ -7,33 +7,89 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <deque>
 
 #include "Core.h"
+#include "ConstantLayout.h"
+#include "ConstantRing.h"
+#include "FrameStats.h"
 
 #pragma comment(lib, "dxguid.lib")
 
-struct ConstantBufferVariable
-{
-	unsigned int offset;
-	unsigned int size;
-};
-
+// One slot per draw. Slots come from a ConstantSlotRing with a segment per back buffer, so a frame never
+// overwrites constants the GPU is still reading for the previous one. Running out of slots grows the
+// buffer instead of wrapping; the old resource is released once no frame in flight can use it
 class ConstantBuffer
 {
 public:
-	std::string name;
-	std::map<std::string, ConstantBufferVariable> constantBufferData;
+	ConstantBufferLayout layout;
 	ID3D12Resource* constantBuffer;
 	unsigned char* buffer;
 	unsigned int cbSizeInBytes;
-	unsigned int numInstances;
 	unsigned int offsetIndex;
-	void init(Core* core, unsigned int sizeInBytes, unsigned int maxDrawCalls = 1024)
+	ConstantSlotRing ring;
+	unsigned long long frameTag;
+	std::deque<ID3D12Resource*> retiredBuffers;
+	Core* core;
+	void init(Core* _core, unsigned int sizeInBytes, unsigned int maxDrawCalls = 1024)
 	{
+		core = _core;
 		cbSizeInBytes = (sizeInBytes + 255) & ~255;
-		unsigned int cbSizeInBytesAligned = cbSizeInBytes * maxDrawCalls;
-		numInstances = maxDrawCalls;
+		// maxDrawCalls is split between the frames in flight
+		unsigned int slotsPerFrame = maxDrawCalls / 2;
+		ring.init(slotsPerFrame > 0 ? slotsPerFrame : 1, 2);
 		offsetIndex = 0;
+		frameTag = ~0ull;
+		createBuffer();
+	}
+	void update(std::string name, void* data) // Data is immediatly visible
+	{
+		ConstantBufferVariable cbVariable;
+		if (layout.find(name, cbVariable))
+		{
+			write(cbVariable.offset, data, cbVariable.size);
+		}
+	}
+	// Copy into the current slot, ranges outside the buffer are dropped
+	void write(unsigned int variableOffset, const void* data, unsigned int size)
+	{
+		if (variableOffset + size > cbSizeInBytes)
+		{
+			return;
+		}
+		beginFrameIfNeeded();
+		memcpy(&buffer[(offsetIndex * cbSizeInBytes) + variableOffset], data, size);
+		frameStats().current.constantBytes += size;
+		frameStats().current.constantWrites++;
+	}
+	D3D12_GPU_VIRTUAL_ADDRESS getGPUAddress()
+	{
+		beginFrameIfNeeded();
+		return (constantBuffer->GetGPUVirtualAddress() + (offsetIndex * cbSizeInBytes));
+	}
+	// Move to a fresh slot for the next draw
+	void next()
+	{
+		beginFrameIfNeeded();
+		if (!ring.allocate(offsetIndex))
+		{
+			grow();
+		}
+	}
+	void free()
+	{
+		constantBuffer->Unmap(0, NULL);
+		constantBuffer->Release();
+		for (int i = 0; i < retiredBuffers.size(); i++)
+		{
+			retiredBuffers[i]->Unmap(0, NULL);
+			retiredBuffers[i]->Release();
+		}
+		retiredBuffers.clear();
+	}
+private:
+	void createBuffer()
+	{
 		HRESULT hr;
 		D3D12_HEAP_PROPERTIES heapprops;
 		memset(&heapprops, 0, sizeof(D3D12_HEAP_PROPERTIES));
@@ -42,7 +98,7 @@ public:
 		heapprops.VisibleNodeMask = 1;
 		D3D12_RESOURCE_DESC cbDesc;
 		memset(&cbDesc, 0, sizeof(D3D12_RESOURCE_DESC));
-		cbDesc.Width = cbSizeInBytesAligned;
+		cbDesc.Width = (unsigned long long)cbSizeInBytes * ring.totalSlots();
 		cbDesc.Height = 1;
 		cbDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
 		cbDesc.DepthOrArraySize = 1;
@@ -54,28 +110,63 @@ public:
 		D3D12_RANGE readRange = { 0, 0 };
 		hr = constantBuffer->Map(0, &readRange, (void**)&buffer);
 	}
-	void update(std::string name, void* data) // Data is immediatly visible
+	// The first use in a frame closes the previous frame's segment against its fence and opens this back buffer's one
+	void beginFrameIfNeeded()
 	{
-		ConstantBufferVariable cbVariable = constantBufferData[name];
-		unsigned int offset = offsetIndex * cbSizeInBytes;
-		memcpy(&buffer[offset + cbVariable.offset], data, cbVariable.size);
+		if (frameTag == core->frameNumber)
+		{
+			return;
+		}
+		int previous = ring.currentSegment();
+		if (previous >= 0)
+		{
+			ring.closeFrame(core->graphicsQueueFence[previous].value);
+		}
+		int segment = core->frameIndex();
+		core->graphicsQueueFence[segment].waitFor(ring.segmentFence(segment));
+		frameTag = core->frameNumber;
+		ring.beginFrame(segment, frameTag);
+		for (int i = ring.releaseRetired(frameTag); i > 0; i--)
+		{
+			retiredBuffers.front()->Unmap(0, NULL);
+			retiredBuffers.front()->Release();
+			retiredBuffers.pop_front();
+		}
+		ring.allocate(offsetIndex);
 	}
-	D3D12_GPU_VIRTUAL_ADDRESS getGPUAddress() const
+	void grow()
 	{
-		return (constantBuffer->GetGPUVirtualAddress() + (offsetIndex * cbSizeInBytes));
+		ring.grow();
+		retiredBuffers.push_back(constantBuffer);
+		createBuffer();
+		ring.allocate(offsetIndex);
+		printf("ConstantBuffer %s grown to %u slots per frame\n", layout.name.c_str(), ring.segmentSlots());
 	}
-	void next()
+};
+
+class Shader;
+
+// Pre-resolved location of one constant: shader, stage, cbuffer index and byte range.
+// Look it up once after the shader is loaded, then updates are a bounds-checked memcpy
+struct ConstantHandle
+{
+	Shader* shader;
+	bool pixelStage;
+	int bufferIndex;
+	unsigned int offset;
+	unsigned int size;
+
+	ConstantHandle()
 	{
-		offsetIndex++;
-		if (offsetIndex >= numInstances)
-		{
-			offsetIndex = 0;
-		}
+		shader = nullptr;
+		pixelStage = false;
+		bufferIndex = -1;
+		offset = 0;
+		size = 0;
 	}
-	void free()
+	bool valid() const
 	{
-		constantBuffer->Unmap(0, NULL);
-		constantBuffer->Release();
+		return shader != nullptr;
 	}
 };
 
@@ -100,20 +191,22 @@ public:
 			ID3D12ShaderReflectionConstantBuffer* constantBuffer = reflection->GetConstantBufferByIndex(i);
 			D3D12_SHADER_BUFFER_DESC cbDesc;
 			constantBuffer->GetDesc(&cbDesc);
-			buffer.name = cbDesc.Name;
-			unsigned int totalSize = 0;
+			// The per-frame block is owned and bound by FrameConstants, not per shader
+			D3D12_SHADER_INPUT_BIND_DESC cbBindDesc;
+			reflection->GetResourceBindingDescByName(cbDesc.Name, &cbBindDesc);
+			if (cbBindDesc.BindPoint == core->frameConstantsRegister)
+			{
+				continue;
+			}
+			buffer.layout.name = cbDesc.Name;
 			for (int j = 0; j < cbDesc.Variables; j++)
 			{
 				ID3D12ShaderReflectionVariable* var = constantBuffer->GetVariableByIndex(j);
 				D3D12_SHADER_VARIABLE_DESC vDesc;
 				var->GetDesc(&vDesc);
-				ConstantBufferVariable bufferVariable;
-				bufferVariable.offset = vDesc.StartOffset;
-				bufferVariable.size = vDesc.Size;
-				buffer.constantBufferData.insert({ vDesc.Name, bufferVariable });
-				totalSize += bufferVariable.size;
+				buffer.layout.addVariable(vDesc.Name, vDesc.StartOffset, vDesc.Size);
 			}
-			buffer.init(core, totalSize);
+			buffer.init(core, buffer.layout.sizeInBytes);
 			buffers.push_back(buffer);
 		}
 		for (int i = 0; i < desc.BoundResources; i++)
@@ -185,7 +278,7 @@ public:
 	{
 		for (int i = 0; i < buffers.size(); i++)
 		{
-			if (buffers[i].name == constantBufferName)
+			if (buffers[i].layout.name == constantBufferName)
 			{
 				buffers[i].update(variableName, data);
 				return;
@@ -200,6 +293,57 @@ public:
 	{
 		updateConstant(constantBufferName, variableName, data, psConstantBuffers);
 	}
+	std::vector<ConstantBufferLayout> getLayouts(bool pixelStage)
+	{
+		std::vector<ConstantBuffer>& buffers = pixelStage ? psConstantBuffers : vsConstantBuffers;
+		std::vector<ConstantBufferLayout> layouts;
+		for (int i = 0; i < buffers.size(); i++)
+		{
+			layouts.push_back(buffers[i].layout);
+		}
+		return layouts;
+	}
+	ConstantHandle findConstant(bool pixelStage, const std::string& constantBufferName, const std::string& variableName)
+	{
+		ConstantHandle handle;
+		ConstantLocation location;
+		if (!resolveConstantLocation(getLayouts(pixelStage), constantBufferName, variableName, location))
+		{
+			printf("WARNING: %s constant %s.%s not found\n", pixelStage ? "PS" : "VS", constantBufferName.c_str(), variableName.c_str());
+			return handle;
+		}
+		handle.shader = this;
+		handle.pixelStage = pixelStage;
+		handle.bufferIndex = location.bufferIndex;
+		handle.offset = location.offset;
+		handle.size = location.size;
+		return handle;
+	}
+	void updateConstant(const ConstantHandle& handle, const void* data)
+	{
+		std::vector<ConstantBuffer>& buffers = handle.pixelStage ? psConstantBuffers : vsConstantBuffers;
+		if (handle.bufferIndex < 0 || handle.bufferIndex >= (int)buffers.size())
+		{
+			return;
+		}
+		buffers[handle.bufferIndex].write(handle.offset, data, handle.size);
+	}
+	void printConstantBufferStats(const std::string& shaderName)
+	{
+		for (int i = 0; i < vsConstantBuffers.size(); i++)
+		{
+			printStats(shaderName, "VS", vsConstantBuffers[i]);
+		}
+		for (int i = 0; i < psConstantBuffers.size(); i++)
+		{
+			printStats(shaderName, "PS", psConstantBuffers[i]);
+		}
+	}
+	void printStats(const std::string& shaderName, const char* stage, ConstantBuffer& cb)
+	{
+		printf("  %-26s %s %-18s peak %5u / %5u slots per frame, grown %d times\n", shaderName.c_str(), stage, cb.layout.name.c_str(),
+			cb.ring.peakSlots(), cb.ring.segmentSlots(), cb.ring.growCount());
+	}
 	void apply(Core* core)
 	{
 		for (int i = 0; i < vsConstantBuffers.size(); i++)
@@ -212,6 +356,7 @@ public:
 			core->getCommandList()->SetGraphicsRootConstantBufferView(1, psConstantBuffers[i].getGPUAddress());
 			psConstantBuffers[i].next();
 		}
+		frameStats().current.rootBinds += (int)(vsConstantBuffers.size() + psConstantBuffers.size());
 	}
 	void free()
 	{
@@ -271,6 +416,41 @@ public:
 	{
 		shaders[name].updateConstantPS(constantBufferName, variableName, data);
 	}
+	// Handles stay valid for the lifetime of Shaders, map nodes never move
+	ConstantHandle findConstantVS(const std::string& name, const std::string& constantBufferName, const std::string& variableName)
+	{
+		return findConstant(name, false, constantBufferName, variableName);
+	}
+	ConstantHandle findConstantPS(const std::string& name, const std::string& constantBufferName, const std::string& variableName)
+	{
+		return findConstant(name, true, constantBufferName, variableName);
+	}
+	ConstantHandle findConstant(const std::string& name, bool pixelStage, const std::string& constantBufferName, const std::string& variableName)
+	{
+		std::map<std::string, Shader>::iterator it = shaders.find(name);
+		if (it == shaders.end())
+		{
+			printf("WARNING: shader %s not loaded, constant %s.%s unresolved\n", name.c_str(), constantBufferName.c_str(), variableName.c_str());
+			return ConstantHandle();
+		}
+		return it->second.findConstant(pixelStage, constantBufferName, variableName);
+	}
+	void update(const ConstantHandle& handle, const void* data)
+	{
+		if (handle.shader != nullptr)
+		{
+			handle.shader->updateConstant(handle, data);
+		}
+	}
+	// Peak slots per frame for every constant buffer, to size maxDrawCalls
+	void printConstantBufferStats()
+	{
+		printf("Constant buffer usage:\n");
+		for (std::map<std::string, Shader>::iterator it = shaders.begin(); it != shaders.end(); ++it)
+		{
+			it->second.printConstantBufferStats(it->first);
+		}
+	}
 	Shader* find(std::string name)
 	{
 		return &shaders[name];
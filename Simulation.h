@@ -0,0 +1,772 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "Maths.h"
+#include "Animation.h"
+#include "StateMechine.h"
+#include "SpatialGrid.h"
+#include "SweptCollision.h"
+#include "FixedTimestep.h"
+#include "Random.h"
+#include "Frustum.h"
+#include "Lod.h"
+
+// Gameplay core of the runner: track tiles and their recycling, level config, obstacles and collision,
+// the runners' movement and animation state, lane control and the game over flow. Nothing here knows
+// about windows, input devices or a graphics API. The game feeds it keyboard state and draws what it
+// finds, the headless driver (HeadlessMain.cpp) feeds it a script. Whatever a renderer derives from a
+// tile's content is rebuilt through TrackListener when that content changes.
+// Content is random but reproducible: each tile draws from RandomStreams keyed by the level seed and the
+// tile's index along the track, one stream per kind of content, never from the global rand()
+
+// Stream ids for a tile's RandomStreams. Grass is generated by the renderer but keeps its own id here so no
+// two kinds of content share a sequence
+enum TrackRandomStream
+{
+	TRACK_RANDOM_CONFIG = 1,
+	TRACK_RANDOM_OBSTACLES,
+	TRACK_RANDOM_DECORATIONS,
+	TRACK_RANDOM_GRASS
+};
+
+// Lane input for one frame, already decoded from whatever device produced it
+struct RunnerInput
+{
+	bool left;
+	bool right;
+
+	RunnerInput()
+	{
+		left = false;
+		right = false;
+	}
+};
+
+// A character running along the track, the player or the farmer. Owns its animation state but no model,
+// a renderer draws it at renderPosition
+class Runner
+{
+public:
+	StateMachine stateMachine;
+	Vec3 position;
+	Vec3 scale;
+	float speed;
+	float rotationX;
+	float rotationY;
+	float rotationZ;
+	Vec3 previousPosition; // Position at the end of the previous fixed step
+	Vec3 renderPosition;   // What gets drawn, between the last two steps, set by interpolate()
+
+	Runner()
+	{
+		position = Vec3(0, 0, 0);
+		previousPosition = position;
+		renderPosition = position;
+		scale = Vec3(0.1f, 0.1f, 0.1f);
+		speed = 1.0f;
+		rotationX = 0.0f;
+		rotationY = 0.0f;
+		rotationZ = 0.0f;
+	}
+
+	void init(Animation* animation, Vec3 startPosition, Vec3 _scale)
+	{
+		position = startPosition;
+		previousPosition = position;
+		renderPosition = position;
+		scale = _scale;
+		stateMachine.init(animation);
+		if (animation != nullptr && animation->hasAnimation("run forward"))
+		{
+			stateMachine.changeState("run forward", 0.0f);
+		}
+	}
+
+	// Called at the start of every fixed step, remembers where interpolation starts from
+	void beginStep()
+	{
+		previousPosition = position;
+	}
+
+	// alpha 0 draws the previous step's position, 1 the latest
+	void interpolate(float alpha)
+	{
+		renderPosition = previousPosition + (position - previousPosition) * alpha;
+	}
+
+	void update(float dt)
+	{
+		stateMachine.update(dt * 0.5f);
+
+		// Forward is -Z
+		position.z -= speed * dt;
+	}
+
+	void playAnimation(std::string name, float blendTime = 0.2f, bool loop = true)
+	{
+		stateMachine.changeState(name, blendTime, loop);
+	}
+
+	void setTransform(Vec3 startPosition, Vec3 _scale)
+	{
+		position = startPosition;
+		previousPosition = position;
+		renderPosition = position;
+		scale = _scale;
+	}
+
+	void setSpeed(float _speed)
+	{
+		speed = _speed;
+	}
+
+	// xyz picks the axis, angle in radians
+	void setRotation(int xyz, float _rotation)
+	{
+		if (xyz == 0) rotationX = _rotation;
+		else if (xyz == 1) rotationY = _rotation;
+		else if (xyz == 2) rotationZ = _rotation;
+	}
+};
+
+// Lane changes: the runner eases toward a fixed offset while a direction is held, and back to the centre
+// once it is released
+class RunnerController
+{
+public:
+	float maxOffset = 3.5f;
+	float transitionSpeed = 8.0f;
+
+	void update(Runner& runner, const RunnerInput& input, float dt)
+	{
+		float targetX = 0.0f;
+		if (input.left)
+		{
+			targetX = maxOffset;
+		}
+		else if (input.right)
+		{
+			targetX = -maxOffset;
+		}
+		// current += (target - current) * speed * dt
+		runner.position.x += (targetX - runner.position.x) * transitionSpeed * dt;
+	}
+};
+
+// An animated obstacle standing on a tile (the grazing sheep). Its clock always runs, but the pose is only
+// evaluated by animate(), which the renderer calls for the ones it draws, less often the further away they are
+class TrackObstacle
+{
+public:
+	StateMachine stateMachine;
+	Vec3 position;
+	Vec3 scale;
+	float rotationY;
+	bool hit;
+	float collisionRadius;
+	float pendingTime;     // Time not handed to the state machine yet
+
+	TrackObstacle()
+	{
+		position = Vec3(0, 0, 0);
+		scale = Vec3(0.1f, 0.1f, 0.1f);
+		rotationY = 0.0f;
+		hit = false;
+		collisionRadius = 0.5f;
+		pendingTime = 0.0f;
+	}
+
+	// startTime puts the clip at a different point for each obstacle, so they do not all move in step
+	void init(Animation* animation, Vec3 _pos, float _rotY, float _scale, float startTime)
+	{
+		position = _pos;
+		rotationY = _rotY;
+		scale = Vec3(_scale, _scale, _scale);
+		hit = false;
+		collisionRadius = 0.8f;
+		pendingTime = 0.0f;
+
+		stateMachine.init(animation);
+		if (animation != nullptr)
+		{
+			stateMachine.changeState("eating", 0.0f);
+			stateMachine.update(startTime);
+		}
+	}
+
+	void update(float dt)
+	{
+		pendingTime += dt;
+	}
+
+	// Hands the saved up time to the state machine once it reaches interval seconds, 0 means every call.
+	// Returns whether the pose was evaluated
+	bool animate(float interval)
+	{
+		if (pendingTime < interval) return false;
+
+		stateMachine.update(pendingTime);
+		pendingTime = 0.0f;
+		return true;
+	}
+
+	void playAnimation(std::string name, float blendTime = 0.2f, bool loop = true)
+	{
+		stateMachine.changeState(name, blendTime, loop);
+	}
+
+	// modelSphere is the obstacle model's bounding sphere in its own space
+	BoundingSphere worldSphere(const BoundingSphere& modelSphere) const
+	{
+		return modelSphere.transformed(Matrix::fromYawTRS(position, rotationY, scale));
+	}
+};
+
+// One stretch of track: what stands on it, generated from a level config line. Tiles are allocated once
+// and recycled from the back to the front
+class TrackTile
+{
+public:
+	int id;        // Creation index, kept through recycling, for renderers that keep data per tile
+	long long index; // Position along the track, 0 for the first tile generated, a recycled tile gets the next
+	unsigned int seed; // Level seed, with index the key of every random draw for this tile
+	Vec3 position;
+	float length;  // Along Z
+
+	std::vector<TrackObstacle> obstacles;
+
+	// Mushrooms beside the road, drawn only
+	struct Decoration
+	{
+		Vec3 position;
+		float scale;
+		float rotationY;
+	};
+	std::vector<Decoration> decorations;
+
+	TrackTile()
+	{
+		id = 0;
+		index = 0;
+		seed = 0;
+		position = Vec3(0, 0, 0);
+		length = 20.0f;
+	}
+
+	// The same draws for the same seed, index and stream, whenever and on whichever thread they are made
+	RandomStream random(unsigned int stream) const
+	{
+		return RandomStream(seed, (unsigned long long)index, stream);
+	}
+
+	// obstacleType: 0 = none, 1 = left, 2 = right
+	void generateObstacles(Animation* animation, int obstacleType)
+	{
+		obstacles.clear();
+		if (obstacleType == 0) return;
+
+		RandomStream rng = random(TRACK_RANDOM_OBSTACLES);
+		TrackObstacle obs;
+		bool isLeft = (obstacleType == 1);
+		float xPos = isLeft ? 5.0f : -5.3f;
+		float rotY = isLeft ? 1.57f : -1.57f;
+
+		// Some randomness along Z so the track does not look stamped out
+		float zOffset = (rng.uniform() - 0.5f) * (length * 0.6f);
+		float startTime = rng.uniform() * 5.0f;
+		obs.init(animation, position + Vec3(xPos, -0.8f, zOffset), rotY, 0.11f, startTime);
+		obstacles.push_back(obs);
+	}
+
+	void generateDecorations(int count)
+	{
+		decorations.clear();
+		RandomStream rng = random(TRACK_RANDOM_DECORATIONS);
+		for (int i = 0; i < count; i++)
+		{
+			Decoration dec;
+			// Clear of the road, which is about 10 wide
+			bool isLeft = rng.below(2) == 0;
+			float xOffset = rng.range(18.0f, 35.0f);
+			float x = isLeft ? xOffset : -xOffset;
+			float zOffset = (rng.uniform() - 0.5f) * length;
+			dec.position = position + Vec3(x, -0.8f, zOffset);
+			dec.scale = rng.range(0.007f, 0.017f);
+			dec.rotationY = rng.uniform() * 6.28f;
+			decorations.push_back(dec);
+		}
+	}
+
+	void update(float dt)
+	{
+		for (auto& obs : obstacles) obs.update(dt);
+	}
+
+	void setPosition(Vec3 pos) { position = pos; }
+};
+
+// Told when a tile's content has been (re)generated, so data derived from it can be rebuilt
+class TrackListener
+{
+public:
+	virtual ~TrackListener() {}
+
+	// At init for every tile, then each time a tile is recycled to the front
+	virtual void tileGenerated(TrackTile& tile) = 0;
+};
+
+// The endless track: a fixed number of tiles, the one furthest behind the player moves to the front and
+// is refilled from the next level config line. All obstacles are also kept in an XZ grid for collision
+class Track
+{
+public:
+	std::vector<TrackTile*> tiles; // Back to front
+	unsigned int seed;             // Level seed, the same seed always gives the same track
+	bool verbose;                  // Print collisions and level loading
+
+	Track()
+	{
+		numTiles = 10;
+		tileLength = 35.0f;
+		obstacleAnimation = nullptr;
+		listener = nullptr;
+		nextTileIndex = 0;
+		recycled = 0;
+		seed = 1;
+		verbose = true;
+	}
+
+	~Track()
+	{
+		for (auto tile : tiles)
+		{
+			delete tile;
+		}
+		tiles.clear();
+	}
+
+	// One line per tile: LEFT, RIGHT or NONE and a decoration count, the lines repeat along the track.
+	// A "SEED n" line sets the seed. Without a file every tile's config is random as well
+	void loadLevelConfig(std::string filename)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			if (verbose) printf("Warning: Could not open %s. Using random generation.\n", filename.c_str());
+			return;
+		}
+
+		levelConfigs.clear();
+		std::string line;
+		while (std::getline(file, line))
+		{
+			if (line.empty() || line[0] == '#') continue;
+			std::stringstream ss(line);
+			std::string obsStr;
+			ss >> obsStr;
+			if (obsStr == "SEED")
+			{
+				ss >> seed;
+				continue;
+			}
+			int decCount;
+			ss >> decCount;
+
+			TileConfig config;
+			if (obsStr == "LEFT") config.obstacleType = 1;
+			else if (obsStr == "RIGHT") config.obstacleType = 2;
+			else config.obstacleType = 0; // NONE or others
+
+			config.decorationCount = decCount;
+			levelConfigs.push_back(config);
+		}
+		if (verbose) printf("Loaded %d tile configs from %s\n", (int)levelConfigs.size(), filename.c_str());
+	}
+
+	// obstacleAnimation may be nullptr, obstacles then stand still
+	void init(Animation* _obstacleAnimation, Vec3 playerStartPosition)
+	{
+		obstacleAnimation = _obstacleAnimation;
+		for (auto tile : tiles) delete tile;
+		tiles.clear();
+		// Cells narrower than a tile, a query only touches a few
+		obstacleGrid.init(8.0f);
+		recycled = 0;
+		nextTileIndex = 0;
+
+		int tilesBehind = 2;
+		for (int i = 0; i < numTiles; i++)
+		{
+			TrackTile* tile = new TrackTile();
+			tile->id = i;
+			tile->length = tileLength;
+			float zPos = playerStartPosition.z + (tilesBehind - i) * tileLength;
+			tile->setPosition(Vec3(playerStartPosition.x, playerStartPosition.y, zPos));
+			generate(tile);
+			tiles.push_back(tile);
+		}
+	}
+
+	// Tells the listener about every current tile straight away, then about each regenerated one
+	void setListener(TrackListener* _listener)
+	{
+		listener = _listener;
+		if (listener == nullptr) return;
+		for (auto tile : tiles)
+		{
+			listener->tileGenerated(*tile);
+		}
+	}
+
+	void update(Vec3 playerPosition, float dt)
+	{
+		// Obstacles only count time here, their poses are evaluated for the ones that get drawn
+		for (auto tile : tiles)
+		{
+			tile->update(dt);
+		}
+
+		if (tiles.empty()) return;
+
+		// Once the player is well past the tile furthest behind, it becomes the new front tile
+		float backTileZ = tiles[0]->position.z;
+		if (playerPosition.z < backTileZ - tileLength * 1.5f)
+		{
+			TrackTile* recycledTile = tiles[0];
+			tiles.erase(tiles.begin());
+
+			float newZ = tiles.back()->position.z - tileLength;
+			recycledTile->setPosition(Vec3(tiles.back()->position.x, tiles.back()->position.y, newZ));
+			generate(recycledTile);
+			tiles.push_back(recycledTile);
+			recycled++;
+		}
+	}
+
+	int checkCollisions(Vec3 playerPos, float playerRadius)
+	{
+		return checkCollisions(&playerPos, 1, playerRadius, nullptr);
+	}
+
+	// Several agents in one query, returns how many obstacles were newly hit. hitsPerAgent (may be nullptr)
+	// gets each agent's share. An obstacle counts once, for the lowest numbered agent touching it that step
+	int checkCollisions(const Vec3* positions, int count, float radius, int* hitsPerAgent)
+	{
+		if (hitsPerAgent)
+		{
+			for (int i = 0; i < count; i++) hitsPerAgent[i] = 0;
+		}
+		obstacleGrid.queryBatch(positions, count, radius, collisionHits);
+		int totalHits = 0;
+		for (auto& hit : collisionHits)
+		{
+			TrackObstacle* obs = hit.value;
+			if (obs->hit) continue;
+			obs->hit = true;
+			totalHits++;
+			if (hitsPerAgent) hitsPerAgent[hit.query]++;
+			if (verbose) printf("Collision Detected! Obstacle at Z: %.2f\n", obs->position.z);
+		}
+		return totalHits;
+	}
+
+	// Swept test: everything touched while moving from -> to counts, however long the step. Returns how many
+	// obstacles were newly hit, firstImpact (may be nullptr) gets the earliest as a fraction of the step, -1 if none
+	int checkCollisions(const Vec3& from, const Vec3& to, float radius, float* firstImpact = nullptr)
+	{
+		sweepCandidates.clear();
+		sweepObstacles.clear();
+		float minX = from.x < to.x ? from.x : to.x;
+		float maxX = from.x < to.x ? to.x : from.x;
+		float minZ = from.z < to.z ? from.z : to.z;
+		float maxZ = from.z < to.z ? to.z : from.z;
+		obstacleGrid.queryBox(minX - radius, minZ - radius, maxX + radius, maxZ + radius, [this](const SpatialGrid<TrackObstacle*>::Item& item)
+			{
+				if (item.value->hit) return;
+				sweepCandidates.add(item.x, item.z, item.radius);
+				sweepObstacles.push_back(item.value);
+			});
+
+		sweepHits.clear();
+		CircleSweep::sweepCircles(from, to, radius, sweepCandidates.x.data(), sweepCandidates.z.data(), sweepCandidates.radius.data(),
+			sweepCandidates.size(), sweepHits);
+		std::sort(sweepHits.begin(), sweepHits.end(), [](const SweepHit& a, const SweepHit& b) { return a.time < b.time; });
+
+		for (auto& hit : sweepHits)
+		{
+			TrackObstacle* obs = sweepObstacles[hit.index];
+			obs->hit = true;
+			if (verbose) printf("Collision Detected! Obstacle at Z: %.2f (%.0f%% into the step)\n", obs->position.z, hit.time * 100.0f);
+		}
+		if (firstImpact)
+		{
+			*firstImpact = sweepHits.empty() ? -1.0f : sweepHits[0].time;
+		}
+		return (int)sweepHits.size();
+	}
+
+	void setNumTiles(int num) { numTiles = num; }
+	void setTileLength(float length) { tileLength = length; }
+	int tileCount() const { return numTiles; }
+	// Tiles moved to the front since init
+	int recycledTiles() const { return recycled; }
+
+private:
+	struct TileConfig
+	{
+		int obstacleType; // 0: None, 1: Left, 2: Right
+		int decorationCount;
+	};
+	std::vector<TileConfig> levelConfigs;
+	long long nextTileIndex;
+
+	int numTiles;
+	float tileLength;
+	Animation* obstacleAnimation;
+	TrackListener* listener;
+	int recycled;
+
+	// Every tile's obstacles, updated incrementally as tiles are recycled
+	SpatialGrid<TrackObstacle*> obstacleGrid;
+	std::vector<SpatialGrid<TrackObstacle*>::Hit> collisionHits;
+	// Candidates and results of a swept test, kept so they stop allocating
+	SweepCandidates sweepCandidates;
+	std::vector<TrackObstacle*> sweepObstacles;
+	std::vector<SweepHit> sweepHits;
+
+	TileConfig configFor(const TrackTile& tile)
+	{
+		if (levelConfigs.empty())
+		{
+			RandomStream rng = tile.random(TRACK_RANDOM_CONFIG);
+			TileConfig config;
+			config.obstacleType = (rng.below(2) == 0) ? (rng.below(2) + 1) : 0; // 50% chance for obstacle
+			config.decorationCount = (rng.below(100) > 30) ? (rng.below(2) + 1) : 0; // 70% chance for decorations
+			return config;
+		}
+		return levelConfigs[(size_t)(tile.index % (long long)levelConfigs.size())];
+	}
+
+	// Refill a tile at its current position as the next index along the track. The grid drops its old
+	// obstacles before the new ones go in
+	void generate(TrackTile* tile)
+	{
+		tile->index = nextTileIndex++;
+		tile->seed = seed;
+		TileConfig config = configFor(*tile);
+		for (auto& obs : tile->obstacles)
+		{
+			obstacleGrid.remove(&obs, obs.position.x, obs.position.z);
+		}
+		tile->generateObstacles(obstacleAnimation, config.obstacleType);
+		for (auto& obs : tile->obstacles)
+		{
+			obstacleGrid.insert(&obs, obs.position.x, obs.position.z, obs.collisionRadius);
+		}
+		tile->generateDecorations(config.decorationCount);
+		if (listener)
+		{
+			listener->tileGenerated(*tile);
+		}
+	}
+};
+
+// The obstacle animation LOD: an obstacle whose bounding sphere is in the frustum evaluates its pose at the
+// rate lod gives the sphere's distance from the eye, one out of view only saves up time. Run once a frame
+// after the simulation and before anything is drawn, by the game and by the headless driver alike
+inline void animateVisibleObstacles(Track& track, const BoundingSphere& modelSphere, const Frustum& frustum, const Vec3& eye, const AnimationLod& lod)
+{
+	for (auto tile : track.tiles)
+	{
+		for (auto& obs : tile->obstacles)
+		{
+			BoundingSphere sphere = obs.worldSphere(modelSphere);
+			if (frustum.sphereVisible(sphere.center, sphere.radius))
+			{
+				obs.animate(lod.interval((sphere.center - eye).length()));
+			}
+		}
+	}
+}
+
+enum GameState
+{
+	PLAYING,
+	GAMEOVER_WALK, // The farmer walks up to the player
+	GAMEOVER_GRAB  // ... and grabs them
+};
+
+// Where the simulation time of the frames since the last reset() went, in milliseconds
+struct SimulationProfile
+{
+	double collisionMs;  // Swept player against obstacle test
+	double flowMs;       // Hit reactions, game over flow, lane control
+	double trackMs;      // Obstacle clocks and tile recycling, including the listener's rebuilds
+	double runnersMs;    // Player and farmer movement and skeletons
+	int steps;
+
+	SimulationProfile()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		collisionMs = 0.0;
+		flowMs = 0.0;
+		trackMs = 0.0;
+		runnersMs = 0.0;
+		steps = 0;
+	}
+};
+
+// The whole game minus drawing and devices: the track, the player running it, the farmer chasing, and the
+// collision count that ends the run. Logic advances in fixed steps and the track comes from the level
+// seed, so a run depends only on its input, never on the frame rate or the time it was started
+class GameSimulation
+{
+public:
+	Track track;
+	RunnerController controller;
+	FixedStepClock clock;
+	Runner* player;
+	Runner* farmer;
+
+	GameState state;
+	int collisionCount;
+	int collisionsToLose;        // Hits that end the run, 0 never ends it (benchmarks)
+	float playerRadius;
+	float farmerWalkSpeed;
+	Vec3 lastCollisionPosition;  // Where the player was at the last collision test, the next one sweeps from here
+
+	SimulationProfile* profile;  // Accumulates timings when set
+	bool verbose;                // Print hits and level loading
+
+	GameSimulation()
+	{
+		player = nullptr;
+		farmer = nullptr;
+		state = PLAYING;
+		collisionCount = 0;
+		collisionsToLose = 2;
+		playerRadius = 5.5f;
+		farmerWalkSpeed = 5.0f;
+		lastCollisionPosition = Vec3(0, 0, 0);
+		profile = nullptr;
+		verbose = true;
+	}
+
+	// The runners stay owned by the caller. obstacleAnimation may be nullptr. seed replaces the level's
+	// own (or the default) when it is not negative
+	void init(Runner* _player, Runner* _farmer, Animation* obstacleAnimation, const std::string& levelFile, long long seed = -1)
+	{
+		player = _player;
+		farmer = _farmer;
+		clock.init(60.0f, 8);
+		state = PLAYING;
+		collisionCount = 0;
+		lastCollisionPosition = player->position;
+		track.verbose = verbose;
+		track.loadLevelConfig(levelFile);
+		if (seed >= 0) track.seed = (unsigned int)seed;
+		track.init(obstacleAnimation, player->position);
+	}
+
+	// One frame of dt seconds: as many fixed steps as the clock hands out (at most 8 after a hitch), then
+	// the runners' render positions between the last two. Returns the number of steps
+	int update(float dt, const RunnerInput& input)
+	{
+		int steps = clock.advance(dt);
+		for (int i = 0; i < steps; i++)
+		{
+			step(clock.step(), input);
+		}
+		player->interpolate(clock.alpha());
+		farmer->interpolate(clock.alpha());
+		if (profile) profile->steps += steps;
+		return steps;
+	}
+
+	void step(float dt, const RunnerInput& input)
+	{
+		std::chrono::high_resolution_clock::time_point mark;
+		if (profile) mark = std::chrono::high_resolution_clock::now();
+		player->beginStep();
+		farmer->beginStep();
+
+		if (state == PLAYING)
+		{
+			// Along the whole path since the last test, so speed or a long step cannot tunnel
+			int newHits = track.checkCollisions(lastCollisionPosition, player->position, playerRadius);
+			lastCollisionPosition = player->position;
+			lap(mark, profile ? &profile->collisionMs : nullptr);
+			if (newHits > 0)
+			{
+				collisionCount += newHits;
+				if (verbose) printf("Total Collisions: %d\n", collisionCount);
+
+				if (collisionsToLose > 0 && collisionCount >= collisionsToLose)
+				{
+					state = GAMEOVER_WALK;
+					// The player dies where they are, the farmer stops running and walks over
+					player->setSpeed(0.0f);
+					player->playAnimation("death", 0.2f, false);
+					farmer->setSpeed(0.0f);
+					farmer->playAnimation("walk", 0.2f);
+				}
+				else
+				{
+					player->playAnimation("hit reaction", 0.1f, false);
+				}
+			}
+			// Back to running once the hit reaction has played
+			if (player->stateMachine.getState() == "hit reaction" && player->stateMachine.isAnimationFinished())
+			{
+				player->playAnimation("run forward", 0.2f, true);
+			}
+
+			// Lane changes only while the game is on
+			controller.update(*player, input, dt);
+		}
+		else if (state == GAMEOVER_WALK)
+		{
+			// Stop just behind the player (+Z is behind)
+			Vec3 targetPos = player->position;
+			targetPos.z += 5.0f;
+			Vec3 dir = targetPos - farmer->position;
+			float dist = dir.length();
+			if (dist < 0.1f)
+			{
+				state = GAMEOVER_GRAB;
+				farmer->playAnimation("grab low", 0.2f, false);
+			}
+			else
+			{
+				farmer->position += dir.normalize() * farmerWalkSpeed * dt;
+			}
+		}
+		lap(mark, profile ? &profile->flowMs : nullptr);
+
+		track.update(player->position, dt);
+		lap(mark, profile ? &profile->trackMs : nullptr);
+		player->update(dt);
+		farmer->update(dt);
+		lap(mark, profile ? &profile->runnersMs : nullptr);
+	}
+
+private:
+	// Adds the time since mark to into and restarts mark. Nothing is timed without a profile
+	void lap(std::chrono::high_resolution_clock::time_point& mark, double* into)
+	{
+		if (into == nullptr) return;
+		std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+		*into += std::chrono::duration<double, std::milli>(now - mark).count();
+		mark = now;
+	}
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <math.h>
+#include "Maths.h"
+
+// Uniform grid over the XZ plane for circle overlap queries, e.g. agents against obstacles.
+// An item is stored in the one cell that holds its centre and queries widen their search by the largest
+// item radius, so nothing is stored twice. Cells are hashed and dropped once empty: the track has no end
+// in Z, memory follows the live items rather than the distance travelled
+template<typename T>
+class SpatialGrid
+{
+public:
+	struct Item
+	{
+		float x;
+		float z;
+		float radius;
+		T value;
+	};
+
+	// One overlap found by queryBatch: which query circle, and the item's value
+	struct Hit
+	{
+		int query;
+		T value;
+	};
+
+	SpatialGrid()
+	{
+		cellSize = 8.0f;
+		inverseCellSize = 1.0f / cellSize;
+		maxRadius = 0.0f;
+		count = 0;
+	}
+
+	// Roughly the spacing of the items or the query radius, whichever is larger. Clears the grid
+	void init(float _cellSize)
+	{
+		clear();
+		cellSize = _cellSize;
+		inverseCellSize = 1.0f / cellSize;
+	}
+
+	void clear()
+	{
+		cells.clear();
+		maxRadius = 0.0f;
+		count = 0;
+	}
+
+	void insert(const T& value, float x, float z, float radius)
+	{
+		Item item;
+		item.x = x;
+		item.z = z;
+		item.radius = radius;
+		item.value = value;
+		cells[key(cellOf(x), cellOf(z))].push_back(item);
+		maxRadius = radius > maxRadius ? radius : maxRadius;
+		count++;
+	}
+
+	// x and z must be the ones it was inserted with. Returns false if it was not found
+	bool remove(const T& value, float x, float z)
+	{
+		typename std::unordered_map<long long, std::vector<Item>>::iterator cell = cells.find(key(cellOf(x), cellOf(z)));
+		if (cell == cells.end())
+		{
+			return false;
+		}
+		std::vector<Item>& items = cell->second;
+		for (int i = 0; i < (int)items.size(); i++)
+		{
+			if (items[i].value == value)
+			{
+				items[i] = items.back();
+				items.pop_back();
+				if (items.empty())
+				{
+					cells.erase(cell);
+				}
+				count--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	int size() const
+	{
+		return count;
+	}
+
+	// visit(const Item&) for every item whose circle overlaps this one
+	template<typename Visitor>
+	void query(float x, float z, float radius, Visitor visit) const
+	{
+		queryBox(x - radius, z - radius, x + radius, z + radius, [&visit, x, z, radius](const Item& item)
+			{
+				if (overlaps(item, x, z, radius))
+				{
+					visit(item);
+				}
+			});
+	}
+
+	// visit(const Item&) for every item that could overlap this box, without an exact test. For callers
+	// that test the candidates themselves, e.g. against a swept shape
+	template<typename Visitor>
+	void queryBox(float minX, float minZ, float maxX, float maxZ, Visitor visit) const
+	{
+		int x0 = cellOf(minX - maxRadius);
+		int x1 = cellOf(maxX + maxRadius);
+		int z0 = cellOf(minZ - maxRadius);
+		int z1 = cellOf(maxZ + maxRadius);
+		for (int cz = z0; cz <= z1; cz++)
+		{
+			for (int cx = x0; cx <= x1; cx++)
+			{
+				typename std::unordered_map<long long, std::vector<Item>>::const_iterator cell = cells.find(key(cx, cz));
+				if (cell == cells.end())
+				{
+					continue;
+				}
+				const std::vector<Item>& items = cell->second;
+				for (int i = 0; i < (int)items.size(); i++)
+				{
+					visit(items[i]);
+				}
+			}
+		}
+	}
+
+	// Many circles of the same radius at once (y is ignored), e.g. every agent of a frame. hits is
+	// cleared and comes back ordered by query index, its storage is reused between calls
+	void queryBatch(const Vec3* centres, int queryCount, float radius, std::vector<Hit>& hits) const
+	{
+		hits.clear();
+		for (int q = 0; q < queryCount; q++)
+		{
+			query(centres[q].x, centres[q].z, radius, [&hits, q](const Item& item)
+				{
+					Hit hit;
+					hit.query = q;
+					hit.value = item.value;
+					hits.push_back(hit);
+				});
+		}
+	}
+
+private:
+	std::unordered_map<long long, std::vector<Item>> cells;
+	float cellSize;
+	float inverseCellSize;
+	float maxRadius;   // Largest item radius so far, how far past a query circle items can reach in from
+	int count;
+
+	int cellOf(float v) const
+	{
+		return (int)floorf(v * inverseCellSize);
+	}
+
+	static long long key(int cx, int cz)
+	{
+		return (long long)(((unsigned long long)(unsigned int)cx << 32) | (unsigned long long)(unsigned int)cz);
+	}
+
+	static bool overlaps(const Item& item, float x, float z, float radius)
+	{
+		float dx = x - item.x;
+		float dz = z - item.z;
+		float reach = radius + item.radius;
+		return dx * dx + dz * dz < reach * reach;
+	}
+};
@@ -3,24 +3,29 @@
 #include <cstdio>
 #include "Animation.h"
 #include "Maths.h"
+#include "FrameStats.h"
 
 // 状态机类--用于管理不同动作之间的切换，支持动作融合
 class StateMachine
 {
-public:
-	// 用于输出混合结果的实例，传给 AnimatedModel::draw 使用
-	AnimationInstance outputInstance;
-
 private:
 	Animation* animationData;
 
-	// 两个实例用于混合：current是当前动作，next是目标动作
-	AnimationInstance currentInstance;
-	AnimationInstance nextInstance;
+	// 两个实例用于混合：instances[currentIndex]是当前动作，另一个是目标动作
+	// 混合结束时只交换下标，不拷贝矩阵
+	AnimationInstance instances[2];
+	int currentIndex;
+
+	// 混合结果（只写入活动骨骼），非混合时直接输出当前实例的矩阵
+	Matrix blendedMatrices[256];
 
 	std::string currentStateName;
 	std::string nextStateName;
 
+	// changeState 时解析一次的动画片段指针，每帧更新不再按名字查找
+	AnimationSequence* currentClip;
+	AnimationSequence* nextClip;
+
 	// 混合控制变量
 	bool isBlending;
 	float blendTime;
@@ -34,6 +39,9 @@ public:
 	StateMachine()
 	{
 		animationData = nullptr;
+		currentIndex = 0;
+		currentClip = nullptr;
+		nextClip = nullptr;
 		isBlending = false;
 		blendTime = 0.0f;
 		blendDuration = 0.2f;
@@ -48,9 +56,9 @@ public:
 		animationData = _animationData;
 		if (animationData)
 		{
-			currentInstance.init(animationData, 0);
-			nextInstance.init(animationData, 0);
-			outputInstance.init(animationData, 0);
+			instances[0].init(animationData, 0);
+			instances[1].init(animationData, 0);
+			currentIndex = 0;
 		}
 	}
 
@@ -60,7 +68,8 @@ public:
 	// loop: 是否循环播放，默认true。设为false则播放一次后停在最后一帧
 	void changeState(const std::string& newState, float duration = 0.2f, bool loop = true)
 	{
-		if (animationData && !animationData->hasAnimation(newState))
+		AnimationSequence* clip = animationData ? animationData->findAnimation(newState) : nullptr;
+		if (animationData && clip == nullptr)
 		{
 			printf("WARNING: Animation '%s' not found! State change ignored.\n", newState.c_str());
 			return;
@@ -76,22 +85,24 @@ public:
 
 		if (isBlending)
 		{
-			currentInstance = nextInstance;
+			// 混合中再次切换：目标实例直接成为当前实例
+			currentIndex = 1 - currentIndex;
 			currentStateName = nextStateName;
+			currentClip = nextClip;
 			currentLoop = nextLoop; // 继承之前的循环设置
 		}
 
 		nextStateName = newState;
+		nextClip = clip;
 		nextLoop = loop; // 记录新动作的循环设置
-		nextInstance.resetAnimationTime();
+		nextInstance().resetAnimationTime();
 
 		if (currentStateName.empty())
 		{
 			currentStateName = newState;
+			currentClip = clip;
 			currentLoop = loop; // 设置当前动作的循环属性
-			currentInstance.update(currentStateName, 0.0f);
-			nextInstance = currentInstance;
-			outputInstance = currentInstance;
+			currentInstance().update(currentClip, 0.0f);
 			isBlending = false;
 		}
 		else
@@ -106,31 +117,31 @@ public:
 	{
 		if (!animationData) return;
 
-		// 1. 更新当前动作
+		// 1. 推进当前动作的时间（骨骼矩阵在 calculateMatrices 里统一计算）
 		if (!currentStateName.empty())
 		{
-			currentInstance.update(currentStateName, dt);
+			currentInstance().advance(currentClip, dt);
 
 			// 根据 loop 属性决定是否重置
-			if (currentInstance.animationFinished())
+			if (currentInstance().animationFinished())
 			{
 				if (currentLoop) {
-					currentInstance.resetAnimationTime();
+					currentInstance().resetAnimationTime();
 				}
-				// else: 不重置，AnimationInstance 内部机制会保持在结束状态（最后一帧）
+				// else: 不重置，采样时帧号会被限制在最后一帧
 			}
 		}
 
-		// 2. 如果在混合，更新目标动作
+		// 2. 如果在混合，推进目标动作的时间
 		if (isBlending)
 		{
-			nextInstance.update(nextStateName, dt);
+			nextInstance().advance(nextClip, dt);
 
 			// 混合目标也要处理循环
-			if (nextInstance.animationFinished())
+			if (nextInstance().animationFinished())
 			{
 				if (nextLoop) {
-					nextInstance.resetAnimationTime();
+					nextInstance().resetAnimationTime();
 				}
 			}
 
@@ -139,23 +150,30 @@ public:
 			if (blendTime >= blendDuration)
 			{
 				isBlending = false;
-				currentStateName = nextStateName;
+				// 交换名字而不是拷贝，每帧更新不构造字符串
+				currentStateName.swap(nextStateName);
+				currentClip = nextClip;
 				currentLoop = nextLoop; // 混合结束，应用新的循环设置
-				currentInstance = nextInstance;
+				currentIndex = 1 - currentIndex;
 			}
 		}
 
 		calculateMatrices();
 	}
 
-	// 获取用于渲染的实例指针
-	AnimationInstance* getRenderInstance()
+	// 获取用于渲染的骨骼矩阵（指向内部数组，不做拷贝），有效数量为 getBoneCount()
+	Matrix* getRenderMatrices()
 	{
-		return &outputInstance;
+		return isBlending ? blendedMatrices : currentInstance().matrices;
 	}
 
-	// 获取当前状态名称
-	std::string getState() const
+	int getBoneCount()
+	{
+		return animationData ? animationData->bonesSize() : 0;
+	}
+
+	// 获取当前状态名称（返回引用，避免每帧构造字符串）
+	const std::string& getState() const
 	{
 		return isBlending ? nextStateName : currentStateName;
 	}
@@ -164,15 +182,27 @@ public:
 	bool isAnimationFinished()
 	{
 		if (isBlending) return false;
-		return currentInstance.animationFinished();
+		return currentInstance().animationFinished();
 	}
 
 private:
+	AnimationInstance& currentInstance()
+	{
+		return instances[currentIndex];
+	}
+
+	AnimationInstance& nextInstance()
+	{
+		return instances[1 - currentIndex];
+	}
+
 	void calculateMatrices()
 	{
+		frameStats().current.skeletonsEvaluated++;
+		frameStats().current.bonesEvaluated += animationData->bonesSize();
 		if (!isBlending)
 		{
-			outputInstance = currentInstance;
+			currentInstance().evaluate();
 		}
 		else
 		{
@@ -180,17 +210,16 @@ private:
 			if (t < 0.0f) t = 0.0f;
 			if (t > 1.0f) t = 1.0f;
 
-			for (int i = 0; i < 256; i++)
-			{
-				float* mOut = outputInstance.matrices[i].m;
-				float* m1 = currentInstance.matrices[i].m;
-				float* m2 = nextInstance.matrices[i].m;
-
-				for (int k = 0; k < 16; k++)
-				{
-					mOut[k] = m1[k] * (1.0f - t) + m2[k] * t;
-				}
-			}
+			// 在局部空间对平移/缩放线性插值、对旋转球面插值，再逐级乘父骨骼
+			// 比直接混合蒙皮矩阵更准确，且只处理活动骨骼
+			AnimationInstance& from = currentInstance();
+			AnimationInstance& to = nextInstance();
+			int frameA = 0, frameB = 0;
+			float factA = 0, factB = 0;
+			animationData->calcFrame(currentClip, from.t, frameA, factA);
+			animationData->calcFrame(nextClip, to.t, frameB, factB);
+			animationData->blendBonesToGlobal(currentClip, frameA, factA, nextClip, frameB, factB, t, blendedMatrices);
+			animationData->calcTransforms(blendedMatrices, from.coordTransform);
 		}
 	}
 };
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+#include <math.h>
+#include "Maths.h"
+
+// Continuous collision in the XZ plane: a circle moving along a segment (a capsule over the frame) against
+// static circles. Testing only where the mover ends up lets a fast mover, or any mover on a long frame,
+// pass straight through something narrower than its step; the sweep reports the fraction of the step at
+// which they first touch instead
+
+struct SweepHit
+{
+	int index;     // Into the circles given to sweepCircles
+	float time;    // 0 = already overlapping at the start of the step, 1 = at its end
+};
+
+class CircleSweep
+{
+public:
+	// First time in [0, 1] at which a circle of radius moving from -> to overlaps the circle (cx, cz, cr),
+	// or -1 if it never does. Overlap is strict, like the point test: grazing contact is not a hit
+	static float timeOfImpact(const Vec3& from, const Vec3& to, float radius, float cx, float cz, float cr)
+	{
+		float dx = to.x - from.x;
+		float dz = to.z - from.z;
+		float mx = from.x - cx;
+		float mz = from.z - cz;
+		float reach = radius + cr;
+		float c = mx * mx + mz * mz - reach * reach;
+		if (c < 0)
+		{
+			return 0.0f;
+		}
+		float a = dx * dx + dz * dz;
+		float b = mx * dx + mz * dz;
+		if (b >= 0)
+		{
+			return -1.0f; // Not closing in, this also covers no movement at all
+		}
+		float discriminant = b * b - a * c;
+		if (discriminant <= 0)
+		{
+			return -1.0f;
+		}
+		float t = (-b - sqrtf(discriminant)) / a;
+		return t <= 1.0f ? t : -1.0f;
+	}
+
+	// timeOfImpact against count circles stored as separate x, z and radius arrays, four at a time with SSE.
+	// Every hit is appended to hits (not sorted), returns how many were added
+	static int sweepCircles(const Vec3& from, const Vec3& to, float radius,
+		const float* cx, const float* cz, const float* cr, int count, std::vector<SweepHit>& hits)
+	{
+		int added = 0;
+		int i = 0;
+#if defined(MATHS_USE_SSE)
+		float dx = to.x - from.x;
+		float dz = to.z - from.z;
+		__m128 fromX = _mm_set1_ps(from.x);
+		__m128 fromZ = _mm_set1_ps(from.z);
+		__m128 dirX = _mm_set1_ps(dx);
+		__m128 dirZ = _mm_set1_ps(dz);
+		__m128 a = _mm_set1_ps(dx * dx + dz * dz);
+		__m128 r = _mm_set1_ps(radius);
+		__m128 zero = _mm_setzero_ps();
+		__m128 one = _mm_set1_ps(1.0f);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 mx = _mm_sub_ps(fromX, _mm_loadu_ps(cx + i));
+			__m128 mz = _mm_sub_ps(fromZ, _mm_loadu_ps(cz + i));
+			__m128 reach = _mm_add_ps(r, _mm_loadu_ps(cr + i));
+			__m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(mz, mz)), _mm_mul_ps(reach, reach));
+			__m128 b = _mm_add_ps(_mm_mul_ps(mx, dirX), _mm_mul_ps(mz, dirZ));
+			__m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+			__m128 inside = _mm_cmplt_ps(c, zero);
+			__m128 entering = _mm_and_ps(_mm_cmplt_ps(b, zero), _mm_cmpgt_ps(discriminant, zero));
+			// Most circles are nowhere near the path, skip the square root and division for all four at once
+			if (_mm_movemask_ps(_mm_or_ps(inside, entering)) == 0)
+			{
+				continue;
+			}
+			// Lanes that are not entering may divide by zero here, they are masked out below
+			__m128 t = _mm_div_ps(_mm_sub_ps(_mm_sub_ps(zero, b), _mm_sqrt_ps(_mm_max_ps(discriminant, zero))), a);
+			entering = _mm_and_ps(entering, _mm_cmple_ps(t, one));
+			t = _mm_andnot_ps(inside, t);
+			int mask = _mm_movemask_ps(_mm_or_ps(inside, entering));
+			if (mask == 0)
+			{
+				continue;
+			}
+			float times[4];
+			_mm_storeu_ps(times, t);
+			for (int k = 0; mask != 0; k++, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					SweepHit hit;
+					hit.index = i + k;
+					hit.time = times[k];
+					hits.push_back(hit);
+					added++;
+				}
+			}
+		}
+#endif
+		for (; i < count; i++)
+		{
+			float t = timeOfImpact(from, to, radius, cx[i], cz[i], cr[i]);
+			if (t >= 0)
+			{
+				SweepHit hit;
+				hit.index = i;
+				hit.time = t;
+				hits.push_back(hit);
+				added++;
+			}
+		}
+		return added;
+	}
+};
+
+// Circles gathered for one sweep, in the layout sweepCircles reads. Kept between calls so it stops allocating
+struct SweepCandidates
+{
+	std::vector<float> x;
+	std::vector<float> z;
+	std::vector<float> radius;
+
+	void clear()
+	{
+		x.clear();
+		z.clear();
+		radius.clear();
+	}
+
+	void add(float cx, float cz, float cr)
+	{
+		x.push_back(cx);
+		z.push_back(cz);
+		radius.push_back(cr);
+	}
+
+	int size() const
+	{
+		return (int)x.size();
+	}
+};
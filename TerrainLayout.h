@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include "Maths.h"
+#include "GrassInstance.h"
+#include "Simulation.h"
+
+// Where a tile's drawn-only content goes: the road and verge strips, the decorations and the grass clumps.
+// TerrainTile draws from these, the headless benchmarks lay out the same scene without a device
+
+const int TERRAIN_GRASS_TYPES = 5;
+const int TERRAIN_GRASS_PER_TILE = 31 * 13 + 6 * 13; // 31 columns right of the road and 6 left, 13 clumps each
+
+inline Matrix terrainRoadMatrix(const TrackTile& tile)
+{
+	return Matrix::fromTS(tile.position + Vec3(0, -0.8f, 0), Vec3(0.07f, 0.01f, 0.04f));
+}
+
+// side 0 is the verge right of the road (-X), 1 the one left of it
+inline Matrix terrainVergeMatrix(const TrackTile& tile, int side)
+{
+	if (side == 0)
+	{
+		return Matrix::fromTS(tile.position + Vec3(-29.9f, -0.7f, 0), Vec3(0.03f, 0.01f, 0.06f));
+	}
+	return Matrix::fromTS(tile.position + Vec3(20.0f, -0.7f, 0), Vec3(0.02f, 0.01f, 0.06f));
+}
+
+inline Matrix terrainDecorationMatrix(const TrackTile::Decoration& dec)
+{
+	return Matrix::fromYawTRS(dec.position, dec.rotationY, Vec3(dec.scale, dec.scale, dec.scale));
+}
+
+// Grass clumps on a 5 x 10 grid with a random offset and type each, from the tile's own grass stream, so the
+// same seed and tile index always give the same grass
+inline void generateTerrainGrass(const TrackTile& tile, std::vector<GrassInstance>& instances)
+{
+	instances.clear();
+	RandomStream rng = tile.random(TRACK_RANDOM_GRASS);
+	auto addGrass = [&](float xBase, float zBase)
+		{
+			float offsetX = rng.range(-4.0f, 4.0f);
+			float offsetZ = rng.range(-4.0f, 4.0f);
+			int type = rng.below(TERRAIN_GRASS_TYPES);
+			Vec3 position = tile.position + Vec3(xBase + offsetX, 0.0f, zBase + offsetZ);
+			instances.push_back(packGrassInstance(position, 5.0f, 0.0f, type));
+		};
+
+	// Right of the road
+	for (int x = -30; x <= 0; x++)
+	{
+		for (int z = -6; z <= 6; z++)
+		{
+			addGrass(x * 5.0f - 17.0f, z * 10.0f);
+		}
+	}
+	// Left of the road
+	for (int x = 0; x <= 5; x++)
+	{
+		for (int z = -6; z <= 6; z++)
+		{
+			addGrass(x * 5.0f + 17.0f, z * 10.0f);
+		}
+	}
+}
@@ -2,9 +2,12 @@
 #include "Core.h"
 #include <string>
 #include <map>
+#include <vector>
 
+#include "AssetLoader.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "FrameStats.h"
 
 class Texture
 {
@@ -23,6 +26,15 @@ public:
 			printf("Failed to load texture: %s\n", filename.c_str());
 			return;
 		}
+		upload(core, data, width, height);
+		stbi_image_free(data);
+	}
+
+	// Create the GPU texture from already decoded RGBA8 pixels
+	void upload(Core* core, const unsigned char* data, int _width, int _height)
+	{
+		width = _width;
+		height = _height;
 
 		// Create texture resource
 		D3D12_HEAP_PROPERTIES heapProps = {};
@@ -44,7 +56,7 @@ public:
 			&heapProps,
 			D3D12_HEAP_FLAG_NONE,
 			&textureDesc,
-			D3D12_RESOURCE_STATE_COPY_DEST,
+			D3D12_RESOURCE_STATE_COMMON, // Promoted to COPY_DEST by the copy queue, then to PIXEL_SHADER_RESOURCE on first use
 			nullptr,
 			IID_PPV_ARGS(&textureResource)
 		);
@@ -68,10 +80,15 @@ public:
 		core->uploadResource(textureResource, uploadData, uploadSize, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, &footprint);
 
 		delete[] uploadData;
-		stbi_image_free(data);
 	}
 
 	void createSRV(Core* core, ID3D12DescriptorHeap* srvHeap, int index)
+	{
+		srvHandle = writeSRV(core, srvHeap, index);
+	}
+
+	// Write a view of this texture at index, also used to place it in a texture set
+	D3D12_GPU_DESCRIPTOR_HANDLE writeSRV(Core* core, ID3D12DescriptorHeap* srvHeap, int index)
 	{
 		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -85,8 +102,9 @@ public:
 
 		core->device->CreateShaderResourceView(textureResource, &srvDesc, cpuHandle);
 
-		srvHandle = srvHeap->GetGPUDescriptorHandleForHeapStart();
-		srvHandle.ptr += index * descriptorSize;
+		D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = srvHeap->GetGPUDescriptorHandleForHeapStart();
+		gpuHandle.ptr += index * descriptorSize;
+		return gpuHandle;
 	}
 
 	void cleanup()
@@ -111,11 +129,13 @@ public:
 	ID3D12DescriptorHeap* srvHeap;
 	int nextTextureIndex;
 	Core* core;
+	AssetPreloader* preloader; // Optional, textures decoded ahead of time are taken from here
 
 	void init(Core* _core, int maxTextures = 100)
 	{
 		core = _core;
 		nextTextureIndex = 0;
+		preloader = nullptr;
 
 		// Create SRV descriptor heap
 		D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
@@ -136,7 +156,24 @@ public:
 
 		// Load new texture
 		Texture* texture = new Texture();
-		texture->load(core, filename);
+		DecodedImage image;
+		if (preloader != nullptr && preloader->takeImage(filename, image))
+		{
+			if (image.pixels != nullptr)
+			{
+				texture->channels = image.channels;
+				texture->upload(core, image.pixels, image.width, image.height);
+				stbi_image_free(image.pixels);
+			}
+			else
+			{
+				printf("Failed to load texture: %s\n", filename.c_str());
+			}
+		}
+		else
+		{
+			texture->load(core, filename);
+		}
 		texture->createSRV(core, srvHeap, nextTextureIndex);
 		nextTextureIndex++;
 
@@ -144,6 +181,28 @@ public:
 		return texture;
 	}
 
+	// Consecutive views of up to Core::textureSetSize textures for the texture set table (t1..),
+	// unused entries repeat the last texture so every descriptor in the table is valid
+	D3D12_GPU_DESCRIPTOR_HANDLE createTextureSet(const std::vector<Texture*>& set)
+	{
+		D3D12_GPU_DESCRIPTOR_HANDLE first = {};
+		if (set.empty())
+		{
+			return first;
+		}
+		for (int i = 0; i < Core::textureSetSize; i++)
+		{
+			Texture* texture = set[i < set.size() ? i : set.size() - 1];
+			D3D12_GPU_DESCRIPTOR_HANDLE handle = texture->writeSRV(core, srvHeap, nextTextureIndex);
+			nextTextureIndex++;
+			if (i == 0)
+			{
+				first = handle;
+			}
+		}
+		return first;
+	}
+
 	Texture* get(std::string filename)
 	{
 		auto it = textures.find(filename);
@@ -158,6 +217,7 @@ public:
 	{
 		ID3D12DescriptorHeap* heaps[] = { srvHeap };
 		core->getCommandList()->SetDescriptorHeaps(1, heaps);
+		frameStats().current.rootBinds++;
 	}
 
 	void cleanup()
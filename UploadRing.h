@@ -0,0 +1,143 @@
+#pragma once
+
+#include <deque>
+
+// Suballocation and fence bookkeeping for a persistent staging buffer used as a ring.
+// Allocations are grouped into batches; closing a batch tags everything allocated since the
+// previous close with the fence value that will signal when the GPU has consumed it.
+// retire() hands the space of every batch whose fence has completed back to the ring.
+// No graphics API types are used here, the D3D side owns the buffer and the actual fence.
+class UploadRing
+{
+public:
+	UploadRing()
+	{
+		init(0);
+	}
+
+	void init(unsigned long long _capacity)
+	{
+		capacity = _capacity;
+		head = 0;
+		tail = 0;
+		usedBytes = 0;
+		openBytes = 0;
+		batches.clear();
+	}
+
+	// Reserve size bytes at the given alignment (a power of two). Returns false when the request does not fit
+	// until older batches retire, or never fits (size > capacity)
+	bool allocate(unsigned long long size, unsigned long long alignment, unsigned long long& offset)
+	{
+		if (size > capacity)
+		{
+			return false;
+		}
+		if (usedBytes == 0)
+		{
+			head = 0;
+			tail = 0;
+		}
+		unsigned long long aligned = (head + alignment - 1) & ~(alignment - 1);
+		if (usedBytes == 0 || head > tail)
+		{
+			// Free space is [head, capacity) followed by [0, tail)
+			if (aligned + size <= capacity)
+			{
+				take(aligned, size, offset);
+				return true;
+			}
+			if (size <= tail)
+			{
+				// Skip the end of the buffer and wrap to the start
+				openBytes += capacity - head;
+				usedBytes += capacity - head;
+				head = 0;
+				take(0, size, offset);
+				return true;
+			}
+			return false;
+		}
+		// head <= tail with live data: free space is [head, tail)
+		if (aligned + size <= tail)
+		{
+			take(aligned, size, offset);
+			return true;
+		}
+		return false;
+	}
+
+	// Everything allocated since the last close is in flight until fenceValue completes
+	void closeBatch(unsigned long long fenceValue)
+	{
+		if (openBytes == 0)
+		{
+			return;
+		}
+		Batch batch;
+		batch.fenceValue = fenceValue;
+		batch.end = head;
+		batch.bytes = openBytes;
+		batches.push_back(batch);
+		openBytes = 0;
+	}
+
+	void retire(unsigned long long completedFenceValue)
+	{
+		while (!batches.empty() && batches.front().fenceValue <= completedFenceValue)
+		{
+			tail = batches.front().end;
+			usedBytes -= batches.front().bytes;
+			batches.pop_front();
+		}
+	}
+
+	// Fence value that has to complete before the oldest batch frees its space, 0 if nothing is in flight
+	unsigned long long oldestFence() const
+	{
+		return batches.empty() ? 0 : batches.front().fenceValue;
+	}
+
+	unsigned long long used() const
+	{
+		return usedBytes;
+	}
+
+	unsigned long long size() const
+	{
+		return capacity;
+	}
+
+	bool hasOpenBatch() const
+	{
+		return openBytes > 0;
+	}
+
+	int batchesInFlight() const
+	{
+		return (int)batches.size();
+	}
+
+private:
+	struct Batch
+	{
+		unsigned long long fenceValue;
+		unsigned long long end;
+		unsigned long long bytes;
+	};
+	unsigned long long capacity;
+	unsigned long long head;
+	unsigned long long tail;
+	unsigned long long usedBytes;
+	unsigned long long openBytes;
+	std::deque<Batch> batches;
+
+	void take(unsigned long long aligned, unsigned long long size, unsigned long long& offset)
+	{
+		unsigned long long consumed = (aligned - head) + size;
+		openBytes += consumed;
+		usedBytes += consumed;
+		offset = aligned;
+		head = aligned + size;
+	}
+};
@@ -0,0 +1,199 @@
+#include "Bench.h"
+#include "Animation.h"
+#include "GEMLoader.h"
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+// Key frame sampling on the Farmer-male.gem clips: the contiguous [frame * bones + bone] tracks of
+// AnimationSequence against the per-frame vectors they replaced (kept here as LegacySequence), and the heap
+// allocations each layout needs to hold the clips
+
+static long long allocations = 0;
+
+void* operator new(size_t size)
+{
+	allocations++;
+	void* p = malloc(size > 0 ? size : 1);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// The layout before the tracks: three vectors per key frame, filled a key at a time as AnimatedModel::load did
+struct LegacyFrame
+{
+	std::vector<Vec3> positions;
+	std::vector<Quaternion> rotations;
+	std::vector<Vec3> scales;
+};
+
+struct LegacySequence
+{
+	std::vector<LegacyFrame> frames;
+	float ticksPerSecond;
+	int nextFrame(int frame) const
+	{
+		return frame + 1 < (int)frames.size() ? frame + 1 : (int)frames.size() - 1;
+	}
+	void sampleLocal(int baseFrame, float interpolationFact, int boneIndex, Vec3& translation, Quaternion& rotation, Vec3& scale) const
+	{
+		const LegacyFrame& f0 = frames[baseFrame];
+		const LegacyFrame& f1 = frames[nextFrame(baseFrame)];
+		scale = (f0.scales[boneIndex] * (1.0f - interpolationFact)) + (f1.scales[boneIndex] * interpolationFact);
+		rotation = Quaternion::slerp(f0.rotations[boneIndex], f1.rotations[boneIndex], interpolationFact);
+		translation = (f0.positions[boneIndex] * (1.0f - interpolationFact)) + (f1.positions[boneIndex] * interpolationFact);
+	}
+};
+
+static void loadLegacy(const GEMLoader::GEMAnimationSequence& src, LegacySequence& clip)
+{
+	clip.ticksPerSecond = src.ticksPerSecond;
+	clip.frames.resize(src.frames.size());
+	for (int j = 0; j < (int)src.frames.size(); j++)
+	{
+		const GEMLoader::GEMAnimationFrame& frame = src.frames[j];
+		for (int b = 0; b < (int)frame.positions.size(); b++)
+		{
+			clip.frames[j].positions.push_back(Vec3(frame.positions[b].x, frame.positions[b].y, frame.positions[b].z));
+			clip.frames[j].rotations.push_back(Quaternion(frame.rotations[b].q[0], frame.rotations[b].q[1], frame.rotations[b].q[2], frame.rotations[b].q[3]));
+			clip.frames[j].scales.push_back(Vec3(frame.scales[b].x, frame.scales[b].y, frame.scales[b].z));
+		}
+	}
+}
+
+// Three tracks sized once, as CookedModel::fillAnimation fills them from the cooked blob
+static void loadTracks(const GEMLoader::GEMAnimationSequence& src, int bones, AnimationSequence& clip)
+{
+	clip.ticksPerSecond = src.ticksPerSecond;
+	clip.init((int)src.frames.size(), bones);
+	for (int j = 0; j < (int)src.frames.size(); j++)
+	{
+		const GEMLoader::GEMAnimationFrame& frame = src.frames[j];
+		for (int b = 0; b < bones; b++)
+		{
+			int k = clip.key(j, b);
+			clip.positions[k] = Vec3(frame.positions[b].x, frame.positions[b].y, frame.positions[b].z);
+			clip.rotations[k] = Quaternion(frame.rotations[b].q[0], frame.rotations[b].q[1], frame.rotations[b].q[2], frame.rotations[b].q[3]);
+			clip.scales[k] = Vec3(frame.scales[b].x, frame.scales[b].y, frame.scales[b].z);
+		}
+	}
+}
+
+// Every bone at 60 Hz steps through the whole clip
+template<typename Clip>
+static float sampleClip(const Clip& clip, int frames, int bones, float ticksPerSecond, long long& samples)
+{
+	float sum = 0;
+	int steps = (int)((float)frames / ticksPerSecond * 60.0f);
+	for (int s = 0; s < steps; s++)
+	{
+		float ticks = ((float)s / 60.0f) * ticksPerSecond;
+		int frame = (int)floorf(ticks);
+		frame = frame < frames - 1 ? frame : frames - 1;
+		float fact = ticks - (float)frame;
+		for (int b = 0; b < bones; b++)
+		{
+			Vec3 translation, scale;
+			Quaternion rotation;
+			const_cast<Clip&>(clip).sampleLocal(frame, fact, b, translation, rotation, scale);
+			sum += translation.x + rotation.a + scale.y;
+		}
+		samples += bones;
+	}
+	return sum;
+}
+
+int main()
+{
+	std::vector<GEMLoader::GEMMesh> meshes;
+	GEMLoader::GEMAnimation gem;
+	GEMLoader::GEMModelLoader loader;
+	loader.load("Models/Farmer-male.gem", meshes, gem);
+	int bones = (int)gem.bones.size();
+	int clipCount = (int)gem.animations.size();
+	int frames = 0;
+	for (int i = 0; i < clipCount; i++)
+	{
+		frames += (int)gem.animations[i].frames.size();
+	}
+
+	long long before = allocations;
+	std::vector<LegacySequence> legacy(clipCount);
+	for (int i = 0; i < clipCount; i++)
+	{
+		loadLegacy(gem.animations[i], legacy[i]);
+	}
+	long long legacyAllocations = allocations - before;
+	long long legacyBlocks = 0;
+	for (int i = 0; i < clipCount; i++)
+	{
+		legacyBlocks += 1 + (3 * (long long)legacy[i].frames.size());
+	}
+
+	// AlignedArray takes its blocks from malloc, which the counter does not see, so they are added per track
+	before = allocations;
+	std::vector<AnimationSequence> tracks(clipCount);
+	for (int i = 0; i < clipCount; i++)
+	{
+		loadTracks(gem.animations[i], bones, tracks[i]);
+	}
+	long long trackAllocations = allocations - before;
+	long long trackBlocks = 0;
+	for (int i = 0; i < clipCount; i++)
+	{
+		trackBlocks += (tracks[i].positions.data != nullptr ? 1 : 0) + (tracks[i].rotations.data != nullptr ? 1 : 0) + (tracks[i].scales.data != nullptr ? 1 : 0);
+	}
+	trackAllocations += trackBlocks;
+
+	printf("Farmer-male.gem: %d clips, %d key frames, %d bones\n", clipCount, frames, bones);
+	printf("  heap allocations while loading: per-frame vectors %lld, tracks %lld\n", legacyAllocations, trackAllocations);
+	printf("  heap blocks held afterwards:    per-frame vectors %lld, tracks %lld\n", legacyBlocks, trackBlocks);
+
+	// The same results from both layouts before timing them
+	long long samples = 0;
+	float legacySum = 0;
+	float trackSum = 0;
+	for (int i = 0; i < clipCount; i++)
+	{
+		legacySum += sampleClip(legacy[i], (int)legacy[i].frames.size(), bones, legacy[i].ticksPerSecond, samples);
+		trackSum += sampleClip(tracks[i], tracks[i].framesN, bones, tracks[i].ticksPerSecond, samples);
+	}
+	samples /= 2;
+
+	float sum = 0;
+	long long counted = 0;
+	double legacyNs = benchNs(20, samples, [&]()
+		{
+			for (int i = 0; i < clipCount; i++)
+			{
+				sum += sampleClip(legacy[i], (int)legacy[i].frames.size(), bones, legacy[i].ticksPerSecond, counted);
+			}
+			benchKeep(sum);
+		});
+	double trackNs = benchNs(20, samples, [&]()
+		{
+			for (int i = 0; i < clipCount; i++)
+			{
+				sum += sampleClip(tracks[i], tracks[i].framesN, bones, tracks[i].ticksPerSecond, counted);
+			}
+			benchKeep(sum);
+		});
+	printf("  sampling every bone at 60 Hz through every clip, %lld samples (best of 20)\n", samples);
+	printf("  per-frame vectors %6.2f ns per bone\n", legacyNs);
+	printf("  tracks            %6.2f ns per bone  %.2fx%s\n", trackNs, legacyNs / trackNs, legacySum == trackSum ? "" : "  (results differ)");
+	return 0;
+}
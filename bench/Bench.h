@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdio>
+#include <chrono>
+
+// Timing helpers for the benchmarks. Each one is a console program built by CMakeLists.txt next to the tests
+// but not run by ctest: numbers depend on the machine, run them by hand from the repository root
+
+// Keeps the compiler from dropping work whose result is otherwise unused
+template<typename T>
+inline void benchKeep(const T& value)
+{
+	volatile const char* bytes = reinterpret_cast<volatile const char*>(&value);
+	(void)bytes[0];
+}
+
+// Best of rounds runs of body(), in nanoseconds per item when one run handles items items
+template<typename Body>
+inline double benchNs(int rounds, long long items, Body body)
+{
+	double best = 1e300;
+	for (int r = 0; r < rounds; r++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		body();
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+		best = ns < best ? ns : best;
+	}
+	return best / (double)items;
+}
@@ -0,0 +1,270 @@
+#include "Bench.h"
+#include "ConstantLayout.h"
+#include "Maths.h"
+#include <string>
+#include <vector>
+
+// CPU cost of the constant updates of one draw: the string path Shaders::updateConstantVS/PS had (shader map
+// lookup, cbuffer name scan, variable map lookup, all names by value) against handles resolved once, as
+// Shader::updateConstant and ConstantBuffer::write do them. Shaders.h needs D3D, so both run here over the
+// recorded layouts of the lit shaders at the time, in plain memory instead of an upload heap
+
+// A cbuffer's slots in plain memory, one slot per draw like ConstantBuffer
+struct BenchConstantBuffer
+{
+	ConstantBufferLayout layout;
+	std::vector<unsigned char> memory;
+	unsigned int cbSizeInBytes;
+	unsigned int slots;
+	unsigned int offsetIndex;
+
+	void init(const ConstantBufferLayout& _layout, unsigned int _slots)
+	{
+		layout = _layout;
+		cbSizeInBytes = (layout.sizeInBytes + 255) & ~255;
+		slots = _slots;
+		offsetIndex = 0;
+		memory.resize((size_t)cbSizeInBytes * slots);
+	}
+	// ConstantBuffer::update before handles: the variable looked up by name on every call
+	void update(std::string name, void* data)
+	{
+		ConstantBufferVariable cbVariable = layout.variables[name];
+		memcpy(&memory[(offsetIndex * cbSizeInBytes) + cbVariable.offset], data, cbVariable.size);
+	}
+	void write(unsigned int variableOffset, const void* data, unsigned int size)
+	{
+		if (variableOffset + size > cbSizeInBytes)
+		{
+			return;
+		}
+		memcpy(&memory[(offsetIndex * cbSizeInBytes) + variableOffset], data, size);
+	}
+	void next()
+	{
+		offsetIndex = offsetIndex + 1 < slots ? offsetIndex + 1 : 0;
+	}
+};
+
+struct BenchShader;
+
+struct BenchHandle
+{
+	BenchShader* shader;
+	bool pixelStage;
+	int bufferIndex;
+	unsigned int offset;
+	unsigned int size;
+};
+
+struct BenchShader
+{
+	std::vector<BenchConstantBuffer> vsConstantBuffers;
+	std::vector<BenchConstantBuffer> psConstantBuffers;
+
+	void load(const std::string& vsRecord, const std::string& psRecord)
+	{
+		std::vector<ConstantBufferLayout> layouts;
+		readConstantLayouts(vsRecord, layouts);
+		vsConstantBuffers.resize(layouts.size());
+		for (int i = 0; i < (int)layouts.size(); i++)
+		{
+			vsConstantBuffers[i].init(layouts[i], 1024);
+		}
+		readConstantLayouts(psRecord, layouts);
+		psConstantBuffers.resize(layouts.size());
+		for (int i = 0; i < (int)layouts.size(); i++)
+		{
+			psConstantBuffers[i].init(layouts[i], 1024);
+		}
+	}
+	void updateConstant(std::string constantBufferName, std::string variableName, void* data, std::vector<BenchConstantBuffer>& buffers)
+	{
+		for (int i = 0; i < (int)buffers.size(); i++)
+		{
+			if (buffers[i].layout.name == constantBufferName)
+			{
+				buffers[i].update(variableName, data);
+				return;
+			}
+		}
+	}
+	BenchHandle find(bool pixelStage, const std::string& constantBufferName, const std::string& variableName)
+	{
+		std::vector<BenchConstantBuffer>& buffers = pixelStage ? psConstantBuffers : vsConstantBuffers;
+		std::vector<ConstantBufferLayout> layouts;
+		for (int i = 0; i < (int)buffers.size(); i++)
+		{
+			layouts.push_back(buffers[i].layout);
+		}
+		ConstantLocation location;
+		resolveConstantLocation(layouts, constantBufferName, variableName, location);
+		BenchHandle handle;
+		handle.shader = this;
+		handle.pixelStage = pixelStage;
+		handle.bufferIndex = location.bufferIndex;
+		handle.offset = location.offset;
+		handle.size = location.size;
+		return handle;
+	}
+	void updateConstant(const BenchHandle& handle, const void* data)
+	{
+		std::vector<BenchConstantBuffer>& buffers = handle.pixelStage ? psConstantBuffers : vsConstantBuffers;
+		if (handle.bufferIndex < 0 || handle.bufferIndex >= (int)buffers.size())
+		{
+			return;
+		}
+		buffers[handle.bufferIndex].write(handle.offset, data, handle.size);
+	}
+	void next()
+	{
+		for (int i = 0; i < (int)vsConstantBuffers.size(); i++)
+		{
+			vsConstantBuffers[i].next();
+		}
+		for (int i = 0; i < (int)psConstantBuffers.size(); i++)
+		{
+			psConstantBuffers[i].next();
+		}
+	}
+};
+
+struct BenchShaders
+{
+	std::map<std::string, BenchShader> shaders;
+	void updateConstantVS(std::string name, std::string constantBufferName, std::string variableName, void* data)
+	{
+		shaders[name].updateConstant(constantBufferName, variableName, data, shaders[name].vsConstantBuffers);
+	}
+	void updateConstantPS(std::string name, std::string constantBufferName, std::string variableName, void* data)
+	{
+		shaders[name].updateConstant(constantBufferName, variableName, data, shaders[name].psConstantBuffers);
+	}
+};
+
+// What one lit draw wrote, and the handles the draw keeps instead
+struct DrawConstants
+{
+	Matrix w;
+	Matrix vp;
+	Matrix bones[256];
+	Vec3 lightDirection;
+	float lightIntensity;
+	Vec3 lightColor;
+	float ambientStrength;
+};
+
+struct LitHandles
+{
+	BenchHandle w, vp, bones, lightDirection, lightIntensity, lightColor, ambientStrength;
+};
+
+// Resolving a name the shader does not have (bones on the static one) leaves a handle that writes nothing
+static LitHandles resolve(BenchShaders& shaders, const std::string& name)
+{
+	BenchShader& shader = shaders.shaders[name];
+	LitHandles handles;
+	handles.w = shader.find(false, "staticMeshBuffer", "W");
+	handles.vp = shader.find(false, "staticMeshBuffer", "VP");
+	handles.bones = shader.find(false, "staticMeshBuffer", "bones");
+	handles.lightDirection = shader.find(true, "LightBuffer", "lightDirection");
+	handles.lightIntensity = shader.find(true, "LightBuffer", "lightIntensity");
+	handles.lightColor = shader.find(true, "LightBuffer", "lightColor");
+	handles.ambientStrength = shader.find(true, "LightBuffer", "ambientStrength");
+	return handles;
+}
+
+static void drawByName(BenchShaders& shaders, const std::string& shaderName, bool animated, DrawConstants& c)
+{
+	shaders.updateConstantVS(shaderName, "staticMeshBuffer", "W", &c.w);
+	shaders.updateConstantVS(shaderName, "staticMeshBuffer", "VP", &c.vp);
+	if (animated)
+	{
+		shaders.updateConstantVS(shaderName, "staticMeshBuffer", "bones", c.bones);
+	}
+	shaders.updateConstantPS(shaderName, "LightBuffer", "lightDirection", &c.lightDirection);
+	shaders.updateConstantPS(shaderName, "LightBuffer", "lightIntensity", &c.lightIntensity);
+	shaders.updateConstantPS(shaderName, "LightBuffer", "lightColor", &c.lightColor);
+	shaders.updateConstantPS(shaderName, "LightBuffer", "ambientStrength", &c.ambientStrength);
+	shaders.shaders[shaderName].next();
+}
+
+static void drawByHandle(const LitHandles& h, bool animated, const DrawConstants& c)
+{
+	BenchShader* shader = h.w.shader;
+	shader->updateConstant(h.w, &c.w);
+	shader->updateConstant(h.vp, &c.vp);
+	if (animated)
+	{
+		shader->updateConstant(h.bones, c.bones);
+	}
+	shader->updateConstant(h.lightDirection, &c.lightDirection);
+	shader->updateConstant(h.lightIntensity, &c.lightIntensity);
+	shader->updateConstant(h.lightColor, &c.lightColor);
+	shader->updateConstant(h.ambientStrength, &c.ambientStrength);
+	shader->next();
+}
+
+static DrawConstants constants;
+
+int main()
+{
+	// The lit shaders' reflection when handles went in, as writeConstantLayouts records it
+	const std::string staticVS = "cbuffer staticMeshBuffer 2\nW 0 64\nVP 64 64\n";
+	const std::string animatedVS = "cbuffer staticMeshBuffer 3\nW 0 64\nVP 64 64\nbones 128 16384\n";
+	const std::string litPS = "cbuffer LightBuffer 4\nlightDirection 0 12\nlightIntensity 12 4\nlightColor 16 12\nambientStrength 28 4\n";
+	const std::string unlitPS = "cbuffer materialBuffer 1\nparams 0 16\n";
+
+	// The shader map holds the game's other shaders too, as Shaders did
+	BenchShaders shaders;
+	const char* others[] = { "StaticModel", "AnimatedModel", "Grass", "GrassInstanced", "SkyEmissive", "StaticModelUntextured", "StaticInstanced" };
+	for (int i = 0; i < (int)(sizeof(others) / sizeof(others[0])); i++)
+	{
+		shaders.shaders[others[i]].load(staticVS, unlitPS);
+	}
+	shaders.shaders["StaticModelLit"].load(staticVS, litPS);
+	shaders.shaders["AnimatedModelLit"].load(animatedVS, litPS);
+	LitHandles staticHandles = resolve(shaders, "StaticModelLit");
+	LitHandles animatedHandles = resolve(shaders, "AnimatedModelLit");
+
+	const int draws = 4096;
+	printf("Constant updates per lit draw, ns (best of 50 passes over %d draws)\n", draws);
+	printf("  %-22s %10s %10s %8s\n", "draw", "by name", "handles", "speedup");
+	const char* names[2] = { "static, 6 constants", "animated, 7 constants" };
+	const char* shaderNames[2] = { "StaticModelLit", "AnimatedModelLit" };
+	const LitHandles* handles[2] = { &staticHandles, &animatedHandles };
+	for (int a = 0; a < 2; a++)
+	{
+		bool animated = a == 1;
+		std::string shaderName = shaderNames[a];
+		double byName = benchNs(50, draws, [&]()
+			{
+				for (int d = 0; d < draws; d++)
+				{
+					constants.lightIntensity = (float)d;
+					drawByName(shaders, shaderName, animated, constants);
+				}
+			});
+		double byHandle = benchNs(50, draws, [&]()
+			{
+				for (int d = 0; d < draws; d++)
+				{
+					constants.lightIntensity = (float)d;
+					drawByHandle(*handles[a], animated, constants);
+				}
+			});
+		printf("  %-22s %10.1f %10.1f %7.1fx\n", names[a], byName, byHandle, byName / byHandle);
+	}
+	// The bone palette alone, the floor for an animated draw whichever way it is addressed
+	BenchConstantBuffer& palette = shaders.shaders["AnimatedModelLit"].vsConstantBuffers[0];
+	double copy = benchNs(50, draws, [&]()
+		{
+			for (int d = 0; d < draws; d++)
+			{
+				palette.write(128, constants.bones, sizeof(constants.bones));
+				palette.next();
+			}
+		});
+	printf("  %-22s %10s %10.1f\n", "16 KB bone palette", "", copy);
+	return 0;
+}
@@ -0,0 +1,349 @@
+#include "Bench.h"
+#include "Simulation.h"
+#include "ModelCache.h"
+#include "TerrainLayout.h"
+#include "GrassCuller.h"
+#include "Frustum.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// View frustum culling along a run: the headless simulation drives the player down the track while the
+// terrain's objects and grass are culled the way TerrainManager does it, tile boxes first, then each object
+// and grass clump of the visible tiles. Prints culled against drawn per camera and the cost of the cull
+//
+//   CullingBench [--frames n] [--models folder] [--level file]
+
+// Object space bounds of a model as StaticModel and AnimatedModel compute them from their meshes
+struct ModelBounds
+{
+	BoundingBox box;
+	BoundingSphere sphere;
+};
+
+static bool loadBounds(const std::string& filename, ModelBounds& bounds)
+{
+	CookedModel model;
+	if (!model.load(filename))
+	{
+		return false;
+	}
+	std::vector<BoundingBox> boxes(model.meshes.size());
+	std::vector<BoundingSphere> spheres(model.meshes.size());
+	for (int i = 0; i < (int)model.meshes.size(); i++)
+	{
+		const CookedMeshView& mesh = model.meshes[i];
+		const unsigned char* vertex = reinterpret_cast<const unsigned char*>(mesh.vertices);
+		for (unsigned int v = 0; v < mesh.vertexCount; v++)
+		{
+			boxes[i].extend(*reinterpret_cast<const Vec3*>(vertex + (size_t)v * mesh.vertexStride));
+		}
+		spheres[i].fromPoints(boxes[i], reinterpret_cast<const Vec3*>(mesh.vertices), (int)mesh.vertexCount, (int)mesh.vertexStride);
+		bounds.box.extend(boxes[i]);
+	}
+	bounds.sphere.center = bounds.box.valid() ? bounds.box.center() : Vec3(0, 0, 0);
+	bounds.sphere.radius = 0;
+	for (int i = 0; i < (int)spheres.size(); i++)
+	{
+		bounds.sphere.enclose(spheres[i]);
+	}
+	return true;
+}
+
+static bool loadAnimation(const std::string& filename, Animation& animation)
+{
+	CookedModel model;
+	if (!model.load(filename) || !model.animated)
+	{
+		printf("ERROR: %s has no animation\n", filename.c_str());
+		return false;
+	}
+	model.fillAnimation(animation);
+	return true;
+}
+
+// What TerrainManager keeps per tile, rebuilt when the track recycles the tile
+struct TileScene
+{
+	long long index;
+	std::vector<BoundingBox> objects; // Road, verges and decorations in world space
+	std::vector<GrassInstance> grass;
+	GrassSpheres grassSpheres;
+	BoundingBox bounds;
+
+	TileScene()
+	{
+		index = -1;
+	}
+};
+
+class TerrainScene
+{
+public:
+	ModelBounds road;
+	ModelBounds verge;
+	ModelBounds decoration;
+	ModelBounds obstacle;
+	BoundingSphere clump;
+
+	void update(Track& track)
+	{
+		if (tiles.size() < track.tiles.size())
+		{
+			tiles.resize(track.tiles.size());
+		}
+		for (auto tile : track.tiles)
+		{
+			TileScene& scene = tiles[tile->id];
+			if (scene.index != tile->index)
+			{
+				rebuild(*tile, scene);
+			}
+		}
+	}
+
+	// Same order as TerrainManager::updateTileBounds: static models, grass spheres, obstacle spheres
+	void rebuild(const TrackTile& tile, TileScene& scene)
+	{
+		scene.index = tile.index;
+		scene.objects.clear();
+		scene.objects.push_back(road.box.transformed(terrainRoadMatrix(tile)));
+		scene.objects.push_back(verge.box.transformed(terrainVergeMatrix(tile, 0)));
+		scene.objects.push_back(verge.box.transformed(terrainVergeMatrix(tile, 1)));
+		for (auto& dec : tile.decorations)
+		{
+			scene.objects.push_back(decoration.box.transformed(terrainDecorationMatrix(dec)));
+		}
+		generateTerrainGrass(tile, scene.grass);
+		scene.grassSpheres.build(scene.grass, clump, 0.5f);
+
+		BoundingBox box;
+		for (auto& object : scene.objects)
+		{
+			box.extend(object);
+		}
+		const GrassSpheres& spheres = scene.grassSpheres;
+		for (int i = 0; i < (int)spheres.x.size(); i++)
+		{
+			Vec3 r(spheres.radius[i], spheres.radius[i], spheres.radius[i]);
+			box.extend(Vec3(spheres.x[i], spheres.y[i], spheres.z[i]) - r);
+			box.extend(Vec3(spheres.x[i], spheres.y[i], spheres.z[i]) + r);
+		}
+		for (auto& obs : tile.obstacles)
+		{
+			BoundingSphere sphere = obstacleSphere(obs);
+			Vec3 r(sphere.radius, sphere.radius, sphere.radius);
+			box.extend(sphere.center - r);
+			box.extend(sphere.center + r);
+		}
+		scene.bounds = box;
+	}
+
+	BoundingSphere obstacleSphere(const TrackObstacle& obs) const
+	{
+		return obstacle.sphere.transformed(Matrix::fromYawTRS(obs.position, obs.rotationY, obs.scale));
+	}
+
+	TileScene& at(const TrackTile& tile)
+	{
+		return tiles[tile.id];
+	}
+
+private:
+	std::vector<TileScene> tiles; // By TrackTile::id
+};
+
+// One camera's totals over the run
+struct CullTotals
+{
+	const char* name;
+	long long tiles;
+	long long tilesDrawn;
+	long long objects;
+	long long objectsDrawn;
+	long long grass;
+	long long grassDrawn;
+	double cullMs;
+
+	CullTotals(const char* _name)
+	{
+		name = _name;
+		tiles = 0;
+		tilesDrawn = 0;
+		objects = 0;
+		objectsDrawn = 0;
+		grass = 0;
+		grassDrawn = 0;
+		cullMs = 0.0;
+	}
+
+	void print(int frames) const
+	{
+		printf("  %-13s %5.1f /%5.1f %7.1f /%7.1f %5.1f%% %8.0f /%8.0f %5.1f%% %9.1f\n", name,
+			(double)tilesDrawn / frames, (double)tiles / frames,
+			(double)objectsDrawn / frames, (double)objects / frames, 100.0 * (1.0 - (double)objectsDrawn / objects),
+			(double)grassDrawn / frames, (double)grass / frames, 100.0 * (1.0 - (double)grassDrawn / grass),
+			cullMs * 1000.0 / frames);
+	}
+};
+
+// The frame's culling as TerrainManager::drawLit does it: tile boxes, then the objects of the visible tiles
+// (road, verges and decorations by box, obstacles by sphere), then their grass through GrassCuller
+class CullPass
+{
+public:
+	CullPass()
+	{
+		grassCuller.init(nullptr);
+	}
+
+	void run(Track& track, TerrainScene& scene, const Frustum& frustum, const Vec3& eye, float grassDistance, CullTotals& totals)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		tileCull.clear();
+		for (auto tile : track.tiles)
+		{
+			tileCull.add(scene.at(*tile).bounds);
+		}
+		int tilesDrawn = tileCull.cull(frustum);
+
+		objectCull.clear();
+		grassCuller.clear();
+		int obstaclesDrawn = 0;
+		int obstacles = 0;
+		int objects = 0;
+		int grass = 0;
+		for (int t = 0; t < (int)track.tiles.size(); t++)
+		{
+			TileScene& tileScene = scene.at(*track.tiles[t]);
+			objects += (int)tileScene.objects.size();
+			grass += (int)tileScene.grass.size();
+			obstacles += (int)track.tiles[t]->obstacles.size();
+			if (!tileCull.isVisible(t))
+			{
+				continue;
+			}
+			for (auto& box : tileScene.objects)
+			{
+				objectCull.add(box);
+			}
+			for (auto& obs : track.tiles[t]->obstacles)
+			{
+				BoundingSphere sphere = scene.obstacleSphere(obs);
+				obstaclesDrawn += frustum.sphereVisible(sphere.center, sphere.radius) ? 1 : 0;
+			}
+			grassCuller.addTile(tileScene.grass, tileScene.grassSpheres);
+		}
+		int objectsDrawn = objectCull.cull(frustum);
+		unsigned int grassDrawn = grassCuller.cull(frustum, eye, grassDistance);
+		totals.cullMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		totals.tiles += track.tiles.size();
+		totals.tilesDrawn += tilesDrawn;
+		totals.objects += objects + obstacles;
+		totals.objectsDrawn += objectsDrawn + obstaclesDrawn;
+		totals.grass += grass;
+		totals.grassDrawn += grassDrawn;
+	}
+
+private:
+	BoxCullBatch tileCull;
+	BoxCullBatch objectCull;
+	GrassCuller grassCuller;
+};
+
+int main(int argc, char** argv)
+{
+	int frames = 3600;
+	std::string models = "Models";
+	std::string level = "level.txt";
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--frames") == 0) frames = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--models") == 0) models = argv[i + 1];
+		else if (strcmp(argv[i], "--level") == 0) level = argv[i + 1];
+		else
+		{
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	// Models and start as in Game.cpp
+	TerrainScene scene;
+	Animation duck;
+	Animation farmerAnimation;
+	Animation sheep;
+	if (!loadBounds(models + "/road_009.gem", scene.road) || !loadBounds(models + "/ground_005.gem", scene.verge) ||
+		!loadBounds(models + "/acacia_003.gem", scene.decoration) || !loadBounds(models + "/Sheep-01.gem", scene.obstacle) ||
+		!loadAnimation(models + "/Duck-white.gem", duck) || !loadAnimation(models + "/Farmer-male.gem", farmerAnimation) ||
+		!loadAnimation(models + "/Sheep-01.gem", sheep))
+	{
+		return 1;
+	}
+	// GrassPatch's two crossed quads, 1 wide and 1 high
+	BoundingBox clumpBox;
+	Vec3 clumpPoints[8] = { Vec3(-0.5f, 0, 0), Vec3(0.5f, 0, 0), Vec3(-0.5f, 1, 0), Vec3(0.5f, 1, 0),
+		Vec3(0, 0, -0.5f), Vec3(0, 0, 0.5f), Vec3(0, 1, -0.5f), Vec3(0, 1, 0.5f) };
+	for (int i = 0; i < 8; i++)
+	{
+		clumpBox.extend(clumpPoints[i]);
+	}
+	scene.clump.fromPoints(clumpBox, clumpPoints, 8, sizeof(Vec3));
+
+	Runner player;
+	player.init(&duck, Vec3(0, 0, -2), Vec3(0.1f, 0.1f, 0.1f));
+	player.setSpeed(10.0f);
+	Runner farmer;
+	farmer.init(&farmerAnimation, Vec3(0, 0, 15), Vec3(0.1f, 0.1f, 0.1f));
+	farmer.playAnimation("run", 0.0f);
+	farmer.setRotation(0, -3.14f / 2.0f);
+	farmer.setSpeed(10.0f);
+	GameSimulation simulation;
+	simulation.verbose = false;
+	simulation.collisionsToLose = 0;
+	simulation.init(&player, &farmer, &sheep, level);
+
+	// CameraManager's defaults: 60 degrees, 16:9, 0.1 to 1000, and TerrainManager's grass distance
+	Matrix projection = Matrix::perspective(0.1f, 1000.0f, 1920.0f / 1080.0f, 60.0f);
+	const float grassDistance = 300.0f;
+	CullTotals thirdPerson("third person");
+	CullTotals firstPerson("first person");
+	CullTotals fixed("static");
+	CullPass pass;
+	const float frameDt = 1.0f / 60.0f;
+	for (int f = 0; f < frames; f++)
+	{
+		// Weave across the lanes every two seconds
+		RunnerInput input;
+		int phase = (f / 120) % 4;
+		input.left = phase == 0;
+		input.right = phase == 2;
+		simulation.update(frameDt, input);
+		scene.update(simulation.track);
+
+		Vec3 at = player.renderPosition;
+		Frustum frustum;
+		Vec3 eye = at + Vec3(13.0f, 6.0f, 20.0f);
+		frustum.fromViewProjection(Matrix::lookAt(eye, at + Vec3(3, 10, 5), Vec3(0, 1, 0)) * projection);
+		pass.run(simulation.track, scene, frustum, eye, grassDistance, thirdPerson);
+
+		Vec3 forward(-sinf(player.rotationY), 0.0f, -cosf(player.rotationY));
+		eye = at + Vec3(0, 4.0f, 0) + forward * 4.8f;
+		frustum.fromViewProjection(Matrix::lookAt(eye, eye + forward, Vec3(0, 1, 0)) * projection);
+		pass.run(simulation.track, scene, frustum, eye, grassDistance, firstPerson);
+
+		eye = Vec3(50, 50, 50);
+		frustum.fromViewProjection(Matrix::lookAt(eye, Vec3(0, 0, 0), Vec3(0, 1, 0)) * projection);
+		pass.run(simulation.track, scene, frustum, eye, grassDistance, fixed);
+	}
+
+	printf("Frustum culling over %d frames, %.0f units of track, %d tiles of %d grass clumps\n", frames, -(player.position.z + 2.0f),
+		simulation.track.tileCount(), TERRAIN_GRASS_PER_TILE);
+	printf("Per frame         tiles drawn  objects drawn  culled   grass drawn     culled  cull (us)\n");
+	thirdPerson.print(frames);
+	firstPerson.print(frames);
+	fixed.print(frames);
+	return 0;
+}
@@ -0,0 +1,207 @@
+#include "Bench.h"
+#include "Simulation.h"
+#include "ModelCache.h"
+#include "TerrainLayout.h"
+#include "FrameStats.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Draw calls and state changes of the terrain's static models for one frame of the level, every tile drawn:
+// one StaticModel::drawLit per road, verge and decoration as TerrainTile drew them before instancing, against
+// one StaticModel::drawLitInstanced per model over the lists TerrainTile::collectStaticInstances builds (the
+// same TerrainLayout.h matrices). The recorder below bumps FrameStats exactly where those functions and the
+// calls under them (bindHeap, Shader::apply, PSOManager::bind, Material::bind, Mesh::draw/drawInstanced) do,
+// with the meshes and textures of the game's models and the constant buffers their shaders declare
+//
+//   DrawCallBench [--models folder] [--level file]
+
+// What the draw functions need to know about a model to record its commands
+struct RecordedModel
+{
+	int meshes;
+	std::vector<bool> textured; // Per mesh, a diffuse texture that exists, as Material::loadFromGEMMaterial sets hasTexture
+	bool hasTextures;
+	int litConstantBuffers;     // Root CBVs Shader::apply binds for the lit and the lit instanced shader
+	int instancedConstantBuffers;
+};
+
+// cbuffer blocks of an HLSL source, less FrameConstants, which Shaders::load leaves to the per-frame block
+static int countConstantBuffers(const std::string& filename)
+{
+	std::ifstream file(filename);
+	std::stringstream text;
+	text << file.rdbuf();
+	std::string source = text.str();
+	int count = 0;
+	for (size_t at = source.find("cbuffer"); at != std::string::npos; at = source.find("cbuffer", at + 7))
+	{
+		count += source.compare(at, 22, "cbuffer FrameConstants") == 0 ? 0 : 1;
+	}
+	return count;
+}
+
+// Where Material looks for a texture, resolveModelTexturePath's rule. AssetLoader.h is not included here,
+// it brings the preloader and stb_image along with it
+static bool textureExists(const std::string& value, const std::string& folder)
+{
+	bool asGiven = value.find('/') == 0 || value.find('\\') == 0 || value.find("Models/") == 0 || value.find("Models\\") == 0;
+	std::ifstream file(asGiven ? value : folder + "/" + value);
+	return file.is_open();
+}
+
+static bool loadModel(const std::string& models, const std::string& name, RecordedModel& model)
+{
+	CookedModel cooked;
+	if (!cooked.load(models + "/" + name))
+	{
+		return false;
+	}
+	model.meshes = (int)cooked.meshes.size();
+	model.textured.assign(model.meshes, false);
+	model.hasTextures = false;
+	for (int i = 0; i < model.meshes; i++)
+	{
+		GEMLoader::GEMMaterialProperty albedo = cooked.meshes[i].material.find("albedo");
+		if (albedo.value.empty())
+		{
+			albedo = cooked.meshes[i].material.find("diffuse");
+		}
+		model.textured[i] = !albedo.value.empty() && textureExists(albedo.value, models + "/Textures");
+		model.hasTextures = model.hasTextures || model.textured[i];
+	}
+	// StaticModel::load's lit pair: VS.txt with PSLit.txt or PSLitUnTextured.txt, VSInstanced.txt with the same
+	std::string ps = model.hasTextures ? "PSLit.txt" : "PSLitUnTextured.txt";
+	model.litConstantBuffers = countConstantBuffers("VS.txt") + countConstantBuffers(ps);
+	model.instancedConstantBuffers = countConstantBuffers("VSInstanced.txt") + countConstantBuffers(ps);
+	return true;
+}
+
+// StaticModel::drawLit's commands, as FrameStats counts them
+static void recordDrawLit(const RecordedModel& model)
+{
+	FrameStats& stats = frameStats().current;
+	stats.rootBinds += model.hasTextures ? 1 : 0; // TextureManager::bindHeap
+	stats.rootBinds += model.litConstantBuffers;
+	stats.psoBinds++;
+	for (int i = 0; i < model.meshes; i++)
+	{
+		stats.rootBinds += model.textured[i] ? 1 : 0;
+		stats.inputBinds += 3;
+		stats.drawCalls++;
+		stats.instances++;
+	}
+}
+
+// StaticModel::drawLitInstanced's commands, nothing for an empty list
+static void recordDrawLitInstanced(const RecordedModel& model, int instanceCount)
+{
+	if (instanceCount == 0)
+	{
+		return;
+	}
+	FrameStats& stats = frameStats().current;
+	stats.rootBinds += model.hasTextures ? 1 : 0;
+	stats.rootBinds += model.instancedConstantBuffers;
+	stats.psoBinds++;
+	for (int i = 0; i < model.meshes; i++)
+	{
+		stats.rootBinds += model.textured[i] ? 1 : 0;
+		stats.inputBinds += 4;
+		stats.drawCalls++;
+		stats.instances += instanceCount;
+	}
+}
+
+// TerrainTile::collectStaticInstances without the device: world matrices only
+static void collectStaticInstances(const TrackTile& tile, std::vector<Matrix>& roads, std::vector<Matrix>& verges, std::vector<Matrix>& decorations)
+{
+	roads.push_back(terrainRoadMatrix(tile));
+	verges.push_back(terrainVergeMatrix(tile, 0));
+	verges.push_back(terrainVergeMatrix(tile, 1));
+	for (auto& dec : tile.decorations)
+	{
+		decorations.push_back(terrainDecorationMatrix(dec));
+	}
+}
+
+static void print(const char* name, const FrameStats& stats)
+{
+	printf("  %-11s %6d %10d %6d %8d %6d %7d\n", name, stats.drawCalls, stats.instances, stats.stateChanges(), stats.psoBinds, stats.rootBinds, stats.inputBinds);
+}
+
+// Static, the tiles hold obstacles with 64 byte aligned matrices and C++14 new only promises the default alignment
+static Track track;
+
+int main(int argc, char** argv)
+{
+	std::string models = "Models";
+	std::string level = "level.txt";
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--models") == 0) models = argv[i + 1];
+		else if (strcmp(argv[i], "--level") == 0) level = argv[i + 1];
+		else
+		{
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	// Game.cpp's terrain models
+	RecordedModel road;
+	RecordedModel verge;
+	RecordedModel decoration;
+	CookedModel sheepModel;
+	Animation sheep;
+	if (!loadModel(models, "road_009.gem", road) || !loadModel(models, "ground_005.gem", verge) ||
+		!loadModel(models, "acacia_003.gem", decoration) || !sheepModel.load(models + "/Sheep-01.gem"))
+	{
+		return 1;
+	}
+	sheepModel.fillAnimation(sheep);
+
+	// The start of the level as GameSimulation::init lays it out
+	track.loadLevelConfig(level);
+	track.init(&sheep, Vec3(0, 0, -2));
+
+	std::vector<Matrix> roads;
+	std::vector<Matrix> verges;
+	std::vector<Matrix> decorations;
+	for (auto tile : track.tiles)
+	{
+		collectStaticInstances(*tile, roads, verges, decorations);
+	}
+
+	frameStats().current.reset();
+	for (int i = 0; i < (int)roads.size(); i++)
+	{
+		recordDrawLit(road);
+	}
+	for (int i = 0; i < (int)verges.size(); i++)
+	{
+		recordDrawLit(verge);
+	}
+	for (int i = 0; i < (int)decorations.size(); i++)
+	{
+		recordDrawLit(decoration);
+	}
+	FrameStats perObject = frameStats().current;
+
+	frameStats().current.reset();
+	recordDrawLitInstanced(road, (int)roads.size());
+	recordDrawLitInstanced(verge, (int)verges.size());
+	recordDrawLitInstanced(decoration, (int)decorations.size());
+	FrameStats instanced = frameStats().current;
+
+	printf("Terrain static models, %d tiles (%d roads, %d verges, %d decorations), one frame with every tile drawn\n",
+		(int)track.tiles.size(), (int)roads.size(), (int)verges.size(), (int)decorations.size());
+	printf("  meshes: road %d, verge %d, decoration %d\n", road.meshes, verge.meshes, decoration.meshes);
+	printf("  %-11s %6s %10s %6s %8s %6s %7s\n", "path", "draws", "instances", "state", "(pso", "root", "input)");
+	print("per object", perObject);
+	print("instanced", instanced);
+	return 0;
+}
@@ -0,0 +1,195 @@
+#include "Bench.h"
+#include "Simulation.h"
+#include "TerrainLayout.h"
+#include "GrassCuller.h"
+#include "JobSystem.h"
+#include "Frustum.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Per-clump grass culling at 10, 50 and 200 tiles: the third-person camera runs down the track and every
+// frame all the tiles' grass goes through GrassCuller and is copied out as it is into the upload buffer.
+// Every tile is added, not only those the tile boxes pass, so the clump count grows with the tile count.
+// The plain loop the SSE path replaced is kept here as cullScalar, and all three paths must give the same
+// instances in the same order. The upload column is what the survivors take in the frame's InstanceBuffer
+// segment, the last line what a tile recycle still costs: its grass and spheres regenerated, nothing uploaded
+//
+//   GrassCullBench [--frames n]
+
+// One sphere at a time, as GrassCuller::cullRange's tail loop does for the last few clumps
+static void cullScalar(const Frustum& frustum, const Vec3& eye, float maxDistanceSq, const std::vector<GrassInstance>& instances,
+	const GrassSpheres& s, std::vector<GrassInstance>& out)
+{
+	for (int i = 0; i < (int)instances.size(); i++)
+	{
+		float distanceSq = SQ(s.x[i] - eye.x) + SQ(s.y[i] - eye.y) + SQ(s.z[i] - eye.z);
+		if (distanceSq <= maxDistanceSq && frustum.sphereVisible(Vec3(s.x[i], s.y[i], s.z[i]), s.radius[i]))
+		{
+			out.push_back(instances[i]);
+		}
+	}
+}
+
+struct GrassTile
+{
+	std::vector<GrassInstance> grass;
+	GrassSpheres spheres;
+};
+
+// CameraManager's third-person view of a player at z, as CullingBench places it
+static Frustum cameraAt(float z, const Matrix& projection, Vec3& eye)
+{
+	Vec3 at(0, 0, z);
+	eye = at + Vec3(13.0f, 6.0f, 20.0f);
+	Frustum frustum;
+	frustum.fromViewProjection(Matrix::lookAt(eye, at + Vec3(3, 10, 5), Vec3(0, 1, 0)) * projection);
+	return frustum;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 600;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--frames") == 0) frames = atoi(argv[i + 1]);
+		else
+		{
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	// GrassPatch's two crossed quads, 1 wide and 1 high, and TerrainManager's wind margin
+	BoundingBox clumpBox;
+	Vec3 clumpPoints[8] = { Vec3(-0.5f, 0, 0), Vec3(0.5f, 0, 0), Vec3(-0.5f, 1, 0), Vec3(0.5f, 1, 0),
+		Vec3(0, 0, -0.5f), Vec3(0, 0, 0.5f), Vec3(0, 1, -0.5f), Vec3(0, 1, 0.5f) };
+	for (int i = 0; i < 8; i++)
+	{
+		clumpBox.extend(clumpPoints[i]);
+	}
+	BoundingSphere clump;
+	clump.fromPoints(clumpBox, clumpPoints, 8, sizeof(Vec3));
+
+	// CameraManager's projection and TerrainManager's grass distance, the player at 10 units a second
+	Matrix projection = Matrix::perspective(0.1f, 1000.0f, 1920.0f / 1080.0f, 60.0f);
+	const float grassDistance = 300.0f;
+	const float step = 10.0f / 60.0f;
+
+	JobSystem jobs;
+	jobs.init();
+	GrassCuller single;
+	single.init(nullptr);
+	GrassCuller threaded;
+	threaded.init(&jobs);
+
+	printf("Grass culling per frame over %d frames, us (best of 5), %d worker thread%s\n", frames, jobs.workerCount(), jobs.workerCount() == 1 ? "" : "s");
+	printf("  %5s %7s %16s %9s %9s %9s %9s %7s\n", "tiles", "clumps", "drawn", "upload KB", "scalar", "SSE", "threaded", "chunks");
+	const int tileCounts[3] = { 10, 50, 200 };
+	for (int n = 0; n < 3; n++)
+	{
+		// Laid out as Track::init does, two tiles behind the start and the rest ahead along -Z
+		int tileCount = tileCounts[n];
+		std::vector<GrassTile> tiles(tileCount);
+		for (int t = 0; t < tileCount; t++)
+		{
+			TrackTile tile;
+			tile.id = t;
+			tile.index = t;
+			tile.seed = 1;
+			tile.length = 35.0f;
+			tile.setPosition(Vec3(0, 0, (float)(2 - t) * tile.length));
+			generateTerrainGrass(tile, tiles[t].grass);
+			tiles[t].spheres.build(tiles[t].grass, clump, 0.5f);
+		}
+		std::vector<GrassInstance> scalarOut;
+		std::vector<GrassInstance> upload((size_t)tileCount * TERRAIN_GRASS_PER_TILE);
+		std::vector<GrassInstance> threadedUpload(upload.size());
+
+		// Every frame once, checking the paths against each other
+		long long drawn = 0;
+		bool same = true;
+		int chunks = 0;
+		for (int f = 0; f < frames; f++)
+		{
+			Vec3 eye;
+			Frustum frustum = cameraAt(-step * (float)f, projection, eye);
+			scalarOut.clear();
+			single.clear();
+			threaded.clear();
+			for (int t = 0; t < tileCount; t++)
+			{
+				cullScalar(frustum, eye, grassDistance * grassDistance, tiles[t].grass, tiles[t].spheres, scalarOut);
+				single.addTile(tiles[t].grass, tiles[t].spheres);
+				threaded.addTile(tiles[t].grass, tiles[t].spheres);
+			}
+			unsigned int count = single.cull(frustum, eye, grassDistance);
+			single.copyVisible(upload.data());
+			unsigned int threadedCount = threaded.cull(frustum, eye, grassDistance);
+			threaded.copyVisible(threadedUpload.data());
+			chunks = threaded.chunksUsed();
+			drawn += count;
+			size_t bytes = (size_t)count * sizeof(GrassInstance);
+			same = same && count == (unsigned int)scalarOut.size() && threadedCount == count &&
+				(count == 0 || (memcmp(upload.data(), scalarOut.data(), bytes) == 0 && memcmp(threadedUpload.data(), scalarOut.data(), bytes) == 0));
+		}
+
+		double scalarNs = benchNs(5, frames, [&]()
+			{
+				for (int f = 0; f < frames; f++)
+				{
+					Vec3 eye;
+					Frustum frustum = cameraAt(-step * (float)f, projection, eye);
+					scalarOut.clear();
+					for (int t = 0; t < tileCount; t++)
+					{
+						cullScalar(frustum, eye, grassDistance * grassDistance, tiles[t].grass, tiles[t].spheres, scalarOut);
+					}
+					memcpy(upload.data(), scalarOut.data(), scalarOut.size() * sizeof(GrassInstance));
+				}
+				benchKeep(upload[0]);
+			});
+		double culler[2];
+		GrassCuller* cullers[2] = { &single, &threaded };
+		for (int c = 0; c < 2; c++)
+		{
+			GrassCuller& grass = *cullers[c];
+			culler[c] = benchNs(5, frames, [&]()
+				{
+					for (int f = 0; f < frames; f++)
+					{
+						Vec3 eye;
+						Frustum frustum = cameraAt(-step * (float)f, projection, eye);
+						grass.clear();
+						for (int t = 0; t < tileCount; t++)
+						{
+							grass.addTile(tiles[t].grass, tiles[t].spheres);
+						}
+						grass.cull(frustum, eye, grassDistance);
+						grass.copyVisible(upload.data());
+					}
+					benchKeep(upload[0]);
+				});
+		}
+
+		long long clumps = (long long)tileCount * TERRAIN_GRASS_PER_TILE;
+		double perFrame = (double)drawn / frames;
+		printf("  %5d %7lld %8.0f (%4.1f%%) %9.1f %9.1f %9.1f %9.1f %7d%s\n", tileCount, clumps, perFrame, 100.0 * perFrame / (double)clumps,
+			perFrame * sizeof(GrassInstance) / 1024.0, scalarNs / 1000.0, culler[0] / 1000.0, culler[1] / 1000.0, chunks, same ? "" : "  (results differ)");
+	}
+
+	// TerrainManager::tileGenerated's grass work for the tile that moves to the front
+	TrackTile recycled;
+	recycled.seed = 1;
+	GrassTile front;
+	double recycleNs = benchNs(20, 1, [&]()
+		{
+			recycled.index++;
+			generateTerrainGrass(recycled, front.grass);
+			front.spheres.build(front.grass, clump, 0.5f);
+			benchKeep(front.spheres.x[0]);
+		});
+	printf("  tile recycle: %d clumps and spheres regenerated in %.1f us, no upload\n", TERRAIN_GRASS_PER_TILE, recycleNs / 1000.0);
+	return 0;
+}
@@ -0,0 +1,54 @@
+#include "Bench.h"
+#include "Maths.h"
+#include "Random.h"
+#include <vector>
+
+// Matrix inverse: the general MESA path against the affine and rigid fast paths, over random TRS matrices
+
+int main()
+{
+	const int count = 4096;
+	std::vector<Matrix> affine(count);
+	std::vector<Matrix> rigid(count);
+	std::vector<Matrix> out(count);
+	RandomStream rng(1, 0, 1);
+	for (int i = 0; i < count; i++)
+	{
+		Vec3 t(rng.range(-50.0f, 50.0f), rng.range(-50.0f, 50.0f), rng.range(-50.0f, 50.0f));
+		Vec3 euler(rng.range(-3.14f, 3.14f), rng.range(-3.14f, 3.14f), rng.range(-3.14f, 3.14f));
+		Vec3 s(rng.range(0.2f, 4.0f), rng.range(0.2f, 4.0f), rng.range(0.2f, 4.0f));
+		affine[i] = Matrix::fromEulerTRS(t, euler, s);
+		rigid[i] = Matrix::fromEulerTRS(t, euler, Vec3(1.0f, 1.0f, 1.0f));
+	}
+
+	double general = benchNs(50, count, [&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				affine[i].invert(out[i]);
+			}
+			benchKeep(out[count - 1]);
+		});
+	double fastAffine = benchNs(50, count, [&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				affine[i].invertAffine(out[i]);
+			}
+			benchKeep(out[count - 1]);
+		});
+	double fastRigid = benchNs(50, count, [&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				out[i] = rigid[i].invertRigid();
+			}
+			benchKeep(out[count - 1]);
+		});
+
+	printf("Matrix inverse, ns per matrix (best of 50 passes over %d matrices)\n", count);
+	printf("  invert        %7.2f\n", general);
+	printf("  invertAffine  %7.2f  (%.1fx)\n", fastAffine, general / fastAffine);
+	printf("  invertRigid   %7.2f  (%.1fx)\n", fastRigid, general / fastRigid);
+	return 0;
+}
@@ -0,0 +1,237 @@
+#include "Bench.h"
+#include "GEMLoader.h"
+#include <string>
+#include <vector>
+
+// GEM model loading over every model in Models/: the ifstream loader GEMModelLoader replaced (kept here as
+// LegacyLoader, a read call and a push_back per vertex, index and key, the file opened twice for animated
+// models), GEMModelLoader::load (mapped, copied into the same vectors) and GEMModelLoader::map (mapped, nothing
+// copied). Files are read once first, so the numbers are with the file cache warm
+//
+//   LoaderBench [--models folder]
+
+class LegacyLoader
+{
+public:
+	bool isAnimatedModel(const std::string& filename)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		unsigned int n = 0;
+		unsigned int isAnimated = 0;
+		file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+		file.read(reinterpret_cast<char*>(&isAnimated), sizeof(unsigned int));
+		return isAnimated != 0;
+	}
+	bool load(const std::string& filename, std::vector<GEMLoader::GEMMesh>& meshes, GEMLoader::GEMAnimation& animation)
+	{
+		std::ifstream file(filename, std::ios::binary);
+		unsigned int n = 0;
+		file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+		if (n != 4058972161)
+		{
+			return false;
+		}
+		unsigned int isAnimated = 0;
+		file.read(reinterpret_cast<char*>(&isAnimated), sizeof(unsigned int));
+		file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+		for (unsigned int i = 0; i < n; i++)
+		{
+			GEMLoader::GEMMesh mesh;
+			loadMesh(file, mesh, isAnimated);
+			meshes.push_back(mesh);
+		}
+		if (isAnimated == 0)
+		{
+			return true;
+		}
+		unsigned int bonesN = 0;
+		file.read(reinterpret_cast<char*>(&bonesN), sizeof(unsigned int));
+		for (unsigned int i = 0; i < bonesN; i++)
+		{
+			GEMLoader::GEMBone bone;
+			bone.name = loadString(file);
+			file.read(reinterpret_cast<char*>(&bone.offset.m), sizeof(float) * 16);
+			file.read(reinterpret_cast<char*>(&bone.parentIndex), sizeof(int));
+			animation.bones.push_back(bone);
+		}
+		file.read(reinterpret_cast<char*>(&animation.globalInverse.m), sizeof(float) * 16);
+		file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+		for (unsigned int i = 0; i < n; i++)
+		{
+			GEMLoader::GEMAnimationSequence aseq;
+			aseq.name = loadString(file);
+			int frames = 0;
+			file.read(reinterpret_cast<char*>(&frames), sizeof(int));
+			file.read(reinterpret_cast<char*>(&aseq.ticksPerSecond), sizeof(float));
+			for (int f = 0; f < frames; f++)
+			{
+				GEMLoader::GEMAnimationFrame frame;
+				for (unsigned int b = 0; b < bonesN; b++)
+				{
+					GEMLoader::GEMVec3 p;
+					file.read(reinterpret_cast<char*>(&p), sizeof(GEMLoader::GEMVec3));
+					frame.positions.push_back(p);
+				}
+				for (unsigned int b = 0; b < bonesN; b++)
+				{
+					GEMLoader::GEMQuaternion q;
+					file.read(reinterpret_cast<char*>(&q.q), sizeof(float) * 4);
+					frame.rotations.push_back(q);
+				}
+				for (unsigned int b = 0; b < bonesN; b++)
+				{
+					GEMLoader::GEMVec3 s;
+					file.read(reinterpret_cast<char*>(&s), sizeof(GEMLoader::GEMVec3));
+					frame.scales.push_back(s);
+				}
+				aseq.frames.push_back(frame);
+			}
+			animation.animations.push_back(aseq);
+		}
+		return true;
+	}
+private:
+	std::string loadString(std::ifstream& file)
+	{
+		int l = 0;
+		file.read(reinterpret_cast<char*>(&l), sizeof(int));
+		char* buffer = new char[l + 1];
+		file.read(buffer, l * sizeof(char));
+		buffer[l] = 0;
+		std::string str(buffer);
+		delete[] buffer;
+		return str;
+	}
+	void loadMesh(std::ifstream& file, GEMLoader::GEMMesh& mesh, unsigned int isAnimated)
+	{
+		unsigned int n = 0;
+		file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+		for (unsigned int i = 0; i < n; i++)
+		{
+			GEMLoader::GEMMaterialProperty prop;
+			prop.name = loadString(file);
+			prop.value = loadString(file);
+			mesh.material.properties.push_back(prop);
+		}
+		file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+		for (unsigned int i = 0; i < n; i++)
+		{
+			if (isAnimated == 0)
+			{
+				GEMLoader::GEMStaticVertex v;
+				file.read(reinterpret_cast<char*>(&v), sizeof(GEMLoader::GEMStaticVertex));
+				mesh.verticesStatic.push_back(v);
+			} else
+			{
+				GEMLoader::GEMAnimatedVertex v;
+				file.read(reinterpret_cast<char*>(&v), sizeof(GEMLoader::GEMAnimatedVertex));
+				mesh.verticesAnimated.push_back(v);
+			}
+		}
+		file.read(reinterpret_cast<char*>(&n), sizeof(unsigned int));
+		for (unsigned int i = 0; i < n; i++)
+		{
+			unsigned int index = 0;
+			file.read(reinterpret_cast<char*>(&index), sizeof(unsigned int));
+			mesh.indices.push_back(index);
+		}
+	}
+};
+
+// Vertices, indices and key frames, to check that every loader read the same model
+static long long countElements(const std::vector<GEMLoader::GEMMesh>& meshes, const GEMLoader::GEMAnimation& animation)
+{
+	long long n = 0;
+	for (int i = 0; i < (int)meshes.size(); i++)
+	{
+		n += (long long)meshes[i].verticesStatic.size() + (long long)meshes[i].verticesAnimated.size() + (long long)meshes[i].indices.size();
+	}
+	for (int i = 0; i < (int)animation.animations.size(); i++)
+	{
+		n += (long long)animation.animations[i].frames.size();
+	}
+	return n;
+}
+
+static long long countElements(const GEMLoader::GEMModelView& view)
+{
+	long long n = 0;
+	for (int i = 0; i < (int)view.meshes.size(); i++)
+	{
+		n += (long long)view.meshes[i].verticesStatic.size() + (long long)view.meshes[i].verticesAnimated.size() + (long long)view.meshes[i].indices.size();
+	}
+	for (int i = 0; i < (int)view.animations.size(); i++)
+	{
+		n += view.animations[i].frames;
+	}
+	return n;
+}
+
+int main(int argc, char** argv)
+{
+	std::string models = "Models";
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--models") == 0) models = argv[i + 1];
+	}
+	// Every .gem in the repository's Models folder
+	const char* files[] = { "Duck-white.gem", "Farmer-male.gem", "Sheep-01.gem", "acacia_003.gem", "ground_001.gem",
+		"ground_002.gem", "ground_003.gem", "ground_004.gem", "ground_005.gem", "ground_006.gem", "ground_007.gem",
+		"ground_008.gem", "ground_009.gem", "road_008.gem", "road_009.gem", "sand_001.gem", "tree_012.gem" };
+	const int rounds = 10;
+	const long long nsPerMs = 1000000; // benchNs divides by its item count, so this gives milliseconds
+
+	printf("GEM loading, ms per file (best of %d, file cache warm)\n", rounds);
+	printf("  %-18s %9s %9s %9s %9s  %7s\n", "model", "KB", "ifstream", "load", "map", "speedup");
+	double totals[3] = { 0, 0, 0 };
+	GEMLoader::GEMModelLoader loader;
+	for (int f = 0; f < (int)(sizeof(files) / sizeof(files[0])); f++)
+	{
+		std::string filename = models + "/" + files[f];
+		GEMLoader::GEMModelView probe;
+		if (!loader.map(filename, probe))
+		{
+			continue;
+		}
+		double kb = (double)probe.file.size / 1024.0;
+		long long expected = countElements(probe);
+		probe.file.close();
+
+		long long counts[3] = { 0, 0, 0 };
+		double legacyMs = benchNs(rounds, nsPerMs, [&]()
+			{
+				LegacyLoader legacy;
+				std::vector<GEMLoader::GEMMesh> meshes;
+				GEMLoader::GEMAnimation animation;
+				legacy.isAnimatedModel(filename);
+				legacy.load(filename, meshes, animation);
+				counts[0] = countElements(meshes, animation);
+			});
+		double loadMs = benchNs(rounds, nsPerMs, [&]()
+			{
+				std::vector<GEMLoader::GEMMesh> meshes;
+				GEMLoader::GEMAnimation animation;
+				if (loader.isAnimatedModel(filename))
+				{
+					loader.load(filename, meshes, animation);
+				} else
+				{
+					loader.load(filename, meshes);
+				}
+				counts[1] = countElements(meshes, animation);
+			});
+		double mapMs = benchNs(rounds, nsPerMs, [&]()
+			{
+				GEMLoader::GEMModelView view;
+				loader.map(filename, view);
+				counts[2] = countElements(view);
+			});
+		totals[0] += legacyMs;
+		totals[1] += loadMs;
+		totals[2] += mapMs;
+		bool same = counts[0] == expected && counts[1] == expected && counts[2] == expected;
+		printf("  %-18s %9.1f %9.3f %9.3f %9.3f  %6.1fx%s\n", files[f], kb, legacyMs, loadMs, mapMs, legacyMs / mapMs, same ? "" : "  (element counts differ)");
+	}
+	printf("  %-18s %9s %9.3f %9.3f %9.3f  %6.1fx\n", "all", "", totals[0], totals[1], totals[2], totals[0] / totals[2]);
+	return 0;
+}
@@ -0,0 +1,99 @@
+#include "Bench.h"
+#include "Maths.h"
+#include "Random.h"
+#include <vector>
+
+// Matrix products and transforms on one core, per call and through the batch entry points. CMakeLists.txt
+// builds this once per Maths.h path (MatrixBench, MatrixBenchScalar, MatrixBenchAVX2) so they can be compared
+
+#if defined(MATHS_USE_AVX2)
+static const char* mathsPath = "AVX2";
+#elif defined(MATHS_USE_SSE)
+static const char* mathsPath = "SSE";
+#else
+static const char* mathsPath = "scalar";
+#endif
+
+static void report(const char* name, double ns)
+{
+	printf("  %-28s %7.2f ns  %8.1f M/s\n", name, ns, 1000.0 / ns);
+}
+
+int main()
+{
+	const int count = 4096;
+	const int rounds = 50;
+	std::vector<Matrix> a(count);
+	std::vector<Matrix> b(count);
+	std::vector<Matrix> out(count);
+	std::vector<Vec3> points(count);
+	std::vector<Vec3> transformed(count);
+	RandomStream rng(1, 0, 2);
+	for (int i = 0; i < count; i++)
+	{
+		Vec3 t(rng.range(-50.0f, 50.0f), rng.range(-50.0f, 50.0f), rng.range(-50.0f, 50.0f));
+		Vec3 euler(rng.range(-3.14f, 3.14f), rng.range(-3.14f, 3.14f), rng.range(-3.14f, 3.14f));
+		Vec3 s(rng.range(0.2f, 4.0f), rng.range(0.2f, 4.0f), rng.range(0.2f, 4.0f));
+		a[i] = Matrix::fromEulerTRS(t, euler, s);
+		b[i] = Matrix::fromEulerTRS(s, t * 0.01f, Vec3(1.0f, 1.0f, 1.0f));
+		points[i] = Vec3(rng.range(-10.0f, 10.0f), rng.range(-10.0f, 10.0f), rng.range(-10.0f, 10.0f));
+	}
+	const Matrix& w = a[0];
+
+	printf("Matrix throughput on one core, %s path, per operation (best of %d passes over %d)\n", mathsPath, rounds, count);
+	report("mul", benchNs(rounds, count, [&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				out[i] = a[i].mul(b[i]);
+			}
+			benchKeep(out[count - 1]);
+		}));
+	report("mulArray (pairs)", benchNs(rounds, count, [&]()
+		{
+			Matrix::mulArray(a.data(), b.data(), out.data(), count);
+			benchKeep(out[count - 1]);
+		}));
+	report("mulArray (one right side)", benchNs(rounds, count, [&]()
+		{
+			Matrix::mulArray(a.data(), w, out.data(), count);
+			benchKeep(out[count - 1]);
+		}));
+	// A dependent chain, like the parent to child walk of a skeleton
+	report("mul chain", benchNs(rounds, count, [&]()
+		{
+			Matrix m = a[0];
+			for (int i = 1; i < count; i++)
+			{
+				m = b[i].mul(m);
+			}
+			benchKeep(m);
+		}));
+	report("mulPoint", benchNs(rounds, count, [&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				transformed[i] = w.mulPoint(points[i]);
+			}
+			benchKeep(transformed[count - 1]);
+		}));
+	report("mulPoints", benchNs(rounds, count, [&]()
+		{
+			w.mulPoints(points.data(), transformed.data(), count);
+			benchKeep(transformed[count - 1]);
+		}));
+	report("mulVec", benchNs(rounds, count, [&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				transformed[i] = w.mulVec(points[i]);
+			}
+			benchKeep(transformed[count - 1]);
+		}));
+	report("mulVecs", benchNs(rounds, count, [&]()
+		{
+			w.mulVecs(points.data(), transformed.data(), count);
+			benchKeep(transformed[count - 1]);
+		}));
+	return 0;
+}
@@ -0,0 +1,206 @@
+#include "Bench.h"
+#include "Simulation.h"
+#include "ModelCache.h"
+#include <chrono>
+#include <cstring>
+#include <string>
+
+// Bytes moved per scene update by the animation state machines: 50 sheep obstacles grazing, a few of them
+// blending into another clip at a time. The old StateMachine, which copied whole AnimationInstances and lerped
+// all 256 final matrices, is kept here as LegacyStateMachine and counts the matrices it evaluates, copies and
+// lerps as it goes. The current one publishes its palette by pointer and only writes the bones it evaluates,
+// which FrameStats counts
+//
+//   PoseBench [--obstacles n] [--updates n]
+
+static unsigned long long legacyBytes = 0;
+static unsigned long long legacyEvaluated = 0;
+
+// The old StateMachine's data movement around the same AnimationInstance, clips resolved once as they are now
+struct LegacyStateMachine
+{
+	AnimationInstance outputInstance;
+	AnimationInstance currentInstance;
+	AnimationInstance nextInstance;
+	AnimationSequence* currentClip;
+	AnimationSequence* nextClip;
+	bool isBlending;
+	float blendTime;
+	float blendDuration;
+
+	void init(Animation* animation)
+	{
+		currentInstance.init(animation, 0);
+		nextInstance.init(animation, 0);
+		outputInstance.init(animation, 0);
+		currentClip = nullptr;
+		nextClip = nullptr;
+		isBlending = false;
+		blendTime = 0;
+		blendDuration = 0.2f;
+	}
+	void copy(AnimationInstance& to, const AnimationInstance& from)
+	{
+		to = from;
+		legacyBytes += sizeof(AnimationInstance);
+	}
+	void changeState(AnimationSequence* clip, float duration)
+	{
+		if (clip == currentClip && !isBlending)
+		{
+			return;
+		}
+		if (isBlending)
+		{
+			copy(currentInstance, nextInstance);
+			currentClip = nextClip;
+		}
+		nextClip = clip;
+		nextInstance.resetAnimationTime();
+		if (currentClip == nullptr)
+		{
+			currentClip = clip;
+			currentInstance.update(currentClip, 0.0f);
+			copy(nextInstance, currentInstance);
+			copy(outputInstance, currentInstance);
+			isBlending = false;
+		} else
+		{
+			isBlending = true;
+			blendTime = 0;
+			blendDuration = duration;
+		}
+	}
+	void evaluate(AnimationInstance& instance, AnimationSequence* clip, float dt)
+	{
+		instance.update(clip, dt);
+		legacyEvaluated += instance.animation->bonesSize() * sizeof(Matrix);
+	}
+	void update(float dt)
+	{
+		evaluate(currentInstance, currentClip, dt);
+		if (currentInstance.animationFinished())
+		{
+			currentInstance.resetAnimationTime();
+		}
+		if (isBlending)
+		{
+			evaluate(nextInstance, nextClip, dt);
+			if (nextInstance.animationFinished())
+			{
+				nextInstance.resetAnimationTime();
+			}
+			blendTime += dt;
+			if (blendTime >= blendDuration)
+			{
+				isBlending = false;
+				currentClip = nextClip;
+				copy(currentInstance, nextInstance);
+			}
+		}
+		if (!isBlending)
+		{
+			copy(outputInstance, currentInstance);
+		} else
+		{
+			float t = blendTime / blendDuration;
+			t = t > 1.0f ? 1.0f : t;
+			for (int i = 0; i < 256; i++)
+			{
+				for (int k = 0; k < 16; k++)
+				{
+					outputInstance.matrices[i].m[k] = currentInstance.matrices[i].m[k] * (1.0f - t) + nextInstance.matrices[i].m[k] * t;
+				}
+			}
+			legacyBytes += 3 * 256 * sizeof(Matrix);
+		}
+	}
+};
+
+// Static, the instances hold 64 byte aligned matrices and C++14 new only promises the default alignment
+static const int maxObstacles = 200;
+static LegacyStateMachine legacyMachines[maxObstacles];
+static TrackObstacle obstacles[maxObstacles];
+
+// Every 60 updates a tenth of the sheep start a 0.2 s blend, alternating between grazing and standing
+static bool switchesAt(int update, int obstacle, int count)
+{
+	return update % 60 == 0 && (obstacle % 10) == (update / 60) % 10 && obstacle < count;
+}
+
+int main(int argc, char** argv)
+{
+	int count = 50;
+	int updates = 3600;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--obstacles") == 0) count = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--updates") == 0) updates = atoi(argv[i + 1]);
+	}
+	count = count < maxObstacles ? count : maxObstacles;
+
+	CookedModel model;
+	Animation animation;
+	if (!model.load("Models/Sheep-01.gem") || !model.animated)
+	{
+		printf("ERROR: Models/Sheep-01.gem has no animation\n");
+		return 1;
+	}
+	model.fillAnimation(animation);
+	AnimationSequence* eating = animation.findAnimation("eating");
+	AnimationSequence* idle = animation.findAnimation("idle");
+	if (eating == nullptr || idle == nullptr)
+	{
+		printf("ERROR: Models/Sheep-01.gem has no eating or idle clip\n");
+		return 1;
+	}
+
+	const float dt = 1.0f / 60.0f;
+	for (int i = 0; i < count; i++)
+	{
+		float startTime = 0.1f * (float)i;
+		legacyMachines[i].init(&animation);
+		legacyMachines[i].changeState(eating, 0.0f);
+		legacyMachines[i].update(startTime);
+		obstacles[i].init(&animation, Vec3(0, 0, -2.0f * (float)i), 0.0f, 0.1f, startTime);
+	}
+
+	legacyBytes = 0;
+	legacyEvaluated = 0;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int u = 0; u < updates; u++)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (switchesAt(u, i, count))
+			{
+				legacyMachines[i].changeState((u / 600) % 2 == 0 ? idle : eating, 0.2f);
+			}
+			legacyMachines[i].update(dt);
+		}
+	}
+	double legacyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	frameStats().current.reset();
+	start = std::chrono::high_resolution_clock::now();
+	for (int u = 0; u < updates; u++)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (switchesAt(u, i, count))
+			{
+				obstacles[i].playAnimation((u / 600) % 2 == 0 ? "idle" : "eating", 0.2f);
+			}
+			obstacles[i].update(dt);
+			obstacles[i].animate(0.0f);
+		}
+	}
+	double currentMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	unsigned long long currentBytes = (unsigned long long)frameStats().current.bonesEvaluated * sizeof(Matrix);
+
+	printf("%d sheep (%d bones), %d updates, per scene update\n", count, animation.bonesSize(), updates);
+	printf("                   evaluated    copied and lerped      time\n");
+	printf("  old StateMachine %6.1f KB    %9.1f KB       %6.3f ms\n", (double)legacyEvaluated / updates / 1024.0, (double)legacyBytes / updates / 1024.0, legacyMs / updates);
+	printf("  StateMachine     %6.1f KB    %9.1f KB       %6.3f ms\n", (double)currentBytes / updates / 1024.0, 0.0, currentMs / updates);
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include "Bench.h"
+#include "SpatialGrid.h"
+#include "Random.h"
+#include <algorithm>
+#include <vector>
+
+// Obstacle lookups for 1000 query circles against 10000 obstacles: SpatialGrid::queryBatch with the track's
+// 8 unit cells against testing every obstacle, as TerrainManager::checkCollisions did before the grid. The
+// queries are spread along 3500 units of track, the obstacles either spread the same way or all crowded into
+// a 20 x 40 area, then moved by the remove and insert a tile recycle makes. The hit sets are compared with
+// brute force before and after the moves
+
+typedef SpatialGrid<int> Grid;
+
+struct Obstacle
+{
+	float x;
+	float z;
+	float radius;
+};
+
+static void bruteForce(const std::vector<Obstacle>& obstacles, const std::vector<Vec3>& queries, float radius, std::vector<Grid::Hit>& hits)
+{
+	hits.clear();
+	for (int q = 0; q < (int)queries.size(); q++)
+	{
+		for (int i = 0; i < (int)obstacles.size(); i++)
+		{
+			float dx = queries[q].x - obstacles[i].x;
+			float dz = queries[q].z - obstacles[i].z;
+			float reach = radius + obstacles[i].radius;
+			if (dx * dx + dz * dz < reach * reach)
+			{
+				Grid::Hit hit;
+				hit.query = q;
+				hit.value = i;
+				hits.push_back(hit);
+			}
+		}
+	}
+}
+
+// The grid returns a query's hits in cell order, brute force in obstacle order
+static bool sameHits(std::vector<Grid::Hit> a, std::vector<Grid::Hit> b)
+{
+	auto less = [](const Grid::Hit& l, const Grid::Hit& r) { return l.query != r.query ? l.query < r.query : l.value < r.value; };
+	std::sort(a.begin(), a.end(), less);
+	std::sort(b.begin(), b.end(), less);
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+	for (int i = 0; i < (int)a.size(); i++)
+	{
+		if (a[i].query != b[i].query || a[i].value != b[i].value)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void run(const char* name, float width, float length, RandomStream& rng)
+{
+	const int obstacleCount = 10000;
+	const int queryCount = 1000;
+	const float queryRadius = 5.5f;
+	const long long nsPerMs = 1000000; // benchNs divides by its item count, so this gives milliseconds
+
+	std::vector<Obstacle> obstacles(obstacleCount);
+	Grid grid;
+	grid.init(8.0f);
+	for (int i = 0; i < obstacleCount; i++)
+	{
+		obstacles[i].x = rng.range(-width * 0.5f, width * 0.5f);
+		obstacles[i].z = rng.range(-length, 0.0f);
+		obstacles[i].radius = rng.range(0.5f, 2.0f);
+		grid.insert(i, obstacles[i].x, obstacles[i].z, obstacles[i].radius);
+	}
+	std::vector<Vec3> queries(queryCount);
+	for (int q = 0; q < queryCount; q++)
+	{
+		queries[q] = Vec3(rng.range(-30.0f, 30.0f), 0, rng.range(-3500.0f, 0.0f));
+	}
+
+	std::vector<Grid::Hit> bruteHits;
+	std::vector<Grid::Hit> gridHits;
+	double bruteMs = benchNs(5, nsPerMs, [&]()
+		{
+			bruteForce(obstacles, queries, queryRadius, bruteHits);
+		});
+	double gridMs = benchNs(20, nsPerMs, [&]()
+		{
+			grid.queryBatch(queries.data(), queryCount, queryRadius, gridHits);
+		});
+	bool same = sameHits(bruteHits, gridHits);
+
+	// A recycle removes a tile's obstacles and inserts the regenerated ones, here one obstacle at a time
+	const int moves = 200;
+	std::vector<Obstacle> moved(moves);
+	std::vector<int> which(moves);
+	for (int m = 0; m < moves; m++)
+	{
+		which[m] = rng.below(obstacleCount);
+		moved[m].x = rng.range(-width * 0.5f, width * 0.5f);
+		moved[m].z = rng.range(-length, 0.0f);
+		moved[m].radius = obstacles[which[m]].radius;
+	}
+	double moveNs = benchNs(1, moves, [&]()
+		{
+			for (int m = 0; m < moves; m++)
+			{
+				Obstacle& obstacle = obstacles[which[m]];
+				grid.remove(which[m], obstacle.x, obstacle.z);
+				obstacle = moved[m];
+				grid.insert(which[m], obstacle.x, obstacle.z, obstacle.radius);
+			}
+		});
+	bruteForce(obstacles, queries, queryRadius, bruteHits);
+	grid.queryBatch(queries.data(), queryCount, queryRadius, gridHits);
+	same = same && sameHits(bruteHits, gridHits) && grid.size() == obstacleCount;
+
+	printf("  %-24s %7d %10.3f %8.3f %7.1fx %9.0f%s\n", name, (int)gridHits.size(), bruteMs, gridMs, bruteMs / gridMs, moveNs,
+		same ? "" : "  (hits differ from brute force)");
+}
+
+int main()
+{
+	RandomStream rng(21, 0, 1);
+	printf("10000 obstacles, 1000 query circles of radius 5.5, ms per batch (brute force best of 5, grid best of 20)\n");
+	printf("  %-24s %7s %10s %8s %8s %9s\n", "layout", "hits", "brute", "grid", "speedup", "move ns");
+	run("spread along 3500 units", 60.0f, 3500.0f, rng);
+	run("crowd in 20 x 40", 20.0f, 40.0f, rng);
+	return 0;
+}
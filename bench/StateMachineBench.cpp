@@ -0,0 +1,329 @@
+#include "Bench.h"
+#include "StateMechine.h"
+#include "ModelCache.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+// String constructions and clip lookups per StateMachine::update on the Farmer-male.gem clips. The
+// string-keyed path it replaced is kept here as Legacy*, with the same calls in the same order, and counts
+// both as they happen. For the current path lookups are counted by Animation::findAnimation (FrameStats) and
+// strings through the heap: the clips are renamed past std::string's small buffer, so every construction of a
+// clip name allocates and the allocation counter sees it. The legacy path goes through the same counter: its
+// allocations match its string count except for assignments into a string already holding a name that long,
+// which reuse the buffer (the one outputInstance copy per update)
+
+static long long allocations = 0;
+
+void* operator new(size_t size)
+{
+	allocations++;
+	void* p = malloc(size > 0 ? size : 1);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+static long long stringsBuilt = 0;
+static long long mapProbes = 0;
+
+// A clip name that counts its copies, short names fit in std::string's own buffer and never allocate
+struct LegacyName
+{
+	std::string text;
+	LegacyName()
+	{
+	}
+	LegacyName(const std::string& name) : text(name)
+	{
+		stringsBuilt++;
+	}
+	LegacyName(const LegacyName& other) : text(other.text)
+	{
+		stringsBuilt++;
+	}
+	LegacyName& operator=(const LegacyName& other)
+	{
+		text = other.text;
+		stringsBuilt++;
+		return *this;
+	}
+	bool operator<(const LegacyName& other) const
+	{
+		return text < other.text;
+	}
+	bool operator==(const LegacyName& other) const
+	{
+		return text == other.text;
+	}
+	bool empty() const
+	{
+		return text.empty();
+	}
+};
+
+// The old Animation: every call takes the name by value and looks it up
+struct LegacyAnimation
+{
+	std::map<LegacyName, AnimationSequence*> animations;
+	Animation* source;
+	AnimationSequence* find(const LegacyName& name)
+	{
+		mapProbes++;
+		return animations[name];
+	}
+	void calcFrame(LegacyName name, float t, int& frame, float& interpolationFact)
+	{
+		find(name)->calcFrame(t, frame, interpolationFact);
+	}
+	Matrix interpolateBoneToGlobal(LegacyName name, Matrix* matrices, int baseFrame, float interpolationFact, int boneIndex)
+	{
+		return find(name)->interpolateBoneToGlobal(matrices, baseFrame, interpolationFact, &source->skeleton, boneIndex);
+	}
+};
+
+struct LegacyInstance
+{
+	LegacyAnimation* animation;
+	LegacyName usingAnimation;
+	float t;
+	Matrix matrices[256];
+	Matrix coordTransform;
+	void update(LegacyName name, float dt)
+	{
+		if (name == usingAnimation)
+		{
+			t += dt;
+		} else
+		{
+			usingAnimation = name;
+			t = 0;
+		}
+		if (animationFinished())
+		{
+			return;
+		}
+		int frame = 0;
+		float interpolationFact = 0;
+		animation->calcFrame(name, t, frame, interpolationFact);
+		for (int i = 0; i < animation->source->bonesSize(); i++)
+		{
+			matrices[i] = animation->interpolateBoneToGlobal(name, matrices, frame, interpolationFact, i);
+		}
+		animation->source->calcTransforms(matrices, coordTransform);
+	}
+	bool animationFinished()
+	{
+		return t > animation->find(usingAnimation)->duration();
+	}
+};
+
+// The old StateMachine::update and calculateMatrices, blending final matrices of all 256 slots
+struct LegacyStateMachine
+{
+	LegacyInstance outputInstance;
+	LegacyInstance currentInstance;
+	LegacyInstance nextInstance;
+	LegacyName currentStateName;
+	LegacyName nextStateName;
+	bool isBlending;
+	float blendTime;
+	float blendDuration;
+
+	void init(LegacyAnimation* animation)
+	{
+		outputInstance.animation = currentInstance.animation = nextInstance.animation = animation;
+		isBlending = false;
+		blendTime = 0;
+		blendDuration = 0.2f;
+	}
+	void changeState(const std::string& newState, float duration)
+	{
+		LegacyName name(newState);
+		if (currentStateName == name && !isBlending)
+		{
+			return;
+		}
+		if (isBlending)
+		{
+			currentInstance = nextInstance;
+			currentStateName = nextStateName;
+		}
+		nextStateName = name;
+		nextInstance.t = 0;
+		if (currentStateName.empty())
+		{
+			currentStateName = name;
+			currentInstance.update(currentStateName, 0.0f);
+			nextInstance = currentInstance;
+			outputInstance = currentInstance;
+			isBlending = false;
+		} else
+		{
+			isBlending = true;
+			blendTime = 0;
+			blendDuration = duration;
+		}
+	}
+	void update(float dt)
+	{
+		currentInstance.update(currentStateName, dt);
+		if (currentInstance.animationFinished())
+		{
+			currentInstance.t = 0;
+		}
+		if (isBlending)
+		{
+			nextInstance.update(nextStateName, dt);
+			if (nextInstance.animationFinished())
+			{
+				nextInstance.t = 0;
+			}
+			blendTime += dt;
+			if (blendTime >= blendDuration)
+			{
+				isBlending = false;
+				currentStateName = nextStateName;
+				currentInstance = nextInstance;
+			}
+		}
+		if (!isBlending)
+		{
+			outputInstance = currentInstance;
+		} else
+		{
+			float t = blendTime / blendDuration;
+			t = t > 1.0f ? 1.0f : t;
+			for (int i = 0; i < 256; i++)
+			{
+				for (int k = 0; k < 16; k++)
+				{
+					outputInstance.matrices[i].m[k] = currentInstance.matrices[i].m[k] * (1.0f - t) + nextInstance.matrices[i].m[k] * t;
+				}
+			}
+		}
+	}
+};
+
+struct Counts
+{
+	double strings;
+	double allocations;
+	double lookups;
+	double ns;
+};
+
+static long long lookups()
+{
+	return mapProbes + frameStats().current.clipLookups;
+}
+
+// Steady running, then a switch to another clip every 30 updates so a third of the updates blend.
+// Only what update itself does is counted, changeState resolves names by design
+template<typename Machine>
+static Counts run(Machine& machine, const std::string& run, const std::string& other, int updates, bool switching)
+{
+	stringsBuilt = 0;
+	mapProbes = 0;
+	frameStats().current.reset();
+	long long allocated = 0;
+	double ns = 0;
+	for (int i = 0; i < updates; i++)
+	{
+		if (switching && i % 30 == 0)
+		{
+			long long strings = stringsBuilt;
+			long long probes = mapProbes;
+			int clipLookups = frameStats().current.clipLookups;
+			machine.changeState((i / 30) % 2 == 0 ? other : run, 0.2f);
+			stringsBuilt = strings;
+			mapProbes = probes;
+			frameStats().current.clipLookups = clipLookups;
+		}
+		long long before = allocations;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		machine.update(1.0f / 60.0f);
+		ns += std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+		allocated += allocations - before;
+	}
+	Counts counts;
+	counts.strings = (double)stringsBuilt / updates;
+	counts.allocations = (double)allocated / updates;
+	counts.lookups = (double)lookups() / updates;
+	counts.ns = ns / updates;
+	return counts;
+}
+
+// Static, the instances hold 64 byte aligned matrices and C++14 new only promises the default alignment
+static LegacyStateMachine legacyMachines[2];
+static StateMachine machines[2];
+
+int main()
+{
+	CookedModel model;
+	Animation animation;
+	if (!model.load("Models/Farmer-male.gem") || !model.animated)
+	{
+		printf("ERROR: Models/Farmer-male.gem has no animation\n");
+		return 1;
+	}
+	model.fillAnimation(animation);
+	if (!animation.hasAnimation("run") || !animation.hasAnimation("walk"))
+	{
+		printf("ERROR: Models/Farmer-male.gem has no run or walk clip\n");
+		return 1;
+	}
+	// Names too long for the small string buffer, so constructing one allocates
+	std::string runClip = "Farmer-male.gem run, renamed for counting";
+	std::string otherClip = "Farmer-male.gem walk, renamed for counting";
+	animation.animations.insert({ runClip, std::move(animation.animations["run"]) });
+	animation.animations.insert({ otherClip, std::move(animation.animations["walk"]) });
+	animation.animations.erase("run");
+	animation.animations.erase("walk");
+
+	LegacyAnimation legacyAnimation;
+	legacyAnimation.source = &animation;
+	for (std::map<std::string, AnimationSequence>::iterator it = animation.animations.begin(); it != animation.animations.end(); ++it)
+	{
+		legacyAnimation.animations[LegacyName(it->first)] = &it->second;
+	}
+
+	printf("StateMachine::update on Farmer-male.gem (%d bones), per update\n", animation.bonesSize());
+	printf("  %-9s %-12s %8s %12s %8s %9s\n", "", "", "strings", "allocations", "lookups", "ns");
+	const int updates = 6000;
+	const bool cases[2] = { false, true };
+	const char* names[2] = { "running", "switching" };
+	for (int c = 0; c < 2; c++)
+	{
+		LegacyStateMachine& legacy = legacyMachines[c];
+		legacy.init(&legacyAnimation);
+		legacy.changeState(runClip, 0.0f);
+		Counts legacyCounts = run(legacy, runClip, otherClip, updates, cases[c]);
+
+		StateMachine& machine = machines[c];
+		machine.init(&animation);
+		machine.changeState(runClip, 0.0f);
+		Counts counts = run(machine, runClip, otherClip, updates, cases[c]);
+		// Every string the current path builds is a heap allocation here, the count is the allocations
+		counts.strings = counts.allocations;
+
+		printf("  %-9s %-12s %8.1f %12.1f %8.1f %9.0f\n", names[c], "string-keyed", legacyCounts.strings, legacyCounts.allocations, legacyCounts.lookups, legacyCounts.ns);
+		printf("  %-9s %-12s %8.1f %12.1f %8.1f %9.0f\n", "", "clip handles", counts.strings, counts.allocations, counts.lookups, counts.ns);
+	}
+	return 0;
+}
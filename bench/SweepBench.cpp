@@ -0,0 +1,70 @@
+#include "Bench.h"
+#include "SweptCollision.h"
+#include "Random.h"
+#include <vector>
+
+// Swept circle test throughput: sweepCircles (four circles per SSE step) against timeOfImpact called per
+// circle, over circles scattered around the path. Short steps are what a 60 Hz step at running speed covers,
+// long ones what a hitch does
+
+static void run(const char* name, float stepLength, int count)
+{
+	const int sweeps = 256;
+	RandomStream rng(22, 0, 2);
+	std::vector<float> x(count), z(count), r(count);
+	for (int i = 0; i < count; i++)
+	{
+		x[i] = rng.range(-30.0f, 30.0f);
+		z[i] = rng.range(-30.0f, 30.0f);
+		r[i] = rng.range(0.3f, 2.0f);
+	}
+	std::vector<Vec3> from(sweeps), to(sweeps);
+	for (int s = 0; s < sweeps; s++)
+	{
+		from[s] = Vec3(rng.range(-20.0f, 20.0f), 0, rng.range(-20.0f, 20.0f));
+		float angle = rng.range(0.0f, 6.2831853f);
+		to[s] = from[s] + Vec3(cosf(angle), 0, sinf(angle)) * stepLength;
+	}
+
+	std::vector<SweepHit> hits;
+	hits.reserve(count);
+	long long batchHits = 0;
+	double batch = benchNs(20, (long long)sweeps * count, [&]()
+		{
+			batchHits = 0;
+			for (int s = 0; s < sweeps; s++)
+			{
+				hits.clear();
+				batchHits += CircleSweep::sweepCircles(from[s], to[s], 0.5f, x.data(), z.data(), r.data(), count, hits);
+			}
+			benchKeep(batchHits);
+		});
+	long long scalarHits = 0;
+	double scalar = benchNs(20, (long long)sweeps * count, [&]()
+		{
+			scalarHits = 0;
+			for (int s = 0; s < sweeps; s++)
+			{
+				for (int i = 0; i < count; i++)
+				{
+					scalarHits += CircleSweep::timeOfImpact(from[s], to[s], 0.5f, x[i], z[i], r[i]) >= 0.0f ? 1 : 0;
+				}
+			}
+			benchKeep(scalarHits);
+		});
+	printf("  %-6s %6d  %9.2f  %9.2f  %5.1fx  %8.2f%s\n", name, count, scalar, batch, scalar / batch,
+		100.0 * (double)batchHits / ((double)sweeps * count), batchHits == scalarHits ? "" : "  (hit counts differ)");
+}
+
+int main()
+{
+	printf("Swept circle test, ns per circle (best of 20 passes, 256 sweeps each)\n");
+	printf("  step   circles     scalar      batch  speedup   hits %%\n");
+	run("short", 0.17f, 16);
+	run("short", 0.17f, 256);
+	run("short", 0.17f, 4096);
+	run("long", 5.0f, 16);
+	run("long", 5.0f, 256);
+	run("long", 5.0f, 4096);
+	return 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdio>
+#include <math.h>
+
+// Minimal checks for the unit tests. A failed check prints where it failed and the test carries on, so one run
+// shows every failure. main returns checkResult(), which ctest reads as pass or fail
+
+static int checkFailures = 0;
+static int checkCount = 0;
+
+#define CHECK(condition) checkTrue((condition), #condition, __FILE__, __LINE__)
+#define CHECK_NEAR(actual, expected, tolerance) checkNear((double)(actual), (double)(expected), (double)(tolerance), #actual, __FILE__, __LINE__)
+
+inline bool checkTrue(bool passed, const char* expression, const char* file, int line)
+{
+	checkCount++;
+	if (!passed)
+	{
+		checkFailures++;
+		printf("%s:%d: CHECK(%s) failed\n", file, line, expression);
+	}
+	return passed;
+}
+
+inline bool checkNear(double actual, double expected, double tolerance, const char* expression, const char* file, int line)
+{
+	checkCount++;
+	if (!(fabs(actual - expected) <= tolerance))
+	{
+		checkFailures++;
+		printf("%s:%d: %s is %.9g, expected %.9g within %g\n", file, line, expression, actual, expected, tolerance);
+		return false;
+	}
+	return true;
+}
+
+inline int checkResult(const char* name)
+{
+	printf("%s: %d checks, %d failed\n", name, checkCount, checkFailures);
+	return checkFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+#include "Check.h"
+#include "ConstantRing.h"
+#include "Random.h"
+#include <vector>
+#include <deque>
+
+// ConstantSlotRing: per-frame segments fenced against the GPU, growth mid-frame and release of old storage
+
+static void testFrameFencing()
+{
+	ConstantSlotRing ring;
+	ring.init(4, 2);
+	unsigned int slot = 99;
+	// Nothing to allocate from before a frame is open
+	CHECK(!ring.allocate(slot));
+	CHECK(ring.currentSegment() == -1 && ring.usedSlots() == 0);
+
+	ring.beginFrame(0, 1);
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		CHECK(ring.allocate(slot) && slot == i);
+	}
+	CHECK(!ring.allocate(slot));
+	ring.closeFrame(10);
+	CHECK(ring.segmentFence(0) == 10 && ring.currentSegment() == -1);
+	CHECK(!ring.allocate(slot));
+	// A second close has no open segment and must not overwrite the fence
+	ring.closeFrame(12);
+	CHECK(ring.segmentFence(0) == 10);
+
+	// The other segment's slots follow the first one's
+	ring.beginFrame(1, 2);
+	CHECK(ring.allocate(slot) && slot == 4);
+	ring.closeFrame(11);
+	CHECK(ring.segmentFence(1) == 11 && ring.segmentFence(0) == 10);
+
+	// Reopening a segment starts it from its first slot again
+	ring.beginFrame(0, 3);
+	CHECK(ring.allocate(slot) && slot == 0);
+	CHECK(ring.usedSlots() == 1);
+	CHECK(ring.peakSlots() == 4);
+}
+
+static void testRangeAllocation()
+{
+	ConstantSlotRing ring;
+	ring.init(8, 2);
+	ring.beginFrame(1, 1);
+	unsigned int first = 0;
+	CHECK(ring.allocate(3, first) && first == 8);
+	CHECK(ring.allocate(5, first) && first == 11);
+	// A range that does not fit takes nothing
+	CHECK(!ring.allocate(1, first));
+	ring.beginFrame(1, 3);
+	CHECK(ring.allocate(6, first) && first == 8);
+	CHECK(!ring.allocate(3, first));
+	CHECK(ring.usedSlots() == 6);
+	CHECK(ring.allocate(2, first) && first == 14);
+}
+
+static void testGrowHalfFilled()
+{
+	ConstantSlotRing ring;
+	ring.init(4, 2);
+	unsigned int slot = 0;
+	ring.beginFrame(1, 5);
+	CHECK(ring.allocate(slot) && slot == 4);
+	CHECK(ring.allocate(slot) && slot == 5);
+	ring.grow();
+	// Slots 4 and 5 stay valid in the old storage. The new storage is twice the size and this frame carries
+	// on from the start of its own segment in it
+	CHECK(ring.segmentSlots() == 8 && ring.totalSlots() == 16);
+	CHECK(ring.currentSegment() == 1);
+	CHECK(ring.usedSlots() == 0);
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		CHECK(ring.allocate(slot) && slot == 8 + i);
+	}
+	CHECK(!ring.allocate(slot));
+	CHECK(ring.growCount() == 1 && ring.retiredCount() == 1);
+	CHECK(ring.peakSlots() == 8);
+
+	// A ring created empty grows to one slot
+	ConstantSlotRing empty;
+	empty.init(0, 2);
+	empty.beginFrame(0, 1);
+	CHECK(!empty.allocate(slot));
+	empty.grow();
+	CHECK(empty.allocate(slot) && slot == 0 && empty.totalSlots() == 2);
+}
+
+static void testReleaseRetired()
+{
+	ConstantSlotRing ring;
+	ring.init(2, 2);
+	ring.beginFrame(0, 5);
+	ring.grow();
+	// Frames 5 and 6 can still hold slots in the old storage. Frame 7 reuses frame 5's segment, which means
+	// frame 5 has completed, and frame 6 already used the new storage
+	CHECK(ring.releaseRetired(5) == 0);
+	CHECK(ring.releaseRetired(6) == 0);
+	CHECK(ring.retiredCount() == 1);
+	CHECK(ring.releaseRetired(7) == 1);
+	CHECK(ring.retiredCount() == 0);
+	CHECK(ring.releaseRetired(8) == 0);
+
+	// Two growths in one frame and one in the next come free oldest first
+	ring.beginFrame(0, 9);
+	ring.grow();
+	ring.grow();
+	ring.beginFrame(1, 10);
+	ring.grow();
+	CHECK(ring.retiredCount() == 3);
+	CHECK(ring.releaseRetired(10) == 0);
+	CHECK(ring.releaseRetired(11) == 2);
+	CHECK(ring.releaseRetired(12) == 1);
+	CHECK(ring.growCount() == 4 && ring.segmentSlots() == 32);
+}
+
+// The way ConstantBuffer drives the ring, with two frames in flight and bursty draw counts. A slot of a given
+// storage must never be handed out again while the frame that used it is in flight, and old storage must only
+// be released once every frame that used it has completed
+static void testRandomFrames()
+{
+	struct Use
+	{
+		int storage;
+		unsigned int slot;
+		long long fence;
+	};
+	const int segments = 2;
+	ConstantSlotRing ring;
+	ring.init(16, segments);
+	RandomStream rng(13, 0, 1);
+	int storage = 0;
+	std::deque<int> retiredStorages;
+	std::vector<long long> storageLastFence(1, 0);
+	std::vector<Use> inFlight;
+	long long completed = 0;
+	int reused = 0;
+	int releasedEarly = 0;
+	int grows = 0;
+	for (long long frame = 1; frame <= 20000; frame++)
+	{
+		int segment = (int)(frame % segments);
+		// beginFrame's contract: the segment's fence has completed, which on a real GPU is the wait in
+		// beginFrameIfNeeded
+		completed = ring.segmentFence(segment) > completed ? ring.segmentFence(segment) : completed;
+		for (int i = 0; i < (int)inFlight.size(); i++)
+		{
+			if (inFlight[i].fence <= completed)
+			{
+				inFlight[i] = inFlight.back();
+				inFlight.pop_back();
+				i--;
+			}
+		}
+		ring.beginFrame(segment, (unsigned long long)frame);
+		for (int i = ring.releaseRetired((unsigned long long)frame); i > 0; i--)
+		{
+			if (storageLastFence[retiredStorages.front()] > completed)
+			{
+				releasedEarly++;
+			}
+			retiredStorages.pop_front();
+		}
+
+		int draws = rng.below(8) == 0 ? rng.below(300) : rng.below(20);
+		for (int d = 0; d < draws; d++)
+		{
+			unsigned int slot = 0;
+			if (!ring.allocate(slot))
+			{
+				ring.grow();
+				grows++;
+				retiredStorages.push_back(storage);
+				storage++;
+				storageLastFence.push_back(0);
+				CHECK(ring.allocate(slot));
+			}
+			for (int i = 0; i < (int)inFlight.size(); i++)
+			{
+				if (inFlight[i].storage == storage && inFlight[i].slot == slot)
+				{
+					reused++;
+				}
+			}
+			Use use;
+			use.storage = storage;
+			use.slot = slot;
+			use.fence = frame;
+			inFlight.push_back(use);
+			storageLastFence[storage] = frame;
+		}
+		ring.closeFrame(frame);
+	}
+	CHECK(grows > 0 && grows == ring.growCount());
+	CHECK(reused == 0);
+	CHECK(releasedEarly == 0);
+	CHECK(ring.retiredCount() <= 1);
+}
+
+int main()
+{
+	testFrameFencing();
+	testRangeAllocation();
+	testGrowHalfFilled();
+	testReleaseRetired();
+	testRandomFrames();
+	return checkResult("ConstantRingTests");
+}
@@ -0,0 +1,318 @@
+#include "Check.h"
+#include "Frustum.h"
+#include "Random.h"
+#include <vector>
+
+// Frustum: the planes against clip space, and the SSE batch culls against the scalar box and sphere tests
+
+// As CameraManager builds it
+static Matrix viewProjection(const Vec3& from, const Vec3& to, float nearPlane, float farPlane, float aspect, float fov)
+{
+	return Matrix::lookAt(from, to, Vec3(0, 1, 0)) * Matrix::perspective(nearPlane, farPlane, aspect, fov);
+}
+
+static Frustum randomFrustum(RandomStream& rng, Vec3& eye)
+{
+	eye = Vec3(rng.range(-100.0f, 100.0f), rng.range(-10.0f, 40.0f), rng.range(-100.0f, 100.0f));
+	Vec3 dir(rng.range(-1.0f, 1.0f), rng.range(-0.7f, 0.7f), rng.range(-1.0f, 1.0f));
+	if (dir.length() < 0.1f)
+	{
+		dir = Vec3(0, 0, -1);
+	}
+	Frustum frustum;
+	frustum.fromViewProjection(viewProjection(eye, eye + dir, rng.range(0.1f, 2.0f), rng.range(50.0f, 1000.0f), rng.range(1.0f, 2.4f), rng.range(40.0f, 100.0f)));
+	return frustum;
+}
+
+// Smallest distance of a box's outside test from its threshold over the six planes. Below a
+// rounding error the SSE and scalar sums may land on different sides
+static float boxMargin(const Frustum& frustum, float x, float y, float z, float ex, float ey, float ez)
+{
+	float margin = FLT_MAX;
+	for (int p = 0; p < 6; p++)
+	{
+		const float* plane = frustum.planes[p];
+		float d = plane[0] * x + plane[1] * y + plane[2] * z + plane[3];
+		float reach = fabsf(plane[0]) * ex + fabsf(plane[1]) * ey + fabsf(plane[2]) * ez;
+		float scale = fabsf(plane[0] * x) + fabsf(plane[1] * y) + fabsf(plane[2] * z) + fabsf(plane[3]) + reach;
+		float m = fabsf(d + reach) / (scale > 1.0f ? scale : 1.0f);
+		margin = m < margin ? m : margin;
+	}
+	return margin;
+}
+
+static float sphereMargin(const Frustum& frustum, float x, float y, float z, float radius)
+{
+	float margin = FLT_MAX;
+	for (int p = 0; p < 6; p++)
+	{
+		const float* plane = frustum.planes[p];
+		float d = plane[0] * x + plane[1] * y + plane[2] * z + plane[3];
+		float scale = fabsf(plane[0] * x) + fabsf(plane[1] * y) + fabsf(plane[2] * z) + fabsf(plane[3]) + radius;
+		float m = fabsf(d + radius) / (scale > 1.0f ? scale : 1.0f);
+		margin = m < margin ? m : margin;
+	}
+	return margin;
+}
+
+static void testKnownCases()
+{
+	Frustum frustum;
+	frustum.fromViewProjection(viewProjection(Vec3(0, 0, 0), Vec3(0, 0, -1), 0.1f, 100.0f, 1.0f, 90.0f));
+	CHECK(frustum.sphereVisible(Vec3(0, 0, -10), 0.0f));
+	CHECK(!frustum.sphereVisible(Vec3(0, 0, 10), 0.0f));
+	CHECK(!frustum.sphereVisible(Vec3(0, 0, -101), 0.0f));
+	CHECK(frustum.sphereVisible(Vec3(0, 0, -101), 2.0f));
+	CHECK(!frustum.sphereVisible(Vec3(0, 0, -0.05f), 0.0f));
+	// 90 degrees: the side planes are at 45 degrees
+	CHECK(frustum.sphereVisible(Vec3(9.0f, 0, -10), 0.0f));
+	CHECK(!frustum.sphereVisible(Vec3(11.0f, 0, -10), 0.0f));
+	CHECK(!frustum.sphereVisible(Vec3(0, -11.0f, -10), 0.0f));
+	CHECK(frustum.sphereVisible(Vec3(11.0f, 0, -10), 1.0f));
+
+	BoundingBox box;
+	box.extend(Vec3(-1, -1, 5));
+	box.extend(Vec3(1, 1, 7));
+	CHECK(!frustum.boxVisible(box));
+	// Straddling the near plane and around the eye
+	box.extend(Vec3(0, 0, -1));
+	CHECK(frustum.boxVisible(box));
+	BoundingBox beside;
+	beside.extend(Vec3(20, -1, -11));
+	beside.extend(Vec3(22, 1, -9));
+	CHECK(!frustum.boxVisible(beside));
+}
+
+// A point with a zero radius is visible exactly when its clip position is inside [-w, w] x [-w, w] x [0, w]
+static void testPointsMatchClipSpace()
+{
+	RandomStream rng(17, 0, 1);
+	int mismatches = 0;
+	int inside = 0;
+	int tested = 0;
+	for (int f = 0; f < 200; f++)
+	{
+		Vec3 dir(rng.range(-1.0f, 1.0f), rng.range(-0.7f, 0.7f), rng.range(-1.0f, 1.0f));
+		Vec3 eye(rng.range(-100.0f, 100.0f), rng.range(-10.0f, 40.0f), rng.range(-100.0f, 100.0f));
+		if (dir.length() < 0.1f)
+		{
+			continue;
+		}
+		Matrix vp = viewProjection(eye, eye + dir, 0.5f, rng.range(50.0f, 500.0f), rng.range(1.0f, 2.4f), rng.range(40.0f, 100.0f));
+		Frustum frustum;
+		frustum.fromViewProjection(vp);
+		for (int i = 0; i < 1000; i++)
+		{
+			Vec3 p = eye + Vec3(rng.range(-300.0f, 300.0f), rng.range(-300.0f, 300.0f), rng.range(-300.0f, 300.0f));
+			float clip[4];
+			for (int r = 0; r < 4; r++)
+			{
+				clip[r] = vp.a[r][0] * p.x + vp.a[r][1] * p.y + vp.a[r][2] * p.z + vp.a[r][3];
+			}
+			float w = clip[3];
+			float slack = 1e-3f * (fabsf(w) + 1.0f);
+			float edges[6] = { w + clip[0], w - clip[0], w + clip[1], w - clip[1], clip[2], w - clip[2] };
+			bool clipInside = true;
+			bool nearEdge = false;
+			for (int e = 0; e < 6; e++)
+			{
+				clipInside = clipInside && edges[e] >= 0.0f;
+				nearEdge = nearEdge || fabsf(edges[e]) < slack;
+			}
+			if (nearEdge)
+			{
+				continue;
+			}
+			tested++;
+			inside += clipInside ? 1 : 0;
+			mismatches += frustum.sphereVisible(p, 0.0f) != clipInside ? 1 : 0;
+		}
+	}
+	CHECK(mismatches == 0);
+	CHECK(tested > 150000 && inside > 1000);
+}
+
+// Every count from 0 to 40 so the scalar tail runs with 0 to 3 entries after the SSE blocks. A result may only
+// differ from the scalar test where the two sums round to opposite sides of a plane
+static void testCullBoxesMatchesScalar()
+{
+	RandomStream rng(17, 0, 2);
+	int mismatches = 0;
+	int onPlane = 0;
+	int tailMismatches = 0;
+	int countErrors = 0;
+	int visibleTotal = 0;
+	int boxes = 0;
+	std::vector<float> cx, cy, cz, ex, ey, ez;
+	std::vector<unsigned char> visible;
+	for (int round = 0; round < 2000; round++)
+	{
+		Vec3 eye;
+		Frustum frustum = randomFrustum(rng, eye);
+		int count = round % 41;
+		cx.resize(count);
+		cy.resize(count);
+		cz.resize(count);
+		ex.resize(count);
+		ey.resize(count);
+		ez.resize(count);
+		visible.assign(count + 1, 7);
+		for (int i = 0; i < count; i++)
+		{
+			cx[i] = eye.x + rng.range(-200.0f, 200.0f);
+			cy[i] = eye.y + rng.range(-200.0f, 200.0f);
+			cz[i] = eye.z + rng.range(-200.0f, 200.0f);
+			ex[i] = rng.below(8) == 0 ? 0.0f : rng.range(0.0f, 30.0f);
+			ey[i] = rng.range(0.0f, 30.0f);
+			ez[i] = rng.range(0.0f, 30.0f);
+		}
+		int reported = frustum.cullBoxes(cx.data(), cy.data(), cz.data(), ex.data(), ey.data(), ez.data(), count, visible.data());
+		int counted = 0;
+		for (int i = 0; i < count; i++)
+		{
+			BoundingBox box;
+			box.min = Vec3(cx[i] - ex[i], cy[i] - ey[i], cz[i] - ez[i]);
+			box.max = Vec3(cx[i] + ex[i], cy[i] + ey[i], cz[i] + ez[i]);
+			bool expected = frustum.boxVisible(box);
+			counted += visible[i];
+			if ((visible[i] != 0) != expected || visible[i] > 1)
+			{
+				if (i >= count - count % 4)
+				{
+					tailMismatches++;
+				} else if (boxMargin(frustum, cx[i], cy[i], cz[i], ex[i], ey[i], ez[i]) < 1e-5f)
+				{
+					onPlane++;
+				} else
+				{
+					mismatches++;
+				}
+			}
+		}
+		countErrors += reported != counted ? 1 : 0;
+		// Nothing written past the end
+		countErrors += visible[count] != 7 ? 1 : 0;
+		visibleTotal += counted;
+		boxes += count;
+	}
+	CHECK(mismatches == 0);
+	CHECK(tailMismatches == 0);
+	CHECK(countErrors == 0);
+	CHECK(onPlane < 10);
+	CHECK(visibleTotal > boxes / 20 && visibleTotal < boxes);
+}
+
+static void testCullSpheresMatchesScalar()
+{
+	RandomStream rng(17, 0, 3);
+	int mismatches = 0;
+	int onPlane = 0;
+	int tailMismatches = 0;
+	int countErrors = 0;
+	int visibleTotal = 0;
+	int spheres = 0;
+	std::vector<float> cx, cy, cz, radius;
+	std::vector<unsigned char> visible;
+	for (int round = 0; round < 2000; round++)
+	{
+		Vec3 eye;
+		Frustum frustum = randomFrustum(rng, eye);
+		int count = round % 41;
+		cx.resize(count);
+		cy.resize(count);
+		cz.resize(count);
+		radius.resize(count);
+		visible.assign(count + 1, 7);
+		for (int i = 0; i < count; i++)
+		{
+			cx[i] = eye.x + rng.range(-200.0f, 200.0f);
+			cy[i] = eye.y + rng.range(-200.0f, 200.0f);
+			cz[i] = eye.z + rng.range(-200.0f, 200.0f);
+			radius[i] = rng.below(8) == 0 ? 0.0f : rng.range(0.0f, 30.0f);
+		}
+		int reported = frustum.cullSpheres(cx.data(), cy.data(), cz.data(), radius.data(), count, visible.data());
+		int counted = 0;
+		for (int i = 0; i < count; i++)
+		{
+			bool expected = frustum.sphereVisible(Vec3(cx[i], cy[i], cz[i]), radius[i]);
+			counted += visible[i];
+			if ((visible[i] != 0) != expected || visible[i] > 1)
+			{
+				if (i >= count - count % 4)
+				{
+					tailMismatches++;
+				} else if (sphereMargin(frustum, cx[i], cy[i], cz[i], radius[i]) < 1e-5f)
+				{
+					onPlane++;
+				} else
+				{
+					mismatches++;
+				}
+			}
+		}
+		countErrors += reported != counted ? 1 : 0;
+		countErrors += visible[count] != 7 ? 1 : 0;
+		visibleTotal += counted;
+		spheres += count;
+	}
+	CHECK(mismatches == 0);
+	CHECK(tailMismatches == 0);
+	CHECK(countErrors == 0);
+	CHECK(onPlane < 10);
+	CHECK(visibleTotal > spheres / 20 && visibleTotal < spheres);
+}
+
+// Culling is conservative: a box with any corner clearly inside the frustum is never dropped
+static void testVisibleCornerNeverCulled()
+{
+	RandomStream rng(17, 0, 4);
+	int culledVisible = 0;
+	int withCorner = 0;
+	const int count = 64;
+	float cx[count], cy[count], cz[count], ex[count], ey[count], ez[count];
+	unsigned char visible[count];
+	for (int round = 0; round < 2000; round++)
+	{
+		Vec3 eye;
+		Frustum frustum = randomFrustum(rng, eye);
+		for (int i = 0; i < count; i++)
+		{
+			cx[i] = eye.x + rng.range(-150.0f, 150.0f);
+			cy[i] = eye.y + rng.range(-150.0f, 150.0f);
+			cz[i] = eye.z + rng.range(-150.0f, 150.0f);
+			ex[i] = rng.range(0.1f, 40.0f);
+			ey[i] = rng.range(0.1f, 40.0f);
+			ez[i] = rng.range(0.1f, 40.0f);
+		}
+		frustum.cullBoxes(cx, cy, cz, ex, ey, ez, count, visible);
+		for (int i = 0; i < count; i++)
+		{
+			bool cornerInside = false;
+			for (int c = 0; c < 8; c++)
+			{
+				Vec3 corner(cx[i] + ((c & 1) ? ex[i] : -ex[i]), cy[i] + ((c & 2) ? ey[i] : -ey[i]), cz[i] + ((c & 4) ? ez[i] : -ez[i]));
+				bool inside = true;
+				for (int p = 0; p < 6; p++)
+				{
+					const float* plane = frustum.planes[p];
+					inside = inside && plane[0] * corner.x + plane[1] * corner.y + plane[2] * corner.z + plane[3] > 1e-3f;
+				}
+				cornerInside = cornerInside || inside;
+			}
+			withCorner += cornerInside ? 1 : 0;
+			culledVisible += (cornerInside && visible[i] == 0) ? 1 : 0;
+		}
+	}
+	CHECK(withCorner > 1000);
+	CHECK(culledVisible == 0);
+}
+
+int main()
+{
+	testKnownCases();
+	testPointsMatchClipSpace();
+	testCullBoxesMatchesScalar();
+	testCullSpheresMatchesScalar();
+	testVisibleCornerNeverCulled();
+	return checkResult("FrustumTests");
+}
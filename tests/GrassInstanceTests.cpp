@@ -0,0 +1,182 @@
+#include "Check.h"
+#include "GrassInstance.h"
+#include "Random.h"
+
+// Grass instance packing: half conversion and the matrix VSGrass rebuilds, against the full matrix path
+
+static float floatFromBits(unsigned int bits)
+{
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static float maxDifference(const Matrix& a, const Matrix& b)
+{
+	float worst = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float d = fabsf(a.m[i] - b.m[i]);
+		worst = d > worst ? d : worst;
+	}
+	return worst;
+}
+
+static void testHalfRoundTrip()
+{
+	int mismatches = 0;
+	int nans = 0;
+	for (unsigned int h = 0; h < 0x10000; h++)
+	{
+		float value = halfToFloat((unsigned short)h);
+		if (value != value)
+		{
+			// NaN stays NaN, the payload is not kept
+			unsigned short back = floatToHalf(value);
+			nans += ((back & 0x7c00) == 0x7c00 && (back & 0x3ff) != 0) ? 1 : 0;
+			continue;
+		}
+		mismatches += floatToHalf(value) != h ? 1 : 0;
+	}
+	CHECK(mismatches == 0);
+	CHECK(nans == 2 * 1023);
+}
+
+static void testHalfRounding()
+{
+	// Halfway cases go to the even neighbour
+	CHECK(floatToHalf(1.0f + 1.0f / 2048.0f) == 0x3c00);
+	CHECK(floatToHalf(1.0f + 3.0f / 2048.0f) == 0x3c02);
+	CHECK(floatToHalf(1.0f + 1.0f / 2048.0f + 1.0f / 1048576.0f) == 0x3c01);
+	CHECK(floatToHalf(-1.0f - 3.0f / 2048.0f) == 0xbc02);
+	// Mantissa carry into the exponent
+	CHECK(floatToHalf(2.0f - 1.0f / 4096.0f) == 0x4000);
+	CHECK(floatToHalf(5.0f) == 0x4500 && halfToFloat(0x4500) == 5.0f);
+
+	// Every other float is rounded to its nearest half
+	RandomStream rng(16, 0, 1);
+	int notNearest = 0;
+	for (int i = 0; i < 200000; i++)
+	{
+		float value = rng.range(-70000.0f, 70000.0f) * (rng.below(2) == 0 ? 1.0f : rng.uniform() * 1e-3f);
+		unsigned short h = floatToHalf(value);
+		if ((h & 0x7c00) == 0x7c00)
+		{
+			notNearest += fabsf(value) < 65520.0f ? 1 : 0;
+			continue;
+		}
+		float error = fabsf(halfToFloat(h) - value);
+		float below = fabsf(halfToFloat((unsigned short)(h - 1)) - value);
+		float above = fabsf(halfToFloat((unsigned short)(h + 1)) - value);
+		if ((h & 0x7fff) != 0 && below < error)
+		{
+			notNearest++;
+		}
+		if ((h & 0x7fff) != 0x7bff && above < error)
+		{
+			notNearest++;
+		}
+	}
+	CHECK(notNearest == 0);
+}
+
+static void testHalfDenormals()
+{
+	float smallest = floatFromBits(0x33800000); // 2^-24
+	CHECK(floatToHalf(smallest) == 0x0001);
+	CHECK(halfToFloat(0x0001) == smallest);
+	CHECK(floatToHalf(-smallest) == 0x8001);
+	// Half of the smallest denormal is a tie with zero, which is even
+	CHECK(floatToHalf(smallest * 0.5f) == 0x0000);
+	CHECK(floatToHalf(smallest * 0.75f) == 0x0001);
+	CHECK(floatToHalf(smallest * 0.25f) == 0x0000);
+	CHECK(floatToHalf(-smallest * 0.25f) == 0x8000);
+	// Largest denormal and smallest normal
+	CHECK(floatToHalf(smallest * 1023.0f) == 0x03ff);
+	CHECK(halfToFloat(0x03ff) == smallest * 1023.0f);
+	CHECK(floatToHalf(smallest * 1024.0f) == 0x0400);
+	CHECK(floatToHalf(smallest * 1023.5f) == 0x0400);
+	// Float denormals are far below the half range
+	CHECK(floatToHalf(floatFromBits(0x00000001)) == 0x0000);
+}
+
+static void testHalfInfinity()
+{
+	float infinity = floatFromBits(0x7f800000);
+	CHECK(floatToHalf(infinity) == 0x7c00);
+	CHECK(floatToHalf(-infinity) == 0xfc00);
+	CHECK(halfToFloat(0x7c00) == infinity);
+	CHECK(halfToFloat(0xfc00) == -infinity);
+	CHECK(floatToHalf(65504.0f) == 0x7bff);
+	CHECK(floatToHalf(65519.0f) == 0x7bff);
+	// Halfway to 65536 rounds to even, which is past the largest half
+	CHECK(floatToHalf(65520.0f) == 0x7c00);
+	CHECK(floatToHalf(1e10f) == 0x7c00);
+	CHECK(floatToHalf(-1e10f) == 0xfc00);
+	unsigned short nan = floatToHalf(floatFromBits(0x7fc00000));
+	CHECK((nan & 0x7c00) == 0x7c00 && (nan & 0x3ff) != 0);
+}
+
+// generateGrass places clumps with no yaw and scale 5: the packed instance must give back exactly the matrix
+// the old path uploaded, scaling(s) * translation(p)
+static void testMatchesScaleTranslate()
+{
+	RandomStream rng(16, 0, 2);
+	int inexact = 0;
+	for (int i = 0; i < 100000; i++)
+	{
+		Vec3 position(rng.range(-200.0f, 200.0f), rng.range(-2.0f, 2.0f), rng.range(-5000.0f, 100.0f));
+		GrassInstance instance = packGrassInstance(position, 5.0f, 0.0f, rng.below(5));
+		Matrix old = Matrix::scaling(Vec3(5.0f, 5.0f, 5.0f)) * Matrix::translation(position);
+		inexact += maxDifference(grassInstanceMatrix(instance), old) != 0.0f ? 1 : 0;
+		inexact += maxDifference(grassInstanceMatrix(instance), Matrix::fromTS(position, Vec3(5.0f, 5.0f, 5.0f))) != 0.0f ? 1 : 0;
+	}
+	CHECK(inexact == 0);
+}
+
+// Any yaw and scale: within what 8 bits of yaw and a half scale can hold of Matrix::fromYawTRS
+static void testMatchesYawTRS()
+{
+	RandomStream rng(16, 0, 3);
+	const float yawStep = 6.28318530718f / 255.0f;
+	float worstRotation = 0.0f;
+	float worstTranslation = 0.0f;
+	bool typesKept = true;
+	for (int i = 0; i < 100000; i++)
+	{
+		Vec3 position(rng.range(-200.0f, 200.0f), rng.range(-2.0f, 2.0f), rng.range(-5000.0f, 100.0f));
+		float yaw = rng.range(-20.0f, 20.0f);
+		float scale = rng.range(0.5f, 10.0f);
+		int type = rng.below(256);
+		GrassInstance instance = packGrassInstance(position, scale, yaw, type);
+		typesKept = typesKept && instance.type == type;
+		Matrix packed = grassInstanceMatrix(instance);
+		Matrix full = Matrix::fromYawTRS(position, yaw, Vec3(scale, scale, scale));
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				// Entries are scale * cos or sin of the yaw: half a yaw step of angle plus the half's rounding
+				float d = fabsf(packed.a[r][c] - full.a[r][c]) / scale;
+				worstRotation = d > worstRotation ? d : worstRotation;
+			}
+			float t = fabsf(packed.a[r][3] - full.a[r][3]);
+			worstTranslation = t > worstTranslation ? t : worstTranslation;
+		}
+	}
+	CHECK(typesKept);
+	CHECK(worstTranslation == 0.0f);
+	CHECK(worstRotation <= yawStep * 0.5f + 1.0f / 1024.0f);
+	printf("  yaw/scale packing: worst rotation entry error %.5f of scale (half a yaw step is %.5f)\n", worstRotation, yawStep * 0.5f);
+}
+
+int main()
+{
+	testHalfRoundTrip();
+	testHalfRounding();
+	testHalfDenormals();
+	testHalfInfinity();
+	testMatchesScaleTranslate();
+	testMatchesYawTRS();
+	return checkResult("GrassInstanceTests");
+}
@@ -0,0 +1,242 @@
+#include "Check.h"
+#include "Lod.h"
+#include "ModelCache.h"
+#include <cstddef>
+#include <set>
+#include <string>
+#include <vector>
+
+// Level of detail: the simplifier's levels on the game's own meshes, and LodSelector's hysteresis
+
+struct LevelStats
+{
+	int meshes;
+	int levels;
+	int overTarget;
+	int notSmaller;
+	int badIndex;
+	int degenerate;
+	int duplicate;
+
+	LevelStats()
+	{
+		meshes = 0;
+		levels = 0;
+		overTarget = 0;
+		notSmaller = 0;
+		badIndex = 0;
+		degenerate = 0;
+		duplicate = 0;
+	}
+};
+
+static const Vec3& vertexPosition(const CookedMeshView& mesh, unsigned int i)
+{
+	return *reinterpret_cast<const Vec3*>(reinterpret_cast<const unsigned char*>(mesh.vertices) + (size_t)i * mesh.vertexStride);
+}
+
+static void checkLevels(const CookedMeshView& mesh, LevelStats& stats)
+{
+	// The normal follows the position in both GEM vertex layouts, as Mesh passes it
+	const int normalOffset = (int)offsetof(GEMLoader::GEMStaticVertex, normal);
+	std::vector<std::vector<unsigned int>> levels;
+	MeshSimplifier::buildLevels(mesh.vertices, (int)mesh.vertexStride, (int)mesh.vertexCount, normalOffset, mesh.indices, (int)mesh.indexCount, levels);
+	stats.meshes++;
+	const float ratios[LOD_MAX_LEVELS - 1] = { 0.5f, 0.2f };
+	int original = (int)mesh.indexCount / 3;
+	int previous = original;
+	for (int l = 0; l < (int)levels.size(); l++)
+	{
+		const std::vector<unsigned int>& level = levels[l];
+		int triangles = (int)level.size() / 3;
+		stats.levels++;
+		stats.overTarget += triangles > (int)(original * ratios[l]) ? 1 : 0;
+		stats.notSmaller += (triangles == 0 || triangles > previous * 3 / 4 || level.size() % 3 != 0) ? 1 : 0;
+		previous = triangles;
+
+		std::set<std::vector<unsigned int>> seen;
+		for (int t = 0; t + 2 < (int)level.size(); t += 3)
+		{
+			unsigned int a = level[t];
+			unsigned int b = level[t + 1];
+			unsigned int c = level[t + 2];
+			if (a >= mesh.vertexCount || b >= mesh.vertexCount || c >= mesh.vertexCount)
+			{
+				stats.badIndex++;
+				continue;
+			}
+			const Vec3& pa = vertexPosition(mesh, a);
+			const Vec3& pb = vertexPosition(mesh, b);
+			const Vec3& pc = vertexPosition(mesh, c);
+			Vec3 cross = Cross(pb - pa, pc - pa);
+			if (a == b || b == c || a == c || (cross.x == 0.0f && cross.y == 0.0f && cross.z == 0.0f))
+			{
+				stats.degenerate++;
+			}
+			// The same triangle with the same winding, from whichever corner
+			std::vector<unsigned int> key(3);
+			unsigned int smallest = a < b ? (a < c ? a : c) : (b < c ? b : c);
+			key[0] = smallest;
+			key[1] = smallest == a ? b : (smallest == b ? c : a);
+			key[2] = smallest == a ? c : (smallest == b ? a : b);
+			stats.duplicate += seen.insert(key).second ? 0 : 1;
+		}
+	}
+}
+
+// Every mesh of the models the game loads
+static void testGameMeshes()
+{
+	const char* models[] = { "Models/Duck-white.gem", "Models/Farmer-male.gem", "Models/Sheep-01.gem",
+		"Models/acacia_003.gem", "Models/road_009.gem", "Models/ground_005.gem" };
+	LevelStats stats;
+	int loaded = 0;
+	for (int m = 0; m < (int)(sizeof(models) / sizeof(models[0])); m++)
+	{
+		CookedModel model;
+		if (!model.load(models[m]))
+		{
+			continue;
+		}
+		loaded++;
+		for (int i = 0; i < (int)model.meshes.size(); i++)
+		{
+			checkLevels(model.meshes[i], stats);
+		}
+	}
+	printf("  %d meshes, %d coarse levels\n", stats.meshes, stats.levels);
+	CHECK(loaded == 6);
+	CHECK(stats.levels > stats.meshes);
+	CHECK(stats.overTarget == 0);
+	CHECK(stats.notSmaller == 0);
+	CHECK(stats.badIndex == 0);
+	CHECK(stats.degenerate == 0);
+	CHECK(stats.duplicate == 0);
+}
+
+// A finely tessellated sphere reaches both targets
+static void testSphere()
+{
+	struct Vertex
+	{
+		Vec3 position;
+		Vec3 normal;
+	};
+	const int rings = 64;
+	const int segments = 128;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	for (int r = 0; r <= rings; r++)
+	{
+		float theta = 3.14159265f * (float)r / rings;
+		for (int s = 0; s <= segments; s++)
+		{
+			float phi = 6.2831853f * (float)s / segments;
+			Vertex v;
+			v.normal = Vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			v.position = v.normal * 10.0f;
+			vertices.push_back(v);
+		}
+	}
+	for (int r = 0; r < rings; r++)
+	{
+		for (int s = 0; s < segments; s++)
+		{
+			unsigned int i0 = r * (segments + 1) + s;
+			unsigned int i1 = i0 + segments + 1;
+			indices.push_back(i0);
+			indices.push_back(i1);
+			indices.push_back(i0 + 1);
+			indices.push_back(i0 + 1);
+			indices.push_back(i1);
+			indices.push_back(i1 + 1);
+		}
+	}
+	CookedMeshView mesh;
+	mesh.vertices = vertices.data();
+	mesh.vertexCount = (unsigned int)vertices.size();
+	mesh.vertexStride = sizeof(Vertex);
+	mesh.indices = indices.data();
+	mesh.indexCount = (unsigned int)indices.size();
+	std::vector<std::vector<unsigned int>> levels;
+	MeshSimplifier::buildLevels(mesh.vertices, (int)mesh.vertexStride, (int)mesh.vertexCount, (int)offsetof(Vertex, normal), mesh.indices, (int)mesh.indexCount, levels);
+	int original = (int)indices.size() / 3;
+	CHECK(levels.size() == 2);
+	if (levels.size() == 2)
+	{
+		int half = (int)levels[0].size() / 3;
+		int fifth = (int)levels[1].size() / 3;
+		printf("  sphere: %d triangles, levels %d (%.2f) and %d (%.2f)\n", original, half, (float)half / original, fifth, (float)fifth / original);
+		CHECK(half <= original / 2 && half > original / 4);
+		CHECK(fifth <= original / 5 && fifth > original / 20);
+	}
+	// Repeated and collapsed triangles are dropped, never passed through
+	LevelStats stats;
+	checkLevels(mesh, stats);
+	CHECK(stats.degenerate == 0 && stats.duplicate == 0 && stats.badIndex == 0 && stats.overTarget == 0);
+
+	// Too little to simplify: no levels
+	unsigned int triangle[3] = { 0, 1, 2 };
+	MeshSimplifier::buildLevels(vertices.data(), sizeof(Vertex), 3, (int)offsetof(Vertex, normal), triangle, 3, levels);
+	CHECK(levels.empty());
+}
+
+static void testSelectorHysteresis()
+{
+	LodSelector selector;
+	const float edge = selector.switchSize[0];
+	int current = 0;
+	// Hovering around the switch size, inside the hysteresis band, never moves
+	int moved = 0;
+	for (int i = 0; i < 1000; i++)
+	{
+		float size = edge * (1.0f + 0.15f * sinf((float)i * 0.37f));
+		moved += selector.select(size, 3, current) != 0 ? 1 : 0;
+	}
+	CHECK(moved == 0);
+	// Exactly at the switch size, and just past it, still stays
+	CHECK(selector.select(edge, 3, current) == 0);
+	CHECK(selector.select(edge * 0.81f, 3, current) == 0);
+	// Once it is past the band it moves, and then holds the new level through the same band
+	CHECK(selector.select(edge * 0.79f, 3, current) == 1 && current == 1);
+	for (int i = 0; i < 1000; i++)
+	{
+		float size = edge * (1.0f + 0.15f * sinf((float)i * 0.37f));
+		moved += selector.select(size, 3, current) != 1 ? 1 : 0;
+	}
+	CHECK(moved == 0);
+	CHECK(selector.select(edge * 1.19f, 3, current) == 1);
+	CHECK(selector.select(edge * 1.21f, 3, current) == 0);
+
+	// A slow zoom out and back switches once each way per boundary
+	int switches = 0;
+	current = 0;
+	int last = 0;
+	for (int i = 0; i <= 2000; i++)
+	{
+		float t = i <= 1000 ? (float)i / 1000.0f : (float)(2000 - i) / 1000.0f;
+		float size = 0.2f * powf(0.05f, t); // 0.2 down to 0.01 and back
+		selector.select(size, 3, current);
+		switches += current != last ? 1 : 0;
+		last = current;
+	}
+	CHECK(switches == 4);
+	CHECK(current == 0);
+
+	// A big jump crosses several levels in one call, and the level is clamped to what the model has
+	current = 0;
+	CHECK(selector.select(0.001f, 3, current) == 2);
+	CHECK(selector.select(0.001f, 2, current) == 1 && current == 1);
+	current = 5;
+	CHECK(selector.select(1.0f, 3, current) == 0);
+	current = 2;
+	CHECK(selector.select(0.5f, 1, current) == 0);
+}
+
+int main()
+{
+	testGameMeshes();
+	testSphere();
+	testSelectorHysteresis();
+	return checkResult("LodTests");
+}
@@ -0,0 +1,305 @@
+#include "Check.h"
+#include "Maths.h"
+#include "Random.h"
+
+// Matrix products and batch transforms against plain reference code, and the inverse fast paths against the
+// general MESA inverse
+
+static float maxDifference(const Matrix& a, const Matrix& b)
+{
+	float worst = 0.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float d = fabsf(a.m[i] - b.m[i]);
+		worst = d > worst ? d : worst;
+	}
+	return worst;
+}
+
+static Vec3 randomVec(RandomStream& rng, float low, float high)
+{
+	return Vec3(rng.range(low, high), rng.range(low, high), rng.range(low, high));
+}
+
+static Matrix randomAffine(RandomStream& rng)
+{
+	return Matrix::fromEulerTRS(randomVec(rng, -50.0f, 50.0f), randomVec(rng, -3.14f, 3.14f), randomVec(rng, 0.2f, 4.0f));
+}
+
+static Matrix randomRigid(RandomStream& rng)
+{
+	return Matrix::fromEulerTRS(randomVec(rng, -50.0f, 50.0f), randomVec(rng, -3.14f, 3.14f), Vec3(1.0f, 1.0f, 1.0f));
+}
+
+static void testAffineMatchesGeneral()
+{
+	RandomStream rng(3, 0, 1);
+	float worst = 0.0f;
+	float worstIdentity = 0.0f;
+	for (int i = 0; i < 1000; i++)
+	{
+		Matrix m = randomAffine(rng);
+		Matrix general = m.invert();
+		Matrix affine;
+		CHECK(m.invertAffine(affine));
+		float d = maxDifference(affine, general);
+		worst = d > worst ? d : worst;
+		Matrix product = m.mul(affine);
+		d = maxDifference(product, Matrix());
+		worstIdentity = d > worstIdentity ? d : worstIdentity;
+	}
+	CHECK_NEAR(worst, 0.0f, 1e-4f);
+	CHECK_NEAR(worstIdentity, 0.0f, 1e-4f);
+}
+
+static void testAffineInPlace()
+{
+	RandomStream rng(3, 0, 2);
+	for (int i = 0; i < 100; i++)
+	{
+		Matrix m = randomAffine(rng);
+		Matrix expected = m.invert();
+		Matrix inPlace = m;
+		CHECK(inPlace.invertAffine(inPlace));
+		CHECK_NEAR(maxDifference(inPlace, expected), 0.0f, 1e-4f);
+	}
+}
+
+static void testAffineWritesWholeMatrix()
+{
+	RandomStream rng(3, 0, 3);
+	Matrix m = randomAffine(rng);
+	Matrix inv;
+	for (int i = 0; i < 16; i++)
+	{
+		inv.m[i] = 7.0f;
+	}
+	CHECK(m.invertAffine(inv));
+	CHECK(inv.a[3][0] == 0.0f && inv.a[3][1] == 0.0f && inv.a[3][2] == 0.0f && inv.a[3][3] == 1.0f);
+	CHECK_NEAR(maxDifference(inv, m.invert()), 0.0f, 1e-4f);
+}
+
+static void testRigidMatchesGeneral()
+{
+	RandomStream rng(3, 0, 4);
+	float worst = 0.0f;
+	for (int i = 0; i < 1000; i++)
+	{
+		Matrix m = randomRigid(rng);
+		float d = maxDifference(m.invertRigid(), m.invert());
+		worst = d > worst ? d : worst;
+	}
+	CHECK_NEAR(worst, 0.0f, 1e-4f);
+
+	// Camera views are the main user
+	Matrix view = Matrix::lookAt(Vec3(3.0f, 6.0f, 20.0f), Vec3(0.0f, 1.0f, -5.0f), Vec3(0.0f, 1.0f, 0.0f));
+	CHECK_NEAR(maxDifference(view.invertRigid(), view.invert()), 0.0f, 1e-4f);
+}
+
+static void testSingular()
+{
+	Matrix flat = Matrix::scaling(Vec3(0.0f, 1.0f, 1.0f));
+	Matrix inv = Matrix::translation(Vec3(1.0f, 2.0f, 3.0f));
+	CHECK(!flat.invertAffine(inv));
+	CHECK(maxDifference(inv, Matrix()) == 0.0f);
+	CHECK(maxDifference(flat.invertAffine(), Matrix()) == 0.0f);
+	inv = Matrix::translation(Vec3(1.0f, 2.0f, 3.0f));
+	CHECK(!flat.invert(inv));
+	CHECK(maxDifference(inv, Matrix()) == 0.0f);
+}
+
+// out = lhs * rhs written out as the row-major sum it stands for
+static Matrix referenceMul(const Matrix& lhs, const Matrix& rhs)
+{
+	Matrix out;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			double sum = 0.0;
+			for (int k = 0; k < 4; k++)
+			{
+				sum += (double)rhs.m[i * 4 + k] * (double)lhs.m[k * 4 + j];
+			}
+			out.m[i * 4 + j] = (float)sum;
+		}
+	}
+	return out;
+}
+
+static void testMulMatchesReference()
+{
+	RandomStream rng(1, 0, 3);
+	const int count = 37;
+	Matrix lhs[count];
+	Matrix rhs[count];
+	Matrix out[count];
+	float worst = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		for (int k = 0; k < 16; k++)
+		{
+			lhs[i].m[k] = rng.range(-4.0f, 4.0f);
+			rhs[i].m[k] = rng.range(-4.0f, 4.0f);
+		}
+		float d = maxDifference(lhs[i].mul(rhs[i]), referenceMul(lhs[i], rhs[i]));
+		worst = d > worst ? d : worst;
+	}
+	CHECK_NEAR(worst, 0.0f, 1e-5f);
+
+	Matrix::mulArray(lhs, rhs, out, count);
+	int wrong = 0;
+	for (int i = 0; i < count; i++)
+	{
+		wrong += maxDifference(out[i], lhs[i].mul(rhs[i])) != 0.0f ? 1 : 0;
+	}
+	Matrix::mulArray(lhs, rhs[0], out, count);
+	for (int i = 0; i < count; i++)
+	{
+		wrong += maxDifference(out[i], lhs[i].mul(rhs[0])) != 0.0f ? 1 : 0;
+	}
+	CHECK(wrong == 0);
+
+	// A chain where each product feeds the next one's left side, like a walk down a skeleton
+	Matrix chain = randomRigid(rng);
+	Matrix expected = chain;
+	for (int i = 0; i < 64; i++)
+	{
+		Matrix step = randomRigid(rng);
+		Matrix next;
+		Matrix::mul(chain, step, next);
+		chain = next;
+		expected = referenceMul(expected, step);
+	}
+	CHECK_NEAR(maxDifference(chain, expected), 0.0f, 1e-2f);
+}
+
+// The direct builders against the scaling * rotation * translation chains they replace, each built with mul
+static void testComposeMatchesChain()
+{
+	RandomStream rng(2, 0, 1);
+	float worstTRS = 0.0f;
+	float worstEuler = 0.0f;
+	float worstYaw = 0.0f;
+	float worstTS = 0.0f;
+	for (int i = 0; i < 1000; i++)
+	{
+		Vec3 t = randomVec(rng, -50.0f, 50.0f);
+		Vec3 s = randomVec(rng, 0.2f, 4.0f);
+		Vec3 euler = randomVec(rng, -3.14f, 3.14f);
+
+		// Unit for even i, otherwise up to 1.5 long: toMatrix does not normalise, so neither may fromTRS
+		Quaternion q(rng.range(-1.0f, 1.0f), rng.range(-1.0f, 1.0f), rng.range(-1.0f, 1.0f), rng.range(-1.0f, 1.0f));
+		q.Normalize();
+		float length = (i % 2) == 0 ? 1.0f : rng.range(0.5f, 1.5f);
+		q = Quaternion(q.a * length, q.b * length, q.c * length, q.d * length);
+		Matrix chain = Matrix::scaling(s).mul(q.toMatrix()).mul(Matrix::translation(t));
+		float d = maxDifference(Matrix::fromTRS(t, q, s), chain);
+		worstTRS = d > worstTRS ? d : worstTRS;
+
+		chain = Matrix::scaling(s).mul(Matrix::rotateX(euler.x)).mul(Matrix::rotateY(euler.y)).mul(Matrix::rotateZ(euler.z)).mul(Matrix::translation(t));
+		d = maxDifference(Matrix::fromEulerTRS(t, euler, s), chain);
+		worstEuler = d > worstEuler ? d : worstEuler;
+
+		chain = Matrix::scaling(s).mul(Matrix::rotateY(euler.y)).mul(Matrix::translation(t));
+		d = maxDifference(Matrix::fromYawTRS(t, euler.y, s), chain);
+		worstYaw = d > worstYaw ? d : worstYaw;
+
+		chain = Matrix::scaling(s).mul(Matrix::translation(t));
+		d = maxDifference(Matrix::fromTS(t, s), chain);
+		worstTS = d > worstTS ? d : worstTS;
+	}
+	CHECK_NEAR(worstTRS, 0.0f, 1e-5f);
+	CHECK_NEAR(worstEuler, 0.0f, 1e-5f);
+	CHECK_NEAR(worstYaw, 0.0f, 1e-5f);
+	CHECK_NEAR(worstTS, 0.0f, 1e-5f);
+}
+
+// mulAffine skips the bottom row, so on affine inputs it must give the full product, bottom row included
+static void testMulAffineMatchesMul()
+{
+	RandomStream rng(2, 0, 2);
+	float worst = 0.0f;
+	float worstReference = 0.0f;
+	for (int i = 0; i < 1000; i++)
+	{
+		Matrix lhs = Matrix::scaling(randomVec(rng, 0.2f, 4.0f)).mul(Matrix::rotateX(rng.range(-3.14f, 3.14f))).mul(Matrix::rotateZ(rng.range(-3.14f, 3.14f))).mul(Matrix::translation(randomVec(rng, -50.0f, 50.0f)));
+		Matrix rhs = Matrix::scaling(randomVec(rng, 0.2f, 4.0f)).mul(Matrix::rotateY(rng.range(-3.14f, 3.14f))).mul(Matrix::translation(randomVec(rng, -50.0f, 50.0f)));
+		Matrix affine = lhs.mulAffine(rhs);
+		float d = maxDifference(affine, lhs.mul(rhs));
+		worst = d > worst ? d : worst;
+		d = maxDifference(affine, referenceMul(lhs, rhs));
+		worstReference = d > worstReference ? d : worstReference;
+	}
+	CHECK_NEAR(worst, 0.0f, 1e-4f);
+	CHECK_NEAR(worstReference, 0.0f, 1e-4f);
+}
+
+// Every count up to 13 so the batch runs with 0 to 3 vectors after its groups of four
+static void testBatchTransforms()
+{
+	RandomStream rng(1, 0, 4);
+	int wrong = 0;
+	float worst = 0.0f;
+	for (int count = 0; count <= 13; count++)
+	{
+		Matrix w = randomAffine(rng);
+		// A projective bottom row too, so mulPoints' divide is exercised
+		Matrix projective = w;
+		projective.m[12] = rng.range(-0.01f, 0.01f);
+		projective.m[14] = rng.range(-0.01f, 0.01f);
+		Vec3 in[14];
+		Vec3 out[14];
+		Vec3 inPlace[14];
+		for (int i = 0; i < 14; i++)
+		{
+			in[i] = randomVec(rng, -10.0f, 10.0f);
+			out[i] = Vec3(99.0f, 99.0f, 99.0f);
+		}
+		const Matrix* matrices[2] = { &w, &projective };
+		for (int mi = 0; mi < 2; mi++)
+		{
+			const Matrix& m = *matrices[mi];
+			m.mulPoints(in, out, count);
+			for (int i = 0; i < count; i++)
+			{
+				Vec3 e = m.mulPoint(in[i]);
+				float d = fabsf(out[i].x - e.x) + fabsf(out[i].y - e.y) + fabsf(out[i].z - e.z);
+				worst = d > worst ? d : worst;
+			}
+			m.mulVecs(in, out, count);
+			for (int i = 0; i < count; i++)
+			{
+				Vec3 e = m.mulVec(in[i]);
+				float d = fabsf(out[i].x - e.x) + fabsf(out[i].y - e.y) + fabsf(out[i].z - e.z);
+				worst = d > worst ? d : worst;
+			}
+			// In place gives the same as out of place
+			memcpy(inPlace, in, sizeof(in));
+			m.mulPoints(inPlace, inPlace, count);
+			m.mulPoints(in, out, count);
+			for (int i = 0; i < count; i++)
+			{
+				wrong += (inPlace[i].x != out[i].x || inPlace[i].y != out[i].y || inPlace[i].z != out[i].z) ? 1 : 0;
+			}
+		}
+		// Nothing written past count
+		wrong += (out[count].x != 99.0f || out[count].y != 99.0f || out[count].z != 99.0f) ? 1 : 0;
+	}
+	CHECK(wrong == 0);
+	CHECK_NEAR(worst, 0.0f, 1e-4f);
+}
+
+int main()
+{
+	testMulMatchesReference();
+	testBatchTransforms();
+	testComposeMatchesChain();
+	testMulAffineMatchesMul();
+	testAffineMatchesGeneral();
+	testAffineInPlace();
+	testAffineWritesWholeMatrix();
+	testRigidMatchesGeneral();
+	testSingular();
+	return checkResult("MathsTests");
+}
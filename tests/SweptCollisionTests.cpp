@@ -0,0 +1,202 @@
+#include "Check.h"
+#include "SweptCollision.h"
+#include "Random.h"
+#include <vector>
+
+// CircleSweep: time of impact of a moving circle against static ones, scalar and four at a time
+
+// Time from the batch for one circle, -1 when it reported no hit
+static float batchTime(const Vec3& from, const Vec3& to, float radius, float cx, float cz, float cr)
+{
+	// Four copies so the SSE path handles it, and one more for the scalar tail
+	float x[5] = { cx, cx, cx, cx, cx };
+	float z[5] = { cz, cz, cz, cz, cz };
+	float r[5] = { cr, cr, cr, cr, cr };
+	std::vector<SweepHit> hits;
+	int added = CircleSweep::sweepCircles(from, to, radius, x, z, r, 5, hits);
+	if (added != (int)hits.size() || (added != 0 && added != 5))
+	{
+		return -2.0f;
+	}
+	for (int i = 1; i < added; i++)
+	{
+		if (hits[i].time != hits[0].time && fabsf(hits[i].time - hits[0].time) > 1e-5f)
+		{
+			return -2.0f;
+		}
+	}
+	return added == 0 ? -1.0f : hits[0].time;
+}
+
+static void testStartInside()
+{
+	Vec3 from(0.5f, 0, 0.5f);
+	Vec3 to(10.0f, 0, -3.0f);
+	CHECK(CircleSweep::timeOfImpact(from, to, 1.0f, 0.0f, 0.0f, 1.0f) == 0.0f);
+	CHECK(batchTime(from, to, 1.0f, 0.0f, 0.0f, 1.0f) == 0.0f);
+	// Overlapping and moving away is still a hit at the start
+	CHECK(CircleSweep::timeOfImpact(from, from + Vec3(5, 0, 5), 1.0f, 0.0f, 0.0f, 1.0f) == 0.0f);
+	CHECK(batchTime(from, from + Vec3(5, 0, 5), 1.0f, 0.0f, 0.0f, 1.0f) == 0.0f);
+	// Y is ignored
+	CHECK(CircleSweep::timeOfImpact(Vec3(0, 50, 0), Vec3(0, -50, 0), 1.0f, 0.0f, 0.0f, 1.0f) == 0.0f);
+}
+
+static void testGraze()
+{
+	// Passing at exactly radius + cr from the centre touches without overlapping
+	Vec3 from(-10.0f, 0, 3.0f);
+	Vec3 to(10.0f, 0, 3.0f);
+	CHECK(CircleSweep::timeOfImpact(from, to, 1.0f, 0.0f, 0.0f, 2.0f) == -1.0f);
+	CHECK(batchTime(from, to, 1.0f, 0.0f, 0.0f, 2.0f) == -1.0f);
+	// A little closer is a hit, a little further is not
+	CHECK(CircleSweep::timeOfImpact(from, to, 1.0f, 0.0f, 0.0f, 2.01f) > 0.0f);
+	CHECK(batchTime(from, to, 1.0f, 0.0f, 0.0f, 2.01f) > 0.0f);
+	CHECK(CircleSweep::timeOfImpact(from, to, 1.0f, 0.0f, 0.0f, 1.99f) == -1.0f);
+	CHECK(batchTime(from, to, 1.0f, 0.0f, 0.0f, 1.99f) == -1.0f);
+
+	// Starting exactly in contact: moving in hits at once, moving away or along the tangent does not
+	Vec3 touching(3.0f, 0, 0);
+	CHECK(CircleSweep::timeOfImpact(touching, Vec3(0, 0, 0), 1.0f, 0.0f, 0.0f, 2.0f) == 0.0f);
+	CHECK(batchTime(touching, Vec3(0, 0, 0), 1.0f, 0.0f, 0.0f, 2.0f) == 0.0f);
+	CHECK(CircleSweep::timeOfImpact(touching, Vec3(6.0f, 0, 0), 1.0f, 0.0f, 0.0f, 2.0f) == -1.0f);
+	CHECK(batchTime(touching, Vec3(6.0f, 0, 0), 1.0f, 0.0f, 0.0f, 2.0f) == -1.0f);
+	CHECK(CircleSweep::timeOfImpact(touching, Vec3(3.0f, 0, 4.0f), 1.0f, 0.0f, 0.0f, 2.0f) == -1.0f);
+	CHECK(batchTime(touching, Vec3(3.0f, 0, 4.0f), 1.0f, 0.0f, 0.0f, 2.0f) == -1.0f);
+
+	// Coming into contact exactly at the end of the step reports t = 1, stopping short is a miss
+	CHECK(CircleSweep::timeOfImpact(Vec3(10.0f, 0, 0), Vec3(3.0f, 0, 0), 1.0f, 0.0f, 0.0f, 2.0f) == 1.0f);
+	CHECK_NEAR(CircleSweep::timeOfImpact(Vec3(10.0f, 0, 0), Vec3(2.0f, 0, 0), 1.0f, 0.0f, 0.0f, 2.0f), 7.0f / 8.0f, 1e-6f);
+	CHECK(CircleSweep::timeOfImpact(Vec3(10.0f, 0, 0), Vec3(3.5f, 0, 0), 1.0f, 0.0f, 0.0f, 2.0f) == -1.0f);
+	CHECK(batchTime(Vec3(10.0f, 0, 0), Vec3(3.5f, 0, 0), 1.0f, 0.0f, 0.0f, 2.0f) == -1.0f);
+}
+
+static void testZeroMotion()
+{
+	Vec3 at(4.0f, 0, 4.0f);
+	CHECK(CircleSweep::timeOfImpact(at, at, 1.0f, 0.0f, 0.0f, 1.0f) == -1.0f);
+	CHECK(batchTime(at, at, 1.0f, 0.0f, 0.0f, 1.0f) == -1.0f);
+	CHECK(CircleSweep::timeOfImpact(at, at, 1.0f, 4.5f, 4.0f, 1.0f) == 0.0f);
+	CHECK(batchTime(at, at, 1.0f, 4.5f, 4.0f, 1.0f) == 0.0f);
+
+	// Mixed in one SSE block: the lanes that divide by a zero length must not leak NaN into the hits
+	float x[4] = { 0.0f, 4.5f, 100.0f, 4.0f };
+	float z[4] = { 0.0f, 4.0f, 100.0f, 4.0f };
+	float r[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+	std::vector<SweepHit> hits;
+	CHECK(CircleSweep::sweepCircles(at, at, 1.0f, x, z, r, 4, hits) == 2);
+	CHECK(hits.size() == 2 && hits[0].index == 1 && hits[0].time == 0.0f && hits[1].index == 3 && hits[1].time == 0.0f);
+}
+
+// One step long enough to jump right over an obstacle: the end points are both clear, the sweep is not
+static void testFastStepThrough()
+{
+	Vec3 from(0.0f, 0, 0.0f);
+	Vec3 to(0.0f, 0, -100.0f);
+	float radius = 0.5f;
+	float cx = 0.2f;
+	float cz = -50.0f;
+	float cr = 0.5f;
+	CHECK(SQ(from.x - cx) + SQ(from.z - cz) > SQ(radius + cr));
+	CHECK(SQ(to.x - cx) + SQ(to.z - cz) > SQ(radius + cr));
+	// Contact when the centres are 1 apart: z offset sqrt(1 - 0.04) before the obstacle
+	float expected = (50.0f - sqrtf(1.0f - 0.04f)) / 100.0f;
+	CHECK_NEAR(CircleSweep::timeOfImpact(from, to, radius, cx, cz, cr), expected, 1e-5f);
+	CHECK_NEAR(batchTime(from, to, radius, cx, cz, cr), expected, 1e-5f);
+
+	// A row of obstacles across the path, only the one in line is hit
+	float x[7] = { -6.0f, -4.0f, -2.0f, 0.0f, 2.0f, 4.0f, 6.0f };
+	float z[7] = { -50.0f, -50.0f, -50.0f, -50.0f, -50.0f, -50.0f, -50.0f };
+	float r[7] = { 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f };
+	std::vector<SweepHit> hits;
+	CHECK(CircleSweep::sweepCircles(from, to, radius, x, z, r, 7, hits) == 1);
+	CHECK(hits.size() == 1 && hits[0].index == 3);
+	CHECK_NEAR(hits[0].time, 0.49f, 1e-6f);
+}
+
+// Every count from 0 to 40 so the scalar tail takes 0 to 3 circles. Each circle's batch result must match
+// timeOfImpact, apart from grazes where the SSE and scalar roundings can fall either side of the contact
+static void testBatchMatchesScalar()
+{
+	RandomStream rng(22, 0, 1);
+	int wrongHit = 0;
+	int wrongTime = 0;
+	int badIndex = 0;
+	int grazes = 0;
+	int hitsSeen = 0;
+	int circles = 0;
+	std::vector<float> x, z, r;
+	std::vector<SweepHit> hits;
+	std::vector<float> found;
+	for (int round = 0; round < 20000; round++)
+	{
+		int count = round % 41;
+		Vec3 from(rng.range(-20.0f, 20.0f), 0, rng.range(-20.0f, 20.0f));
+		Vec3 to = rng.below(10) == 0 ? from : from + Vec3(rng.range(-15.0f, 15.0f), 0, rng.range(-15.0f, 15.0f));
+		float radius = rng.range(0.0f, 3.0f);
+		x.resize(count);
+		z.resize(count);
+		r.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = rng.range(-30.0f, 30.0f);
+			z[i] = rng.range(-30.0f, 30.0f);
+			r[i] = rng.below(8) == 0 ? 0.0f : rng.range(0.0f, 4.0f);
+		}
+		// Something already in the list must be kept
+		hits.assign(1, SweepHit());
+		hits[0].index = -7;
+		int added = CircleSweep::sweepCircles(from, to, radius, x.data(), z.data(), r.data(), count, hits);
+		badIndex += (hits[0].index != -7 || added != (int)hits.size() - 1) ? 1 : 0;
+		found.assign(count, -1.0f);
+		for (int h = 1; h < (int)hits.size(); h++)
+		{
+			if (hits[h].index < 0 || hits[h].index >= count || found[hits[h].index] >= 0.0f || !(hits[h].time >= 0.0f && hits[h].time <= 1.0f))
+			{
+				badIndex++;
+				continue;
+			}
+			found[hits[h].index] = hits[h].time;
+		}
+		for (int i = 0; i < count; i++)
+		{
+			float expected = CircleSweep::timeOfImpact(from, to, radius, x[i], z[i], r[i]);
+			hitsSeen += expected >= 0.0f ? 1 : 0;
+			if ((found[i] >= 0.0f) != (expected >= 0.0f))
+			{
+				// Closest approach within rounding of the contact distance, or contact within rounding of the end
+				float dx = to.x - from.x;
+				float dz = to.z - from.z;
+				float length = sqrtf(dx * dx + dz * dz);
+				float miss = length > 0.0f ? fabsf(((x[i] - from.x) * dz - (z[i] - from.z) * dx) / length) : 0.0f;
+				float reach = radius + r[i];
+				float t = found[i] >= 0.0f ? found[i] : expected;
+				if (fabsf(miss - reach) < 1e-3f || fabsf(t - 1.0f) < 1e-4f)
+				{
+					grazes++;
+				} else
+				{
+					wrongHit++;
+				}
+			} else if (expected >= 0.0f && fabsf(found[i] - expected) > 1e-4f)
+			{
+				wrongTime++;
+			}
+		}
+		circles += count;
+	}
+	CHECK(badIndex == 0);
+	CHECK(wrongHit == 0);
+	CHECK(wrongTime == 0);
+	CHECK(grazes < 10);
+	CHECK(hitsSeen > circles / 50);
+}
+
+int main()
+{
+	testStartInside();
+	testGraze();
+	testZeroMotion();
+	testFastStepThrough();
+	testBatchMatchesScalar();
+	return checkResult("SweptCollisionTests");
+}
@@ -0,0 +1,210 @@
+#include "Check.h"
+#include "UploadRing.h"
+#include "Random.h"
+#include <vector>
+
+// UploadRing: suballocation in the staging ring and retiring batches by fence value
+
+static void testAlignment()
+{
+	UploadRing ring;
+	ring.init(1024);
+	unsigned long long offset = 99;
+	CHECK(ring.allocate(3, 1, offset) && offset == 0);
+	CHECK(ring.allocate(16, 256, offset) && offset == 256);
+	CHECK(ring.allocate(1, 16, offset) && offset == 272);
+	// Padding skipped for alignment counts as used until the batch retires
+	CHECK(ring.used() == 273);
+	ring.closeBatch(1);
+	ring.retire(1);
+	CHECK(ring.used() == 0);
+	// An empty ring starts again from 0 whatever the alignment
+	CHECK(ring.allocate(8, 512, offset) && offset == 0);
+}
+
+static void testOutOfSpace()
+{
+	UploadRing ring;
+	ring.init(256);
+	unsigned long long offset = 0;
+	CHECK(ring.allocate(200, 1, offset));
+	CHECK(!ring.allocate(100, 1, offset));
+	ring.closeBatch(1);
+	CHECK(ring.oldestFence() == 1);
+	ring.retire(0);
+	CHECK(!ring.allocate(100, 1, offset));
+	CHECK(ring.used() == 200);
+	ring.retire(1);
+	CHECK(ring.used() == 0 && ring.batchesInFlight() == 0 && ring.oldestFence() == 0);
+	CHECK(ring.allocate(100, 1, offset) && offset == 0);
+}
+
+static void testWrapAround()
+{
+	UploadRing ring;
+	ring.init(256);
+	unsigned long long offset = 0;
+	CHECK(ring.allocate(100, 1, offset) && offset == 0);
+	ring.closeBatch(1);
+	CHECK(ring.allocate(100, 1, offset) && offset == 100);
+	ring.closeBatch(2);
+	ring.retire(1);
+	CHECK(ring.used() == 100);
+
+	// 80 bytes do not fit in [200, 256), they go to the start and the 56 byte tail is skipped
+	CHECK(ring.allocate(80, 1, offset) && offset == 0);
+	CHECK(ring.used() == 100 + 56 + 80);
+	// Between the wrapped head (80) and the live batch at 100 only 20 bytes are free
+	CHECK(!ring.allocate(30, 1, offset));
+	CHECK(ring.allocate(20, 1, offset) && offset == 80);
+	CHECK(!ring.allocate(1, 1, offset));
+	ring.closeBatch(3);
+	CHECK(ring.batchesInFlight() == 2);
+
+	ring.retire(2);
+	CHECK(ring.used() == 56 + 80 + 20);
+	ring.retire(3);
+	CHECK(ring.used() == 0);
+}
+
+static void testRetireOutOfOrder()
+{
+	UploadRing ring;
+	ring.init(1024);
+	unsigned long long offset = 0;
+	// Batches closed against fences that do not increase, e.g. values from a different queue
+	CHECK(ring.allocate(100, 1, offset));
+	ring.closeBatch(5);
+	CHECK(ring.allocate(100, 1, offset));
+	ring.closeBatch(3);
+	// The second batch's fence has completed but the first one's has not: nothing may be freed, the space
+	// between them is still being read
+	ring.retire(3);
+	CHECK(ring.used() == 200 && ring.batchesInFlight() == 2 && ring.oldestFence() == 5);
+	ring.retire(5);
+	CHECK(ring.used() == 0 && ring.batchesInFlight() == 0);
+
+	// A completed value past several batches frees them all at once, an older value later changes nothing
+	for (int i = 0; i < 4; i++)
+	{
+		CHECK(ring.allocate(64, 16, offset));
+		ring.closeBatch(10 + i);
+	}
+	ring.retire(12);
+	CHECK(ring.batchesInFlight() == 1 && ring.used() == 64);
+	ring.retire(11);
+	CHECK(ring.batchesInFlight() == 1 && ring.used() == 64);
+	ring.retire(13);
+	CHECK(ring.used() == 0);
+
+	// Closing with nothing allocated does not make an empty batch
+	ring.closeBatch(20);
+	CHECK(ring.batchesInFlight() == 0 && !ring.hasOpenBatch());
+}
+
+static void testBiggerThanCapacity()
+{
+	UploadRing ring;
+	ring.init(256);
+	unsigned long long offset = 7;
+	CHECK(!ring.allocate(257, 1, offset));
+	CHECK(offset == 7 && ring.used() == 0 && !ring.hasOpenBatch());
+	// The whole ring is fine when empty
+	CHECK(ring.allocate(256, 1, offset) && offset == 0);
+	ring.closeBatch(1);
+	CHECK(!ring.allocate(1000, 1, offset));
+	CHECK(ring.used() == 256 && ring.batchesInFlight() == 1);
+	ring.retire(1);
+	CHECK(ring.allocate(10, 1, offset) && offset == 0);
+}
+
+// Random uploads with two frames of GPU latency: no allocation may be misaligned, out of bounds or overlap a
+// range whose batch has not retired
+static void testRandomTraffic()
+{
+	struct Range
+	{
+		unsigned long long begin;
+		unsigned long long end;
+		unsigned long long fence;
+	};
+	const unsigned long long capacity = 1 << 16;
+	UploadRing ring;
+	ring.init(capacity);
+	RandomStream rng(10, 0, 1);
+	std::vector<Range> live;
+	unsigned long long fence = 0;
+	unsigned long long completed = 0;
+	int allocations = 0;
+	int bad = 0;
+	for (int op = 0; op < 200000; op++)
+	{
+		int action = rng.below(10);
+		if (action < 7)
+		{
+			unsigned long long size = 1 + (unsigned long long)rng.below(rng.below(8) == 0 ? 20000 : 600);
+			unsigned long long alignment = 1ull << rng.below(10);
+			unsigned long long offset = 0;
+			if (!ring.allocate(size, alignment, offset))
+			{
+				continue;
+			}
+			allocations++;
+			if ((offset & (alignment - 1)) != 0 || offset + size > capacity)
+			{
+				bad++;
+			}
+			for (int i = 0; i < (int)live.size(); i++)
+			{
+				if (offset < live[i].end && live[i].begin < offset + size)
+				{
+					bad++;
+				}
+			}
+			Range range;
+			range.begin = offset;
+			range.end = offset + size;
+			range.fence = fence + 1;
+			live.push_back(range);
+		} else if (action < 9)
+		{
+			if (ring.hasOpenBatch())
+			{
+				fence++;
+				ring.closeBatch(fence);
+			}
+		} else
+		{
+			completed = fence > 2 ? fence - 2 : completed;
+			ring.retire(completed);
+			for (int i = 0; i < (int)live.size(); i++)
+			{
+				if (live[i].fence <= completed)
+				{
+					live[i] = live.back();
+					live.pop_back();
+					i--;
+				}
+			}
+		}
+	}
+	CHECK(allocations > 50000);
+	CHECK(bad == 0);
+	fence++;
+	ring.closeBatch(fence);
+	ring.retire(fence);
+	CHECK(ring.used() == 0 && ring.batchesInFlight() == 0);
+	unsigned long long offset = 1;
+	CHECK(ring.allocate(capacity, 256, offset) && offset == 0);
+}
+
+int main()
+{
+	testAlignment();
+	testOutOfSpace();
+	testWrapAround();
+	testRetireOutOfOrder();
+	testBiggerThanCapacity();
+	testRandomTraffic();
+	return checkResult("UploadRingTests");
+}